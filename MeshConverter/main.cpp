@@ -0,0 +1,161 @@
+#include <string>
+#include <iostream>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include "MeshData.h"
+#include "MeshFile.h"
+#include "MeshImporter.h"
+#include "MeshOptimizer.h"
+#include "MeshletBuilder.h"
+#include "MeshSimplifier.h"
+#include "JobSystem.h"
+
+// Offline tool converting source meshes into the binary mesh file format
+// loaded by VulkanBufferFactory::CreateMeshFromFile
+//
+// Usage: MeshConverter <input.obj|.gltf|.glb|.mesh> <output.mesh> [-bench N] [-nooptimize] [-quantize] [-rawindices] [-nomeshlets] [-nolods]
+//
+// -bench N imports the source N extra times and reports the best import throughput
+// -nooptimize keeps the authored triangle and vertex order
+// -quantize writes the QuantizedVertex layout, a .mesh input can be used to quantize existing files
+// -rawindices stores the index stream without delta/zigzag encoding
+// -nomeshlets leaves out the meshlet table used for cluster culling
+// -nolods skips generating the simplified levels of detail
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		std::cout << "Usage: MeshConverter <input.obj|.gltf|.glb|.mesh> <output.mesh> [-bench N] [-nooptimize] [-quantize] [-rawindices] [-nomeshlets] [-nolods]\n";
+		return -1;
+	}
+	std::string inPath = argv[1];
+	std::string outPath = argv[2];
+	int benchRuns = 0;
+	bool optimize = true;
+	bool quantize = false;
+	bool encodeIndices = true;
+	bool buildMeshlets = true;
+	bool buildLods = true;
+	for (int i = 3; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "-bench" && i + 1 < argc)
+			benchRuns = std::max(0, atoi(argv[++i]));
+		else if (arg == "-nooptimize")
+			optimize = false;
+		else if (arg == "-quantize")
+			quantize = true;
+		else if (arg == "-rawindices")
+			encodeIndices = false;
+		else if (arg == "-nomeshlets")
+			buildMeshlets = false;
+		else if (arg == "-nolods")
+			buildLods = false;
+	}
+
+	JobSystem jobSystem;
+
+	MeshData mesh;
+	MeshImporter::ImportStats stats = {};
+	bool isMeshFile = inPath.size() > 5 && inPath.compare(inPath.size() - 5, 5, ".mesh") == 0;
+	if (isMeshFile ? !MeshFile::Read(inPath, mesh) : !MeshImporter::Import(inPath, mesh, &jobSystem, &stats))
+	{
+		std::cout << "Failed to import " << inPath << "\n";
+		return -1;
+	}
+
+	if (benchRuns > 0 && !isMeshFile)
+	{
+		double bestSeconds = stats.m_seconds;
+		double totalSeconds = 0.0;
+		for (int i = 0; i < benchRuns; ++i)
+		{
+			MeshData benchMesh;
+			MeshImporter::ImportStats benchStats = {};
+			MeshImporter::Import(inPath, benchMesh, &jobSystem, &benchStats);
+			bestSeconds = std::min(bestSeconds, benchStats.m_seconds);
+			totalSeconds += benchStats.m_seconds;
+		}
+		double megaBytes = stats.m_bytesRead / (1024.0 * 1024.0);
+		std::cout << "Import benchmark (" << benchRuns << " runs, " << jobSystem.GetThreadCount() << " threads): best "
+			<< megaBytes / bestSeconds << " MB/s, average " << megaBytes / (totalSeconds / benchRuns) << " MB/s\n";
+	}
+
+	// Levels of detail are added as extra submeshes, so they get optimized like the rest
+	if (buildLods)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		MeshSimplifier::GenerateLods(mesh, MeshSimplifier::Options(), &jobSystem);
+		double simplifyMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+		std::cout << "Levels of detail:";
+		for (const MeshData::Lod& lod : mesh.m_lods)
+		{
+			size_t triangles = 0;
+			for (uint32_t s = lod.m_firstSubmesh; s < lod.m_firstSubmesh + lod.m_submeshCount; ++s)
+				triangles += mesh.m_submeshes[s].m_indexCount / 3;
+			std::cout << " " << triangles << " (error " << lod.m_error << ")";
+		}
+		if (mesh.m_lods.empty())
+			std::cout << " none, the mesh is too small";
+		std::cout << " (" << simplifyMs << " ms)\n";
+	}
+	else
+	{
+		// Drops the levels of a .mesh input
+		MeshSimplifier::Options levelZeroOnly;
+		levelZeroOnly.m_levelCount = 1;
+		MeshSimplifier::GenerateLods(mesh, levelZeroOnly);
+	}
+
+	if (optimize)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		MeshOptimizer::VertexCacheStats before, after;
+		MeshOptimizer::Optimize(mesh, MeshOptimizer::Options(), &jobSystem, &before, &after);
+		double optimizeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+		std::cout << "Vertex cache (" << MeshOptimizer::c_defaultCacheSize << " entries): ACMR " << before.m_acmr << " -> " << after.m_acmr
+			<< ", ATVR " << before.m_atvr << " -> " << after.m_atvr << " (" << optimizeMs << " ms)\n";
+	}
+
+	// 16 bit indices where possible, splitting into clusters if that pays off
+	uint32_t vertexStride = quantize ? sizeof(QuantizedVertex) : sizeof(Vertex);
+	size_t addedVertices = 0;
+	bool shortIndices = MeshOptimizer::MakeShortIndices(mesh, vertexStride, &addedVertices);
+	std::cout << "Index buffer: " << (shortIndices ? 16 : 32) << " bit, " << mesh.m_submeshes.size() << " draw ranges";
+	if (addedVertices > 0)
+		std::cout << ", " << addedVertices << " vertices duplicated by splitting";
+	std::cout << "\n";
+
+	// Meshlets index into the final buffers, so they are built last
+	if (buildMeshlets)
+	{
+		MeshletBuilder::Build(mesh, &jobSystem);
+		size_t coneCullable = std::count_if(mesh.m_meshlets.begin(), mesh.m_meshlets.end(),
+			[](const Meshlet& in_meshlet) { return in_meshlet.m_coneCutoff < 1.0f; });
+		std::cout << "Meshlets: " << mesh.m_meshlets.size() << " (" << MeshletBuilder::c_maxVertices << " vertices, "
+			<< MeshletBuilder::c_maxTriangles << " triangles max), " << coneCullable << " with a backface cone\n";
+	}
+	else
+	{
+		mesh.m_meshlets.clear();
+	}
+
+	if (!MeshFile::Write(outPath, mesh, quantize, encodeIndices))
+	{
+		std::cout << "Failed to write " << outPath << "\n";
+		return -1;
+	}
+
+	std::cout << "Converted " << inPath << " -> " << outPath << ": "
+		<< mesh.m_vertices.size() << " vertices, " << mesh.m_indices.size() / 3 << " triangles, "
+		<< mesh.m_submeshes.size() << " submeshes, " << vertexStride << " byte vertices";
+	if (!isMeshFile)
+	{
+		std::cout << " (" << stats.m_seconds * 1000.0 << " ms import, "
+			<< (stats.m_bytesRead / (1024.0 * 1024.0)) / std::max(stats.m_seconds, 1e-9) << " MB/s)";
+	}
+	std::cout << "\n";
+	return 0;
+}
@@ -0,0 +1,364 @@
+#include "Benchmarks.h"
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include "MathTypes.h"
+#include "Frustum.h"
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+#include "TransformHierarchy.h"
+#include "MatrixKernels.h"
+#include "MipGenerator.h"
+#include "DrawList.h"
+
+namespace
+{
+	const int c_runs = 20;
+
+	// Best time of c_runs in milliseconds
+	template<typename Func>
+	double BestOf(Func in_func)
+	{
+		double best = 0.0;
+		for (int i = 0; i < c_runs; ++i)
+		{
+			auto startTime = std::chrono::high_resolution_clock::now();
+			in_func();
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+			best = i == 0 ? ms : std::min(best, ms);
+		}
+		return best;
+	}
+}
+
+void Benchmarks::RunAll()
+{
+	JobSystem jobSystem;
+	FrustumCulling(1000000, jobSystem);
+	JobScheduling(100000, jobSystem);
+	TransformUpdate(100000);
+	MatrixBatches(100000);
+	MipGeneration(2048, jobSystem);
+	DrawListSort(1000000, jobSystem);
+}
+
+void Benchmarks::FrustumCulling(size_t in_objectCount, JobSystem& in_jobSystem)
+{
+	// Same setup as the uniform buffer's projection and view matrices
+	glm::mat4 projectionMatrix = glm::perspective(deg_to_rad(60.0f), 800.0f / 600.0f, 0.1f, 1000.0f);
+	glm::mat4 viewMatrix = glm::translate(glm::mat4(), glm::vec3(0.0f, 0.0f, -3.0f));
+	Frustum frustum = Frustum::FromMatrix(projectionMatrix * viewMatrix);
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> size(0.5f, 10.0f);
+	FrustumCuller culler;
+	culler.Reserve(in_objectCount);
+	std::vector<glm::vec4> spheres;
+	spheres.reserve(in_objectCount);
+	for (size_t i = 0; i < in_objectCount; ++i)
+	{
+		glm::vec3 boxMin(position(random), position(random), position(random));
+		glm::vec3 boxMax = boxMin + glm::vec3(size(random), size(random), size(random));
+		culler.Add(boxMin, boxMax);
+		glm::vec3 center = (boxMin + boxMax) * 0.5f;
+		spheres.push_back(glm::vec4(center, glm::length(boxMax - center)));
+	}
+
+	// Reference: one sphere at a time from an array of structures
+	std::vector<uint32_t> visible;
+	visible.reserve(in_objectCount);
+	double referenceMs = BestOf([&]()
+	{
+		visible.clear();
+		for (size_t i = 0; i < in_objectCount; ++i)
+		{
+			if (frustum.IntersectsSphere(glm::vec3(spheres[i]), spheres[i].w))
+				visible.push_back(static_cast<uint32_t>(i));
+		}
+	});
+	size_t referenceVisible = visible.size();
+
+	double singleMs = BestOf([&]() { culler.Cull(frustum, visible); });
+	double parallelMs = BestOf([&]() { culler.Cull(frustum, visible, &in_jobSystem); });
+
+	std::cout << "Frustum culling " << in_objectCount << " objects: " << visible.size() << " visible (" << referenceVisible
+		<< " by sphere only)\n"
+		<< "  scalar spheres:       " << referenceMs << " ms\n"
+		<< "  batched, 1 thread:    " << singleMs << " ms\n"
+		<< "  batched, " << in_jobSystem.GetThreadCount() << " threads:   " << parallelMs << " ms\n";
+}
+
+void Benchmarks::JobScheduling(size_t in_jobCount, JobSystem& in_jobSystem)
+{
+	std::atomic<size_t> executed(0);
+	auto emptyJob = [&executed]() { executed.fetch_add(1, std::memory_order_relaxed); };
+
+	double mainMs = BestOf([&]()
+	{
+		JobCounter counter;
+		for (size_t i = 0; i < in_jobCount; ++i)
+			in_jobSystem.Run(emptyJob, &counter);
+		in_jobSystem.Wait(counter);
+	});
+
+	// A few jobs that each queue their share, on their own deques
+	const size_t spawnerCount = 64;
+	double nestedMs = BestOf([&]()
+	{
+		JobCounter counter;
+		for (size_t spawner = 0; spawner < spawnerCount; ++spawner)
+		{
+			in_jobSystem.Run([&]()
+			{
+				for (size_t i = 0; i < in_jobCount / spawnerCount; ++i)
+					in_jobSystem.Run(emptyJob, &counter);
+			}, &counter);
+		}
+		in_jobSystem.Wait(counter);
+	});
+
+	// Jobs released by a counter they depend on
+	double dependentMs = BestOf([&]()
+	{
+		JobCounter first, second;
+		in_jobSystem.Run(emptyJob, &first);
+		for (size_t i = 0; i < in_jobCount; ++i)
+			in_jobSystem.Run(emptyJob, &second, &first);
+		in_jobSystem.Wait(second);
+	});
+
+	double nsPerJob = 1000000.0 / in_jobCount;
+	std::cout << "Job scheduling " << in_jobCount << " empty jobs, " << in_jobSystem.GetThreadCount() << " threads:\n"
+		<< "  queued from main:     " << mainMs * nsPerJob << " ns/job\n"
+		<< "  queued from jobs:     " << nestedMs * nsPerJob << " ns/job\n"
+		<< "  behind a dependency:  " << dependentMs * nsPerJob << " ns/job\n";
+}
+
+void Benchmarks::TransformUpdate(size_t in_nodeCount)
+{
+	struct Node
+	{
+		uint32_t  m_parent;
+		glm::vec3 m_position;
+		glm::quat m_rotation;
+		glm::vec3 m_scale;
+	};
+
+	// Every node under a random earlier one, so node 0 is the root of all
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<Node> nodes(in_nodeCount);
+	TransformHierarchy hierarchy;
+	hierarchy.Reserve(in_nodeCount);
+	for (size_t i = 0; i < in_nodeCount; ++i)
+	{
+		Node& node = nodes[i];
+		node.m_parent = i == 0 ? TransformHierarchy::c_noParent : std::uniform_int_distribution<uint32_t>(0, static_cast<uint32_t>(i) - 1)(random);
+		node.m_position = glm::vec3(unit(random), unit(random), unit(random));
+		node.m_rotation = glm::angleAxis(unit(random) * 3.14159f, glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.0f, 2.0f, 0.0f)));
+		node.m_scale = glm::vec3(1.0f + unit(random) * 0.01f);
+		hierarchy.Add(node.m_parent, node.m_position, node.m_rotation, node.m_scale);
+	}
+	hierarchy.Update();
+
+	std::vector<glm::mat4> world(in_nodeCount);
+	double referenceMs = BestOf([&]()
+	{
+		for (size_t i = 0; i < in_nodeCount; ++i)
+		{
+			const Node& node = nodes[i];
+			glm::mat4 local = glm::translate(glm::mat4(), node.m_position) * glm::mat4_cast(node.m_rotation) * glm::scale(glm::mat4(), node.m_scale);
+			world[i] = node.m_parent == TransformHierarchy::c_noParent ? local : world[node.m_parent] * local;
+		}
+	});
+
+	size_t fullCount = 0;
+	double fullMs = BestOf([&]()
+	{
+		hierarchy.SetPosition(0, nodes[0].m_position);
+		fullCount = hierarchy.Update();
+	});
+
+	std::vector<uint32_t> changed;
+	for (size_t i = 0; i < in_nodeCount / 100; ++i)
+		changed.push_back(std::uniform_int_distribution<uint32_t>(0, static_cast<uint32_t>(in_nodeCount) - 1)(random));
+	size_t partialCount = 0;
+	double partialMs = BestOf([&]()
+	{
+		for (uint32_t node : changed)
+			hierarchy.SetPosition(node, nodes[node].m_position);
+		partialCount = hierarchy.Update();
+	});
+
+	float maxError = 0.0f;
+	for (size_t i = 0; i < in_nodeCount; ++i)
+	{
+		for (int c = 0; c < 4; ++c)
+			maxError = std::max(maxError, glm::length(world[i][c] - hierarchy.GetWorldMatrix(static_cast<uint32_t>(i))[c]));
+	}
+
+	std::cout << "Transform update " << in_nodeCount << " nodes (max difference " << maxError << "):\n"
+		<< "  glm, structures:      " << referenceMs << " ms\n"
+		<< "  all changed:          " << fullMs << " ms, " << fullCount << " recomputed\n"
+		<< "  1% changed:           " << partialMs << " ms, " << partialCount << " recomputed\n";
+}
+
+void Benchmarks::MatrixBatches(size_t in_count)
+{
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	glm::mat4 viewProjection = glm::perspective(deg_to_rad(60.0f), 800.0f / 600.0f, 0.1f, 1000.0f) *
+		glm::translate(glm::mat4(), glm::vec3(0.0f, 0.0f, -3.0f));
+	glm::mat4 affine = glm::rotate(glm::translate(glm::mat4(), glm::vec3(1.0f, 2.0f, 3.0f)), 0.5f, glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f)));
+	std::vector<glm::mat4> worlds(in_count), results(in_count);
+	std::vector<glm::vec3> points(in_count), transformed(in_count), boxMin(in_count), boxMax(in_count), outMin(in_count), outMax(in_count);
+	for (size_t i = 0; i < in_count; ++i)
+	{
+		worlds[i] = glm::translate(glm::mat4(), glm::vec3(unit(random), unit(random), unit(random)) * 100.0f);
+		points[i] = glm::vec3(unit(random), unit(random), unit(random));
+		boxMin[i] = points[i];
+		boxMax[i] = points[i] + glm::vec3(1.0f + unit(random), 1.0f + unit(random), 1.0f + unit(random));
+	}
+
+	double multiplyGlmMs = BestOf([&]()
+	{
+		for (size_t i = 0; i < in_count; ++i)
+			results[i] = viewProjection * worlds[i];
+	});
+	double multiplyBatchMs = BestOf([&]() { MatrixKernels::MultiplyBatch(viewProjection, worlds.data(), results.data(), in_count); });
+
+	double pointsGlmMs = BestOf([&]()
+	{
+		for (size_t i = 0; i < in_count; ++i)
+			transformed[i] = glm::vec3(affine * glm::vec4(points[i], 1.0f));
+	});
+	double pointsBatchMs = BestOf([&]() { MatrixKernels::TransformPoints(affine, points.data(), transformed.data(), in_count); });
+
+	// Reference: the eight corners of each box
+	double boxesGlmMs = BestOf([&]()
+	{
+		for (size_t i = 0; i < in_count; ++i)
+		{
+			glm::vec3 newMin(FLT_MAX), newMax(-FLT_MAX);
+			for (int corner = 0; corner < 8; ++corner)
+			{
+				glm::vec3 point((corner & 1) ? boxMax[i].x : boxMin[i].x, (corner & 2) ? boxMax[i].y : boxMin[i].y, (corner & 4) ? boxMax[i].z : boxMin[i].z);
+				glm::vec3 moved = glm::vec3(affine * glm::vec4(point, 1.0f));
+				newMin = glm::min(newMin, moved);
+				newMax = glm::max(newMax, moved);
+			}
+			outMin[i] = newMin;
+			outMax[i] = newMax;
+		}
+	});
+	double boxesBatchMs = BestOf([&]() { MatrixKernels::TransformAabbs(affine, boxMin.data(), boxMax.data(), outMin.data(), outMax.data(), in_count); });
+
+	std::cout << "Matrix batches of " << in_count << ", glm one at a time / batch kernel:\n"
+		<< "  view projection * world: " << multiplyGlmMs << " / " << multiplyBatchMs << " ms\n"
+		<< "  transform points:        " << pointsGlmMs << " / " << pointsBatchMs << " ms\n"
+		<< "  transform boxes:         " << boxesGlmMs << " / " << boxesBatchMs << " ms\n";
+}
+
+void Benchmarks::MipGeneration(uint32_t in_size, JobSystem& in_jobSystem)
+{
+	std::mt19937 random(1234);
+	std::vector<uint8_t> image(size_t(in_size) * in_size * 4);
+	for (uint8_t& channel : image)
+		channel = static_cast<uint8_t>(random());
+	std::vector<uint8_t> levels;
+	MipGenerator::GenerateChain(VK_FORMAT_R8G8B8A8_UNORM, image.data(), in_size, in_size, levels);
+
+	// Reference: every channel of every texel on its own
+	std::vector<uint8_t> referenceLevels(levels.size());
+	double referenceMs = BestOf([&]()
+	{
+		const uint8_t* src = image.data();
+		uint8_t* dst = referenceLevels.data();
+		for (uint32_t size = in_size; size > 1; size /= 2)
+		{
+			uint32_t dstSize = size / 2;
+			for (uint32_t y = 0; y < dstSize; ++y)
+			{
+				for (uint32_t x = 0; x < dstSize; ++x)
+				{
+					for (uint32_t c = 0; c < 4; ++c)
+					{
+						const uint8_t* texel = src + ((y * 2) * size + x * 2) * 4 + c;
+						dst[(y * dstSize + x) * 4 + c] = static_cast<uint8_t>((texel[0] + texel[4] + texel[size * 4] + texel[size * 4 + 4] + 2) >> 2);
+					}
+				}
+			}
+			src = dst;
+			dst += size_t(dstSize) * dstSize * 4;
+		}
+	});
+
+	double singleMs = BestOf([&]() { MipGenerator::GenerateChain(VK_FORMAT_R8G8B8A8_UNORM, image.data(), in_size, in_size, levels); });
+	double parallelMs = BestOf([&]() { MipGenerator::GenerateChain(VK_FORMAT_R8G8B8A8_UNORM, image.data(), in_size, in_size, levels, &in_jobSystem); });
+
+	std::cout << "Mip chain of a " << in_size << "x" << in_size << " RGBA8 image" << (levels == referenceLevels ? "" : " (MISMATCH)") << "\n"
+		<< "  scalar:               " << referenceMs << " ms\n"
+		<< "  SIMD, 1 thread:       " << singleMs << " ms\n"
+		<< "  SIMD, " << in_jobSystem.GetThreadCount() << " threads:      " << parallelMs << " ms\n";
+}
+
+void Benchmarks::DrawListSort(size_t in_drawCount, JobSystem& in_jobSystem)
+{
+	// A few pipelines, more materials and meshes, depth anywhere
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<uint32_t> pipeline(0, 7);
+	std::uniform_int_distribution<uint32_t> material(0, 255);
+	std::uniform_int_distribution<uint32_t> mesh(0, 1023);
+	std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+	DrawList drawList;
+	drawList.Reserve(in_drawCount);
+	for (size_t i = 0; i < in_drawCount; ++i)
+		drawList.Add(DrawList::MakeKey(pipeline(random), material(random), mesh(random), depth(random)));
+
+	// Reference: the draw indices stable sorted by key
+	std::vector<uint32_t> referenceOrder(in_drawCount);
+	double referenceMs = BestOf([&]()
+	{
+		for (size_t i = 0; i < in_drawCount; ++i)
+			referenceOrder[i] = static_cast<uint32_t>(i);
+		std::stable_sort(referenceOrder.begin(), referenceOrder.end(),
+			[&](uint32_t in_a, uint32_t in_b) { return drawList.GetKey(in_a) < drawList.GetKey(in_b); });
+	});
+
+	double singleMs = BestOf([&]() { drawList.Sort(); });
+	bool match = drawList.GetOrder() == referenceOrder;
+	double parallelMs = BestOf([&]() { drawList.Sort(&in_jobSystem); });
+	match &= drawList.GetOrder() == referenceOrder;
+
+	// Binds when recording, a state is bound when it differs from the previous draw's
+	auto countBinds = [&](const std::vector<uint32_t>& in_order, size_t& out_pipelines, size_t& out_materials, size_t& out_meshes)
+	{
+		out_pipelines = out_materials = out_meshes = 0;
+		for (size_t i = 0; i < in_order.size(); ++i)
+		{
+			uint64_t key = drawList.GetKey(in_order[i]);
+			uint64_t previous = i > 0 ? drawList.GetKey(in_order[i - 1]) : ~key;
+			out_pipelines += DrawList::GetPipeline(key) != DrawList::GetPipeline(previous);
+			out_materials += DrawList::GetMaterial(key) != DrawList::GetMaterial(previous);
+			out_meshes += DrawList::GetMesh(key) != DrawList::GetMesh(previous);
+		}
+	};
+	std::vector<uint32_t> submissionOrder(in_drawCount);
+	for (size_t i = 0; i < in_drawCount; ++i)
+		submissionOrder[i] = static_cast<uint32_t>(i);
+	size_t unsortedBinds[3], sortedBinds[3];
+	countBinds(submissionOrder, unsortedBinds[0], unsortedBinds[1], unsortedBinds[2]);
+	countBinds(drawList.GetOrder(), sortedBinds[0], sortedBinds[1], sortedBinds[2]);
+
+	std::cout << "Sorting " << in_drawCount << " draw keys" << (match ? "" : " (MISMATCH)") << "\n"
+		<< "  std::stable_sort:     " << referenceMs << " ms\n"
+		<< "  radix, 1 thread:      " << singleMs << " ms\n"
+		<< "  radix, " << in_jobSystem.GetThreadCount() << " threads:     " << parallelMs << " ms\n"
+		<< "  pipeline/material/mesh binds unsorted: " << unsortedBinds[0] << "/" << unsortedBinds[1] << "/" << unsortedBinds[2]
+		<< ", sorted: " << sortedBinds[0] << "/" << sortedBinds[1] << "/" << sortedBinds[2] << "\n";
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class JobSystem;
+
+// =======================================================================================
+//                                      Benchmarks
+// =======================================================================================
+
+///---------------------------------------------------------------------------------------
+/// \brief	Micro-benchmarks of engine systems, without a window or a Vulkan device
+///
+/// Run with "SimpleTest -bench", results are printed to the console.
+///---------------------------------------------------------------------------------------
+
+namespace Benchmarks
+{
+	// Run every benchmark
+	void RunAll();
+
+	// Random boxes around the camera, culled against a 60 degree perspective frustum
+	void FrustumCulling(size_t in_objectCount, JobSystem& in_jobSystem);
+
+	// Scheduling overhead per empty job, queued from the main thread, from other jobs
+	// and held back by a dependency
+	void JobScheduling(size_t in_jobCount, JobSystem& in_jobSystem);
+
+	// World matrices of a random tree, all nodes and one percent of them changed,
+	// against glm on an array of structures
+	void TransformUpdate(size_t in_nodeCount);
+
+	// The batch kernels of MatrixKernels against glm one at a time: view projection times
+	// world matrices, transforming points and transforming boxes
+	void MatrixBatches(size_t in_count);
+
+	// A full RGBA8 mip chain from an in_size square image, a scalar box filter against
+	// MipGenerator on one thread and as jobs
+	void MipGeneration(uint32_t in_size, JobSystem& in_jobSystem);
+
+	// Random draw sort keys (see DrawList), std::stable_sort against the radix sort on one thread
+	// and as jobs, and the state changes left when recording in submission and in key order
+	void DrawListSort(size_t in_drawCount, JobSystem& in_jobSystem);
+}
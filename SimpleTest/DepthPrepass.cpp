@@ -0,0 +1,84 @@
+#include "DepthPrepass.h"
+#include <algorithm>
+#include <cstring>
+#include "VulkanVertexLayout.h"
+
+void DepthPrepass::SortFrontToBack(std::vector<glm::mat4>& inout_modelViewProjections, std::vector<uint32_t>* out_order/* = nullptr*/)
+{
+	std::vector<std::pair<float, uint32_t>> keys(inout_modelViewProjections.size());
+	for (size_t i = 0; i < keys.size(); ++i)
+		keys[i] = std::make_pair(GetViewDepth(inout_modelViewProjections[i]), static_cast<uint32_t>(i));
+	std::sort(keys.begin(), keys.end());
+
+	std::vector<glm::mat4> sorted(inout_modelViewProjections.size());
+	for (size_t i = 0; i < keys.size(); ++i)
+		sorted[i] = inout_modelViewProjections[keys[i].second];
+	inout_modelViewProjections.swap(sorted);
+
+	if (out_order)
+	{
+		out_order->resize(keys.size());
+		for (size_t i = 0; i < keys.size(); ++i)
+			(*out_order)[i] = keys[i].second;
+	}
+}
+
+void DepthPrepass::GetPositionLayout(const VulkanVertexLayout& in_layout, VulkanVertexLayout& out_layout)
+{
+	out_layout.m_bindingDescriptions = in_layout.m_bindingDescriptions;
+	out_layout.m_attributeDescriptions.clear();
+	for (const VkVertexInputAttributeDescription& attribute : in_layout.m_attributeDescriptions)
+	{
+		if (attribute.location == c_positionLocation)
+			out_layout.m_attributeDescriptions.push_back(attribute);
+	}
+}
+
+void DepthPrepass::GetPositionStreamLayout(VkFormat in_format, uint32_t in_bindingId, VulkanVertexLayout& out_layout)
+{
+	out_layout.m_bindingDescriptions.resize(1);
+	out_layout.m_bindingDescriptions[0].binding = in_bindingId;
+	out_layout.m_bindingDescriptions[0].stride = GetPositionSize(in_format);
+	out_layout.m_bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	out_layout.m_attributeDescriptions.resize(1);
+	out_layout.m_attributeDescriptions[0].location = c_positionLocation;
+	out_layout.m_attributeDescriptions[0].binding = in_bindingId;
+	out_layout.m_attributeDescriptions[0].format = in_format;
+	out_layout.m_attributeDescriptions[0].offset = 0;
+}
+
+bool DepthPrepass::ExtractPositions(const uint8_t* in_vertices, uint32_t in_vertexCount, const VulkanVertexLayout& in_layout,
+	std::vector<uint8_t>& out_positions, VkFormat& out_format)
+{
+	if (in_layout.m_bindingDescriptions.empty())
+		return false;
+	const VkVertexInputAttributeDescription* position = nullptr;
+	for (const VkVertexInputAttributeDescription& attribute : in_layout.m_attributeDescriptions)
+	{
+		if (attribute.location == c_positionLocation)
+			position = &attribute;
+	}
+	uint32_t size = position ? GetPositionSize(position->format) : 0;
+	if (size == 0)
+		return false;
+
+	uint32_t stride = in_layout.m_bindingDescriptions[0].stride;
+	out_positions.resize(size_t(in_vertexCount) * size);
+	for (uint32_t i = 0; i < in_vertexCount; ++i)
+		memcpy(out_positions.data() + size_t(i) * size, in_vertices + size_t(i) * stride + position->offset, size);
+	out_format = position->format;
+	return true;
+}
+
+uint32_t DepthPrepass::GetPositionSize(VkFormat in_format)
+{
+	switch (in_format)
+	{
+	case VK_FORMAT_R32G32B32_SFLOAT:    return 12;
+	case VK_FORMAT_R32G32B32A32_SFLOAT: return 16;
+	case VK_FORMAT_R16G16B16A16_SNORM:  return 8;
+	case VK_FORMAT_R16G16B16A16_SFLOAT: return 8;
+	default:                            return 0;
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "MathTypes.h"
+
+// Lay down depth with a position only pass before shading, the main pass then only shades visible fragments
+//#define USE_DEPTH_PREPASS
+
+struct VulkanVertexLayout;
+
+// =======================================================================================
+//                                      DepthPrepass
+// =======================================================================================
+
+///---------------------------------------------------------------------------------------
+/// \brief	Helpers for drawing depth before color
+///
+/// With heavy fragment shaders every overdrawn fragment costs a full shade. A prepass
+/// draws the scene with color writes off and only positions fetched, which is cheap,
+/// and the main pass then tests EQUAL with depth writes off so each pixel is shaded
+/// once. Both passes must compute bit identical positions, the vertex shaders declare
+/// gl_Position invariant and read the same position data.
+///
+/// The prepass itself rejects more when drawn front to back, which is what
+/// SortFrontToBack is for. Whether it pays off depends on the overdraw and the shading,
+/// USE_GPU_TIMER logs the GPU time of both passes to compare with a build without it.
+///---------------------------------------------------------------------------------------
+
+namespace DepthPrepass
+{
+	// Attribute location of positions, in every vertex layout
+	const uint32_t c_positionLocation = 0;
+
+	// The view depth of the origin of in_modelViewProjection, the w of its clip position with a perspective projection
+	inline float GetViewDepth(const glm::mat4& in_modelViewProjection) { return in_modelViewProjection[3][3]; }
+
+	// Sort model-view-projection matrices by the view depth of their origins, nearest first.
+	// out_order, when given, maps the new positions to the old indices.
+	void SortFrontToBack(std::vector<glm::mat4>& inout_modelViewProjections, std::vector<uint32_t>* out_order = nullptr);
+
+	// in_layout with only the position attribute, for drawing the prepass from the full vertex buffer
+	void GetPositionLayout(const VulkanVertexLayout& in_layout, VulkanVertexLayout& out_layout);
+
+	// Layout of a tightly packed position stream of in_format
+	void GetPositionStreamLayout(VkFormat in_format, uint32_t in_bindingId, VulkanVertexLayout& out_layout);
+
+	// Copy the positions out of interleaved vertices into a packed stream. Returns false when
+	// the layout has no position attribute or it is of a format that isn't handled.
+	bool ExtractPositions(const uint8_t* in_vertices, uint32_t in_vertexCount, const VulkanVertexLayout& in_layout,
+		std::vector<uint8_t>& out_positions, VkFormat& out_format);
+
+	// Size of a vertex position format, 0 for formats that aren't handled
+	uint32_t GetPositionSize(VkFormat in_format);
+}
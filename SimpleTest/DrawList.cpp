@@ -0,0 +1,142 @@
+#include "DrawList.h"
+#include <algorithm>
+#include <functional>
+#include "JobSystem.h"
+
+namespace
+{
+	const uint32_t c_depthShift = 0;
+	const uint32_t c_meshShift = c_depthShift + DrawList::c_depthBits;
+	const uint32_t c_materialShift = c_meshShift + DrawList::c_meshBits;
+	const uint32_t c_pipelineShift = c_materialShift + DrawList::c_materialBits;
+	static_assert(c_pipelineShift + DrawList::c_pipelineBits == 64, "Sort key fields don't fill 64 bits");
+
+	const uint32_t c_radixBits = 8;
+	const uint32_t c_radixSize = 1 << c_radixBits;
+	// Fewer draws than this per block aren't worth a thread
+	const size_t c_minBlockSize = 16384;
+
+	uint64_t Field(uint32_t in_value, uint32_t in_bits, uint32_t in_shift)
+	{
+		return (uint64_t(in_value) & ((uint64_t(1) << in_bits) - 1)) << in_shift;
+	}
+
+	uint32_t GetField(uint64_t in_key, uint32_t in_bits, uint32_t in_shift)
+	{
+		return static_cast<uint32_t>((in_key >> in_shift) & ((uint64_t(1) << in_bits) - 1));
+	}
+}
+
+uint64_t DrawList::MakeKey(uint32_t in_pipeline, uint32_t in_material, uint32_t in_mesh, float in_depth)
+{
+	const uint32_t maxDepth = (1u << c_depthBits) - 1;
+	uint32_t depth = static_cast<uint32_t>(std::min(std::max(in_depth, 0.0f), 1.0f) * maxDepth);
+	return Field(in_pipeline, c_pipelineBits, c_pipelineShift) | Field(in_material, c_materialBits, c_materialShift) |
+		Field(in_mesh, c_meshBits, c_meshShift) | Field(depth, c_depthBits, c_depthShift);
+}
+
+uint32_t DrawList::GetPipeline(uint64_t in_key)
+{
+	return GetField(in_key, c_pipelineBits, c_pipelineShift);
+}
+
+uint32_t DrawList::GetMaterial(uint64_t in_key)
+{
+	return GetField(in_key, c_materialBits, c_materialShift);
+}
+
+uint32_t DrawList::GetMesh(uint64_t in_key)
+{
+	return GetField(in_key, c_meshBits, c_meshShift);
+}
+
+uint32_t DrawList::Add(uint64_t in_key)
+{
+	m_keys.push_back(in_key);
+	return static_cast<uint32_t>(m_keys.size() - 1);
+}
+
+void DrawList::Clear()
+{
+	m_keys.clear();
+	m_order.clear();
+}
+
+void DrawList::Reserve(size_t in_count)
+{
+	m_keys.reserve(in_count);
+	m_order.reserve(in_count);
+}
+
+void DrawList::Sort(JobSystem* in_jobSystem/* = nullptr*/)
+{
+	size_t count = m_keys.size();
+	m_entries.resize(count);
+	m_scratch.resize(count);
+	uint64_t differing = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		m_entries[i].m_key = m_keys[i];
+		m_entries[i].m_draw = static_cast<uint32_t>(i);
+		differing |= m_keys[i] ^ m_keys[0];
+	}
+
+	size_t blockCount = 1;
+	if (in_jobSystem)
+		blockCount = std::max<size_t>(1, std::min<size_t>(in_jobSystem->GetThreadCount(), count / c_minBlockSize));
+	m_digitOffsets.resize(blockCount * c_radixSize);
+	auto runBlocks = [&](const std::function<void(size_t in_begin, size_t in_end, uint32_t* inout_offsets)>& in_func)
+	{
+		auto runBlock = [&](size_t in_block)
+		{
+			in_func(count * in_block / blockCount, count * (in_block + 1) / blockCount, &m_digitOffsets[in_block * c_radixSize]);
+		};
+		if (blockCount == 1)
+		{
+			runBlock(0);
+			return;
+		}
+		in_jobSystem->ParallelFor(blockCount, 1, [&](size_t in_begin, size_t in_end)
+		{
+			for (size_t b = in_begin; b < in_end; ++b)
+				runBlock(b);
+		});
+	};
+
+	for (uint32_t shift = 0; shift < 64; shift += c_radixBits)
+	{
+		// Every key has the same byte here, the order stays as it is
+		if (((differing >> shift) & (c_radixSize - 1)) == 0)
+			continue;
+
+		runBlocks([&](size_t in_begin, size_t in_end, uint32_t* inout_offsets)
+		{
+			std::fill(inout_offsets, inout_offsets + c_radixSize, 0);
+			for (size_t i = in_begin; i < in_end; ++i)
+				inout_offsets[(m_entries[i].m_key >> shift) & (c_radixSize - 1)]++;
+		});
+
+		// Digit major, then block, so each block scatters after the blocks before it and the sort stays stable
+		uint32_t offset = 0;
+		for (uint32_t digit = 0; digit < c_radixSize; ++digit)
+		{
+			for (size_t b = 0; b < blockCount; ++b)
+			{
+				uint32_t digitCount = m_digitOffsets[b * c_radixSize + digit];
+				m_digitOffsets[b * c_radixSize + digit] = offset;
+				offset += digitCount;
+			}
+		}
+
+		runBlocks([&](size_t in_begin, size_t in_end, uint32_t* inout_offsets)
+		{
+			for (size_t i = in_begin; i < in_end; ++i)
+				m_scratch[inout_offsets[(m_entries[i].m_key >> shift) & (c_radixSize - 1)]++] = m_entries[i];
+		});
+		m_entries.swap(m_scratch);
+	}
+
+	m_order.resize(count);
+	for (size_t i = 0; i < count; ++i)
+		m_order[i] = m_entries[i].m_draw;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+class JobSystem;
+
+/*!
+* \class DrawList
+*
+* \brief
+*
+* Draws ordered by the state they need, so recording them binds each pipeline, material
+* and mesh as few times as possible (see VulkanCommandBufferFactory::BindStats).
+*
+* Every draw has a 64 bit sort key, most significant first:
+*   [63..56] pipeline,  8 bits
+*   [55..40] material, 16 bits
+*   [39..24] mesh,     16 bits (the vertex buffers)
+*   [23..0]  depth,    24 bits, near first
+* Sorting by key groups the draws by pipeline, the most expensive switch, then by material
+* and mesh, and front to back within a group so depth testing rejects more. The pipeline is
+* also what orders passes within a render pass, like the depth prepass before the main one.
+*
+* Sorted with a stable LSD radix sort, a byte per pass, skipping the bytes every key has in
+* common (unused fields cost nothing). Large lists are split into blocks that are
+* histogrammed and scattered in parallel as jobs.
+*/
+
+class DrawList
+{
+public:
+	static const uint32_t c_pipelineBits = 8;
+	static const uint32_t c_materialBits = 16;
+	static const uint32_t c_meshBits = 16;
+	static const uint32_t c_depthBits = 24;
+
+	// in_depth is clamped to [0, 1], the other fields are masked to their bits
+	static uint64_t MakeKey(uint32_t in_pipeline, uint32_t in_material, uint32_t in_mesh, float in_depth);
+	static uint32_t GetPipeline(uint64_t in_key);
+	static uint32_t GetMaterial(uint64_t in_key);
+	static uint32_t GetMesh(uint64_t in_key);
+
+	// Returns the draw index, which is what the sorted order lists
+	uint32_t Add(uint64_t in_key);
+
+	void Clear();
+	void Reserve(size_t in_count);
+	size_t GetCount() const { return m_keys.size(); }
+	uint64_t GetKey(uint32_t in_draw) const { return m_keys[in_draw]; }
+
+	// Draws with equal keys keep the order they were added in
+	void Sort(JobSystem* in_jobSystem = nullptr);
+
+	// Draw indices in key order, valid after Sort()
+	const std::vector<uint32_t>& GetOrder() const { return m_order; }
+
+private:
+	struct Entry
+	{
+		uint64_t m_key;
+		uint32_t m_draw;
+	};
+
+	std::vector<uint64_t> m_keys; // by draw index
+	std::vector<uint32_t> m_order;
+	std::vector<Entry>    m_entries;
+	std::vector<Entry>    m_scratch;
+	std::vector<uint32_t> m_digitOffsets; // 256 per block
+};
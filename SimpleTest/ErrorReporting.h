@@ -1,5 +1,6 @@
 #pragma once
 
+#include <Windows.h> // OutputDebugString
 #include <exception>
 #include <string>
 #include <assert.h>
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "MathTypes.h"
+
+// View frustum as six inward facing planes, extracted from a (model-)view-projection
+// matrix (Gribb & Hartmann), so the planes are in the space the matrix transforms from.
+
+struct Frustum
+{
+	enum Plane { PLANE_LEFT, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR, PLANE_COUNT };
+
+	static Frustum FromMatrix(const glm::mat4& in_matrix)
+	{
+		// glm is column major, in_matrix[column][row]
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; ++i)
+			rows[i] = glm::vec4(in_matrix[0][i], in_matrix[1][i], in_matrix[2][i], in_matrix[3][i]);
+
+		Frustum frustum;
+		frustum.m_planes[PLANE_LEFT] = rows[3] + rows[0];
+		frustum.m_planes[PLANE_RIGHT] = rows[3] - rows[0];
+		frustum.m_planes[PLANE_BOTTOM] = rows[3] + rows[1];
+		frustum.m_planes[PLANE_TOP] = rows[3] - rows[1];
+		frustum.m_planes[PLANE_NEAR] = rows[3] + rows[2]; // -1..1 depth as produced by glm::perspective
+		frustum.m_planes[PLANE_FAR] = rows[3] - rows[2];
+		for (glm::vec4& plane : frustum.m_planes)
+			plane /= glm::length(glm::vec3(plane));
+		return frustum;
+	}
+
+	bool IntersectsSphere(const glm::vec3& in_center, float in_radius) const
+	{
+		for (const glm::vec4& plane : m_planes)
+		{
+			if (glm::dot(glm::vec3(plane), in_center) + plane.w < -in_radius)
+				return false;
+		}
+		return true;
+	}
+
+	// xyz is the normal pointing into the frustum, w the distance
+	glm::vec4 m_planes[PLANE_COUNT];
+};
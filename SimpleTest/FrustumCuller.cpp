@@ -0,0 +1,250 @@
+#include "FrustumCuller.h"
+#include <algorithm>
+#include "Frustum.h"
+#include "JobSystem.h"
+
+// glm only turns on SSE2 for MSVC x86 builds with /arch:SSE2, but every x64 cpu has it
+#if GLM_ARCH & GLM_ARCH_AVX
+#	define FRUSTUM_CULLER_AVX
+#elif (GLM_ARCH & GLM_ARCH_SSE2) || defined(_M_X64) || defined(__x86_64__)
+#	define FRUSTUM_CULLER_SSE2
+#	include <emmintrin.h>
+#endif
+
+namespace
+{
+	// Objects per job, a multiple of every batch width
+	const size_t c_blockSize = 16384;
+
+#if defined(FRUSTUM_CULLER_AVX)
+	const size_t c_batchWidth = 8;
+#elif defined(FRUSTUM_CULLER_SSE2)
+	const size_t c_batchWidth = 4;
+#else
+	const size_t c_batchWidth = 1;
+#endif
+
+	bool IsOutside(const glm::vec4& in_plane, const glm::vec3& in_boxCenter, const glm::vec3& in_boxExtent,
+		const glm::vec4& in_sphere)
+	{
+		glm::vec3 normal(in_plane);
+		if (glm::dot(normal, glm::vec3(in_sphere)) + in_plane.w < -in_sphere.w)
+			return true;
+		// Distance of the box corner furthest along the normal
+		return glm::dot(normal, in_boxCenter) + glm::dot(glm::abs(normal), in_boxExtent) + in_plane.w < 0.0f;
+	}
+}
+
+FrustumCuller::FrustumCuller()
+	: m_count(0)
+{
+}
+
+uint32_t FrustumCuller::Add(const glm::vec3& in_boxMin, const glm::vec3& in_boxMax, const glm::vec4& in_sphere)
+{
+	uint32_t object = static_cast<uint32_t>(m_count++);
+	for (std::vector<float>* array : { &m_boxCenterX, &m_boxCenterY, &m_boxCenterZ, &m_boxExtentX, &m_boxExtentY,
+		&m_boxExtentZ, &m_sphereX, &m_sphereY, &m_sphereZ, &m_sphereRadius })
+	{
+		array->push_back(0.0f);
+	}
+	Set(object, in_boxMin, in_boxMax, in_sphere);
+	return object;
+}
+
+uint32_t FrustumCuller::Add(const glm::vec3& in_boxMin, const glm::vec3& in_boxMax)
+{
+	glm::vec3 center = (in_boxMin + in_boxMax) * 0.5f;
+	return Add(in_boxMin, in_boxMax, glm::vec4(center, glm::length(in_boxMax - center)));
+}
+
+void FrustumCuller::Set(uint32_t in_object, const glm::vec3& in_boxMin, const glm::vec3& in_boxMax, const glm::vec4& in_sphere)
+{
+	glm::vec3 center = (in_boxMin + in_boxMax) * 0.5f;
+	glm::vec3 extent = (in_boxMax - in_boxMin) * 0.5f;
+	m_boxCenterX[in_object] = center.x;
+	m_boxCenterY[in_object] = center.y;
+	m_boxCenterZ[in_object] = center.z;
+	m_boxExtentX[in_object] = extent.x;
+	m_boxExtentY[in_object] = extent.y;
+	m_boxExtentZ[in_object] = extent.z;
+	m_sphereX[in_object] = in_sphere.x;
+	m_sphereY[in_object] = in_sphere.y;
+	m_sphereZ[in_object] = in_sphere.z;
+	m_sphereRadius[in_object] = in_sphere.w;
+}
+
+void FrustumCuller::Clear()
+{
+	m_count = 0;
+	for (std::vector<float>* array : { &m_boxCenterX, &m_boxCenterY, &m_boxCenterZ, &m_boxExtentX, &m_boxExtentY,
+		&m_boxExtentZ, &m_sphereX, &m_sphereY, &m_sphereZ, &m_sphereRadius })
+	{
+		array->clear();
+	}
+}
+
+void FrustumCuller::Reserve(size_t in_count)
+{
+	for (std::vector<float>* array : { &m_boxCenterX, &m_boxCenterY, &m_boxCenterZ, &m_boxExtentX, &m_boxExtentY,
+		&m_boxExtentZ, &m_sphereX, &m_sphereY, &m_sphereZ, &m_sphereRadius })
+	{
+		array->reserve(in_count);
+	}
+}
+
+size_t FrustumCuller::Cull(const Frustum& in_frustum, std::vector<uint32_t>& out_visible, JobSystem* in_jobSystem/* = nullptr*/) const
+{
+	// Every block writes its visible objects at its own offset, and the blocks are packed together afterwards
+	out_visible.resize(m_count);
+	size_t blockCount = (m_count + c_blockSize - 1) / c_blockSize;
+	std::vector<size_t> blockVisible(blockCount);
+
+	auto cullBlocks = [&](size_t in_beginBlock, size_t in_endBlock)
+	{
+		for (size_t block = in_beginBlock; block < in_endBlock; ++block)
+		{
+			size_t begin = block * c_blockSize;
+			size_t end = std::min(begin + c_blockSize, m_count);
+			blockVisible[block] = CullRange(in_frustum, begin, end, out_visible.data() + begin);
+		}
+	};
+
+	if (in_jobSystem && blockCount > 1)
+		in_jobSystem->ParallelFor(blockCount, 1, cullBlocks);
+	else
+		cullBlocks(0, blockCount);
+
+	size_t visibleCount = 0;
+	for (size_t block = 0; block < blockCount; ++block)
+	{
+		const uint32_t* blockBegin = out_visible.data() + block * c_blockSize;
+		std::copy(blockBegin, blockBegin + blockVisible[block], out_visible.data() + visibleCount);
+		visibleCount += blockVisible[block];
+	}
+	out_visible.resize(visibleCount);
+	return visibleCount;
+}
+
+size_t FrustumCuller::CullRange(const Frustum& in_frustum, size_t in_begin, size_t in_end, uint32_t* out_visible) const
+{
+	size_t visibleCount = 0;
+	size_t i = in_begin;
+
+#if defined(FRUSTUM_CULLER_AVX)
+	// The plane equations broadcast to every lane, absolute normals for the box extents
+	__m256 normalX[Frustum::PLANE_COUNT], normalY[Frustum::PLANE_COUNT], normalZ[Frustum::PLANE_COUNT], distance[Frustum::PLANE_COUNT];
+	__m256 absNormalX[Frustum::PLANE_COUNT], absNormalY[Frustum::PLANE_COUNT], absNormalZ[Frustum::PLANE_COUNT];
+	for (int p = 0; p < Frustum::PLANE_COUNT; ++p)
+	{
+		const glm::vec4& plane = in_frustum.m_planes[p];
+		normalX[p] = _mm256_set1_ps(plane.x);
+		normalY[p] = _mm256_set1_ps(plane.y);
+		normalZ[p] = _mm256_set1_ps(plane.z);
+		distance[p] = _mm256_set1_ps(plane.w);
+		absNormalX[p] = _mm256_set1_ps(glm::abs(plane.x));
+		absNormalY[p] = _mm256_set1_ps(glm::abs(plane.y));
+		absNormalZ[p] = _mm256_set1_ps(glm::abs(plane.z));
+	}
+	const __m256 zero = _mm256_setzero_ps();
+
+	for (; i + c_batchWidth <= in_end; i += c_batchWidth)
+	{
+		__m256 sphereX = _mm256_loadu_ps(&m_sphereX[i]);
+		__m256 sphereY = _mm256_loadu_ps(&m_sphereY[i]);
+		__m256 sphereZ = _mm256_loadu_ps(&m_sphereZ[i]);
+		__m256 sphereRadius = _mm256_loadu_ps(&m_sphereRadius[i]);
+		__m256 boxCenterX = _mm256_loadu_ps(&m_boxCenterX[i]);
+		__m256 boxCenterY = _mm256_loadu_ps(&m_boxCenterY[i]);
+		__m256 boxCenterZ = _mm256_loadu_ps(&m_boxCenterZ[i]);
+		__m256 boxExtentX = _mm256_loadu_ps(&m_boxExtentX[i]);
+		__m256 boxExtentY = _mm256_loadu_ps(&m_boxExtentY[i]);
+		__m256 boxExtentZ = _mm256_loadu_ps(&m_boxExtentZ[i]);
+
+		__m256 outside = zero;
+		for (int p = 0; p < Frustum::PLANE_COUNT; ++p)
+		{
+			// Sphere distance + radius < 0
+			__m256 sphereDistance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(normalX[p], sphereX), _mm256_mul_ps(normalY[p], sphereY)),
+				_mm256_add_ps(_mm256_mul_ps(normalZ[p], sphereZ), _mm256_add_ps(distance[p], sphereRadius)));
+			// Box center distance + projected extent < 0
+			__m256 boxDistance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(normalX[p], boxCenterX), _mm256_mul_ps(normalY[p], boxCenterY)),
+				_mm256_add_ps(_mm256_mul_ps(normalZ[p], boxCenterZ), distance[p]));
+			boxDistance = _mm256_add_ps(boxDistance, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(absNormalX[p], boxExtentX),
+				_mm256_mul_ps(absNormalY[p], boxExtentY)), _mm256_mul_ps(absNormalZ[p], boxExtentZ)));
+			outside = _mm256_or_ps(outside, _mm256_or_ps(_mm256_cmp_ps(sphereDistance, zero, _CMP_LT_OQ),
+				_mm256_cmp_ps(boxDistance, zero, _CMP_LT_OQ)));
+		}
+
+		// Write every lane, but only advance past the visible ones
+		int visibleMask = ~_mm256_movemask_ps(outside);
+		for (uint32_t lane = 0; lane < c_batchWidth; ++lane)
+		{
+			out_visible[visibleCount] = static_cast<uint32_t>(i + lane);
+			visibleCount += (visibleMask >> lane) & 1;
+		}
+	}
+#elif defined(FRUSTUM_CULLER_SSE2)
+	__m128 normalX[Frustum::PLANE_COUNT], normalY[Frustum::PLANE_COUNT], normalZ[Frustum::PLANE_COUNT], distance[Frustum::PLANE_COUNT];
+	__m128 absNormalX[Frustum::PLANE_COUNT], absNormalY[Frustum::PLANE_COUNT], absNormalZ[Frustum::PLANE_COUNT];
+	for (int p = 0; p < Frustum::PLANE_COUNT; ++p)
+	{
+		const glm::vec4& plane = in_frustum.m_planes[p];
+		normalX[p] = _mm_set1_ps(plane.x);
+		normalY[p] = _mm_set1_ps(plane.y);
+		normalZ[p] = _mm_set1_ps(plane.z);
+		distance[p] = _mm_set1_ps(plane.w);
+		absNormalX[p] = _mm_set1_ps(glm::abs(plane.x));
+		absNormalY[p] = _mm_set1_ps(glm::abs(plane.y));
+		absNormalZ[p] = _mm_set1_ps(glm::abs(plane.z));
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	for (; i + c_batchWidth <= in_end; i += c_batchWidth)
+	{
+		__m128 sphereX = _mm_loadu_ps(&m_sphereX[i]);
+		__m128 sphereY = _mm_loadu_ps(&m_sphereY[i]);
+		__m128 sphereZ = _mm_loadu_ps(&m_sphereZ[i]);
+		__m128 sphereRadius = _mm_loadu_ps(&m_sphereRadius[i]);
+		__m128 boxCenterX = _mm_loadu_ps(&m_boxCenterX[i]);
+		__m128 boxCenterY = _mm_loadu_ps(&m_boxCenterY[i]);
+		__m128 boxCenterZ = _mm_loadu_ps(&m_boxCenterZ[i]);
+		__m128 boxExtentX = _mm_loadu_ps(&m_boxExtentX[i]);
+		__m128 boxExtentY = _mm_loadu_ps(&m_boxExtentY[i]);
+		__m128 boxExtentZ = _mm_loadu_ps(&m_boxExtentZ[i]);
+
+		__m128 outside = zero;
+		for (int p = 0; p < Frustum::PLANE_COUNT; ++p)
+		{
+			__m128 sphereDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX[p], sphereX), _mm_mul_ps(normalY[p], sphereY)),
+				_mm_add_ps(_mm_mul_ps(normalZ[p], sphereZ), _mm_add_ps(distance[p], sphereRadius)));
+			__m128 boxDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX[p], boxCenterX), _mm_mul_ps(normalY[p], boxCenterY)),
+				_mm_add_ps(_mm_mul_ps(normalZ[p], boxCenterZ), distance[p]));
+			boxDistance = _mm_add_ps(boxDistance, _mm_add_ps(_mm_add_ps(_mm_mul_ps(absNormalX[p], boxExtentX),
+				_mm_mul_ps(absNormalY[p], boxExtentY)), _mm_mul_ps(absNormalZ[p], boxExtentZ)));
+			outside = _mm_or_ps(outside, _mm_or_ps(_mm_cmplt_ps(sphereDistance, zero), _mm_cmplt_ps(boxDistance, zero)));
+		}
+
+		int visibleMask = ~_mm_movemask_ps(outside);
+		for (uint32_t lane = 0; lane < c_batchWidth; ++lane)
+		{
+			out_visible[visibleCount] = static_cast<uint32_t>(i + lane);
+			visibleCount += (visibleMask >> lane) & 1;
+		}
+	}
+#endif
+
+	// Whatever doesn't fill a batch
+	for (; i < in_end; ++i)
+	{
+		glm::vec3 boxCenter(m_boxCenterX[i], m_boxCenterY[i], m_boxCenterZ[i]);
+		glm::vec3 boxExtent(m_boxExtentX[i], m_boxExtentY[i], m_boxExtentZ[i]);
+		glm::vec4 sphere(m_sphereX[i], m_sphereY[i], m_sphereZ[i], m_sphereRadius[i]);
+		bool outside = false;
+		for (int p = 0; p < Frustum::PLANE_COUNT && !outside; ++p)
+			outside = IsOutside(in_frustum.m_planes[p], boxCenter, boxExtent, sphere);
+		if (!outside)
+			out_visible[visibleCount++] = static_cast<uint32_t>(i);
+	}
+	return visibleCount;
+}
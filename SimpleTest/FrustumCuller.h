@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "MathTypes.h"
+
+struct Frustum;
+class JobSystem;
+
+/*!
+* \class FrustumCuller
+*
+* \brief
+*
+* Batch frustum culling of object bounds, producing a compact list of the visible object indices.
+*
+* Every object has an axis aligned box and a bounding sphere, kept as structure of arrays so
+* a batch of objects is tested against one frustum plane with a few vector instructions.
+* The width follows the instruction set glm was configured for (GLM_ARCH):
+* 8 objects at a time with AVX, 4 with SSE2 (always on x64), and one at a time otherwise.
+*
+* An object is culled when its sphere or its box is fully outside one of the planes,
+* the sphere rejects fast, the box is tighter for long thin objects.
+*
+* Large batches are split into blocks that are culled in parallel as jobs.
+*/
+
+class FrustumCuller
+{
+public:
+	FrustumCuller();
+
+	// Returns the object index. The sphere (xyz center, w radius) may be looser than the box.
+	uint32_t Add(const glm::vec3& in_boxMin, const glm::vec3& in_boxMax, const glm::vec4& in_sphere);
+	// Use the sphere around the box
+	uint32_t Add(const glm::vec3& in_boxMin, const glm::vec3& in_boxMax);
+	void Set(uint32_t in_object, const glm::vec3& in_boxMin, const glm::vec3& in_boxMax, const glm::vec4& in_sphere);
+
+	void Clear();
+	void Reserve(size_t in_count);
+	size_t GetCount() const { return m_count; }
+
+	// Replaces out_visible with the indices of the objects inside or intersecting in_frustum,
+	// in ascending order. Returns the visible count.
+	size_t Cull(const Frustum& in_frustum, std::vector<uint32_t>& out_visible, JobSystem* in_jobSystem = nullptr) const;
+
+private:
+	// Culls objects [in_begin, in_end) and writes the visible ones to out_visible, returns how many
+	size_t CullRange(const Frustum& in_frustum, size_t in_begin, size_t in_end, uint32_t* out_visible) const;
+
+	size_t m_count;
+
+	// Box center and half extent
+	std::vector<float> m_boxCenterX, m_boxCenterY, m_boxCenterZ;
+	std::vector<float> m_boxExtentX, m_boxExtentY, m_boxExtentZ;
+	// Sphere center and radius
+	std::vector<float> m_sphereX, m_sphereY, m_sphereZ, m_sphereRadius;
+};
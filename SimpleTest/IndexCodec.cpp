@@ -0,0 +1,208 @@
+#include "IndexCodec.h"
+#include <cstring>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define INDEXCODEC_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	inline uint32_t ZigZag(int32_t in_value)
+	{
+		return (static_cast<uint32_t>(in_value) << 1) ^ static_cast<uint32_t>(in_value >> 31);
+	}
+
+	inline uint32_t UnZigZag(uint32_t in_value)
+	{
+		return (in_value >> 1) ^ (0u - (in_value & 1));
+	}
+
+	size_t GetBlockCount(size_t in_count)
+	{
+		return (in_count + IndexCodec::c_blockSize - 1) / IndexCodec::c_blockSize;
+	}
+
+	// Widen one block of stored values to uint32
+	void LoadBlock(const uint8_t* in_data, uint8_t in_width, uint32_t* out_values)
+	{
+		for (size_t i = 0; i < IndexCodec::c_blockSize; ++i)
+		{
+			switch (in_width)
+			{
+			case 1: out_values[i] = in_data[i]; break;
+			case 2: { uint16_t v; memcpy(&v, in_data + i * 2, 2); out_values[i] = v; break; }
+			default: memcpy(&out_values[i], in_data + i * 4, 4); break;
+			}
+		}
+	}
+
+#ifdef INDEXCODEC_SSE2
+	// Zigzag values to deltas, then running sum on top of in_previous (broadcast in all lanes)
+	inline __m128i DecodeLanes(__m128i in_zigzag, __m128i& inout_previous)
+	{
+		const __m128i one = _mm_set1_epi32(1);
+		__m128i delta = _mm_xor_si128(_mm_srli_epi32(in_zigzag, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(in_zigzag, one)));
+		delta = _mm_add_epi32(delta, _mm_slli_si128(delta, 4));
+		delta = _mm_add_epi32(delta, _mm_slli_si128(delta, 8));
+		__m128i result = _mm_add_epi32(delta, inout_previous);
+		inout_previous = _mm_shuffle_epi32(result, _MM_SHUFFLE(3, 3, 3, 3));
+		return result;
+	}
+
+	// Decode a full block of 16 values into 4 registers
+	inline void DecodeBlock(const uint8_t* in_data, uint8_t in_width, __m128i& inout_previous, __m128i* out_lanes)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		__m128i z[4];
+		if (in_width == 1)
+		{
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in_data));
+			__m128i lo = _mm_unpacklo_epi8(bytes, zero);
+			__m128i hi = _mm_unpackhi_epi8(bytes, zero);
+			z[0] = _mm_unpacklo_epi16(lo, zero);
+			z[1] = _mm_unpackhi_epi16(lo, zero);
+			z[2] = _mm_unpacklo_epi16(hi, zero);
+			z[3] = _mm_unpackhi_epi16(hi, zero);
+		}
+		else if (in_width == 2)
+		{
+			__m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in_data));
+			__m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in_data + 16));
+			z[0] = _mm_unpacklo_epi16(lo, zero);
+			z[1] = _mm_unpackhi_epi16(lo, zero);
+			z[2] = _mm_unpacklo_epi16(hi, zero);
+			z[3] = _mm_unpackhi_epi16(hi, zero);
+		}
+		else
+		{
+			for (int i = 0; i < 4; ++i)
+				z[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in_data + i * 16));
+		}
+		for (int i = 0; i < 4; ++i)
+			out_lanes[i] = DecodeLanes(z[i], inout_previous);
+	}
+
+	// Narrow 2x4 uint32 (all < 65536) to 8 uint16, SSE2 only has a signed saturating pack
+	inline __m128i PackUint16(__m128i in_lo, __m128i in_hi)
+	{
+		const __m128i bias32 = _mm_set1_epi32(0x8000);
+		const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+		__m128i packed = _mm_packs_epi32(_mm_sub_epi32(in_lo, bias32), _mm_sub_epi32(in_hi, bias32));
+		return _mm_xor_si128(packed, bias16);
+	}
+
+	inline bool FitsUint16(const __m128i* in_lanes)
+	{
+		__m128i high = _mm_or_si128(_mm_or_si128(in_lanes[0], in_lanes[1]), _mm_or_si128(in_lanes[2], in_lanes[3]));
+		high = _mm_srli_epi32(high, 16);
+		return _mm_movemask_epi8(_mm_cmpeq_epi32(high, _mm_setzero_si128())) == 0xFFFF;
+	}
+#endif
+}
+
+void IndexCodec::Encode(const uint32_t* in_indices, size_t in_count, std::vector<uint8_t>& out_data)
+{
+	size_t blockCount = GetBlockCount(in_count);
+	out_data.assign(blockCount, 0);
+	out_data.reserve(blockCount + in_count * 2);
+
+	uint32_t previous = 0;
+	uint32_t values[c_blockSize];
+	for (size_t block = 0; block < blockCount; ++block)
+	{
+		// The last block is padded with zero deltas
+		uint32_t maxValue = 0;
+		for (size_t i = 0; i < c_blockSize; ++i)
+		{
+			size_t idx = block * c_blockSize + i;
+			uint32_t index = idx < in_count ? in_indices[idx] : previous;
+			values[i] = ZigZag(static_cast<int32_t>(index - previous));
+			previous = index;
+			maxValue = std::max(maxValue, values[i]);
+		}
+
+		uint8_t width = maxValue <= 0xFF ? 1 : (maxValue <= 0xFFFF ? 2 : 4);
+		out_data[block] = width;
+		for (size_t i = 0; i < c_blockSize; ++i)
+		{
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&values[i]);
+			out_data.insert(out_data.end(), bytes, bytes + width); // little endian
+		}
+	}
+}
+
+bool IndexCodec::Decode(const uint8_t* in_data, size_t in_size, size_t in_count, uint32_t in_indexSize, void* out_indices)
+{
+	size_t blockCount = GetBlockCount(in_count);
+	if (in_size < blockCount || (in_indexSize != 2 && in_indexSize != 4)) return false;
+
+	// Check the block widths against the data size before touching any block data
+	const uint8_t* widths = in_data;
+	size_t dataSize = blockCount;
+	for (size_t block = 0; block < blockCount; ++block)
+	{
+		if (widths[block] != 1 && widths[block] != 2 && widths[block] != 4) return false;
+		dataSize += widths[block] * c_blockSize;
+	}
+	if (dataSize != in_size) return false;
+
+	const uint8_t* data = in_data + blockCount;
+	uint16_t* out16 = static_cast<uint16_t*>(out_indices);
+	uint32_t* out32 = static_cast<uint32_t*>(out_indices);
+	bool fits = true;
+
+#ifdef INDEXCODEC_SSE2
+	__m128i previous = _mm_setzero_si128();
+	size_t fullBlocks = in_count / c_blockSize;
+	for (size_t block = 0; block < fullBlocks; ++block)
+	{
+		__m128i lanes[4];
+		DecodeBlock(data, widths[block], previous, lanes);
+		data += widths[block] * c_blockSize;
+
+		size_t first = block * c_blockSize;
+		if (in_indexSize == 4)
+		{
+			for (int i = 0; i < 4; ++i)
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out32 + first + i * 4), lanes[i]);
+		}
+		else
+		{
+			fits = fits && FitsUint16(lanes);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out16 + first), PackUint16(lanes[0], lanes[1]));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out16 + first + 8), PackUint16(lanes[2], lanes[3]));
+		}
+	}
+	uint32_t previousScalar = static_cast<uint32_t>(_mm_cvtsi128_si32(previous));
+	size_t scalarBlock = fullBlocks;
+#else
+	uint32_t previousScalar = 0;
+	size_t scalarBlock = 0;
+#endif
+
+	// Remaining blocks, or everything without SSE2
+	uint32_t values[c_blockSize];
+	for (size_t block = scalarBlock; block < blockCount; ++block)
+	{
+		LoadBlock(data, widths[block], values);
+		data += widths[block] * c_blockSize;
+		for (size_t i = 0; i < c_blockSize; ++i)
+		{
+			size_t idx = block * c_blockSize + i;
+			previousScalar += UnZigZag(values[i]);
+			if (idx >= in_count) break;
+			if (in_indexSize == 4)
+			{
+				out32[idx] = previousScalar;
+			}
+			else
+			{
+				fits = fits && previousScalar <= 0xFFFF;
+				out16[idx] = static_cast<uint16_t>(previousScalar);
+			}
+		}
+	}
+	return fits;
+}
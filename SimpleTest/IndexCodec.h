@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// =======================================================================================
+//                                      IndexCodec
+// =======================================================================================
+
+///---------------------------------------------------------------------------------------
+/// \brief	Delta + zigzag coding of index buffers
+///
+/// Consecutive indices of a cache optimized mesh are close to each other, so their
+/// differences are small. Each difference is zigzag mapped to an unsigned value
+/// (0,-1,1,-2.. -> 0,1,2,3..) and stored in blocks of c_blockSize values, where each
+/// block uses the smallest byte width (1, 2 or 4) that fits all of its values.
+///
+/// [width byte per block][block data...]
+///
+/// Decoding widens a block, undoes the zigzag and prefix sums it, four lanes at a time
+/// with SSE2 where available.
+///---------------------------------------------------------------------------------------
+
+namespace IndexCodec
+{
+	const size_t c_blockSize = 16;
+
+	void Encode(const uint32_t* in_indices, size_t in_count, std::vector<uint8_t>& out_data);
+
+	// Decode in_count indices to 16 or 32 bit output, returns false if the data doesn't
+	// match the count or a value doesn't fit the output width
+	bool Decode(const uint8_t* in_data, size_t in_size, size_t in_count, uint32_t in_indexSize, void* out_indices);
+}
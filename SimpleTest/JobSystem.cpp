@@ -0,0 +1,306 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace
+{
+	// Jobs a worker deque holds, more spill over to the shared queue
+	const int64_t c_queueCapacity = 4096;
+	// Failed attempts to find a job before a worker goes to sleep
+	const int c_spinCount = 64;
+
+	// The system and queue of the current thread, if it has one
+	thread_local const JobSystem* t_jobSystem = nullptr;
+	thread_local unsigned int t_queueIdx = 0;
+}
+
+struct JobSystem::Job
+{
+	JobFunction m_function;
+	JobCounter* m_counter;
+};
+
+// Chase-Lev deque of fixed size, bottom is only touched by the owning thread
+class JobSystem::WorkQueue
+{
+public:
+	WorkQueue()
+		: m_top(0)
+		, m_bottom(0)
+	{
+		for (std::atomic<Job*>& job : m_jobs)
+			job.store(nullptr, std::memory_order_relaxed);
+	}
+
+	// Owner only, returns false when full
+	bool Push(Job* in_job)
+	{
+		int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+		int64_t top = m_top.load(std::memory_order_acquire);
+		if (bottom - top >= c_queueCapacity)
+			return false;
+		m_jobs[bottom & (c_queueCapacity - 1)].store(in_job, std::memory_order_relaxed);
+		// Publishes the job to the thieves
+		m_bottom.store(bottom + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Owner only, takes the newest job
+	Job* Pop()
+	{
+		int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+		m_bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t top = m_top.load(std::memory_order_relaxed);
+
+		Job* job = nullptr;
+		if (top <= bottom)
+		{
+			job = m_jobs[bottom & (c_queueCapacity - 1)].load(std::memory_order_relaxed);
+			if (top == bottom)
+			{
+				// Last job, race the thieves for it
+				if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+					job = nullptr;
+				m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			}
+		}
+		else
+		{
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	// Any thread, takes the oldest job
+	Job* Steal()
+	{
+		int64_t top = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t bottom = m_bottom.load(std::memory_order_acquire);
+		if (top >= bottom)
+			return nullptr;
+
+		Job* job = m_jobs[top & (c_queueCapacity - 1)].load(std::memory_order_relaxed);
+		if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return nullptr;
+		return job;
+	}
+
+private:
+	static_assert((c_queueCapacity & (c_queueCapacity - 1)) == 0, "Queue capacity must be a power of two");
+
+	// Top and bottom on separate cache lines, the thieves only write top
+	std::atomic<int64_t> m_top;
+	char                 m_padding[64];
+	std::atomic<int64_t> m_bottom;
+	std::atomic<Job*>    m_jobs[c_queueCapacity];
+};
+
+JobSystem::JobSystem(unsigned int in_workerCount/* = 0*/)
+	: m_sharedCount(0)
+	, m_queuedCount(0)
+	, m_sleepingCount(0)
+	, m_stop(false)
+{
+	unsigned int workerCount = in_workerCount;
+	if (workerCount == 0)
+		workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+	// Queue 0 is the creating thread's
+	for (unsigned int i = 0; i <= workerCount; ++i)
+		m_queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+	t_jobSystem = this;
+	t_queueIdx = 0;
+
+	m_threads.reserve(workerCount);
+	for (unsigned int i = 1; i <= workerCount; ++i)
+	{
+		m_threads.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_stop = true;
+	}
+	m_jobAvailable.notify_all();
+	for (auto& thread : m_threads)
+	{
+		thread.join();
+	}
+	if (t_jobSystem == this)
+		t_jobSystem = nullptr;
+
+	// Jobs nobody waited for are dropped
+	while (Job* job = FindJob())
+		delete job;
+}
+
+void JobSystem::Run(JobFunction in_job, JobCounter* in_counter/* = nullptr*/, JobCounter* in_dependency/* = nullptr*/)
+{
+	Job* job = new Job{ std::move(in_job), in_counter };
+	if (in_counter)
+		in_counter->m_count.fetch_add(1, std::memory_order_relaxed);
+
+	if (in_dependency)
+	{
+		// Checked under the lock, so the job is either released by the last job of the dependency or queued here
+		std::lock_guard<std::mutex> lock(in_dependency->m_mutex);
+		if (!in_dependency->IsDone())
+		{
+			in_dependency->m_dependents.push_back(job);
+			return;
+		}
+	}
+	Push(job);
+}
+
+void JobSystem::Wait(JobCounter& in_counter)
+{
+	while (!in_counter.IsDone())
+	{
+		if (Job* job = FindJob())
+			Execute(job);
+		else
+			std::this_thread::yield();
+	}
+	// The last job sets the count to zero under the lock, once we have it the counter is no longer touched
+	std::lock_guard<std::mutex> lock(in_counter.m_mutex);
+}
+
+void JobSystem::ParallelFor(size_t in_count, size_t in_grainSize, const std::function<void(size_t in_begin, size_t in_end)>& in_func)
+{
+	if (in_count == 0) return;
+
+	// A few ranges per thread so uneven ranges even out, but never below the grain size
+	size_t grainSize = std::max<size_t>(1, in_grainSize);
+	size_t rangeCount = std::min((in_count + grainSize - 1) / grainSize, size_t(GetThreadCount()) * 4);
+	size_t rangeSize = (in_count + rangeCount - 1) / rangeCount;
+
+	JobCounter counter;
+	for (size_t begin = rangeSize; begin < in_count; begin += rangeSize)
+	{
+		size_t end = std::min(begin + rangeSize, in_count);
+		Run([&in_func, begin, end]() { in_func(begin, end); }, &counter);
+	}
+
+	// First range on this thread
+	in_func(0, std::min(rangeSize, in_count));
+	Wait(counter);
+}
+
+void JobSystem::WorkerLoop(unsigned int in_queueIdx)
+{
+	t_jobSystem = this;
+	t_queueIdx = in_queueIdx;
+
+	int idleCount = 0;
+	while (!m_stop.load(std::memory_order_relaxed))
+	{
+		if (Job* job = FindJob())
+		{
+			Execute(job);
+			idleCount = 0;
+		}
+		else if (++idleCount < c_spinCount)
+		{
+			std::this_thread::yield();
+		}
+		else
+		{
+			// Counted as sleeping before checking for jobs, so Push either sees the sleeper or the sleeper sees the job
+			std::unique_lock<std::mutex> lock(m_sleepMutex);
+			m_sleepingCount.fetch_add(1);
+			m_jobAvailable.wait(lock, [this]() { return m_stop || m_queuedCount.load() > 0; });
+			m_sleepingCount.fetch_sub(1);
+			idleCount = 0;
+		}
+	}
+}
+
+void JobSystem::Push(Job* in_job)
+{
+	m_queuedCount.fetch_add(1);
+	if (t_jobSystem != this || !m_queues[t_queueIdx]->Push(in_job))
+	{
+		std::lock_guard<std::mutex> lock(m_sharedMutex);
+		m_sharedJobs.push_back(in_job);
+		m_sharedCount.fetch_add(1, std::memory_order_release);
+	}
+
+	if (m_sleepingCount.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_jobAvailable.notify_one();
+	}
+}
+
+JobSystem::Job* JobSystem::FindJob()
+{
+	Job* job = nullptr;
+	bool ownQueue = t_jobSystem == this;
+	if (ownQueue)
+		job = m_queues[t_queueIdx]->Pop();
+
+	if (!job && m_sharedCount.load(std::memory_order_acquire) > 0)
+	{
+		std::lock_guard<std::mutex> lock(m_sharedMutex);
+		if (!m_sharedJobs.empty())
+		{
+			job = m_sharedJobs.front();
+			m_sharedJobs.pop_front();
+			m_sharedCount.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+
+	// Steal, starting after our own queue so the thieves spread out
+	unsigned int queueCount = GetThreadCount();
+	unsigned int start = ownQueue ? t_queueIdx + 1 : 0;
+	for (unsigned int i = 0; !job && i < queueCount; ++i)
+	{
+		unsigned int victim = (start + i) % queueCount;
+		if (!ownQueue || victim != t_queueIdx)
+			job = m_queues[victim]->Steal();
+	}
+
+	if (job)
+		m_queuedCount.fetch_sub(1, std::memory_order_relaxed);
+	return job;
+}
+
+void JobSystem::Execute(Job* in_job)
+{
+	in_job->m_function();
+	JobCounter* counter = in_job->m_counter;
+	delete in_job;
+	if (!counter)
+		return;
+
+	// The last job reaches zero under the lock and releases the jobs depending on the group,
+	// so Run either sees the count done or has its job in the list
+	while (true)
+	{
+		int count = counter->m_count.load(std::memory_order_acquire);
+		if (count > 1)
+		{
+			if (counter->m_count.compare_exchange_weak(count, count - 1, std::memory_order_acq_rel))
+				return;
+			continue;
+		}
+
+		std::vector<Job*> dependents;
+		{
+			std::lock_guard<std::mutex> lock(counter->m_mutex);
+			// Jobs may have been added since
+			if (!counter->m_count.compare_exchange_strong(count, 0, std::memory_order_acq_rel))
+				continue;
+			dependents.swap(counter->m_dependents);
+		}
+		for (Job* dependent : dependents)
+			Push(dependent);
+		return;
+	}
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+
+class JobCounter;
+
+/*!
+* \class JobSystem
+*
+* \brief
+*
+* Work stealing job scheduler for all parallel work, the many small jobs of the engine
+* (culling, command recording, decoding) as well as the asset work of the mesh converter.
+*
+* Every worker owns a Chase-Lev deque (Chase & Lev 2005, "Dynamic Circular Work-Stealing Deque",
+* with the memory orders of Le et al. 2013). The owner pushes and pops jobs at the bottom without
+* locking, idle workers steal from the top of the others. New jobs stay on the thread that
+* spawned them, so a job that splits itself keeps its data in the local cache.
+*
+* The thread that creates the system gets a deque as well and runs jobs while it waits on a counter,
+* so it never blocks while there is work left. Other threads may also queue jobs, these go to a
+* shared queue behind a mutex.
+*
+* Workers spin briefly when there is nothing to do and then sleep until a job is queued.
+*/
+
+class JobSystem
+{
+public:
+	typedef std::function<void()> JobFunction;
+	struct Job;
+
+	// A worker count of 0 uses one worker less than there are hardware threads,
+	// as the creating thread takes part as well
+	explicit JobSystem(unsigned int in_workerCount = 0);
+	~JobSystem();
+
+	// Queue a job. in_counter is incremented now and decremented when the job is done.
+	// With in_dependency the job is held back until that counter is done.
+	void Run(JobFunction in_job, JobCounter* in_counter = nullptr, JobCounter* in_dependency = nullptr);
+
+	// Run queued jobs on the calling thread until in_counter is done
+	void Wait(JobCounter& in_counter);
+
+	// Split [0, in_count) into ranges of at least in_grainSize and return when all are done.
+	// The calling thread runs one of the ranges itself.
+	void ParallelFor(size_t in_count, size_t in_grainSize, const std::function<void(size_t in_begin, size_t in_end)>& in_func);
+
+	// Threads running jobs, including the creating thread
+	unsigned int GetThreadCount() const { return static_cast<unsigned int>(m_queues.size()); }
+
+private:
+	class WorkQueue;
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	void WorkerLoop(unsigned int in_queueIdx);
+
+	void Push(Job* in_job);
+	Job* FindJob();
+	void Execute(Job* in_job);
+
+	std::vector<std::unique_ptr<WorkQueue>> m_queues;   // [0] belongs to the creating thread
+	std::vector<std::thread>                m_threads;
+
+	// Jobs from threads without a queue of their own, or from a full queue
+	std::deque<Job*>                        m_sharedJobs;
+	std::atomic<int>                        m_sharedCount;
+	std::mutex                              m_sharedMutex;
+
+	// Jobs queued and not yet taken, lets workers sleep without missing any
+	std::atomic<int>                        m_queuedCount;
+	std::atomic<int>                        m_sleepingCount;
+	std::mutex                              m_sleepMutex;
+	std::condition_variable                 m_jobAvailable;
+	std::atomic<bool>                       m_stop;
+};
+
+/*!
+* \class JobCounter
+*
+* \brief
+*
+* Number of unfinished jobs of a group. Jobs run with a counter increment it when they are
+* queued and decrement it when they finish. Wait on it with JobSystem::Wait, or use it as the
+* dependency of other jobs, which are queued first when it reaches zero.
+*
+* A counter must outlive the jobs counting on it and the jobs depending on it.
+*/
+
+class JobCounter
+{
+public:
+	JobCounter() : m_count(0) {}
+
+	bool IsDone() const { return m_count.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	std::atomic<int>              m_count;
+	// Jobs waiting for the count to reach zero
+	std::mutex                    m_mutex;
+	std::vector<JobSystem::Job*>  m_dependents;
+};
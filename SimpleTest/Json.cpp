@@ -0,0 +1,328 @@
+#include "Json.h"
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+	const JsonValue& NullValue()
+	{
+		static const JsonValue nullValue;
+		return nullValue;
+	}
+
+	const std::string& EmptyString()
+	{
+		static const std::string emptyString;
+		return emptyString;
+	}
+
+	// Append a unicode code point as UTF-8
+	void AppendUTF8(unsigned int in_codePoint, std::string& out_string)
+	{
+		if (in_codePoint < 0x80)
+		{
+			out_string += static_cast<char>(in_codePoint);
+		}
+		else if (in_codePoint < 0x800)
+		{
+			out_string += static_cast<char>(0xC0 | (in_codePoint >> 6));
+			out_string += static_cast<char>(0x80 | (in_codePoint & 0x3F));
+		}
+		else if (in_codePoint < 0x10000)
+		{
+			out_string += static_cast<char>(0xE0 | (in_codePoint >> 12));
+			out_string += static_cast<char>(0x80 | ((in_codePoint >> 6) & 0x3F));
+			out_string += static_cast<char>(0x80 | (in_codePoint & 0x3F));
+		}
+		else
+		{
+			out_string += static_cast<char>(0xF0 | (in_codePoint >> 18));
+			out_string += static_cast<char>(0x80 | ((in_codePoint >> 12) & 0x3F));
+			out_string += static_cast<char>(0x80 | ((in_codePoint >> 6) & 0x3F));
+			out_string += static_cast<char>(0x80 | (in_codePoint & 0x3F));
+		}
+	}
+}
+
+// Recursive descent parser, kept out of the header
+class JsonParser
+{
+public:
+	JsonParser(const char* in_begin, const char* in_end)
+		: m_ptr(in_begin)
+		, m_begin(in_begin)
+		, m_end(in_end)
+	{}
+
+	bool ParseDocument(JsonValue& out_value)
+	{
+		if (!ParseValue(out_value, 0)) return false;
+		SkipSpace();
+		if (m_ptr != m_end) return Fail("Trailing characters after document");
+		return true;
+	}
+
+	std::string m_error;
+
+private:
+	static const int c_maxDepth = 256;
+
+	bool Fail(const char* in_msg)
+	{
+		std::ostringstream ss;
+		ss << in_msg << " at offset " << (m_ptr - m_begin);
+		m_error = ss.str();
+		return false;
+	}
+
+	void SkipSpace()
+	{
+		while (m_ptr < m_end && (*m_ptr == ' ' || *m_ptr == '\t' || *m_ptr == '\n' || *m_ptr == '\r')) ++m_ptr;
+	}
+
+	bool Match(const char* in_literal)
+	{
+		size_t len = strlen(in_literal);
+		if (static_cast<size_t>(m_end - m_ptr) < len || strncmp(m_ptr, in_literal, len) != 0) return false;
+		m_ptr += len;
+		return true;
+	}
+
+	bool ParseValue(JsonValue& out_value, int in_depth)
+	{
+		if (in_depth > c_maxDepth) return Fail("Document nested too deep");
+		SkipSpace();
+		if (m_ptr >= m_end) return Fail("Unexpected end of document");
+
+		switch (*m_ptr)
+		{
+		case '{': return ParseObject(out_value, in_depth);
+		case '[': return ParseArray(out_value, in_depth);
+		case '"':
+			out_value.m_type = JsonValue::STRING;
+			return ParseString(out_value.m_string);
+		case 't':
+			if (!Match("true")) return Fail("Bad literal");
+			out_value.m_type = JsonValue::BOOL;
+			out_value.m_bool = true;
+			return true;
+		case 'f':
+			if (!Match("false")) return Fail("Bad literal");
+			out_value.m_type = JsonValue::BOOL;
+			out_value.m_bool = false;
+			return true;
+		case 'n':
+			if (!Match("null")) return Fail("Bad literal");
+			out_value.m_type = JsonValue::NUL;
+			return true;
+		default:
+			return ParseNumber(out_value);
+		}
+	}
+
+	bool ParseNumber(JsonValue& out_value)
+	{
+		// strtod needs a terminated string, numbers are short so copy to a local buffer
+		char buffer[64];
+		size_t len = 0;
+		while (m_ptr + len < m_end && len < sizeof(buffer) - 1 && strchr("+-0123456789.eE", m_ptr[len]) != nullptr) ++len;
+		if (len == 0) return Fail("Unexpected character");
+		memcpy(buffer, m_ptr, len);
+		buffer[len] = '\0';
+		char* parsedEnd = nullptr;
+		out_value.m_number = strtod(buffer, &parsedEnd);
+		if (parsedEnd != buffer + len) return Fail("Bad number");
+		out_value.m_type = JsonValue::NUMBER;
+		m_ptr += len;
+		return true;
+	}
+
+	bool ParseHex4(unsigned int& out_value)
+	{
+		if (m_end - m_ptr < 4) return Fail("Bad unicode escape");
+		out_value = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			char c = *m_ptr++;
+			out_value <<= 4;
+			if (c >= '0' && c <= '9') out_value |= c - '0';
+			else if (c >= 'a' && c <= 'f') out_value |= c - 'a' + 10;
+			else if (c >= 'A' && c <= 'F') out_value |= c - 'A' + 10;
+			else return Fail("Bad unicode escape");
+		}
+		return true;
+	}
+
+	bool ParseString(std::string& out_string)
+	{
+		++m_ptr; // opening quote
+		out_string.clear();
+		while (m_ptr < m_end && *m_ptr != '"')
+		{
+			char c = *m_ptr++;
+			if (c != '\\')
+			{
+				out_string += c;
+				continue;
+			}
+			if (m_ptr >= m_end) break;
+			char escaped = *m_ptr++;
+			switch (escaped)
+			{
+			case '"': out_string += '"'; break;
+			case '\\': out_string += '\\'; break;
+			case '/': out_string += '/'; break;
+			case 'b': out_string += '\b'; break;
+			case 'f': out_string += '\f'; break;
+			case 'n': out_string += '\n'; break;
+			case 'r': out_string += '\r'; break;
+			case 't': out_string += '\t'; break;
+			case 'u':
+			{
+				unsigned int codePoint;
+				if (!ParseHex4(codePoint)) return false;
+				// Surrogate pair
+				if (codePoint >= 0xD800 && codePoint <= 0xDBFF && Match("\\u"))
+				{
+					unsigned int low;
+					if (!ParseHex4(low)) return false;
+					codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+				}
+				AppendUTF8(codePoint, out_string);
+				break;
+			}
+			default:
+				return Fail("Bad escape sequence");
+			}
+		}
+		if (m_ptr >= m_end) return Fail("Unterminated string");
+		++m_ptr; // closing quote
+		return true;
+	}
+
+	bool ParseArray(JsonValue& out_value, int in_depth)
+	{
+		++m_ptr; // [
+		out_value.m_type = JsonValue::ARRAY;
+		SkipSpace();
+		if (m_ptr < m_end && *m_ptr == ']')
+		{
+			++m_ptr;
+			return true;
+		}
+		while (true)
+		{
+			out_value.m_elements.emplace_back();
+			if (!ParseValue(out_value.m_elements.back(), in_depth + 1)) return false;
+			SkipSpace();
+			if (m_ptr >= m_end) return Fail("Unterminated array");
+			if (*m_ptr == ',') { ++m_ptr; continue; }
+			if (*m_ptr == ']') { ++m_ptr; return true; }
+			return Fail("Expected , or ] in array");
+		}
+	}
+
+	bool ParseObject(JsonValue& out_value, int in_depth)
+	{
+		++m_ptr; // {
+		out_value.m_type = JsonValue::OBJECT;
+		SkipSpace();
+		if (m_ptr < m_end && *m_ptr == '}')
+		{
+			++m_ptr;
+			return true;
+		}
+		while (true)
+		{
+			SkipSpace();
+			if (m_ptr >= m_end || *m_ptr != '"') return Fail("Expected member name");
+			out_value.m_members.emplace_back();
+			if (!ParseString(out_value.m_members.back().first)) return false;
+			SkipSpace();
+			if (m_ptr >= m_end || *m_ptr != ':') return Fail("Expected : after member name");
+			++m_ptr;
+			if (!ParseValue(out_value.m_members.back().second, in_depth + 1)) return false;
+			SkipSpace();
+			if (m_ptr >= m_end) return Fail("Unterminated object");
+			if (*m_ptr == ',') { ++m_ptr; continue; }
+			if (*m_ptr == '}') { ++m_ptr; return true; }
+			return Fail("Expected , or } in object");
+		}
+	}
+
+	const char* m_ptr;
+	const char* m_begin;
+	const char* m_end;
+};
+
+
+JsonValue::JsonValue()
+	: m_type(NUL)
+	, m_bool(false)
+	, m_number(0.0)
+{
+}
+
+bool JsonValue::Parse(const char* in_begin, const char* in_end, JsonValue& out_value, std::string& out_error)
+{
+	out_value = JsonValue();
+	JsonParser parser(in_begin, in_end);
+	if (!parser.ParseDocument(out_value))
+	{
+		out_error = parser.m_error;
+		out_value = JsonValue();
+		return false;
+	}
+	return true;
+}
+
+bool JsonValue::AsBool(bool in_default/* = false*/) const
+{
+	return m_type == BOOL ? m_bool : in_default;
+}
+
+double JsonValue::AsNumber(double in_default/* = 0.0*/) const
+{
+	return m_type == NUMBER ? m_number : in_default;
+}
+
+int JsonValue::AsInt(int in_default/* = 0*/) const
+{
+	return m_type == NUMBER ? static_cast<int>(m_number) : in_default;
+}
+
+const std::string& JsonValue::AsString() const
+{
+	return m_type == STRING ? m_string : EmptyString();
+}
+
+size_t JsonValue::Size() const
+{
+	if (m_type == ARRAY) return m_elements.size();
+	if (m_type == OBJECT) return m_members.size();
+	return 0;
+}
+
+const JsonValue& JsonValue::operator[](size_t in_idx) const
+{
+	if (m_type == ARRAY && in_idx < m_elements.size()) return m_elements[in_idx];
+	return NullValue();
+}
+
+const JsonValue& JsonValue::operator[](const char* in_member) const
+{
+	if (m_type == OBJECT)
+	{
+		for (const auto& member : m_members)
+		{
+			if (member.first == in_member) return member.second;
+		}
+	}
+	return NullValue();
+}
+
+bool JsonValue::Has(const char* in_member) const
+{
+	return !(*this)[in_member].IsNull();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+
+// =======================================================================================
+//                                      Json
+// =======================================================================================
+
+///---------------------------------------------------------------------------------------
+/// \brief	Minimal JSON document reader
+///
+/// Just enough for reading asset descriptions such as glTF.
+/// Lookups on missing members or out of range elements return a shared null value,
+/// so chained lookups like doc["meshes"][0]["primitives"] never need checks in between.
+///---------------------------------------------------------------------------------------
+
+class JsonValue
+{
+public:
+	enum Type
+	{
+		NUL,
+		BOOL,
+		NUMBER,
+		STRING,
+		ARRAY,
+		OBJECT
+	};
+
+	JsonValue();
+
+	// Parse a whole document, returns false and an error description on syntax errors
+	static bool Parse(const char* in_begin, const char* in_end, JsonValue& out_value, std::string& out_error);
+
+	Type GetType() const { return m_type; }
+	bool IsNull() const { return m_type == NUL; }
+	bool IsNumber() const { return m_type == NUMBER; }
+	bool IsString() const { return m_type == STRING; }
+	bool IsArray() const { return m_type == ARRAY; }
+	bool IsObject() const { return m_type == OBJECT; }
+
+	bool               AsBool(bool in_default = false) const;
+	double             AsNumber(double in_default = 0.0) const;
+	int                AsInt(int in_default = 0) const;
+	const std::string& AsString() const;
+
+	// Array/object element count
+	size_t Size() const;
+
+	const JsonValue& operator[](size_t in_idx) const;
+	const JsonValue& operator[](int in_idx) const { return (*this)[static_cast<size_t>(in_idx)]; }
+	const JsonValue& operator[](const char* in_member) const;
+	bool             Has(const char* in_member) const;
+
+private:
+	friend class JsonParser;
+
+	Type        m_type;
+	bool        m_bool;
+	double      m_number;
+	std::string m_string;
+	std::vector<JsonValue>                         m_elements;
+	std::vector<std::pair<std::string, JsonValue>> m_members;
+};
@@ -0,0 +1,40 @@
+#include "LodSelection.h"
+#include <algorithm>
+#include "JobSystem.h"
+
+namespace
+{
+	// Objects per job
+	const size_t c_grainSize = 4096;
+	// Keeps the camera inside a bounding sphere from dividing by zero
+	const float c_minDistance = 1e-4f;
+}
+
+void LodSelection::Select(const View& in_view, const float* in_lodErrors, uint32_t in_lodCount,
+	const glm::vec4* in_spheres, const float* in_scales, size_t in_count, uint8_t* out_lods,
+	JobSystem* in_jobSystem/* = nullptr*/)
+{
+	// Error allowed at distance 1, scaled by distance per object
+	float errorPerDistance = in_view.m_maxPixelError / in_view.m_projectionScale;
+
+	auto selectRange = [&](size_t in_begin, size_t in_end)
+	{
+		for (size_t i = in_begin; i < in_end; ++i)
+		{
+			const glm::vec4& sphere = in_spheres[i];
+			float distance = std::max(glm::length(glm::vec3(sphere) - in_view.m_cameraPos) - sphere.w, c_minDistance);
+			float allowedError = errorPerDistance * distance / (in_scales ? in_scales[i] : 1.0f);
+
+			// Errors are ascending, count the levels that are good enough
+			uint32_t lod = 0;
+			while (lod + 1 < in_lodCount && in_lodErrors[lod + 1] <= allowedError)
+				++lod;
+			out_lods[i] = static_cast<uint8_t>(lod);
+		}
+	};
+
+	if (in_jobSystem && in_count > c_grainSize)
+		in_jobSystem->ParallelFor(in_count, c_grainSize, selectRange);
+	else
+		selectRange(0, in_count);
+}
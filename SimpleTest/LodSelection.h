@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include "MathTypes.h"
+
+class JobSystem;
+
+// =======================================================================================
+//                                      LodSelection
+// =======================================================================================
+
+///---------------------------------------------------------------------------------------
+/// \brief	Screen space error based level of detail selection
+///
+/// Each level stores its geometric error in model units (see MeshSimplifier.h). The
+/// error of a level seen from distance d covers error * projectionScale / d pixels, and
+/// the coarsest level that stays under the pixel threshold is picked.
+///
+/// Objects sharing a mesh are selected in one batch, split into jobs when
+/// there are many of them.
+///---------------------------------------------------------------------------------------
+
+namespace LodSelection
+{
+	struct View
+	{
+		glm::vec3 m_cameraPos;
+		float     m_projectionScale; // pixels covered by one unit at distance 1: viewportHeight / (2 * tan(fovY / 2))
+		float     m_maxPixelError;
+	};
+
+	inline float GetProjectionScale(float in_fovY, float in_viewportHeight)
+	{
+		return in_viewportHeight / (2.0f * glm::tan(in_fovY * 0.5f));
+	}
+
+	// in_lodErrors holds the error of every level, ascending with level 0 first.
+	// in_spheres are the object bounds (xyz center, w radius) in the space of the camera position,
+	// in_scales optional uniform scales from model to that space. Writes one level per object.
+	void Select(const View& in_view, const float* in_lodErrors, uint32_t in_lodCount,
+		const glm::vec4* in_spheres, const float* in_scales, size_t in_count, uint8_t* out_lods,
+		JobSystem* in_jobSystem = nullptr);
+}
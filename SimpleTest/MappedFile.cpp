@@ -0,0 +1,103 @@
+#include "MappedFile.h"
+#include "DebugPrint.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+#ifdef _WIN32
+	: m_file(INVALID_HANDLE_VALUE)
+	, m_mapping(nullptr)
+#else
+	: m_fileDescriptor(-1)
+#endif
+	, m_data(nullptr)
+	, m_size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& in_path)
+{
+	Close();
+
+#ifdef _WIN32
+	m_file = CreateFile(in_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		LOG("Could not open file for mapping: " << in_path);
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+	m_size = static_cast<size_t>(size.QuadPart);
+
+	m_mapping = CreateFileMapping(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping == nullptr)
+	{
+		LOG("Could not create file mapping: " << in_path);
+		Close();
+		return false;
+	}
+
+	m_data = reinterpret_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	m_fileDescriptor = open(in_path.c_str(), O_RDONLY);
+	if (m_fileDescriptor < 0)
+	{
+		LOG("Could not open file for mapping: " << in_path);
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(m_fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+	m_size = static_cast<size_t>(fileStat.st_size);
+
+	void* mapped = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+	m_data = (mapped == MAP_FAILED) ? nullptr : reinterpret_cast<const uint8_t*>(mapped);
+	if (m_data)
+		madvise(mapped, m_size, MADV_SEQUENTIAL);
+#endif
+
+	if (m_data == nullptr)
+	{
+		LOG("Could not map view of file: " << in_path);
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (m_data) UnmapViewOfFile(m_data);
+	if (m_mapping) CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+	m_mapping = nullptr;
+	m_file = INVALID_HANDLE_VALUE;
+#else
+	if (m_data) munmap(const_cast<uint8_t*>(m_data), m_size);
+	if (m_fileDescriptor >= 0) close(m_fileDescriptor);
+	m_fileDescriptor = -1;
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+/*!
+* \class MappedFile
+*
+* \brief
+*
+* Read-only memory mapping of a whole file.
+* Lets loaders copy data straight from the OS page cache into
+* GPU staging memory without reading it into an intermediate buffer first.
+*/
+
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const std::string& in_path);
+	void Close();
+
+	bool           IsOpen() const { return m_data != nullptr; }
+	const uint8_t* GetData() const { return m_data; }
+	size_t         GetSize() const { return m_size; }
+
+private:
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+#ifdef _WIN32
+	HANDLE m_file;
+	HANDLE m_mapping;
+#else
+	int    m_fileDescriptor;
+#endif
+	const uint8_t* m_data;
+	size_t         m_size;
+};
@@ -0,0 +1,367 @@
+#include "MatrixKernels.h"
+
+#if defined(MATRIX_KERNELS_AVX2) && (defined(__FMA__) || defined(_MSC_VER))
+#	define MATRIX_KERNELS_FMA
+#endif
+
+namespace
+{
+	// =================================================================================
+	// Matrix multiply, the left matrix held in registers
+	// =================================================================================
+#if defined(MATRIX_KERNELS_AVX2)
+	// Each column of the left matrix in both halves, so two result columns are made at once
+	struct LeftMatrix
+	{
+		__m256 m_columns[4];
+
+		void Load(const glm::mat4& in_matrix)
+		{
+			const float* a = &in_matrix[0][0];
+			for (int k = 0; k < 4; ++k)
+				m_columns[k] = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + k * 4));
+		}
+
+		void Multiply(const glm::mat4& in_right, glm::mat4& out_result) const
+		{
+			const float* b = &in_right[0][0];
+			__m256 b01 = _mm256_loadu_ps(b);
+			__m256 b23 = _mm256_loadu_ps(b + 8);
+			__m256 r01 = Column(b01);
+			__m256 r23 = Column(b23);
+			float* out = &out_result[0][0];
+			_mm256_storeu_ps(out, r01);
+			_mm256_storeu_ps(out + 8, r23);
+		}
+
+		// Sum of the left columns weighted by the four elements of each half of in_right
+		__m256 Column(__m256 in_right) const
+		{
+			__m256 result = _mm256_mul_ps(m_columns[0], _mm256_permute_ps(in_right, 0x00));
+#ifdef MATRIX_KERNELS_FMA
+			result = _mm256_fmadd_ps(m_columns[1], _mm256_permute_ps(in_right, 0x55), result);
+			result = _mm256_fmadd_ps(m_columns[2], _mm256_permute_ps(in_right, 0xAA), result);
+			result = _mm256_fmadd_ps(m_columns[3], _mm256_permute_ps(in_right, 0xFF), result);
+#else
+			result = _mm256_add_ps(result, _mm256_mul_ps(m_columns[1], _mm256_permute_ps(in_right, 0x55)));
+			result = _mm256_add_ps(result, _mm256_mul_ps(m_columns[2], _mm256_permute_ps(in_right, 0xAA)));
+			result = _mm256_add_ps(result, _mm256_mul_ps(m_columns[3], _mm256_permute_ps(in_right, 0xFF)));
+#endif
+			return result;
+		}
+	};
+#elif defined(MATRIX_KERNELS_SSE2)
+	struct LeftMatrix
+	{
+		__m128 m_columns[4];
+
+		void Load(const glm::mat4& in_matrix)
+		{
+			const float* a = &in_matrix[0][0];
+			for (int k = 0; k < 4; ++k)
+				m_columns[k] = _mm_loadu_ps(a + k * 4);
+		}
+
+		void Multiply(const glm::mat4& in_right, glm::mat4& out_result) const
+		{
+			const float* b = &in_right[0][0];
+			__m128 result[4];
+			for (int c = 0; c < 4; ++c)
+			{
+				__m128 column = _mm_loadu_ps(b + c * 4);
+				result[c] = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(m_columns[0], _mm_shuffle_ps(column, column, 0x00)),
+						_mm_mul_ps(m_columns[1], _mm_shuffle_ps(column, column, 0x55))),
+					_mm_add_ps(_mm_mul_ps(m_columns[2], _mm_shuffle_ps(column, column, 0xAA)),
+						_mm_mul_ps(m_columns[3], _mm_shuffle_ps(column, column, 0xFF))));
+			}
+			float* out = &out_result[0][0];
+			for (int c = 0; c < 4; ++c)
+				_mm_storeu_ps(out + c * 4, result[c]);
+		}
+	};
+#elif defined(MATRIX_KERNELS_NEON)
+	struct LeftMatrix
+	{
+		float32x4_t m_columns[4];
+
+		void Load(const glm::mat4& in_matrix)
+		{
+			const float* a = &in_matrix[0][0];
+			for (int k = 0; k < 4; ++k)
+				m_columns[k] = vld1q_f32(a + k * 4);
+		}
+
+		void Multiply(const glm::mat4& in_right, glm::mat4& out_result) const
+		{
+			const float* b = &in_right[0][0];
+			float32x4_t result[4];
+			for (int c = 0; c < 4; ++c)
+			{
+				result[c] = vmulq_n_f32(m_columns[0], b[c * 4 + 0]);
+				result[c] = vmlaq_n_f32(result[c], m_columns[1], b[c * 4 + 1]);
+				result[c] = vmlaq_n_f32(result[c], m_columns[2], b[c * 4 + 2]);
+				result[c] = vmlaq_n_f32(result[c], m_columns[3], b[c * 4 + 3]);
+			}
+			float* out = &out_result[0][0];
+			for (int c = 0; c < 4; ++c)
+				vst1q_f32(out + c * 4, result[c]);
+		}
+	};
+#else
+	struct LeftMatrix
+	{
+		glm::mat4 m_matrix;
+
+		void Load(const glm::mat4& in_matrix) { m_matrix = in_matrix; }
+		void Multiply(const glm::mat4& in_right, glm::mat4& out_result) const { out_result = m_matrix * in_right; }
+	};
+#endif
+
+	// A stride of 0 uses the same matrix for all
+	void MultiplyStrided(const glm::mat4* in_a, size_t in_aStride, const glm::mat4* in_b, size_t in_bStride,
+		glm::mat4* out_results, size_t in_count)
+	{
+		LeftMatrix left;
+		if (in_aStride == 0 && in_count > 0)
+			left.Load(*in_a);
+		for (size_t i = 0; i < in_count; ++i)
+		{
+			if (in_aStride != 0)
+				left.Load(in_a[i * in_aStride]);
+			left.Multiply(in_b[i * in_bStride], out_results[i]);
+		}
+	}
+
+	// =================================================================================
+	// Lanes, one vec3 component of several points
+	// =================================================================================
+#if defined(MATRIX_KERNELS_SSE2) || defined(MATRIX_KERNELS_AVX2)
+	// 4 packed vec3s (x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3) to x, y and z of each
+	inline void Deinterleave4(const float* in_data, __m128& out_x, __m128& out_y, __m128& out_z)
+	{
+		__m128 v0 = _mm_loadu_ps(in_data);
+		__m128 v1 = _mm_loadu_ps(in_data + 4);
+		__m128 v2 = _mm_loadu_ps(in_data + 8);
+		__m128 x23 = _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(1, 0, 2, 1));              // z1 x2 z2 x3
+		out_x = _mm_shuffle_ps(v0, x23, _MM_SHUFFLE(3, 1, 3, 0));
+		__m128 y01 = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(0, 0, 1, 1));              // y0 y0 y1 y1
+		__m128 y23 = _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(2, 2, 3, 3));              // y2 y2 y3 y3
+		out_y = _mm_shuffle_ps(y01, y23, _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 z01 = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(1, 1, 2, 2));              // z0 z0 z1 z1
+		__m128 z23 = _mm_shuffle_ps(v2, v2, _MM_SHUFFLE(3, 3, 0, 0));              // z2 z2 z3 z3
+		out_z = _mm_shuffle_ps(z01, z23, _MM_SHUFFLE(2, 0, 2, 0));
+	}
+
+	inline void Interleave4(__m128 in_x, __m128 in_y, __m128 in_z, float* out_data)
+	{
+		__m128 xy01 = _mm_unpacklo_ps(in_x, in_y);                                   // x0 y0 x1 y1
+		__m128 xy23 = _mm_unpackhi_ps(in_x, in_y);                                   // x2 y2 x3 y3
+		__m128 z0x1 = _mm_shuffle_ps(in_z, xy01, _MM_SHUFFLE(2, 2, 0, 0));          // z0 z0 x1 x1
+		__m128 y1z1 = _mm_shuffle_ps(xy01, in_z, _MM_SHUFFLE(1, 1, 3, 3));          // y1 y1 z1 z1
+		__m128 z2x3 = _mm_shuffle_ps(in_z, xy23, _MM_SHUFFLE(2, 2, 2, 2));          // z2 z2 x3 x3
+		__m128 y3z3 = _mm_shuffle_ps(xy23, in_z, _MM_SHUFFLE(3, 3, 3, 3));          // y3 y3 z3 z3
+		_mm_storeu_ps(out_data, _mm_shuffle_ps(xy01, z0x1, _MM_SHUFFLE(2, 0, 1, 0)));
+		_mm_storeu_ps(out_data + 4, _mm_shuffle_ps(y1z1, xy23, _MM_SHUFFLE(1, 0, 2, 0)));
+		_mm_storeu_ps(out_data + 8, _mm_shuffle_ps(z2x3, y3z3, _MM_SHUFFLE(2, 0, 2, 0)));
+	}
+#endif
+
+#if defined(MATRIX_KERNELS_AVX2)
+	typedef __m256 Lanes;
+	const size_t c_laneCount = 8;
+
+	inline Lanes Set1(float in_value) { return _mm256_set1_ps(in_value); }
+	inline Lanes Add(Lanes in_a, Lanes in_b) { return _mm256_add_ps(in_a, in_b); }
+	inline Lanes Sub(Lanes in_a, Lanes in_b) { return _mm256_sub_ps(in_a, in_b); }
+	inline Lanes Mul(Lanes in_a, Lanes in_b) { return _mm256_mul_ps(in_a, in_b); }
+#ifdef MATRIX_KERNELS_FMA
+	inline Lanes MulAdd(Lanes in_a, Lanes in_b, Lanes in_c) { return _mm256_fmadd_ps(in_a, in_b, in_c); }
+#else
+	inline Lanes MulAdd(Lanes in_a, Lanes in_b, Lanes in_c) { return _mm256_add_ps(_mm256_mul_ps(in_a, in_b), in_c); }
+#endif
+
+	inline void LoadVec3(const glm::vec3* in_data, Lanes& out_x, Lanes& out_y, Lanes& out_z)
+	{
+		__m128 x0, y0, z0, x1, y1, z1;
+		Deinterleave4(&in_data[0].x, x0, y0, z0);
+		Deinterleave4(&in_data[4].x, x1, y1, z1);
+		out_x = _mm256_insertf128_ps(_mm256_castps128_ps256(x0), x1, 1);
+		out_y = _mm256_insertf128_ps(_mm256_castps128_ps256(y0), y1, 1);
+		out_z = _mm256_insertf128_ps(_mm256_castps128_ps256(z0), z1, 1);
+	}
+
+	inline void StoreVec3(Lanes in_x, Lanes in_y, Lanes in_z, glm::vec3* out_data)
+	{
+		Interleave4(_mm256_castps256_ps128(in_x), _mm256_castps256_ps128(in_y), _mm256_castps256_ps128(in_z), &out_data[0].x);
+		Interleave4(_mm256_extractf128_ps(in_x, 1), _mm256_extractf128_ps(in_y, 1), _mm256_extractf128_ps(in_z, 1), &out_data[4].x);
+	}
+#elif defined(MATRIX_KERNELS_SSE2)
+	typedef __m128 Lanes;
+	const size_t c_laneCount = 4;
+
+	inline Lanes Set1(float in_value) { return _mm_set1_ps(in_value); }
+	inline Lanes Add(Lanes in_a, Lanes in_b) { return _mm_add_ps(in_a, in_b); }
+	inline Lanes Sub(Lanes in_a, Lanes in_b) { return _mm_sub_ps(in_a, in_b); }
+	inline Lanes Mul(Lanes in_a, Lanes in_b) { return _mm_mul_ps(in_a, in_b); }
+	inline Lanes MulAdd(Lanes in_a, Lanes in_b, Lanes in_c) { return _mm_add_ps(_mm_mul_ps(in_a, in_b), in_c); }
+
+	inline void LoadVec3(const glm::vec3* in_data, Lanes& out_x, Lanes& out_y, Lanes& out_z)
+	{
+		Deinterleave4(&in_data[0].x, out_x, out_y, out_z);
+	}
+
+	inline void StoreVec3(Lanes in_x, Lanes in_y, Lanes in_z, glm::vec3* out_data)
+	{
+		Interleave4(in_x, in_y, in_z, &out_data[0].x);
+	}
+#elif defined(MATRIX_KERNELS_NEON)
+	typedef float32x4_t Lanes;
+	const size_t c_laneCount = 4;
+
+	inline Lanes Set1(float in_value) { return vdupq_n_f32(in_value); }
+	inline Lanes Add(Lanes in_a, Lanes in_b) { return vaddq_f32(in_a, in_b); }
+	inline Lanes Sub(Lanes in_a, Lanes in_b) { return vsubq_f32(in_a, in_b); }
+	inline Lanes Mul(Lanes in_a, Lanes in_b) { return vmulq_f32(in_a, in_b); }
+	inline Lanes MulAdd(Lanes in_a, Lanes in_b, Lanes in_c) { return vmlaq_f32(in_c, in_a, in_b); }
+
+	// The structure loads deinterleave by themselves
+	inline void LoadVec3(const glm::vec3* in_data, Lanes& out_x, Lanes& out_y, Lanes& out_z)
+	{
+		float32x4x3_t xyz = vld3q_f32(&in_data[0].x);
+		out_x = xyz.val[0];
+		out_y = xyz.val[1];
+		out_z = xyz.val[2];
+	}
+
+	inline void StoreVec3(Lanes in_x, Lanes in_y, Lanes in_z, glm::vec3* out_data)
+	{
+		float32x4x3_t xyz;
+		xyz.val[0] = in_x;
+		xyz.val[1] = in_y;
+		xyz.val[2] = in_z;
+		vst3q_f32(&out_data[0].x, xyz);
+	}
+#else
+	typedef float Lanes;
+	const size_t c_laneCount = 1;
+
+	inline Lanes Set1(float in_value) { return in_value; }
+	inline Lanes Add(Lanes in_a, Lanes in_b) { return in_a + in_b; }
+	inline Lanes Sub(Lanes in_a, Lanes in_b) { return in_a - in_b; }
+	inline Lanes Mul(Lanes in_a, Lanes in_b) { return in_a * in_b; }
+	inline Lanes MulAdd(Lanes in_a, Lanes in_b, Lanes in_c) { return in_a * in_b + in_c; }
+
+	inline void LoadVec3(const glm::vec3* in_data, Lanes& out_x, Lanes& out_y, Lanes& out_z)
+	{
+		out_x = in_data->x;
+		out_y = in_data->y;
+		out_z = in_data->z;
+	}
+
+	inline void StoreVec3(Lanes in_x, Lanes in_y, Lanes in_z, glm::vec3* out_data)
+	{
+		*out_data = glm::vec3(in_x, in_y, in_z);
+	}
+#endif
+
+	// The upper 3x4 of a matrix, every element in all lanes
+	struct AffineLanes
+	{
+		AffineLanes(const glm::mat4& in_matrix, bool in_absolute)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				for (int r = 0; r < 3; ++r)
+					m_m[c][r] = Set1(in_absolute ? glm::abs(in_matrix[c][r]) : in_matrix[c][r]);
+			}
+		}
+
+		// Row in_row of the matrix times (in_x, in_y, in_z, 1)
+		Lanes Row(int in_row, Lanes in_x, Lanes in_y, Lanes in_z) const
+		{
+			return MulAdd(m_m[0][in_row], in_x, MulAdd(m_m[1][in_row], in_y, MulAdd(m_m[2][in_row], in_z, m_m[3][in_row])));
+		}
+
+		// Row in_row of the matrix times (in_x, in_y, in_z, 0)
+		Lanes RowNoTranslation(int in_row, Lanes in_x, Lanes in_y, Lanes in_z) const
+		{
+			return MulAdd(m_m[0][in_row], in_x, MulAdd(m_m[1][in_row], in_y, Mul(m_m[2][in_row], in_z)));
+		}
+
+		Lanes m_m[4][3];
+	};
+
+	inline glm::vec3 TransformPoint(const glm::mat4& in_matrix, const glm::vec3& in_point)
+	{
+		return glm::vec3(in_matrix[0]) * in_point.x + glm::vec3(in_matrix[1]) * in_point.y +
+			glm::vec3(in_matrix[2]) * in_point.z + glm::vec3(in_matrix[3]);
+	}
+}
+
+void MatrixKernels::MultiplyBatch(const glm::mat4* in_a, const glm::mat4* in_b, glm::mat4* out_results, size_t in_count)
+{
+	MultiplyStrided(in_a, 1, in_b, 1, out_results, in_count);
+}
+
+void MatrixKernels::MultiplyBatch(const glm::mat4& in_a, const glm::mat4* in_b, glm::mat4* out_results, size_t in_count)
+{
+	MultiplyStrided(&in_a, 0, in_b, 1, out_results, in_count);
+}
+
+void MatrixKernels::MultiplyBatch(const glm::mat4* in_a, const glm::mat4& in_b, glm::mat4* out_results, size_t in_count)
+{
+	// Copied so out_results may hold in_b
+	glm::mat4 b = in_b;
+	MultiplyStrided(in_a, 1, &b, 0, out_results, in_count);
+}
+
+void MatrixKernels::TransformPoints(const glm::mat4& in_matrix, const glm::vec3* in_points, glm::vec3* out_points, size_t in_count)
+{
+	AffineLanes matrix(in_matrix, false);
+	size_t i = 0;
+	for (; i + c_laneCount <= in_count; i += c_laneCount)
+	{
+		Lanes x, y, z;
+		LoadVec3(in_points + i, x, y, z);
+		StoreVec3(matrix.Row(0, x, y, z), matrix.Row(1, x, y, z), matrix.Row(2, x, y, z), out_points + i);
+	}
+	for (; i < in_count; ++i)
+		out_points[i] = TransformPoint(in_matrix, in_points[i]);
+}
+
+void MatrixKernels::TransformAabbs(const glm::mat4& in_matrix, const glm::vec3* in_min, const glm::vec3* in_max,
+	glm::vec3* out_min, glm::vec3* out_max, size_t in_count)
+{
+	// The center moves with the matrix, the half extent grows by the absolute rotation and scale
+	AffineLanes matrix(in_matrix, false);
+	AffineLanes absMatrix(in_matrix, true);
+	Lanes half = Set1(0.5f);
+	size_t i = 0;
+	for (; i + c_laneCount <= in_count; i += c_laneCount)
+	{
+		Lanes minX, minY, minZ, maxX, maxY, maxZ;
+		LoadVec3(in_min + i, minX, minY, minZ);
+		LoadVec3(in_max + i, maxX, maxY, maxZ);
+		Lanes centerX = Mul(Add(minX, maxX), half), centerY = Mul(Add(minY, maxY), half), centerZ = Mul(Add(minZ, maxZ), half);
+		Lanes extentX = Mul(Sub(maxX, minX), half), extentY = Mul(Sub(maxY, minY), half), extentZ = Mul(Sub(maxZ, minZ), half);
+
+		Lanes newCenter[3], newExtent[3];
+		for (int r = 0; r < 3; ++r)
+		{
+			newCenter[r] = matrix.Row(r, centerX, centerY, centerZ);
+			newExtent[r] = absMatrix.RowNoTranslation(r, extentX, extentY, extentZ);
+		}
+		StoreVec3(Sub(newCenter[0], newExtent[0]), Sub(newCenter[1], newExtent[1]), Sub(newCenter[2], newExtent[2]), out_min + i);
+		StoreVec3(Add(newCenter[0], newExtent[0]), Add(newCenter[1], newExtent[1]), Add(newCenter[2], newExtent[2]), out_max + i);
+	}
+
+	glm::mat3 absRotation(glm::abs(glm::vec3(in_matrix[0])), glm::abs(glm::vec3(in_matrix[1])), glm::abs(glm::vec3(in_matrix[2])));
+	for (; i < in_count; ++i)
+	{
+		glm::vec3 center = TransformPoint(in_matrix, (in_min[i] + in_max[i]) * 0.5f);
+		glm::vec3 extent = absRotation * ((in_max[i] - in_min[i]) * 0.5f);
+		out_min[i] = center - extent;
+		out_max[i] = center + extent;
+	}
+}
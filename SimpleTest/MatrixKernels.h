@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include "MathTypes.h"
+
+// The widest instruction set the build allows is picked at compile time.
+// glm only turns on SSE2 for MSVC x86 builds with /arch:SSE2, but every x64 cpu has it.
+// AVX2 needs /arch:AVX2 (or -mavx2), NEON is always there on 64 bit ARM.
+#if (GLM_ARCH & GLM_ARCH_AVX2) || defined(__AVX2__)
+#	define MATRIX_KERNELS_AVX2
+#	include <immintrin.h>
+#endif
+#if (GLM_ARCH & GLM_ARCH_SSE2) || defined(_M_X64) || defined(__x86_64__)
+#	define MATRIX_KERNELS_SSE2
+#	include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#	define MATRIX_KERNELS_NEON
+#	include <arm_neon.h>
+#endif
+
+// =======================================================================================
+//                                      MatrixKernels
+// =======================================================================================
+
+///---------------------------------------------------------------------------------------
+/// \brief	SIMD versions of the glm::mat4 operations on hot paths
+///
+/// glm multiplies through generic per component code unless GLM_ARCH has SIMD enabled,
+/// which it hasn't for MSVC x64 builds. These work on the column major glm layout
+/// directly, one column of the result per vector.
+///
+/// The batch versions take arrays and keep the matrix that is the same for all of them in
+/// registers. Multiplies do two result columns per instruction with AVX2, points and boxes
+/// are transposed to structure of arrays on the fly and done 8 (AVX2) or 4 (SSE2, NEON)
+/// at a time. Outputs may be the same array as an input.
+///---------------------------------------------------------------------------------------
+
+namespace MatrixKernels
+{
+	// out_result = in_a * in_b, out_result may be either input
+	inline void Multiply(const glm::mat4& in_a, const glm::mat4& in_b, glm::mat4& out_result)
+	{
+#if defined(MATRIX_KERNELS_SSE2)
+		const float* a = &in_a[0][0];
+		const float* b = &in_b[0][0];
+		__m128 a0 = _mm_loadu_ps(a);
+		__m128 a1 = _mm_loadu_ps(a + 4);
+		__m128 a2 = _mm_loadu_ps(a + 8);
+		__m128 a3 = _mm_loadu_ps(a + 12);
+
+		// Column c of the result is a weighted by column c of b
+		__m128 result[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			result[c] = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(b[c * 4 + 0])), _mm_mul_ps(a1, _mm_set1_ps(b[c * 4 + 1]))),
+				_mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(b[c * 4 + 2])), _mm_mul_ps(a3, _mm_set1_ps(b[c * 4 + 3]))));
+		}
+		float* out = &out_result[0][0];
+		for (int c = 0; c < 4; ++c)
+			_mm_storeu_ps(out + c * 4, result[c]);
+#elif defined(MATRIX_KERNELS_NEON)
+		const float* a = &in_a[0][0];
+		const float* b = &in_b[0][0];
+		float32x4_t a0 = vld1q_f32(a);
+		float32x4_t a1 = vld1q_f32(a + 4);
+		float32x4_t a2 = vld1q_f32(a + 8);
+		float32x4_t a3 = vld1q_f32(a + 12);
+
+		float32x4_t result[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			result[c] = vmulq_n_f32(a0, b[c * 4 + 0]);
+			result[c] = vmlaq_n_f32(result[c], a1, b[c * 4 + 1]);
+			result[c] = vmlaq_n_f32(result[c], a2, b[c * 4 + 2]);
+			result[c] = vmlaq_n_f32(result[c], a3, b[c * 4 + 3]);
+		}
+		float* out = &out_result[0][0];
+		for (int c = 0; c < 4; ++c)
+			vst1q_f32(out + c * 4, result[c]);
+#else
+		out_result = in_a * in_b;
+#endif
+	}
+
+	// out_results[i] = in_a[i] * in_b[i]
+	void MultiplyBatch(const glm::mat4* in_a, const glm::mat4* in_b, glm::mat4* out_results, size_t in_count);
+	// out_results[i] = in_a * in_b[i], a view projection times object world matrices for example
+	void MultiplyBatch(const glm::mat4& in_a, const glm::mat4* in_b, glm::mat4* out_results, size_t in_count);
+	// out_results[i] = in_a[i] * in_b
+	void MultiplyBatch(const glm::mat4* in_a, const glm::mat4& in_b, glm::mat4* out_results, size_t in_count);
+
+	// out_points[i] = in_matrix * (in_points[i], 1), for affine matrices (the bottom row is ignored)
+	void TransformPoints(const glm::mat4& in_matrix, const glm::vec3* in_points, glm::vec3* out_points, size_t in_count);
+
+	// The boxes around in_matrix applied to each box [in_min[i], in_max[i]], for affine matrices.
+	// Exact for the transformed box, found from its center and half extent (Arvo 1990).
+	void TransformAabbs(const glm::mat4& in_matrix, const glm::vec3* in_min, const glm::vec3* in_max,
+		glm::vec3* out_min, glm::vec3* out_max, size_t in_count);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "MathTypes.h"
+#include "Vertex.h"
+#include "Meshlet.h"
+
+// CPU side mesh as produced by the importers, before it is written
+// to a mesh file or uploaded to the GPU
+
+struct MeshData
+{
+	// A range of the index buffer drawn with its own vertex offset
+	struct Submesh
+	{
+		uint32_t m_firstIndex;
+		uint32_t m_indexCount;
+		int32_t  m_vertexOffset;
+	};
+
+	// A level of detail, a run of submeshes (and their meshlets) drawn instead of the full mesh.
+	// Levels are stored in order after each other, so each level is also one index range.
+	struct Lod
+	{
+		uint32_t m_firstSubmesh;
+		uint32_t m_submeshCount;
+		uint32_t m_firstMeshlet;
+		uint32_t m_meshletCount;
+		float    m_error; // geometric deviation from level 0 in model units
+	};
+
+	MeshData()
+		: m_boundsMin()
+		, m_boundsMax()
+	{}
+
+	// Recalculate the axis aligned bounds from the vertex positions
+	void CalculateBounds()
+	{
+		if (m_vertices.empty())
+		{
+			m_boundsMin = m_boundsMax = glm::vec3();
+			return;
+		}
+		m_boundsMin = m_boundsMax = glm::vec3(m_vertices[0].m_pos[0], m_vertices[0].m_pos[1], m_vertices[0].m_pos[2]);
+		for (const Vertex& v : m_vertices)
+		{
+			glm::vec3 pos(v.m_pos[0], v.m_pos[1], v.m_pos[2]);
+			m_boundsMin = glm::min(m_boundsMin, pos);
+			m_boundsMax = glm::max(m_boundsMax, pos);
+		}
+	}
+
+	std::vector<Vertex>   m_vertices;
+	std::vector<uint32_t> m_indices;
+	std::vector<Submesh>  m_submeshes;
+	std::vector<Meshlet>  m_meshlets; // optional, see MeshletBuilder
+	std::vector<Lod>      m_lods;     // optional, see MeshSimplifier. Empty means a single level.
+	glm::vec3             m_boundsMin;
+	glm::vec3             m_boundsMax;
+};
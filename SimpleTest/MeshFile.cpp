@@ -0,0 +1,370 @@
+#include "MeshFile.h"
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include "DebugPrint.h"
+#include "MeshData.h"
+#include "VulkanVertexLayout.h"
+#include "MappedFile.h"
+#include "VertexQuantization.h"
+#include "IndexCodec.h"
+
+namespace
+{
+	// Pad the output stream with zeroes up to in_offset
+	void PadTo(std::ofstream& out_stream, uint64_t in_offset)
+	{
+		static const char zeroes[MeshFile::c_streamAlignment] = {};
+		uint64_t current = static_cast<uint64_t>(out_stream.tellp());
+		if (in_offset > current)
+			out_stream.write(zeroes, static_cast<std::streamsize>(in_offset - current));
+	}
+
+	template<typename Decl>
+	void SetLayout(MeshFile::Header& out_header)
+	{
+		static_assert(Decl::c_attributeCount <= MeshFile::c_maxAttributes, "Too many vertex attributes for the mesh file");
+		VkVertexInputAttributeDescription attributes[Decl::c_attributeCount];
+		Decl::GetAttributes(0, attributes);
+		out_header.m_vertexStride = Decl::c_stride;
+		out_header.m_attributeCount = Decl::c_attributeCount;
+		for (uint32_t i = 0; i < Decl::c_attributeCount; ++i)
+			out_header.m_attributes[i] = { attributes[i].location, static_cast<uint32_t>(attributes[i].format), attributes[i].offset, 0 };
+	}
+
+	template<typename Decl>
+	bool HasLayout(const MeshFile::Header& in_header)
+	{
+		MeshFile::Header expected = {};
+		SetLayout<Decl>(expected);
+		return in_header.m_vertexStride == expected.m_vertexStride &&
+			in_header.m_attributeCount == expected.m_attributeCount &&
+			memcmp(in_header.m_attributes, expected.m_attributes, sizeof(MeshFile::Attribute) * expected.m_attributeCount) == 0;
+	}
+
+	void GetQuantizationBox(const glm::vec3& in_boundsMin, const glm::vec3& in_boundsMax, glm::vec3& out_center, glm::vec3& out_halfExtent)
+	{
+		out_center = (in_boundsMin + in_boundsMax) * 0.5f;
+		out_halfExtent = (in_boundsMax - in_boundsMin) * 0.5f;
+		// Flat meshes still need an invertible transform
+		for (int i = 0; i < 3; ++i)
+		{
+			if (out_halfExtent[i] <= 0.0f) out_halfExtent[i] = 1.0f;
+		}
+	}
+
+	bool StreamInFile(uint64_t in_offset, uint64_t in_size, size_t in_fileSize)
+	{
+		return in_offset % MeshFile::c_streamAlignment == 0 &&
+			in_offset <= in_fileSize && in_size <= in_fileSize - in_offset;
+	}
+
+	// A draw range (submesh or meshlet) reads within the index stream and starts within the vertex stream.
+	// Indices themselves aren't checked, they are decoded later and are relative to the vertex offset.
+	bool DrawRangeInStreams(uint32_t in_firstIndex, uint32_t in_indexCount, int32_t in_vertexOffset, const MeshFile::Header& in_header)
+	{
+		return uint64_t(in_firstIndex) + in_indexCount <= in_header.m_indexCount &&
+			in_vertexOffset >= 0 && (in_indexCount == 0 || uint32_t(in_vertexOffset) < in_header.m_vertexCount);
+	}
+}
+
+bool MeshFile::Validate(const uint8_t* in_data, size_t in_size, std::string& out_error)
+{
+	std::ostringstream err;
+	if (in_data == nullptr || in_size < sizeof(Header))
+	{
+		out_error = "File too small for a mesh header";
+		return false;
+	}
+
+	const Header& header = *reinterpret_cast<const Header*>(in_data);
+	if (header.m_magic != c_magic)
+		err << "Not a mesh file (bad magic). ";
+	else if (header.m_version != c_version)
+		err << "Unsupported mesh file version " << header.m_version << " (expected " << c_version << "). ";
+	else
+	{
+		if (header.m_fileSize != in_size)
+			err << "File size mismatch. ";
+		if (header.m_attributeCount == 0 || header.m_attributeCount > c_maxAttributes)
+			err << "Bad attribute count " << header.m_attributeCount << ". ";
+		if (header.m_indexType != VK_INDEX_TYPE_UINT16 && header.m_indexType != VK_INDEX_TYPE_UINT32)
+			err << "Bad index type. ";
+		if (header.m_vertexSize != uint64_t(header.m_vertexCount) * header.m_vertexStride)
+			err << "Vertex stream size mismatch. ";
+		if (header.m_indexSize != uint64_t(header.m_indexCount) * GetIndexSize(header.m_indexType))
+			err << "Index stream size mismatch. ";
+		if (!StreamInFile(header.m_submeshOffset, uint64_t(header.m_submeshCount) * sizeof(Submesh), in_size))
+			err << "Submesh table out of bounds. ";
+		else
+		{
+			const Submesh* submeshes = reinterpret_cast<const Submesh*>(in_data + header.m_submeshOffset);
+			for (uint32_t i = 0; i < header.m_submeshCount; ++i)
+			{
+				if (!DrawRangeInStreams(submeshes[i].m_firstIndex, submeshes[i].m_indexCount, submeshes[i].m_vertexOffset, header))
+				{
+					err << "Submesh " << i << " out of range. ";
+					break;
+				}
+			}
+		}
+		if (!StreamInFile(header.m_lodOffset, uint64_t(header.m_lodCount) * sizeof(Lod), in_size))
+			err << "Level of detail table out of bounds. ";
+		else
+		{
+			const Lod* lods = reinterpret_cast<const Lod*>(in_data + header.m_lodOffset);
+			for (uint32_t i = 0; i < header.m_lodCount; ++i)
+			{
+				if (uint64_t(lods[i].m_firstSubmesh) + lods[i].m_submeshCount > header.m_submeshCount ||
+					uint64_t(lods[i].m_firstMeshlet) + lods[i].m_meshletCount > header.m_meshletCount)
+				{
+					err << "Level of detail " << i << " out of range. ";
+					break;
+				}
+			}
+		}
+		if (!StreamInFile(header.m_meshletOffset, uint64_t(header.m_meshletCount) * sizeof(Meshlet), in_size))
+			err << "Meshlet table out of bounds. ";
+		else
+		{
+			const Meshlet* meshlets = reinterpret_cast<const Meshlet*>(in_data + header.m_meshletOffset);
+			for (uint32_t i = 0; i < header.m_meshletCount; ++i)
+			{
+				if (!DrawRangeInStreams(meshlets[i].m_firstIndex, meshlets[i].m_indexCount, meshlets[i].m_vertexOffset, header))
+				{
+					err << "Meshlet " << i << " out of range. ";
+					break;
+				}
+			}
+		}
+		if (!StreamInFile(header.m_vertexOffset, header.m_vertexSize, in_size))
+			err << "Vertex stream out of bounds. ";
+		if ((header.m_flags & c_flagEncodedIndices) == 0 && header.m_indexStreamSize != header.m_indexSize)
+			err << "Index stream size mismatch. ";
+		if (!StreamInFile(header.m_indexOffset, header.m_indexStreamSize, in_size))
+			err << "Index stream out of bounds. ";
+	}
+
+	out_error = err.str();
+	return out_error.empty();
+}
+
+void MeshFile::GetVertexLayout(const Header& in_header, uint32_t in_bindingId, VulkanVertexLayout& out_layout)
+{
+	out_layout.m_bindingDescriptions.resize(1);
+	out_layout.m_bindingDescriptions[0].binding = in_bindingId;
+	out_layout.m_bindingDescriptions[0].stride = in_header.m_vertexStride;
+	out_layout.m_bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	out_layout.m_attributeDescriptions.resize(in_header.m_attributeCount);
+	for (uint32_t i = 0; i < in_header.m_attributeCount; ++i)
+	{
+		VkVertexInputAttributeDescription& attribute = out_layout.m_attributeDescriptions[i];
+		attribute.binding = in_bindingId;
+		attribute.location = in_header.m_attributes[i].m_location;
+		attribute.format = static_cast<VkFormat>(in_header.m_attributes[i].m_format);
+		attribute.offset = in_header.m_attributes[i].m_offset;
+	}
+}
+
+glm::mat4 MeshFile::GetDequantizeTransform(const Header& in_header)
+{
+	if ((in_header.m_flags & c_flagQuantizedPositions) == 0) return glm::mat4();
+
+	glm::vec3 center, halfExtent;
+	GetQuantizationBox(glm::vec3(in_header.m_boundsMin[0], in_header.m_boundsMin[1], in_header.m_boundsMin[2]),
+		glm::vec3(in_header.m_boundsMax[0], in_header.m_boundsMax[1], in_header.m_boundsMax[2]), center, halfExtent);
+	return glm::scale(glm::translate(glm::mat4(), center), halfExtent);
+}
+
+bool MeshFile::ReadIndices(const uint8_t* in_data, const Header& in_header, void* out_indices)
+{
+	const uint8_t* stream = in_data + in_header.m_indexOffset;
+	if (in_header.m_flags & c_flagEncodedIndices)
+	{
+		return IndexCodec::Decode(stream, static_cast<size_t>(in_header.m_indexStreamSize), in_header.m_indexCount,
+			GetIndexSize(in_header.m_indexType), out_indices);
+	}
+	memcpy(out_indices, stream, static_cast<size_t>(in_header.m_indexSize));
+	return true;
+}
+
+bool MeshFile::Write(const std::string& in_path, const MeshData& in_mesh, bool in_quantize/* = false*/, bool in_encodeIndices/* = true*/)
+{
+	Header header = {};
+	header.m_magic = c_magic;
+	header.m_version = c_version;
+
+	const void* vertexData = in_mesh.m_vertices.data();
+	std::vector<QuantizedVertex> quantizedVertices;
+	if (in_quantize)
+	{
+		SetLayout<QuantizedVertexDecl>(header);
+		header.m_flags |= c_flagQuantizedPositions;
+
+		glm::vec3 center, halfExtent;
+		GetQuantizationBox(in_mesh.m_boundsMin, in_mesh.m_boundsMax, center, halfExtent);
+		quantizedVertices.resize(in_mesh.m_vertices.size());
+		for (size_t i = 0; i < in_mesh.m_vertices.size(); ++i)
+		{
+			const Vertex& v = in_mesh.m_vertices[i];
+			quantizedVertices[i].m_pos = VertexQuantization::EncodePosition(glm::vec3(v.m_pos[0], v.m_pos[1], v.m_pos[2]), center, halfExtent);
+			quantizedVertices[i].m_col = VertexQuantization::EncodeColor(glm::vec4(v.m_col[0], v.m_col[1], v.m_col[2], 1.0f));
+		}
+		vertexData = quantizedVertices.data();
+	}
+	else
+	{
+		SetLayout<VertexDecl>(header);
+	}
+
+	uint32_t maxIndex = in_mesh.m_indices.empty() ? 0 : *std::max_element(in_mesh.m_indices.begin(), in_mesh.m_indices.end());
+	header.m_indexType = maxIndex <= 0xFFFF ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+	header.m_vertexCount = static_cast<uint32_t>(in_mesh.m_vertices.size());
+	header.m_indexCount = static_cast<uint32_t>(in_mesh.m_indices.size());
+
+	// Always have at least one submesh covering everything
+	std::vector<Submesh> submeshes;
+	for (const MeshData::Submesh& submesh : in_mesh.m_submeshes)
+		submeshes.push_back({ submesh.m_firstIndex, submesh.m_indexCount, submesh.m_vertexOffset, 0 });
+	if (submeshes.empty())
+		submeshes.push_back({ 0, header.m_indexCount, 0, 0 });
+	header.m_submeshCount = static_cast<uint32_t>(submeshes.size());
+
+	for (int i = 0; i < 3; ++i)
+	{
+		header.m_boundsMin[i] = in_mesh.m_boundsMin[i];
+		header.m_boundsMax[i] = in_mesh.m_boundsMax[i];
+	}
+
+	// Lay out the streams
+	header.m_submeshOffset = AlignStream(sizeof(Header));
+	std::vector<Lod> lods;
+	for (const MeshData::Lod& lod : in_mesh.m_lods)
+		lods.push_back({ lod.m_firstSubmesh, lod.m_submeshCount, lod.m_firstMeshlet, lod.m_meshletCount, lod.m_error, {} });
+	header.m_lodCount = static_cast<uint32_t>(lods.size());
+	header.m_meshletCount = static_cast<uint32_t>(in_mesh.m_meshlets.size());
+	header.m_lodOffset = AlignStream(header.m_submeshOffset + submeshes.size() * sizeof(Submesh));
+	header.m_meshletOffset = AlignStream(header.m_lodOffset + lods.size() * sizeof(Lod));
+	header.m_vertexOffset = AlignStream(header.m_meshletOffset + in_mesh.m_meshlets.size() * sizeof(Meshlet));
+	header.m_vertexSize = uint64_t(header.m_vertexCount) * header.m_vertexStride;
+	header.m_indexOffset = AlignStream(header.m_vertexOffset + header.m_vertexSize);
+	header.m_indexSize = uint64_t(header.m_indexCount) * GetIndexSize(header.m_indexType);
+
+	// Index stream, either encoded or raw at the chosen width
+	std::vector<uint8_t> indexStream;
+	if (in_encodeIndices)
+	{
+		header.m_flags |= c_flagEncodedIndices;
+		IndexCodec::Encode(in_mesh.m_indices.data(), in_mesh.m_indices.size(), indexStream);
+	}
+	else if (header.m_indexType == VK_INDEX_TYPE_UINT16)
+	{
+		indexStream.resize(static_cast<size_t>(header.m_indexSize));
+		uint16_t* dst = reinterpret_cast<uint16_t*>(indexStream.data());
+		for (size_t i = 0; i < in_mesh.m_indices.size(); ++i) dst[i] = static_cast<uint16_t>(in_mesh.m_indices[i]);
+	}
+	else
+	{
+		const uint8_t* src = reinterpret_cast<const uint8_t*>(in_mesh.m_indices.data());
+		indexStream.assign(src, src + header.m_indexSize);
+	}
+	header.m_indexStreamSize = indexStream.size();
+	uint64_t fileSize = header.m_indexOffset + header.m_indexStreamSize;
+	if (fileSize > UINT32_MAX)
+	{
+		LOG("Mesh too large for mesh file: " << in_path);
+		return false;
+	}
+	header.m_fileSize = static_cast<uint32_t>(fileSize);
+
+	std::ofstream file(in_path, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		LOG("Could not open mesh file for writing: " << in_path);
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+	PadTo(file, header.m_submeshOffset);
+	file.write(reinterpret_cast<const char*>(submeshes.data()), submeshes.size() * sizeof(Submesh));
+	PadTo(file, header.m_lodOffset);
+	file.write(reinterpret_cast<const char*>(lods.data()), lods.size() * sizeof(Lod));
+	PadTo(file, header.m_meshletOffset);
+	file.write(reinterpret_cast<const char*>(in_mesh.m_meshlets.data()), in_mesh.m_meshlets.size() * sizeof(Meshlet));
+	PadTo(file, header.m_vertexOffset);
+	file.write(reinterpret_cast<const char*>(vertexData), header.m_vertexSize);
+	PadTo(file, header.m_indexOffset);
+	file.write(reinterpret_cast<const char*>(indexStream.data()), indexStream.size());
+
+	return file.good();
+}
+
+bool MeshFile::Read(const std::string& in_path, MeshData& out_mesh)
+{
+	MappedFile file;
+	if (!file.Open(in_path)) return false;
+
+	std::string validationError;
+	if (!Validate(file.GetData(), file.GetSize(), validationError))
+	{
+		LOG("Invalid mesh file " << in_path << ": " << validationError);
+		return false;
+	}
+	const Header& header = *reinterpret_cast<const Header*>(file.GetData());
+	const uint8_t* vertexData = file.GetData() + header.m_vertexOffset;
+
+	out_mesh = MeshData();
+	out_mesh.m_boundsMin = glm::vec3(header.m_boundsMin[0], header.m_boundsMin[1], header.m_boundsMin[2]);
+	out_mesh.m_boundsMax = glm::vec3(header.m_boundsMax[0], header.m_boundsMax[1], header.m_boundsMax[2]);
+	out_mesh.m_vertices.resize(header.m_vertexCount);
+	if (HasLayout<VertexDecl>(header))
+	{
+		memcpy(out_mesh.m_vertices.data(), vertexData, header.m_vertexSize);
+	}
+	else if (HasLayout<QuantizedVertexDecl>(header))
+	{
+		glm::mat4 dequantize = GetDequantizeTransform(header);
+		const QuantizedVertex* src = reinterpret_cast<const QuantizedVertex*>(vertexData);
+		for (uint32_t i = 0; i < header.m_vertexCount; ++i)
+		{
+			glm::vec4 pos(glm::max(src[i].m_pos.m_v[0] / 32767.0f, -1.0f), glm::max(src[i].m_pos.m_v[1] / 32767.0f, -1.0f),
+				glm::max(src[i].m_pos.m_v[2] / 32767.0f, -1.0f), 1.0f);
+			pos = dequantize * pos;
+			for (int c = 0; c < 3; ++c)
+			{
+				out_mesh.m_vertices[i].m_pos[c] = pos[c];
+				out_mesh.m_vertices[i].m_col[c] = src[i].m_col.m_v[c] / 255.0f;
+			}
+		}
+	}
+	else
+	{
+		LOG("Unknown vertex layout in mesh file " << in_path);
+		return false;
+	}
+
+	out_mesh.m_indices.resize(header.m_indexCount);
+	std::vector<uint16_t> shortIndices(header.m_indexType == VK_INDEX_TYPE_UINT16 ? header.m_indexCount : 0);
+	void* indices = shortIndices.empty() ? static_cast<void*>(out_mesh.m_indices.data()) : static_cast<void*>(shortIndices.data());
+	if (!ReadIndices(file.GetData(), header, indices))
+	{
+		LOG("Corrupt index stream in mesh file " << in_path);
+		return false;
+	}
+	if (!shortIndices.empty())
+		std::copy(shortIndices.begin(), shortIndices.end(), out_mesh.m_indices.begin());
+
+	const Submesh* submeshes = reinterpret_cast<const Submesh*>(file.GetData() + header.m_submeshOffset);
+	for (uint32_t i = 0; i < header.m_submeshCount; ++i)
+		out_mesh.m_submeshes.push_back({ submeshes[i].m_firstIndex, submeshes[i].m_indexCount, submeshes[i].m_vertexOffset });
+	const Meshlet* meshlets = reinterpret_cast<const Meshlet*>(file.GetData() + header.m_meshletOffset);
+	out_mesh.m_meshlets.assign(meshlets, meshlets + header.m_meshletCount);
+	const Lod* lods = reinterpret_cast<const Lod*>(file.GetData() + header.m_lodOffset);
+	for (uint32_t i = 0; i < header.m_lodCount; ++i)
+		out_mesh.m_lods.push_back({ lods[i].m_firstSubmesh, lods[i].m_submeshCount, lods[i].m_firstMeshlet, lods[i].m_meshletCount, lods[i].m_error });
+
+	return true;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include <cstdint>
+#include <string>
+#include "MathTypes.h"
+
+struct MeshData;
+struct VulkanVertexLayout;
+
+// =======================================================================================
+//                                      MeshFile
+// =======================================================================================
+
+///---------------------------------------------------------------------------------------
+/// \brief	Binary mesh container
+///
+/// Versioned file layout that can be memory mapped and copied straight into
+/// staging memory. All offsets are from the start of the file, and every
+/// stream starts on a c_streamAlignment boundary.
+///
+/// [Header][Submesh * submeshCount][pad][Lod * lodCount][pad][Meshlet * meshletCount][pad][vertex stream][pad][index stream]
+///
+/// The index stream is normally delta/zigzag encoded (see IndexCodec.h) and decoded
+/// on load. The level of detail and meshlet tables are optional (see MeshSimplifier.h
+/// and MeshletBuilder.h).
+///
+/// Files are written by the MeshConverter tool, either with the float Vertex layout or
+/// with QuantizedVertex. Quantized positions are relative to the bounds, see
+/// c_flagQuantizedPositions.
+///---------------------------------------------------------------------------------------
+
+namespace MeshFile
+{
+	const uint32_t c_magic = 0x4853454D; // "MESH"
+	const uint32_t c_version = 4;
+	const uint32_t c_streamAlignment = 16;
+	const uint32_t c_maxAttributes = 8;
+
+	// Header flags
+	// Positions are normalized to the bounds: pos = center + value * halfExtent
+	const uint32_t c_flagQuantizedPositions = 1 << 0;
+	// The index stream is IndexCodec encoded, m_indexSize is the decoded size
+	const uint32_t c_flagEncodedIndices = 1 << 1;
+
+	// Matches a VkVertexInputAttributeDescription, minus the binding which is decided at load
+	struct Attribute
+	{
+		uint32_t m_location;
+		uint32_t m_format; // VkFormat
+		uint32_t m_offset;
+		uint32_t m_padding;
+	};
+
+	struct Submesh
+	{
+		uint32_t m_firstIndex;
+		uint32_t m_indexCount;
+		int32_t  m_vertexOffset;
+		uint32_t m_padding;
+	};
+
+	// Levels are runs of submeshes and meshlets, see MeshData::Lod
+	struct Lod
+	{
+		uint32_t m_firstSubmesh;
+		uint32_t m_submeshCount;
+		uint32_t m_firstMeshlet;
+		uint32_t m_meshletCount;
+		float    m_error;
+		uint32_t m_padding[3];
+	};
+
+	struct Header
+	{
+		uint32_t  m_magic;
+		uint32_t  m_version;
+		uint32_t  m_fileSize;
+		uint32_t  m_flags;
+
+		// Vertex layout
+		uint32_t  m_vertexStride;
+		uint32_t  m_attributeCount;
+		uint32_t  m_padding0[2];
+		Attribute m_attributes[c_maxAttributes];
+
+		// Counts
+		uint32_t  m_indexType; // VkIndexType
+		uint32_t  m_vertexCount;
+		uint32_t  m_indexCount;
+		uint32_t  m_submeshCount;
+
+		// Bounds
+		float     m_boundsMin[3];
+		float     m_boundsMax[3];
+		uint32_t  m_padding1[2];
+
+		// Stream locations
+		uint64_t  m_submeshOffset;
+		uint64_t  m_vertexOffset;
+		uint64_t  m_vertexSize;
+		uint64_t  m_indexOffset;
+		uint64_t  m_indexSize;
+		uint64_t  m_indexStreamSize; // bytes stored in the file, differs from m_indexSize when encoded
+		uint64_t  m_meshletOffset;
+		uint32_t  m_meshletCount;
+		uint32_t  m_padding2;
+		uint64_t  m_lodOffset;
+		uint32_t  m_lodCount;
+		uint32_t  m_padding3;
+	};
+	static_assert(sizeof(Header) % c_streamAlignment == 0, "Mesh file header must keep the streams aligned");
+
+	inline uint64_t AlignStream(uint64_t in_offset)
+	{
+		return (in_offset + c_streamAlignment - 1) & ~uint64_t(c_streamAlignment - 1);
+	}
+
+	inline uint32_t GetIndexSize(uint32_t in_indexType)
+	{
+		return in_indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	}
+
+	// Check that a mapped header and its streams fit in the file, and that every submesh
+	// and meshlet draws within the streams
+	bool Validate(const uint8_t* in_data, size_t in_size, std::string& out_error);
+
+	// Create the vertex input description for the layout stored in the file
+	void GetVertexLayout(const Header& in_header, uint32_t in_bindingId, VulkanVertexLayout& out_layout);
+
+	// Transform from stored to real positions, identity unless the positions are quantized
+	glm::mat4 GetDequantizeTransform(const Header& in_header);
+
+	// Decode or copy the index stream into out_indices (m_indexSize bytes)
+	bool ReadIndices(const uint8_t* in_data, const Header& in_header, void* out_indices);
+
+	// Write a mesh to disk, optionally with the QuantizedVertex layout. 16 bit indices are
+	// used when every index fits (see MeshOptimizer::MakeShortIndices).
+	bool Write(const std::string& in_path, const MeshData& in_mesh, bool in_quantize = false, bool in_encodeIndices = true);
+
+	// Read a mesh file back into MeshData, so existing files can be reprocessed
+	bool Read(const std::string& in_path, MeshData& out_mesh);
+}
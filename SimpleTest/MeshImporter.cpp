@@ -0,0 +1,1004 @@
+#include "MeshImporter.h"
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include "MathTypes.h"
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "DebugPrint.h"
+#include "MappedFile.h"
+#include "MeshData.h"
+#include "JobSystem.h"
+#include "Json.h"
+
+namespace
+{
+	// Run in_func over [0, in_count) as jobs, or inline without a job system
+	void RunParallel(JobSystem* in_jobSystem, size_t in_count, size_t in_grainSize,
+		const std::function<void(size_t, size_t)>& in_func)
+	{
+		if (in_jobSystem)
+			in_jobSystem->ParallelFor(in_count, in_grainSize, in_func);
+		else if (in_count > 0)
+			in_func(0, in_count);
+	}
+
+	bool EndsWith(const std::string& in_str, const std::string& in_suffix)
+	{
+		if (in_suffix.size() > in_str.size()) return false;
+		for (size_t i = 0; i < in_suffix.size(); ++i)
+		{
+			if (tolower(in_str[in_str.size() - in_suffix.size() + i]) != in_suffix[i]) return false;
+		}
+		return true;
+	}
+
+	void SetVertex(const glm::vec3& in_pos, const glm::vec3& in_col, Vertex& out_vertex)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			out_vertex.m_pos[i] = in_pos[i];
+			out_vertex.m_col[i] = in_col[i];
+		}
+	}
+
+	glm::vec3 NormalAsColor(const glm::vec3& in_normal)
+	{
+		return in_normal * 0.5f + glm::vec3(0.5f);
+	}
+
+	// =======================================================================================
+	// OBJ
+	// =======================================================================================
+
+	// Chunks are at least this large, small files are parsed in one go
+	const size_t c_objMinChunkSize = 256 * 1024;
+
+	// One OBJ index as written in a chunk, resolved to a global index once the chunk offsets are known.
+	// Relative (negative) indices are stored as chunk local and flagged.
+	struct ObjIndex
+	{
+		int64_t m_value; // -1 when missing
+		bool    m_chunkLocal;
+	};
+
+	struct ObjRawCorner
+	{
+		ObjIndex m_pos;
+		ObjIndex m_normal;
+	};
+
+	// Resolved global position/normal pair, the key vertices are deduplicated on
+	struct ObjCorner
+	{
+		int64_t m_pos, m_normal;
+		bool operator == (const ObjCorner& rhs) const
+		{
+			return m_pos == rhs.m_pos && m_normal == rhs.m_normal;
+		}
+	};
+
+	struct ObjCornerHash
+	{
+		size_t operator()(const ObjCorner& in_corner) const
+		{
+			uint64_t h = static_cast<uint64_t>(in_corner.m_pos) * 0x9E3779B97F4A7C15ull;
+			h ^= static_cast<uint64_t>(in_corner.m_normal) + 0x7F4A7C159E3779B9ull + (h << 6) + (h >> 2);
+			return static_cast<size_t>(h);
+		}
+	};
+
+	typedef std::unordered_map<ObjCorner, uint32_t, ObjCornerHash> ObjCornerMap;
+
+	struct ObjChunk
+	{
+		const char* m_begin;
+		const char* m_end;
+
+		// Parsed data, colors always follow the positions (white when missing)
+		std::vector<glm::vec3>    m_positions;
+		std::vector<glm::vec3>    m_colors;
+		std::vector<glm::vec3>    m_normals;
+		bool                      m_hasColors;
+		std::vector<ObjRawCorner> m_corners;      // 3 per triangle
+		std::vector<uint32_t>     m_groupStarts;  // corner index where a new group/material begins
+
+		// Global offsets of this chunk's data
+		size_t m_positionOffset;
+		size_t m_normalOffset;
+		size_t m_cornerOffset;
+
+		// Chunk local deduplication
+		std::vector<ObjCorner> m_uniqueCorners;
+		std::vector<uint32_t>  m_localIndices;
+		std::vector<uint32_t>  m_uniqueToGlobal;
+
+		bool m_valid;
+	};
+
+	const char* SkipSpace(const char* in_ptr, const char* in_end)
+	{
+		while (in_ptr < in_end && (*in_ptr == ' ' || *in_ptr == '\t')) ++in_ptr;
+		return in_ptr;
+	}
+
+	// Parse up to in_count floats, returns how many were read
+	int ParseFloats(const char* in_ptr, const char* in_lineEnd, float* out_values, int in_count)
+	{
+		int read = 0;
+		while (read < in_count)
+		{
+			in_ptr = SkipSpace(in_ptr, in_lineEnd);
+			if (in_ptr >= in_lineEnd) break;
+			char* next = nullptr;
+			out_values[read] = strtof(in_ptr, &next);
+			if (next == in_ptr) break;
+			in_ptr = next;
+			++read;
+		}
+		return read;
+	}
+
+	ObjIndex MakeObjIndex(long in_raw, size_t in_localCount)
+	{
+		if (in_raw > 0) return { in_raw - 1, false };
+		if (in_raw < 0) return { static_cast<int64_t>(in_localCount) + in_raw, true };
+		return { -1, false };
+	}
+
+	int64_t ResolveObjIndex(const ObjIndex& in_index, size_t in_chunkOffset)
+	{
+		if (in_index.m_value < 0 && !in_index.m_chunkLocal) return -1;
+		return in_index.m_chunkLocal ? static_cast<int64_t>(in_chunkOffset) + in_index.m_value : in_index.m_value;
+	}
+
+	void ParseObjChunk(ObjChunk& inout_chunk)
+	{
+		const char* ptr = inout_chunk.m_begin;
+		const char* end = inout_chunk.m_end;
+		std::vector<ObjRawCorner> faceCorners;
+
+		while (ptr < end)
+		{
+			const char* lineStart = SkipSpace(ptr, end);
+			const char* lineEnd = lineStart;
+			while (lineEnd < end && *lineEnd != '\n' && *lineEnd != '\r') ++lineEnd;
+			ptr = lineEnd;
+			while (ptr < end && (*ptr == '\n' || *ptr == '\r')) ++ptr;
+
+			if (lineEnd - lineStart < 2) continue;
+
+			if (lineStart[0] == 'v' && lineStart[1] == ' ')
+			{
+				float values[6] = { 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+				int read = ParseFloats(lineStart + 2, lineEnd, values, 6);
+				inout_chunk.m_positions.push_back(glm::vec3(values[0], values[1], values[2]));
+				inout_chunk.m_colors.push_back(glm::vec3(values[3], values[4], values[5]));
+				// Vertex color extension
+				if (read == 6) inout_chunk.m_hasColors = true;
+			}
+			else if (lineStart[0] == 'v' && lineStart[1] == 'n')
+			{
+				float values[3] = {};
+				ParseFloats(lineStart + 2, lineEnd, values, 3);
+				inout_chunk.m_normals.push_back(glm::vec3(values[0], values[1], values[2]));
+			}
+			else if (lineStart[0] == 'f' && lineStart[1] == ' ')
+			{
+				faceCorners.clear();
+				const char* c = lineStart + 2;
+				while (true)
+				{
+					c = SkipSpace(c, lineEnd);
+					if (c >= lineEnd) break;
+
+					// v, v/vt, v//vn or v/vt/vn
+					long raw[3] = { 0, 0, 0 };
+					for (int part = 0; part < 3 && c < lineEnd && *c != ' ' && *c != '\t'; ++part)
+					{
+						if (*c != '/')
+						{
+							char* next = nullptr;
+							raw[part] = strtol(c, &next, 10);
+							if (next == c) break;
+							c = next;
+						}
+						if (c < lineEnd && *c == '/') ++c;
+					}
+					while (c < lineEnd && *c != ' ' && *c != '\t') ++c;
+
+					faceCorners.push_back({ MakeObjIndex(raw[0], inout_chunk.m_positions.size()),
+						MakeObjIndex(raw[2], inout_chunk.m_normals.size()) });
+				}
+
+				// Triangulate polygon as a fan
+				for (size_t i = 2; i < faceCorners.size(); ++i)
+				{
+					inout_chunk.m_corners.push_back(faceCorners[0]);
+					inout_chunk.m_corners.push_back(faceCorners[i - 1]);
+					inout_chunk.m_corners.push_back(faceCorners[i]);
+				}
+			}
+			else if (((lineStart[0] == 'o' || lineStart[0] == 'g') && lineStart[1] == ' ') ||
+				(lineEnd - lineStart > 6 && strncmp(lineStart, "usemtl", 6) == 0))
+			{
+				inout_chunk.m_groupStarts.push_back(static_cast<uint32_t>(inout_chunk.m_corners.size()));
+			}
+		}
+	}
+
+	// Resolve the chunk's corners to global indices and deduplicate them within the chunk
+	void DeduplicateObjChunk(ObjChunk& inout_chunk, size_t in_positionCount, size_t in_normalCount)
+	{
+		ObjCornerMap cornerToUnique;
+		cornerToUnique.reserve(inout_chunk.m_corners.size() / 2);
+		inout_chunk.m_localIndices.resize(inout_chunk.m_corners.size());
+
+		for (size_t i = 0; i < inout_chunk.m_corners.size(); ++i)
+		{
+			const ObjRawCorner& raw = inout_chunk.m_corners[i];
+			ObjCorner corner = { ResolveObjIndex(raw.m_pos, inout_chunk.m_positionOffset),
+				ResolveObjIndex(raw.m_normal, inout_chunk.m_normalOffset) };
+			if (corner.m_pos < 0 || corner.m_pos >= static_cast<int64_t>(in_positionCount))
+			{
+				inout_chunk.m_valid = false;
+				return;
+			}
+			if (corner.m_normal >= static_cast<int64_t>(in_normalCount))
+				corner.m_normal = -1;
+
+			auto inserted = cornerToUnique.insert(std::make_pair(corner, static_cast<uint32_t>(inout_chunk.m_uniqueCorners.size())));
+			if (inserted.second)
+				inout_chunk.m_uniqueCorners.push_back(corner);
+			inout_chunk.m_localIndices[i] = inserted.first->second;
+		}
+	}
+
+	// =======================================================================================
+	// glTF
+	// =======================================================================================
+
+	const uint32_t c_glbMagic = 0x46546C67;     // "glTF"
+	const uint32_t c_glbChunkJSON = 0x4E4F534A; // "JSON"
+	const uint32_t c_glbChunkBIN = 0x004E4942;  // "BIN\0"
+	const int c_gltfMaxNodeDepth = 64;
+
+	enum GltfComponentType
+	{
+		GLTF_BYTE = 5120,
+		GLTF_UNSIGNED_BYTE = 5121,
+		GLTF_SHORT = 5122,
+		GLTF_UNSIGNED_SHORT = 5123,
+		GLTF_UNSIGNED_INT = 5125,
+		GLTF_FLOAT = 5126
+	};
+
+	// A view of buffer memory, either owned or pointing into a mapped file
+	struct GltfBuffer
+	{
+		const uint8_t*       m_data;
+		size_t               m_size;
+		std::vector<uint8_t> m_owned;
+	};
+
+	// Decoded accessor data, floats for attributes and uint32 for indices
+	struct GltfAccessorData
+	{
+		std::vector<float>    m_floats;
+		std::vector<uint32_t> m_indices;
+		int                   m_components;
+		bool                  m_valid;
+	};
+
+	struct GltfPrimitiveInstance
+	{
+		const JsonValue* m_primitive;
+		glm::mat4        m_transform;
+		size_t           m_vertexOffset;
+		size_t           m_indexOffset;
+		size_t           m_vertexCount;
+		size_t           m_indexCount;
+	};
+
+	struct VertexHash
+	{
+		size_t operator()(const Vertex& in_vertex) const
+		{
+			uint32_t words[6];
+			memcpy(words, &in_vertex, sizeof(words));
+			uint64_t h = 0xCBF29CE484222325ull;
+			for (uint32_t word : words)
+			{
+				h ^= word;
+				h *= 0x100000001B3ull;
+			}
+			return static_cast<size_t>(h);
+		}
+	};
+
+	struct VertexEqual
+	{
+		bool operator()(const Vertex& lhs, const Vertex& rhs) const
+		{
+			return memcmp(&lhs, &rhs, sizeof(Vertex)) == 0;
+		}
+	};
+
+	int GltfComponentCount(const std::string& in_type)
+	{
+		if (in_type == "SCALAR") return 1;
+		if (in_type == "VEC2") return 2;
+		if (in_type == "VEC3") return 3;
+		if (in_type == "VEC4") return 4;
+		if (in_type == "MAT4") return 16;
+		return 0;
+	}
+
+	int GltfComponentSize(int in_componentType)
+	{
+		switch (in_componentType)
+		{
+		case GLTF_BYTE:
+		case GLTF_UNSIGNED_BYTE: return 1;
+		case GLTF_SHORT:
+		case GLTF_UNSIGNED_SHORT: return 2;
+		case GLTF_UNSIGNED_INT:
+		case GLTF_FLOAT: return 4;
+		}
+		return 0;
+	}
+
+	// Read one component, normalized integers are mapped to [0,1] or [-1,1]
+	float ReadGltfComponent(const uint8_t* in_ptr, int in_componentType, bool in_normalized)
+	{
+		switch (in_componentType)
+		{
+		case GLTF_FLOAT: { float v; memcpy(&v, in_ptr, 4); return v; }
+		case GLTF_UNSIGNED_BYTE: return in_normalized ? *in_ptr / 255.0f : static_cast<float>(*in_ptr);
+		case GLTF_BYTE: { int8_t v; memcpy(&v, in_ptr, 1); return in_normalized ? glm::max(v / 127.0f, -1.0f) : static_cast<float>(v); }
+		case GLTF_UNSIGNED_SHORT: { uint16_t v; memcpy(&v, in_ptr, 2); return in_normalized ? v / 65535.0f : static_cast<float>(v); }
+		case GLTF_SHORT: { int16_t v; memcpy(&v, in_ptr, 2); return in_normalized ? glm::max(v / 32767.0f, -1.0f) : static_cast<float>(v); }
+		case GLTF_UNSIGNED_INT: { uint32_t v; memcpy(&v, in_ptr, 4); return static_cast<float>(v); }
+		}
+		return 0.0f;
+	}
+
+	bool DecodeBase64(const char* in_begin, const char* in_end, std::vector<uint8_t>& out_data)
+	{
+		static int8_t table[256];
+		static bool tableInitialized = false;
+		if (!tableInitialized)
+		{
+			const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+			memset(table, -1, sizeof(table));
+			for (int i = 0; i < 64; ++i) table[static_cast<uint8_t>(alphabet[i])] = static_cast<int8_t>(i);
+			tableInitialized = true;
+		}
+
+		out_data.clear();
+		out_data.reserve((in_end - in_begin) * 3 / 4);
+		uint32_t accumulator = 0;
+		int bits = 0;
+		for (const char* c = in_begin; c < in_end; ++c)
+		{
+			if (*c == '=') break;
+			int8_t value = table[static_cast<uint8_t>(*c)];
+			if (value < 0) return false;
+			accumulator = (accumulator << 6) | static_cast<uint32_t>(value);
+			bits += 6;
+			if (bits >= 8)
+			{
+				bits -= 8;
+				out_data.push_back(static_cast<uint8_t>((accumulator >> bits) & 0xFF));
+			}
+		}
+		return true;
+	}
+
+	std::string DirectoryOf(const std::string& in_path)
+	{
+		size_t slash = in_path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : in_path.substr(0, slash + 1);
+	}
+
+	bool DecodeGltfAccessor(const JsonValue& in_doc, const std::vector<GltfBuffer>& in_buffers,
+		int in_accessorIdx, bool in_asIndices, GltfAccessorData& out_data)
+	{
+		const JsonValue& accessor = in_doc["accessors"][in_accessorIdx];
+		int componentType = accessor["componentType"].AsInt();
+		int components = GltfComponentCount(accessor["type"].AsString());
+		int componentSize = GltfComponentSize(componentType);
+		size_t count = static_cast<size_t>(accessor["count"].AsNumber());
+		bool normalized = accessor["normalized"].AsBool();
+		out_data.m_components = components;
+
+		if (components == 0 || componentSize == 0) return false;
+		if (accessor.Has("sparse"))
+		{
+			LOG("glTF import: sparse accessors not supported (accessor " << in_accessorIdx << ")");
+			return false;
+		}
+
+		// Accessors without a buffer view are all zeroes
+		if (!accessor.Has("bufferView"))
+		{
+			if (in_asIndices) out_data.m_indices.assign(count, 0);
+			else out_data.m_floats.assign(count * components, 0.0f);
+			return true;
+		}
+
+		const JsonValue& bufferView = in_doc["bufferViews"][accessor["bufferView"].AsInt()];
+		size_t bufferIdx = static_cast<size_t>(bufferView["buffer"].AsInt());
+		if (bufferIdx >= in_buffers.size()) return false;
+		const GltfBuffer& buffer = in_buffers[bufferIdx];
+
+		size_t elementSize = static_cast<size_t>(components * componentSize);
+		size_t stride = static_cast<size_t>(bufferView["byteStride"].AsNumber(0.0));
+		if (stride == 0) stride = elementSize;
+		size_t offset = static_cast<size_t>(bufferView["byteOffset"].AsNumber(0.0) + accessor["byteOffset"].AsNumber(0.0));
+		size_t viewEnd = static_cast<size_t>(bufferView["byteOffset"].AsNumber(0.0) + bufferView["byteLength"].AsNumber(0.0));
+		if (count > 0 && (offset + (count - 1) * stride + elementSize > viewEnd || viewEnd > buffer.m_size))
+		{
+			LOG("glTF import: accessor " << in_accessorIdx << " out of buffer bounds");
+			return false;
+		}
+
+		const uint8_t* src = buffer.m_data + offset;
+		if (in_asIndices)
+		{
+			out_data.m_indices.resize(count);
+			for (size_t i = 0; i < count; ++i, src += stride)
+			{
+				switch (componentType)
+				{
+				case GLTF_UNSIGNED_BYTE: out_data.m_indices[i] = *src; break;
+				case GLTF_UNSIGNED_SHORT: { uint16_t v; memcpy(&v, src, 2); out_data.m_indices[i] = v; break; }
+				case GLTF_UNSIGNED_INT: { uint32_t v; memcpy(&v, src, 4); out_data.m_indices[i] = v; break; }
+				default: return false;
+				}
+			}
+		}
+		else if (componentType == GLTF_FLOAT && stride == elementSize)
+		{
+			// Tightly packed floats, straight copy
+			out_data.m_floats.resize(count * components);
+			memcpy(out_data.m_floats.data(), src, count * elementSize);
+		}
+		else
+		{
+			out_data.m_floats.resize(count * components);
+			float* dst = out_data.m_floats.data();
+			for (size_t i = 0; i < count; ++i, src += stride)
+			{
+				for (int c = 0; c < components; ++c)
+				{
+					*dst++ = ReadGltfComponent(src + c * componentSize, componentType, normalized);
+				}
+			}
+		}
+		return true;
+	}
+
+	glm::mat4 GltfNodeTransform(const JsonValue& in_node)
+	{
+		const JsonValue& matrix = in_node["matrix"];
+		if (matrix.Size() == 16)
+		{
+			float m[16];
+			for (int i = 0; i < 16; ++i) m[i] = static_cast<float>(matrix[i].AsNumber());
+			return glm::make_mat4(m); // glTF matrices are column major as glm
+		}
+
+		glm::mat4 transform;
+		const JsonValue& translation = in_node["translation"];
+		if (translation.Size() == 3)
+			transform = glm::translate(transform, glm::vec3(translation[0].AsNumber(), translation[1].AsNumber(), translation[2].AsNumber()));
+		const JsonValue& rotation = in_node["rotation"];
+		if (rotation.Size() == 4)
+		{
+			glm::quat q(static_cast<float>(rotation[3].AsNumber()), static_cast<float>(rotation[0].AsNumber()),
+				static_cast<float>(rotation[1].AsNumber()), static_cast<float>(rotation[2].AsNumber()));
+			transform = transform * glm::mat4_cast(q);
+		}
+		const JsonValue& scale = in_node["scale"];
+		if (scale.Size() == 3)
+			transform = glm::scale(transform, glm::vec3(scale[0].AsNumber(), scale[1].AsNumber(), scale[2].AsNumber()));
+		return transform;
+	}
+
+	void CollectGltfNode(const JsonValue& in_doc, int in_nodeIdx, const glm::mat4& in_parentTransform, int in_depth,
+		std::vector<GltfPrimitiveInstance>& out_instances)
+	{
+		if (in_depth > c_gltfMaxNodeDepth) return;
+		const JsonValue& node = in_doc["nodes"][in_nodeIdx];
+		glm::mat4 transform = in_parentTransform * GltfNodeTransform(node);
+
+		if (node.Has("mesh"))
+		{
+			const JsonValue& primitives = in_doc["meshes"][node["mesh"].AsInt()]["primitives"];
+			for (size_t i = 0; i < primitives.Size(); ++i)
+			{
+				// Triangle lists only (mode 4 is the default)
+				if (primitives[i]["mode"].AsInt(4) != 4) continue;
+				out_instances.push_back({ &primitives[i], transform, 0, 0, 0, 0 });
+			}
+		}
+
+		const JsonValue& children = node["children"];
+		for (size_t i = 0; i < children.Size(); ++i)
+		{
+			CollectGltfNode(in_doc, children[i].AsInt(), transform, in_depth + 1, out_instances);
+		}
+	}
+
+	bool LoadGltfBuffers(const JsonValue& in_doc, const std::string& in_directory, const uint8_t* in_glbBinary, size_t in_glbBinarySize,
+		std::vector<std::unique_ptr<MappedFile>>& out_mappedFiles, std::vector<GltfBuffer>& out_buffers, size_t& inout_bytesRead)
+	{
+		const JsonValue& buffers = in_doc["buffers"];
+		out_buffers.resize(buffers.Size());
+		for (size_t i = 0; i < buffers.Size(); ++i)
+		{
+			const std::string& uri = buffers[i]["uri"].AsString();
+			GltfBuffer& buffer = out_buffers[i];
+			if (uri.empty())
+			{
+				// The GLB binary chunk
+				buffer.m_data = in_glbBinary;
+				buffer.m_size = in_glbBinarySize;
+				if (buffer.m_data == nullptr) return false;
+			}
+			else if (uri.compare(0, 5, "data:") == 0)
+			{
+				size_t comma = uri.find(";base64,");
+				if (comma == std::string::npos) return false;
+				const char* base64 = uri.c_str() + comma + 8;
+				if (!DecodeBase64(base64, uri.c_str() + uri.size(), buffer.m_owned)) return false;
+				buffer.m_data = buffer.m_owned.data();
+				buffer.m_size = buffer.m_owned.size();
+			}
+			else
+			{
+				out_mappedFiles.push_back(std::make_unique<MappedFile>());
+				if (!out_mappedFiles.back()->Open(in_directory + uri))
+				{
+					LOG("glTF import: could not open buffer " << uri);
+					return false;
+				}
+				buffer.m_data = out_mappedFiles.back()->GetData();
+				buffer.m_size = out_mappedFiles.back()->GetSize();
+				inout_bytesRead += buffer.m_size;
+			}
+		}
+		return true;
+	}
+}
+
+bool MeshImporter::Import(const std::string& in_path, MeshData& out_mesh, JobSystem* in_jobSystem/* = nullptr*/, ImportStats* out_stats/* = nullptr*/)
+{
+	if (EndsWith(in_path, ".obj"))
+		return ImportOBJ(in_path, out_mesh, in_jobSystem, out_stats);
+	if (EndsWith(in_path, ".gltf") || EndsWith(in_path, ".glb"))
+		return ImportGLTF(in_path, out_mesh, in_jobSystem, out_stats);
+	LOG("Mesh import: unsupported format " << in_path);
+	return false;
+}
+
+bool MeshImporter::ImportOBJ(const std::string& in_path, MeshData& out_mesh, JobSystem* in_jobSystem/* = nullptr*/, ImportStats* out_stats/* = nullptr*/)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	MappedFile file;
+	if (!file.Open(in_path)) return false;
+
+	const char* fileBegin = reinterpret_cast<const char*>(file.GetData());
+	const char* fileEnd = fileBegin + file.GetSize();
+
+	// Split into line aligned chunks
+	size_t threadCount = in_jobSystem ? in_jobSystem->GetThreadCount() : 1;
+	size_t chunkCount = std::max<size_t>(1, std::min(threadCount * 4, file.GetSize() / c_objMinChunkSize));
+	size_t chunkSize = file.GetSize() / chunkCount;
+	std::vector<ObjChunk> chunks;
+	const char* chunkBegin = fileBegin;
+	for (size_t i = 0; i < chunkCount && chunkBegin < fileEnd; ++i)
+	{
+		const char* chunkEnd = (i == chunkCount - 1) ? fileEnd : std::min(fileEnd, chunkBegin + chunkSize);
+		while (chunkEnd < fileEnd && *chunkEnd != '\n') ++chunkEnd;
+		if (chunkEnd < fileEnd) ++chunkEnd;
+
+		ObjChunk chunk = {};
+		chunk.m_begin = chunkBegin;
+		chunk.m_end = chunkEnd;
+		chunk.m_valid = true;
+		chunks.push_back(std::move(chunk));
+		chunkBegin = chunkEnd;
+	}
+
+	// 1. Parse all chunks
+	RunParallel(in_jobSystem, chunks.size(), 1, [&chunks](size_t in_begin, size_t in_end)
+	{
+		for (size_t i = in_begin; i < in_end; ++i) ParseObjChunk(chunks[i]);
+	});
+
+	// 2. Global offsets of each chunk's data
+	size_t positionCount = 0, normalCount = 0, cornerCount = 0;
+	bool hasColors = false;
+	for (ObjChunk& chunk : chunks)
+	{
+		chunk.m_positionOffset = positionCount;
+		chunk.m_normalOffset = normalCount;
+		chunk.m_cornerOffset = cornerCount;
+		positionCount += chunk.m_positions.size();
+		normalCount += chunk.m_normals.size();
+		cornerCount += chunk.m_corners.size();
+		hasColors = hasColors || chunk.m_hasColors;
+	}
+
+	// 3. Resolve indices and deduplicate within each chunk
+	RunParallel(in_jobSystem, chunks.size(), 1, [&](size_t in_begin, size_t in_end)
+	{
+		for (size_t i = in_begin; i < in_end; ++i) DeduplicateObjChunk(chunks[i], positionCount, normalCount);
+	});
+	for (const ObjChunk& chunk : chunks)
+	{
+		if (!chunk.m_valid)
+		{
+			LOG("OBJ import: face references a missing position in " << in_path);
+			return false;
+		}
+	}
+
+	// 4. Merge the chunks' unique corners into the global vertex list
+	std::vector<ObjCorner> vertexCorners;
+	{
+		ObjCornerMap cornerToVertex;
+		cornerToVertex.reserve(cornerCount / 3);
+		for (ObjChunk& chunk : chunks)
+		{
+			chunk.m_uniqueToGlobal.resize(chunk.m_uniqueCorners.size());
+			for (size_t i = 0; i < chunk.m_uniqueCorners.size(); ++i)
+			{
+				auto inserted = cornerToVertex.insert(std::make_pair(chunk.m_uniqueCorners[i], static_cast<uint32_t>(vertexCorners.size())));
+				if (inserted.second)
+					vertexCorners.push_back(chunk.m_uniqueCorners[i]);
+				chunk.m_uniqueToGlobal[i] = inserted.first->second;
+			}
+		}
+	}
+
+	// 5. Build interleaved vertices and the final index buffer
+	out_mesh = MeshData();
+	out_mesh.m_vertices.resize(vertexCorners.size());
+	out_mesh.m_indices.resize(cornerCount);
+
+	// Gather the attribute arrays so vertices can be built from global indices
+	std::vector<const ObjChunk*> positionChunk(positionCount), normalChunk(normalCount);
+	for (const ObjChunk& chunk : chunks)
+	{
+		std::fill(positionChunk.begin() + chunk.m_positionOffset, positionChunk.begin() + chunk.m_positionOffset + chunk.m_positions.size(), &chunk);
+		std::fill(normalChunk.begin() + chunk.m_normalOffset, normalChunk.begin() + chunk.m_normalOffset + chunk.m_normals.size(), &chunk);
+	}
+
+	RunParallel(in_jobSystem, vertexCorners.size(), 4096, [&](size_t in_begin, size_t in_end)
+	{
+		for (size_t i = in_begin; i < in_end; ++i)
+		{
+			const ObjCorner& corner = vertexCorners[i];
+			const ObjChunk& posChunk = *positionChunk[corner.m_pos];
+			size_t localPos = corner.m_pos - posChunk.m_positionOffset;
+			glm::vec3 col(1.0f);
+			if (hasColors)
+			{
+				col = posChunk.m_colors[localPos];
+			}
+			else if (corner.m_normal >= 0)
+			{
+				const ObjChunk& nrmChunk = *normalChunk[corner.m_normal];
+				col = NormalAsColor(nrmChunk.m_normals[corner.m_normal - nrmChunk.m_normalOffset]);
+			}
+			SetVertex(posChunk.m_positions[localPos], col, out_mesh.m_vertices[i]);
+		}
+	});
+
+	RunParallel(in_jobSystem, chunks.size(), 1, [&](size_t in_begin, size_t in_end)
+	{
+		for (size_t c = in_begin; c < in_end; ++c)
+		{
+			const ObjChunk& chunk = chunks[c];
+			uint32_t* dst = out_mesh.m_indices.data() + chunk.m_cornerOffset;
+			for (size_t i = 0; i < chunk.m_localIndices.size(); ++i)
+			{
+				dst[i] = chunk.m_uniqueToGlobal[chunk.m_localIndices[i]];
+			}
+		}
+	});
+
+	// 6. Submeshes from the group/material statements
+	uint32_t submeshStart = 0;
+	for (const ObjChunk& chunk : chunks)
+	{
+		for (uint32_t groupStart : chunk.m_groupStarts)
+		{
+			uint32_t globalStart = static_cast<uint32_t>(chunk.m_cornerOffset) + groupStart;
+			if (globalStart > submeshStart)
+				out_mesh.m_submeshes.push_back({ submeshStart, globalStart - submeshStart, 0 });
+			submeshStart = std::max(submeshStart, globalStart);
+		}
+	}
+	if (cornerCount > submeshStart)
+		out_mesh.m_submeshes.push_back({ submeshStart, static_cast<uint32_t>(cornerCount) - submeshStart, 0 });
+
+	out_mesh.CalculateBounds();
+
+	if (out_stats)
+	{
+		out_stats->m_bytesRead = file.GetSize();
+		out_stats->m_seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	}
+	LOG("OBJ import: " << in_path << " " << out_mesh.m_vertices.size() << " vertices, "
+		<< out_mesh.m_indices.size() / 3 << " triangles, " << out_mesh.m_submeshes.size() << " submeshes, "
+		<< chunks.size() << " chunks");
+	return !out_mesh.m_indices.empty();
+}
+
+bool MeshImporter::ImportGLTF(const std::string& in_path, MeshData& out_mesh, JobSystem* in_jobSystem/* = nullptr*/, ImportStats* out_stats/* = nullptr*/)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	MappedFile file;
+	if (!file.Open(in_path)) return false;
+	size_t bytesRead = file.GetSize();
+
+	// Find the JSON document, and the binary chunk for GLB
+	const char* jsonBegin = reinterpret_cast<const char*>(file.GetData());
+	const char* jsonEnd = jsonBegin + file.GetSize();
+	const uint8_t* glbBinary = nullptr;
+	size_t glbBinarySize = 0;
+
+	uint32_t magic = 0;
+	if (file.GetSize() >= 12) memcpy(&magic, file.GetData(), 4);
+	if (magic == c_glbMagic)
+	{
+		// 12 byte header, then chunks of [length, type, data]
+		const uint8_t* ptr = file.GetData() + 12;
+		const uint8_t* end = file.GetData() + file.GetSize();
+		jsonBegin = jsonEnd = nullptr;
+		while (end - ptr >= 8)
+		{
+			uint32_t chunkLength, chunkType;
+			memcpy(&chunkLength, ptr, 4);
+			memcpy(&chunkType, ptr + 4, 4);
+			ptr += 8;
+			if (chunkLength > static_cast<size_t>(end - ptr)) break;
+			if (chunkType == c_glbChunkJSON && jsonBegin == nullptr)
+			{
+				jsonBegin = reinterpret_cast<const char*>(ptr);
+				jsonEnd = jsonBegin + chunkLength;
+			}
+			else if (chunkType == c_glbChunkBIN && glbBinary == nullptr)
+			{
+				glbBinary = ptr;
+				glbBinarySize = chunkLength;
+			}
+			ptr += (chunkLength + 3) & ~3u;
+		}
+		if (jsonBegin == nullptr)
+		{
+			LOG("glTF import: no JSON chunk in " << in_path);
+			return false;
+		}
+	}
+
+	JsonValue doc;
+	std::string parseError;
+	if (!JsonValue::Parse(jsonBegin, jsonEnd, doc, parseError))
+	{
+		LOG("glTF import: " << in_path << ": " << parseError);
+		return false;
+	}
+	if (doc["asset"]["version"].AsString().compare(0, 1, "2") != 0)
+	{
+		LOG("glTF import: only glTF 2.0 supported: " << in_path);
+		return false;
+	}
+
+	std::vector<std::unique_ptr<MappedFile>> bufferFiles;
+	std::vector<GltfBuffer> buffers;
+	if (!LoadGltfBuffers(doc, DirectoryOf(in_path), glbBinary, glbBinarySize, bufferFiles, buffers, bytesRead))
+	{
+		LOG("glTF import: failed to load buffers for " << in_path);
+		return false;
+	}
+
+	// Collect the primitives to bake from the scene graph
+	std::vector<GltfPrimitiveInstance> instances;
+	const JsonValue& scenes = doc["scenes"];
+	if (scenes.Size() > 0)
+	{
+		const JsonValue& scene = scenes[doc["scene"].AsInt(0)];
+		for (size_t i = 0; i < scene["nodes"].Size(); ++i)
+			CollectGltfNode(doc, scene["nodes"][i].AsInt(), glm::mat4(), 0, instances);
+	}
+	else
+	{
+		// No scene, take every mesh as is
+		for (size_t m = 0; m < doc["meshes"].Size(); ++m)
+		{
+			const JsonValue& primitives = doc["meshes"][m]["primitives"];
+			for (size_t i = 0; i < primitives.Size(); ++i)
+			{
+				if (primitives[i]["mode"].AsInt(4) == 4)
+					instances.push_back({ &primitives[i], glm::mat4(), 0, 0, 0, 0 });
+			}
+		}
+	}
+
+	// Decode every used accessor as its own task
+	std::vector<GltfAccessorData> accessors(doc["accessors"].Size());
+	std::vector<int> accessorIsIndices(accessors.size(), -1);
+	for (const GltfPrimitiveInstance& instance : instances)
+	{
+		const JsonValue& attributes = (*instance.m_primitive)["attributes"];
+		for (const char* name : { "POSITION", "NORMAL", "COLOR_0" })
+		{
+			int idx = attributes[name].AsInt(-1);
+			if (idx >= 0 && idx < static_cast<int>(accessors.size())) accessorIsIndices[idx] = 0;
+		}
+		int indicesIdx = (*instance.m_primitive)["indices"].AsInt(-1);
+		if (indicesIdx >= 0 && indicesIdx < static_cast<int>(accessors.size())) accessorIsIndices[indicesIdx] = 1;
+	}
+	std::vector<int> usedAccessors;
+	for (size_t i = 0; i < accessors.size(); ++i)
+	{
+		if (accessorIsIndices[i] >= 0) usedAccessors.push_back(static_cast<int>(i));
+	}
+	RunParallel(in_jobSystem, usedAccessors.size(), 1, [&](size_t in_begin, size_t in_end)
+	{
+		for (size_t i = in_begin; i < in_end; ++i)
+		{
+			int idx = usedAccessors[i];
+			accessors[idx].m_valid = DecodeGltfAccessor(doc, buffers, idx, accessorIsIndices[idx] == 1, accessors[idx]);
+		}
+	});
+
+	// Work out where each primitive goes in the output
+	size_t vertexCount = 0, indexCount = 0;
+	for (GltfPrimitiveInstance& instance : instances)
+	{
+		const JsonValue& primitive = *instance.m_primitive;
+		int positionIdx = primitive["attributes"]["POSITION"].AsInt(-1);
+		if (positionIdx < 0 || positionIdx >= static_cast<int>(accessors.size()) || !accessors[positionIdx].m_valid ||
+			accessors[positionIdx].m_components != 3)
+		{
+			LOG("glTF import: skipping primitive without valid positions");
+			continue;
+		}
+		instance.m_vertexCount = accessors[positionIdx].m_floats.size() / 3;
+		int indicesIdx = primitive["indices"].AsInt(-1);
+		if (indicesIdx >= 0)
+		{
+			if (!accessors[indicesIdx].m_valid) { instance.m_vertexCount = 0; continue; }
+			instance.m_indexCount = accessors[indicesIdx].m_indices.size();
+		}
+		else
+		{
+			instance.m_indexCount = instance.m_vertexCount;
+		}
+		instance.m_indexCount -= instance.m_indexCount % 3;
+		instance.m_vertexOffset = vertexCount;
+		instance.m_indexOffset = indexCount;
+		vertexCount += instance.m_vertexCount;
+		indexCount += instance.m_indexCount;
+	}
+
+	// Bake the transforms, deduplicate each primitive's vertices and emit its indices
+	std::vector<Vertex> vertices(vertexCount);
+	std::vector<uint32_t> indices(indexCount);
+	std::vector<uint32_t> uniqueCounts(instances.size(), 0);
+	std::atomic<bool> indicesValid(true);
+	RunParallel(in_jobSystem, instances.size(), 1, [&](size_t in_begin, size_t in_end)
+	{
+		for (size_t p = in_begin; p < in_end; ++p)
+		{
+			const GltfPrimitiveInstance& instance = instances[p];
+			if (instance.m_vertexCount == 0) continue;
+			const JsonValue& attributes = (*instance.m_primitive)["attributes"];
+			const GltfAccessorData& positions = accessors[attributes["POSITION"].AsInt()];
+			int normalIdx = attributes["NORMAL"].AsInt(-1);
+			int colorIdx = attributes["COLOR_0"].AsInt(-1);
+			const GltfAccessorData* normals = (normalIdx >= 0 && accessors[normalIdx].m_valid && accessors[normalIdx].m_components == 3) ? &accessors[normalIdx] : nullptr;
+			const GltfAccessorData* colors = (colorIdx >= 0 && accessors[colorIdx].m_valid && accessors[colorIdx].m_components >= 3) ? &accessors[colorIdx] : nullptr;
+			int indicesIdx = (*instance.m_primitive)["indices"].AsInt(-1);
+			const GltfAccessorData* sourceIndices = indicesIdx >= 0 ? &accessors[indicesIdx] : nullptr;
+
+			glm::mat3 normalTransform = glm::transpose(glm::inverse(glm::mat3(instance.m_transform)));
+
+			// Deduplicate on the final vertex content
+			std::unordered_map<Vertex, uint32_t, VertexHash, VertexEqual> vertexToUnique;
+			vertexToUnique.reserve(instance.m_vertexCount);
+			std::vector<uint32_t> remap(instance.m_vertexCount);
+			Vertex* dstVertices = vertices.data() + instance.m_vertexOffset;
+			uint32_t uniqueCount = 0;
+			for (size_t v = 0; v < instance.m_vertexCount; ++v)
+			{
+				glm::vec3 pos = glm::vec3(instance.m_transform * glm::vec4(glm::make_vec3(&positions.m_floats[v * 3]), 1.0f));
+				glm::vec3 col(1.0f);
+				if (colors && v * colors->m_components + 2 < colors->m_floats.size())
+					col = glm::make_vec3(&colors->m_floats[v * colors->m_components]);
+				else if (normals && v * 3 + 2 < normals->m_floats.size())
+					col = NormalAsColor(glm::normalize(normalTransform * glm::make_vec3(&normals->m_floats[v * 3])));
+
+				Vertex vertex;
+				SetVertex(pos, col, vertex);
+				auto inserted = vertexToUnique.insert(std::make_pair(vertex, uniqueCount));
+				if (inserted.second)
+					dstVertices[uniqueCount++] = vertex;
+				remap[v] = inserted.first->second;
+			}
+			uniqueCounts[p] = uniqueCount;
+
+			// Indices are primitive local for now, rebased when the vertices are compacted
+			uint32_t* dstIndices = indices.data() + instance.m_indexOffset;
+			for (size_t i = 0; i < instance.m_indexCount; ++i)
+			{
+				uint32_t src = sourceIndices ? sourceIndices->m_indices[i] : static_cast<uint32_t>(i);
+				if (src >= instance.m_vertexCount)
+				{
+					indicesValid = false;
+					src = 0;
+				}
+				dstIndices[i] = remap[src];
+			}
+		}
+	});
+	if (!indicesValid)
+	{
+		LOG("glTF import: index out of range in " << in_path);
+		return false;
+	}
+
+	// Compact the deduplicated vertices and rebase the indices
+	out_mesh = MeshData();
+	std::vector<uint32_t> compactOffsets(instances.size(), 0);
+	uint32_t compactCount = 0;
+	for (size_t p = 0; p < instances.size(); ++p)
+	{
+		compactOffsets[p] = compactCount;
+		compactCount += uniqueCounts[p];
+	}
+	out_mesh.m_vertices.resize(compactCount);
+	out_mesh.m_indices.swap(indices);
+	RunParallel(in_jobSystem, instances.size(), 1, [&](size_t in_begin, size_t in_end)
+	{
+		for (size_t p = in_begin; p < in_end; ++p)
+		{
+			const GltfPrimitiveInstance& instance = instances[p];
+			if (uniqueCounts[p] == 0) continue;
+			memcpy(out_mesh.m_vertices.data() + compactOffsets[p], vertices.data() + instance.m_vertexOffset, uniqueCounts[p] * sizeof(Vertex));
+			uint32_t* dstIndices = out_mesh.m_indices.data() + instance.m_indexOffset;
+			for (size_t i = 0; i < instance.m_indexCount; ++i)
+				dstIndices[i] += compactOffsets[p];
+		}
+	});
+	for (const GltfPrimitiveInstance& instance : instances)
+	{
+		if (instance.m_indexCount > 0)
+			out_mesh.m_submeshes.push_back({ static_cast<uint32_t>(instance.m_indexOffset), static_cast<uint32_t>(instance.m_indexCount), 0 });
+	}
+
+	out_mesh.CalculateBounds();
+
+	if (out_stats)
+	{
+		out_stats->m_bytesRead = bytesRead;
+		out_stats->m_seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	}
+	LOG("glTF import: " << in_path << " " << out_mesh.m_vertices.size() << " vertices, "
+		<< out_mesh.m_indices.size() / 3 << " triangles, " << out_mesh.m_submeshes.size() << " submeshes, "
+		<< usedAccessors.size() << " accessors");
+	return !out_mesh.m_indices.empty();
+}
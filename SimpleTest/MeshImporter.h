@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+
+struct MeshData;
+class JobSystem;
+
+// =======================================================================================
+//                                      MeshImporter
+// =======================================================================================
+
+///---------------------------------------------------------------------------------------
+/// \brief	Import of source mesh formats into MeshData
+///
+/// Only used offline by the MeshConverter, the renderer loads mesh files.
+///
+/// OBJ files are split into line aligned chunks that are parsed in parallel, their
+/// relative indices are resolved once all chunk sizes are known. Vertices are
+/// deduplicated on their position/normal index pair (texture coordinates are not part
+/// of Vertex, so they don't split vertices). Vertex color is taken from the OBJ vertex
+/// color extension ("v x y z r g b") if present, otherwise the normal is used as color.
+///
+/// glTF 2.0 files (.gltf with external or embedded buffers, and .glb) decode each
+/// accessor as its own task, then bake the node transforms into one vertex/index set
+/// with a submesh per primitive. Vertices are deduplicated by content per primitive.
+///
+/// The job system is optional, without one everything runs on the calling thread.
+///---------------------------------------------------------------------------------------
+
+namespace MeshImporter
+{
+	struct ImportStats
+	{
+		size_t m_bytesRead;  // source bytes, including external glTF buffers
+		double m_seconds;
+	};
+
+	// Picks the importer from the file extension
+	bool Import(const std::string& in_path, MeshData& out_mesh, JobSystem* in_jobSystem = nullptr, ImportStats* out_stats = nullptr);
+
+	bool ImportOBJ(const std::string& in_path, MeshData& out_mesh, JobSystem* in_jobSystem = nullptr, ImportStats* out_stats = nullptr);
+	bool ImportGLTF(const std::string& in_path, MeshData& out_mesh, JobSystem* in_jobSystem = nullptr, ImportStats* out_stats = nullptr);
+}
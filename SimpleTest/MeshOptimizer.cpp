@@ -0,0 +1,475 @@
+#include "MeshOptimizer.h"
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include "MeshData.h"
+#include "JobSystem.h"
+
+namespace
+{
+	const uint32_t c_invalidIndex = 0xFFFFFFFF;
+
+	// Submeshes to process, a mesh without any is treated as one submesh
+	std::vector<MeshData::Submesh> GetSubmeshes(const MeshData& in_mesh)
+	{
+		if (!in_mesh.m_submeshes.empty()) return in_mesh.m_submeshes;
+		return{ { 0, static_cast<uint32_t>(in_mesh.m_indices.size()), 0 } };
+	}
+
+	glm::vec3 GetPosition(const Vertex& in_vertex)
+	{
+		return glm::vec3(in_vertex.m_pos[0], in_vertex.m_pos[1], in_vertex.m_pos[2]);
+	}
+
+	// FIFO cache simulation using per vertex timestamps, a vertex is in the cache if fewer
+	// than in_cacheSize misses happened since it was loaded. Advancing inout_time by more
+	// than the cache size flushes the cache.
+	bool UpdateCache(uint32_t in_vertex, unsigned int in_cacheSize, std::vector<uint32_t>& inout_timestamps, uint32_t& inout_time)
+	{
+		if (inout_time - inout_timestamps[in_vertex] > in_cacheSize)
+		{
+			inout_timestamps[in_vertex] = inout_time++;
+			return true;
+		}
+		return false;
+	}
+
+	// Copy a submesh's index range to local vertex ids 0..n-1, in_globalToLocal must be all invalid
+	// and is restored to that state before returning
+	void BuildLocalIndices(const MeshData& in_mesh, const MeshData::Submesh& in_submesh, std::vector<uint32_t>& inout_globalToLocal,
+		std::vector<uint32_t>& out_localIndices, std::vector<uint32_t>& out_localToGlobal)
+	{
+		size_t indexCount = in_submesh.m_indexCount - in_submesh.m_indexCount % 3;
+		out_localIndices.resize(indexCount);
+		out_localToGlobal.clear();
+		for (size_t i = 0; i < indexCount; ++i)
+		{
+			uint32_t global = in_mesh.m_indices[in_submesh.m_firstIndex + i] + in_submesh.m_vertexOffset;
+			uint32_t& local = inout_globalToLocal[global];
+			if (local == c_invalidIndex)
+			{
+				local = static_cast<uint32_t>(out_localToGlobal.size());
+				out_localToGlobal.push_back(global);
+			}
+			out_localIndices[i] = local;
+		}
+		for (uint32_t global : out_localToGlobal)
+		{
+			inout_globalToLocal[global] = c_invalidIndex;
+		}
+	}
+
+	class Tipsify
+	{
+	public:
+		Tipsify(const uint32_t* in_indices, size_t in_indexCount, size_t in_vertexCount, unsigned int in_cacheSize)
+			: m_indices(in_indices)
+			, m_indexCount(in_indexCount)
+			, m_vertexCount(in_vertexCount)
+			, m_cacheSize(in_cacheSize)
+			, m_cursor(0)
+		{}
+
+		// Writes the reordered triangles to out_indices and the first triangle of every
+		// cluster that starts at a dead end (where the cache state is unknown)
+		void Run(uint32_t* out_indices, std::vector<uint32_t>& out_hardBoundaries)
+		{
+			size_t triangleCount = m_indexCount / 3;
+
+			// Vertex to triangle adjacency, and live triangle count per vertex
+			m_liveTriangles.assign(m_vertexCount, 0);
+			for (size_t i = 0; i < m_indexCount; ++i) m_liveTriangles[m_indices[i]]++;
+			std::vector<uint32_t> adjacencyOffsets(m_vertexCount + 1, 0);
+			for (size_t v = 0; v < m_vertexCount; ++v) adjacencyOffsets[v + 1] = adjacencyOffsets[v] + m_liveTriangles[v];
+			std::vector<uint32_t> adjacency(m_indexCount);
+			{
+				std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+				for (size_t i = 0; i < m_indexCount; ++i) adjacency[fill[m_indices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+
+			std::vector<uint32_t> timestamps(m_vertexCount, 0);
+			std::vector<bool> emitted(triangleCount, false);
+			std::vector<uint32_t> candidates;
+			uint32_t time = m_cacheSize + 1;
+			size_t outCount = 0;
+
+			int64_t fanVertex = m_vertexCount > 0 ? 0 : -1;
+			bool deadEnd = true;
+			while (fanVertex >= 0)
+			{
+				if (deadEnd && (out_hardBoundaries.empty() || out_hardBoundaries.back() != outCount / 3))
+					out_hardBoundaries.push_back(static_cast<uint32_t>(outCount / 3));
+
+				// Emit all remaining triangles around the fan vertex
+				candidates.clear();
+				for (uint32_t a = adjacencyOffsets[fanVertex]; a < adjacencyOffsets[fanVertex + 1]; ++a)
+				{
+					uint32_t triangle = adjacency[a];
+					if (emitted[triangle]) continue;
+					for (int k = 0; k < 3; ++k)
+					{
+						uint32_t v = m_indices[triangle * 3 + k];
+						out_indices[outCount++] = v;
+						m_deadEndStack.push_back(v);
+						candidates.push_back(v);
+						m_liveTriangles[v]--;
+						UpdateCache(v, m_cacheSize, timestamps, time);
+					}
+					emitted[triangle] = true;
+				}
+
+				// Next fan: the candidate that has been in the cache longest while still
+				// staying in the cache when its remaining triangles are emitted
+				int64_t best = -1;
+				int64_t bestPriority = -1;
+				for (uint32_t v : candidates)
+				{
+					if (m_liveTriangles[v] == 0) continue;
+					int64_t priority = 0;
+					if (time - timestamps[v] + 2 * m_liveTriangles[v] <= m_cacheSize)
+						priority = time - timestamps[v];
+					if (priority > bestPriority)
+					{
+						bestPriority = priority;
+						best = v;
+					}
+				}
+				deadEnd = best < 0;
+				fanVertex = deadEnd ? SkipDeadEnd() : best;
+			}
+		}
+
+	private:
+		int64_t SkipDeadEnd()
+		{
+			// Recently used vertices first, then the next one in input order
+			while (!m_deadEndStack.empty())
+			{
+				uint32_t v = m_deadEndStack.back();
+				m_deadEndStack.pop_back();
+				if (m_liveTriangles[v] > 0) return v;
+			}
+			for (; m_cursor < m_vertexCount; ++m_cursor)
+			{
+				if (m_liveTriangles[m_cursor] > 0) return static_cast<int64_t>(m_cursor);
+			}
+			return -1;
+		}
+
+		const uint32_t*       m_indices;
+		size_t                m_indexCount;
+		size_t                m_vertexCount;
+		unsigned int          m_cacheSize;
+		size_t                m_cursor;
+		std::vector<uint32_t> m_liveTriangles;
+		std::vector<uint32_t> m_deadEndStack;
+	};
+
+	// Split the cache optimized order into clusters and draw them roughly outside in
+	void OptimizeOverdraw(std::vector<uint32_t>& inout_indices, const std::vector<uint32_t>& in_hardBoundaries,
+		const std::vector<glm::vec3>& in_positions, unsigned int in_cacheSize, float in_threshold)
+	{
+		uint32_t triangleCount = static_cast<uint32_t>(inout_indices.size() / 3);
+		if (triangleCount < 2) return;
+
+		// Soft boundaries inside each hard cluster wherever the cluster so far has an ACMR
+		// within the threshold of the whole hard cluster, the cache is flushed at each start
+		std::vector<uint32_t> clusters;
+		std::vector<uint32_t> timestamps(in_positions.size(), 0);
+		uint32_t time = in_cacheSize + 1;
+		for (size_t h = 0; h < in_hardBoundaries.size(); ++h)
+		{
+			uint32_t start = in_hardBoundaries[h];
+			uint32_t end = h + 1 < in_hardBoundaries.size() ? in_hardBoundaries[h + 1] : triangleCount;
+			clusters.push_back(start);
+			if (in_threshold <= 1.0f) continue;
+
+			time += in_cacheSize + 1;
+			uint32_t hardMisses = 0;
+			for (uint32_t i = start * 3; i < end * 3; ++i)
+				hardMisses += UpdateCache(inout_indices[i], in_cacheSize, timestamps, time) ? 1 : 0;
+			float acmrLimit = in_threshold * hardMisses / (end - start);
+
+			time += in_cacheSize + 1;
+			uint32_t clusterStart = start;
+			uint32_t misses = 0;
+			for (uint32_t t = start; t < end; ++t)
+			{
+				for (int k = 0; k < 3; ++k)
+					misses += UpdateCache(inout_indices[t * 3 + k], in_cacheSize, timestamps, time) ? 1 : 0;
+				if (t + 1 < end && static_cast<float>(misses) / (t + 1 - clusterStart) <= acmrLimit)
+				{
+					clusters.push_back(t + 1);
+					clusterStart = t + 1;
+					misses = 0;
+					time += in_cacheSize + 1;
+				}
+			}
+		}
+		if (clusters.size() < 2) return;
+
+		// Area weighted centroid and normal of each cluster
+		size_t clusterCount = clusters.size();
+		std::vector<glm::vec3> clusterCentroids(clusterCount);
+		std::vector<glm::vec3> clusterNormals(clusterCount);
+		glm::vec3 meshCentroid;
+		float meshArea = 0.0f;
+		for (size_t c = 0; c < clusterCount; ++c)
+		{
+			uint32_t end = c + 1 < clusterCount ? clusters[c + 1] : triangleCount;
+			glm::vec3 centroid, normal;
+			float area = 0.0f;
+			for (uint32_t t = clusters[c]; t < end; ++t)
+			{
+				const glm::vec3& p0 = in_positions[inout_indices[t * 3 + 0]];
+				const glm::vec3& p1 = in_positions[inout_indices[t * 3 + 1]];
+				const glm::vec3& p2 = in_positions[inout_indices[t * 3 + 2]];
+				glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+				float triangleArea = glm::length(n);
+				centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+				normal += n;
+				area += triangleArea;
+			}
+			meshCentroid += centroid;
+			meshArea += area;
+			clusterCentroids[c] = area > 0.0f ? centroid / area : centroid;
+			float normalLength = glm::length(normal);
+			clusterNormals[c] = normalLength > 0.0f ? normal / normalLength : normal;
+		}
+		if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+		// Clusters facing away from the center are likely to occlude the others
+		std::vector<float> sortKeys(clusterCount);
+		for (size_t c = 0; c < clusterCount; ++c)
+			sortKeys[c] = glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c]);
+		std::vector<uint32_t> order(clusterCount);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&sortKeys](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+		std::vector<uint32_t> sorted;
+		sorted.reserve(inout_indices.size());
+		for (uint32_t c : order)
+		{
+			uint32_t end = c + 1 < clusterCount ? clusters[c + 1] : triangleCount;
+			sorted.insert(sorted.end(), inout_indices.begin() + clusters[c] * 3, inout_indices.begin() + end * 3);
+		}
+		inout_indices.swap(sorted);
+	}
+
+	void OptimizeVertexFetch(MeshData& inout_mesh)
+	{
+		std::vector<MeshData::Submesh> submeshes = GetSubmeshes(inout_mesh);
+		std::vector<uint32_t> remap(inout_mesh.m_vertices.size(), c_invalidIndex);
+		std::vector<Vertex> vertices;
+		vertices.reserve(inout_mesh.m_vertices.size());
+
+		// Renumber in order of first use, submesh vertex offsets are folded into the indices
+		for (MeshData::Submesh& submesh : submeshes)
+		{
+			for (uint32_t i = submesh.m_firstIndex; i < submesh.m_firstIndex + submesh.m_indexCount; ++i)
+			{
+				uint32_t global = inout_mesh.m_indices[i] + submesh.m_vertexOffset;
+				if (remap[global] == c_invalidIndex)
+				{
+					remap[global] = static_cast<uint32_t>(vertices.size());
+					vertices.push_back(inout_mesh.m_vertices[global]);
+				}
+				inout_mesh.m_indices[i] = remap[global];
+			}
+			submesh.m_vertexOffset = 0;
+		}
+
+		inout_mesh.m_vertices.swap(vertices);
+		if (!inout_mesh.m_submeshes.empty()) inout_mesh.m_submeshes = submeshes;
+	}
+}
+
+MeshOptimizer::VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const MeshData& in_mesh, unsigned int in_cacheSize/* = c_defaultCacheSize*/)
+{
+	VertexCacheStats stats = {};
+	std::vector<uint32_t> timestamps(in_mesh.m_vertices.size(), 0);
+	std::vector<uint32_t> lastSeenSubmesh(in_mesh.m_vertices.size(), c_invalidIndex);
+	uint32_t time = in_cacheSize + 1;
+
+	std::vector<MeshData::Submesh> submeshes = GetSubmeshes(in_mesh);
+	for (uint32_t s = 0; s < submeshes.size(); ++s)
+	{
+		const MeshData::Submesh& submesh = submeshes[s];
+		// Every draw starts with a cold cache
+		time += in_cacheSize + 1;
+		for (uint32_t i = submesh.m_firstIndex; i < submesh.m_firstIndex + submesh.m_indexCount; ++i)
+		{
+			uint32_t v = in_mesh.m_indices[i] + submesh.m_vertexOffset;
+			if (UpdateCache(v, in_cacheSize, timestamps, time)) stats.m_transformCount++;
+			if (lastSeenSubmesh[v] != s)
+			{
+				lastSeenSubmesh[v] = s;
+				stats.m_uniqueVertexCount++;
+			}
+		}
+		stats.m_triangleCount += submesh.m_indexCount / 3;
+	}
+
+	stats.m_acmr = stats.m_triangleCount > 0 ? static_cast<float>(stats.m_transformCount) / stats.m_triangleCount : 0.0f;
+	stats.m_atvr = stats.m_uniqueVertexCount > 0 ? static_cast<float>(stats.m_transformCount) / stats.m_uniqueVertexCount : 0.0f;
+	return stats;
+}
+
+void MeshOptimizer::Optimize(MeshData& inout_mesh, const Options& in_options, JobSystem* in_jobSystem/* = nullptr*/,
+	VertexCacheStats* out_before/* = nullptr*/, VertexCacheStats* out_after/* = nullptr*/)
+{
+	if (out_before) *out_before = AnalyzeVertexCache(inout_mesh, in_options.m_cacheSize);
+
+	std::vector<MeshData::Submesh> submeshes = GetSubmeshes(inout_mesh);
+	auto optimizeSubmeshes = [&](size_t in_begin, size_t in_end)
+	{
+		std::vector<uint32_t> globalToLocal(inout_mesh.m_vertices.size(), c_invalidIndex);
+		std::vector<uint32_t> localIndices, localToGlobal, optimized, hardBoundaries;
+		std::vector<glm::vec3> positions;
+		for (size_t s = in_begin; s < in_end; ++s)
+		{
+			const MeshData::Submesh& submesh = submeshes[s];
+			BuildLocalIndices(inout_mesh, submesh, globalToLocal, localIndices, localToGlobal);
+			if (localIndices.empty()) continue;
+
+			optimized.resize(localIndices.size());
+			hardBoundaries.clear();
+			Tipsify tipsify(localIndices.data(), localIndices.size(), localToGlobal.size(), in_options.m_cacheSize);
+			tipsify.Run(optimized.data(), hardBoundaries);
+
+			if (in_options.m_optimizeOverdraw)
+			{
+				positions.resize(localToGlobal.size());
+				for (size_t v = 0; v < localToGlobal.size(); ++v)
+					positions[v] = GetPosition(inout_mesh.m_vertices[localToGlobal[v]]);
+				OptimizeOverdraw(optimized, hardBoundaries, positions, in_options.m_cacheSize, in_options.m_overdrawThreshold);
+			}
+
+			// Submeshes don't overlap, so each one writes its own index range
+			for (size_t i = 0; i < optimized.size(); ++i)
+				inout_mesh.m_indices[submesh.m_firstIndex + i] = localToGlobal[optimized[i]] - submesh.m_vertexOffset;
+		}
+	};
+	if (in_jobSystem)
+		in_jobSystem->ParallelFor(submeshes.size(), 1, optimizeSubmeshes);
+	else
+		optimizeSubmeshes(0, submeshes.size());
+
+	if (in_options.m_optimizeVertexFetch)
+		OptimizeVertexFetch(inout_mesh);
+
+	if (out_after) *out_after = AnalyzeVertexCache(inout_mesh, in_options.m_cacheSize);
+}
+
+bool MeshOptimizer::MakeShortIndices(MeshData& inout_mesh, uint32_t in_vertexStride, size_t* out_addedVertices/* = nullptr*/)
+{
+	if (out_addedVertices) *out_addedVertices = 0;
+	std::vector<MeshData::Submesh> submeshes = GetSubmeshes(inout_mesh);
+
+	// Vertex range of each submesh
+	bool fitsAfterRebase = true;
+	std::vector<uint32_t> submeshMin(submeshes.size(), c_invalidIndex);
+	for (size_t s = 0; s < submeshes.size(); ++s)
+	{
+		const MeshData::Submesh& submesh = submeshes[s];
+		uint32_t minVertex = c_invalidIndex, maxVertex = 0;
+		for (uint32_t i = submesh.m_firstIndex; i < submesh.m_firstIndex + submesh.m_indexCount; ++i)
+		{
+			uint32_t v = inout_mesh.m_indices[i] + submesh.m_vertexOffset;
+			minVertex = std::min(minVertex, v);
+			maxVertex = std::max(maxVertex, v);
+		}
+		if (submesh.m_indexCount == 0) continue;
+		submeshMin[s] = minVertex;
+		fitsAfterRebase = fitsAfterRebase && maxVertex - minVertex < c_maxShortIndexVertices;
+	}
+
+	if (fitsAfterRebase)
+	{
+		for (size_t s = 0; s < submeshes.size(); ++s)
+		{
+			MeshData::Submesh& submesh = submeshes[s];
+			if (submeshMin[s] == c_invalidIndex) continue;
+			uint32_t rebase = submeshMin[s] - submesh.m_vertexOffset;
+			for (uint32_t i = submesh.m_firstIndex; i < submesh.m_firstIndex + submesh.m_indexCount; ++i)
+				inout_mesh.m_indices[i] -= rebase;
+			submesh.m_vertexOffset = static_cast<int32_t>(submeshMin[s]);
+		}
+		inout_mesh.m_submeshes = submeshes;
+		return true;
+	}
+
+	// Split into clusters in draw order, each with its own vertex range
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<MeshData::Submesh> clusters;
+	std::vector<uint32_t> clusterSubmesh; // submesh each cluster came from
+	vertices.reserve(inout_mesh.m_vertices.size());
+	indices.reserve(inout_mesh.m_indices.size());
+	std::vector<uint32_t> globalToLocal(inout_mesh.m_vertices.size(), c_invalidIndex);
+	std::vector<uint32_t> clusterVertices;
+
+	uint32_t currentSubmesh = 0;
+	auto closeCluster = [&]()
+	{
+		uint32_t firstIndex = clusters.empty() ? 0 : clusters.back().m_firstIndex + clusters.back().m_indexCount;
+		if (indices.size() > firstIndex)
+		{
+			int32_t vertexOffset = static_cast<int32_t>(vertices.size());
+			clusters.push_back({ firstIndex, static_cast<uint32_t>(indices.size()) - firstIndex, vertexOffset });
+			clusterSubmesh.push_back(currentSubmesh);
+			for (uint32_t v : clusterVertices)
+			{
+				vertices.push_back(inout_mesh.m_vertices[v]);
+				globalToLocal[v] = c_invalidIndex;
+			}
+		}
+		clusterVertices.clear();
+	};
+
+	for (; currentSubmesh < submeshes.size(); ++currentSubmesh)
+	{
+		const MeshData::Submesh& submesh = submeshes[currentSubmesh];
+		uint32_t indexEnd = submesh.m_firstIndex + submesh.m_indexCount - submesh.m_indexCount % 3;
+		for (uint32_t i = submesh.m_firstIndex; i < indexEnd; i += 3)
+		{
+			uint32_t newVertices = 0;
+			for (int k = 0; k < 3; ++k)
+				newVertices += globalToLocal[inout_mesh.m_indices[i + k] + submesh.m_vertexOffset] == c_invalidIndex ? 1 : 0;
+			if (clusterVertices.size() + newVertices > c_maxShortIndexVertices)
+				closeCluster();
+
+			for (int k = 0; k < 3; ++k)
+			{
+				uint32_t v = inout_mesh.m_indices[i + k] + submesh.m_vertexOffset;
+				if (globalToLocal[v] == c_invalidIndex)
+				{
+					globalToLocal[v] = static_cast<uint32_t>(clusterVertices.size());
+					clusterVertices.push_back(v);
+				}
+				indices.push_back(globalToLocal[v]);
+			}
+		}
+		// Keep submesh boundaries as cluster boundaries
+		closeCluster();
+	}
+
+	size_t addedVertices = vertices.size() > inout_mesh.m_vertices.size() ? vertices.size() - inout_mesh.m_vertices.size() : 0;
+	if (addedVertices * in_vertexStride >= inout_mesh.m_indices.size() * sizeof(uint16_t))
+		return false;
+
+	inout_mesh.m_vertices.swap(vertices);
+	inout_mesh.m_indices.swap(indices);
+	inout_mesh.m_submeshes.swap(clusters);
+
+	// Levels of detail now cover the clusters of their submeshes
+	for (MeshData::Lod& lod : inout_mesh.m_lods)
+	{
+		auto first = std::lower_bound(clusterSubmesh.begin(), clusterSubmesh.end(), lod.m_firstSubmesh);
+		auto last = std::lower_bound(clusterSubmesh.begin(), clusterSubmesh.end(), lod.m_firstSubmesh + lod.m_submeshCount);
+		lod.m_firstSubmesh = static_cast<uint32_t>(first - clusterSubmesh.begin());
+		lod.m_submeshCount = static_cast<uint32_t>(last - first);
+	}
+	if (out_addedVertices) *out_addedVertices = addedVertices;
+	return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+struct MeshData;
+class JobSystem;
+
+// =======================================================================================
+//                                      MeshOptimizer
+// =======================================================================================
+
+///---------------------------------------------------------------------------------------
+/// \brief	Offline reordering of mesh data for the GPU vertex pipeline
+///
+/// Run by the MeshConverter between import and writing the mesh file.
+///
+/// 1. Triangles of each submesh are reordered for the post transform vertex cache with
+///    Tipsify (Sander et al. 2007, "Fast Triangle Reordering for Vertex Locality and
+///    Reduced Overdraw").
+/// 2. The same paper's overdraw pass splits the cache optimized order into clusters
+///    and sorts these so outward facing clusters, which tend to occlude the rest, are
+///    drawn first. The threshold limits how much cache efficiency may be given up.
+/// 3. Vertices are renumbered in order of first use for vertex fetch locality and
+///    unreferenced vertices are dropped.
+///
+/// Steps 1 and 2 are independent per submesh and run in parallel as jobs.
+///
+/// MakeShortIndices is a separate step that prepares the mesh for 16 bit index buffers.
+///---------------------------------------------------------------------------------------
+
+namespace MeshOptimizer
+{
+	// Matches the post transform cache size assumed on most current GPUs
+	const unsigned int c_defaultCacheSize = 16;
+
+	struct VertexCacheStats
+	{
+		size_t m_triangleCount;
+		size_t m_uniqueVertexCount;
+		size_t m_transformCount;    // cache misses in a simulated FIFO cache
+		float  m_acmr;              // average cache miss ratio, transforms per triangle (0.5 - 3)
+		float  m_atvr;              // average transform to vertex ratio (1 is optimal)
+	};
+
+	struct Options
+	{
+		Options()
+			: m_cacheSize(c_defaultCacheSize)
+			, m_overdrawThreshold(1.05f)
+			, m_optimizeOverdraw(true)
+			, m_optimizeVertexFetch(true)
+		{}
+
+		unsigned int m_cacheSize;
+		float        m_overdrawThreshold; // allowed ACMR increase of overdraw clusters, <= 1 disables splitting
+		bool         m_optimizeOverdraw;
+		bool         m_optimizeVertexFetch;
+	};
+
+	// Simulate a FIFO cache over every submesh of the mesh
+	VertexCacheStats AnalyzeVertexCache(const MeshData& in_mesh, unsigned int in_cacheSize = c_defaultCacheSize);
+
+	const uint32_t c_maxShortIndexVertices = 0x10000;
+
+	// Rebase every submesh on the lowest vertex it uses, so its indices fit in 16 bits.
+	// Submeshes referencing more than c_maxShortIndexVertices vertices are split into
+	// clusters that each get a copy of the vertices they use. The split is only kept if the
+	// added vertex bytes are fewer than the index bytes saved, returns whether all
+	// indices now fit in 16 bits.
+	bool MakeShortIndices(MeshData& inout_mesh, uint32_t in_vertexStride, size_t* out_addedVertices = nullptr);
+
+	// Reorder in place, optionally returning the cache statistics before and after
+	void Optimize(MeshData& inout_mesh, const Options& in_options, JobSystem* in_jobSystem = nullptr,
+		VertexCacheStats* out_before = nullptr, VertexCacheStats* out_after = nullptr);
+}
@@ -0,0 +1,452 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "MeshData.h"
+#include "JobSystem.h"
+
+namespace
+{
+	const uint32_t c_invalidIndex = 0xFFFFFFFF;
+	// Border planes are weighted up so open edges keep their shape
+	const double c_borderWeight = 10.0;
+	// Cosine of the largest rotation a triangle may get from one collapse
+	const double c_minNormalDot = 0.25;
+
+	struct Quadric
+	{
+		double m_a00, m_a01, m_a02, m_a11, m_a12, m_a22;
+		double m_b0, m_b1, m_b2;
+		double m_c;
+		double m_weight;
+	};
+
+	// Add the squared distance to the plane n.p + d = 0 (n unit length)
+	void AddPlane(Quadric& inout_quadric, const glm::dvec3& in_normal, double in_distance, double in_weight)
+	{
+		const glm::dvec3& n = in_normal;
+		inout_quadric.m_a00 += in_weight * n.x * n.x;
+		inout_quadric.m_a01 += in_weight * n.x * n.y;
+		inout_quadric.m_a02 += in_weight * n.x * n.z;
+		inout_quadric.m_a11 += in_weight * n.y * n.y;
+		inout_quadric.m_a12 += in_weight * n.y * n.z;
+		inout_quadric.m_a22 += in_weight * n.z * n.z;
+		inout_quadric.m_b0 += in_weight * n.x * in_distance;
+		inout_quadric.m_b1 += in_weight * n.y * in_distance;
+		inout_quadric.m_b2 += in_weight * n.z * in_distance;
+		inout_quadric.m_c += in_weight * in_distance * in_distance;
+		inout_quadric.m_weight += in_weight;
+	}
+
+	void AddQuadric(Quadric& inout_quadric, const Quadric& in_other)
+	{
+		inout_quadric.m_a00 += in_other.m_a00;
+		inout_quadric.m_a01 += in_other.m_a01;
+		inout_quadric.m_a02 += in_other.m_a02;
+		inout_quadric.m_a11 += in_other.m_a11;
+		inout_quadric.m_a12 += in_other.m_a12;
+		inout_quadric.m_a22 += in_other.m_a22;
+		inout_quadric.m_b0 += in_other.m_b0;
+		inout_quadric.m_b1 += in_other.m_b1;
+		inout_quadric.m_b2 += in_other.m_b2;
+		inout_quadric.m_c += in_other.m_c;
+		inout_quadric.m_weight += in_other.m_weight;
+	}
+
+	// Weighted mean squared distance to the planes of the quadric
+	double Evaluate(const Quadric& in_quadric, const glm::dvec3& in_pos)
+	{
+		const Quadric& q = in_quadric;
+		const glm::dvec3& p = in_pos;
+		double result =
+			q.m_a00 * p.x * p.x + 2.0 * q.m_a01 * p.x * p.y + 2.0 * q.m_a02 * p.x * p.z +
+			q.m_a11 * p.y * p.y + 2.0 * q.m_a12 * p.y * p.z +
+			q.m_a22 * p.z * p.z +
+			2.0 * (q.m_b0 * p.x + q.m_b1 * p.y + q.m_b2 * p.z) + q.m_c;
+		return q.m_weight > 0.0 ? std::fabs(result) / q.m_weight : 0.0;
+	}
+
+	inline uint64_t EdgeKey(uint32_t in_a, uint32_t in_b)
+	{
+		return in_a < in_b ? (uint64_t(in_a) << 32) | in_b : (uint64_t(in_b) << 32) | in_a;
+	}
+
+	struct Collapse
+	{
+		uint32_t m_from;
+		uint32_t m_to;
+		double   m_cost;
+	};
+
+	// Welded triangle soup of one simplification job, vertex ids are local
+	class Simplifier
+	{
+	public:
+		Simplifier(const MeshData& in_mesh, const uint32_t* in_indices, size_t in_indexCount)
+		{
+			Weld(in_mesh, in_indices, in_indexCount);
+			InitQuadrics();
+		}
+
+		// Returns the largest collapse error, squared
+		double Run(size_t in_targetIndexCount, double in_maxErrorSquared)
+		{
+			double maxCost = 0.0;
+			while (m_indices.size() > in_targetIndexCount)
+			{
+				size_t trianglesToRemove = (m_indices.size() - in_targetIndexCount) / 3;
+				size_t removed = 0;
+				bool reachedMaxError = false;
+				if (!RunPass(trianglesToRemove, in_maxErrorSquared, removed, maxCost, reachedMaxError) || reachedMaxError)
+					break;
+			}
+			return maxCost;
+		}
+
+		void GetIndices(std::vector<uint32_t>& out_indices) const
+		{
+			out_indices.resize(m_indices.size());
+			for (size_t i = 0; i < m_indices.size(); ++i)
+				out_indices[i] = m_localToGlobal[m_indices[i]];
+		}
+
+	private:
+		// Merge vertices with identical positions, so seams don't stop collapses
+		void Weld(const MeshData& in_mesh, const uint32_t* in_indices, size_t in_indexCount)
+		{
+			std::vector<uint32_t> globals(in_indices, in_indices + in_indexCount - in_indexCount % 3);
+			std::sort(globals.begin(), globals.end());
+			globals.erase(std::unique(globals.begin(), globals.end()), globals.end());
+
+			auto position = [&](uint32_t in_global)
+			{
+				const Vertex& v = in_mesh.m_vertices[in_global];
+				return glm::vec3(v.m_pos[0], v.m_pos[1], v.m_pos[2]);
+			};
+			std::vector<uint32_t> byPosition(globals.begin(), globals.end());
+			std::sort(byPosition.begin(), byPosition.end(), [&](uint32_t in_a, uint32_t in_b)
+			{
+				glm::vec3 a = position(in_a), b = position(in_b);
+				if (a.x != b.x) return a.x < b.x;
+				if (a.y != b.y) return a.y < b.y;
+				if (a.z != b.z) return a.z < b.z;
+				return in_a < in_b;
+			});
+
+			// The lowest global index of each position represents it
+			std::vector<std::pair<uint32_t, uint32_t>> globalToLocal;
+			globalToLocal.reserve(globals.size());
+			for (size_t i = 0; i < byPosition.size(); ++i)
+			{
+				if (i == 0 || position(byPosition[i]) != position(byPosition[i - 1]))
+				{
+					m_localToGlobal.push_back(byPosition[i]);
+					m_positions.push_back(glm::dvec3(position(byPosition[i])));
+				}
+				globalToLocal.push_back(std::make_pair(byPosition[i], static_cast<uint32_t>(m_localToGlobal.size() - 1)));
+			}
+			std::sort(globalToLocal.begin(), globalToLocal.end());
+
+			auto toLocal = [&](uint32_t in_global)
+			{
+				return std::lower_bound(globalToLocal.begin(), globalToLocal.end(), std::make_pair(in_global, 0u))->second;
+			};
+			m_indices.reserve(globals.empty() ? 0 : in_indexCount);
+			for (size_t i = 0; i + 3 <= in_indexCount; i += 3)
+			{
+				uint32_t a = toLocal(in_indices[i]), b = toLocal(in_indices[i + 1]), c = toLocal(in_indices[i + 2]);
+				if (a == b || b == c || a == c) continue;
+				m_indices.push_back(a);
+				m_indices.push_back(b);
+				m_indices.push_back(c);
+			}
+		}
+
+		void InitQuadrics()
+		{
+			m_quadrics.assign(m_positions.size(), Quadric());
+			for (size_t i = 0; i < m_indices.size(); i += 3)
+			{
+				const glm::dvec3& p0 = m_positions[m_indices[i]];
+				const glm::dvec3& p1 = m_positions[m_indices[i + 1]];
+				const glm::dvec3& p2 = m_positions[m_indices[i + 2]];
+				glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+				double length = glm::length(normal);
+				if (length <= 0.0) continue;
+				normal /= length;
+				double area = length * 0.5;
+				for (int c = 0; c < 3; ++c)
+					AddPlane(m_quadrics[m_indices[i + c]], normal, -glm::dot(normal, p0), area);
+			}
+
+			// Planes through each border edge, perpendicular to its triangle
+			std::vector<uint64_t> edges;
+			GetSortedEdges(edges);
+			for (size_t i = 0; i < m_indices.size(); i += 3)
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					uint32_t a = m_indices[i + c], b = m_indices[i + (c + 1) % 3];
+					if (!IsBorderEdge(edges, EdgeKey(a, b))) continue;
+					const glm::dvec3& p0 = m_positions[m_indices[i]];
+					glm::dvec3 faceNormal = glm::cross(m_positions[m_indices[i + 1]] - p0, m_positions[m_indices[i + 2]] - p0);
+					glm::dvec3 edge = m_positions[b] - m_positions[a];
+					glm::dvec3 normal = glm::cross(edge, faceNormal);
+					double length = glm::length(normal);
+					if (length <= 0.0) continue;
+					normal /= length;
+					double weight = glm::dot(edge, edge) * c_borderWeight;
+					double distance = -glm::dot(normal, m_positions[a]);
+					AddPlane(m_quadrics[a], normal, distance, weight);
+					AddPlane(m_quadrics[b], normal, distance, weight);
+				}
+			}
+		}
+
+		void GetSortedEdges(std::vector<uint64_t>& out_edges) const
+		{
+			out_edges.resize(m_indices.size());
+			for (size_t i = 0; i < m_indices.size(); i += 3)
+			{
+				out_edges[i] = EdgeKey(m_indices[i], m_indices[i + 1]);
+				out_edges[i + 1] = EdgeKey(m_indices[i + 1], m_indices[i + 2]);
+				out_edges[i + 2] = EdgeKey(m_indices[i + 2], m_indices[i]);
+			}
+			std::sort(out_edges.begin(), out_edges.end());
+		}
+
+		static bool IsBorderEdge(const std::vector<uint64_t>& in_sortedEdges, uint64_t in_key)
+		{
+			auto range = std::equal_range(in_sortedEdges.begin(), in_sortedEdges.end(), in_key);
+			return range.second - range.first == 1;
+		}
+
+		// True if moving in_from onto in_to keeps all surrounding triangles facing roughly the same way
+		bool IsCollapseValid(uint32_t in_from, uint32_t in_to) const
+		{
+			for (uint32_t t = m_adjacencyOffsets[in_from]; t < m_adjacencyOffsets[in_from + 1]; ++t)
+			{
+				const uint32_t* tri = &m_indices[m_adjacency[t] * 3];
+				if (tri[0] == in_to || tri[1] == in_to || tri[2] == in_to) continue; // collapses away
+
+				glm::dvec3 before[3], after[3];
+				for (int c = 0; c < 3; ++c)
+				{
+					before[c] = m_positions[tri[c]];
+					after[c] = tri[c] == in_from ? m_positions[in_to] : before[c];
+				}
+				glm::dvec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+				glm::dvec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+				// Also reject large turns, they tend to fold the surface over in later collapses
+				if (glm::dot(normalBefore, normalAfter) <= c_minNormalDot * glm::length(normalBefore) * glm::length(normalAfter)) return false;
+			}
+			return true;
+		}
+
+		void BuildAdjacency()
+		{
+			m_adjacencyOffsets.assign(m_positions.size() + 1, 0);
+			for (uint32_t index : m_indices)
+				m_adjacencyOffsets[index + 1]++;
+			for (size_t v = 0; v < m_positions.size(); ++v)
+				m_adjacencyOffsets[v + 1] += m_adjacencyOffsets[v];
+			m_adjacency.resize(m_indices.size());
+			std::vector<uint32_t> cursor(m_adjacencyOffsets.begin(), m_adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < m_indices.size(); ++i)
+				m_adjacency[cursor[m_indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		// One round of independent collapses, returns false if nothing could be collapsed
+		bool RunPass(size_t in_trianglesToRemove, double in_maxErrorSquared, size_t& out_removed, double& inout_maxCost, bool& out_reachedMaxError)
+		{
+			std::vector<uint64_t> edges;
+			GetSortedEdges(edges);
+			std::vector<uint8_t> border(m_positions.size(), 0);
+			for (size_t i = 0; i < edges.size();)
+			{
+				size_t run = i + 1;
+				while (run < edges.size() && edges[run] == edges[i]) ++run;
+				if (run - i == 1)
+				{
+					border[uint32_t(edges[i] >> 32)] = 1;
+					border[uint32_t(edges[i])] = 1;
+				}
+				i = run;
+			}
+
+			// Cheapest direction of every edge, border vertices may only slide along the border
+			std::vector<Collapse> collapses;
+			for (size_t i = 0; i < edges.size();)
+			{
+				size_t run = i + 1;
+				while (run < edges.size() && edges[run] == edges[i]) ++run;
+				bool borderEdge = run - i == 1;
+				uint32_t ends[2] = { uint32_t(edges[i] >> 32), uint32_t(edges[i]) };
+				Collapse best = { c_invalidIndex, c_invalidIndex, std::numeric_limits<double>::max() };
+				for (int d = 0; d < 2; ++d)
+				{
+					uint32_t from = ends[d], to = ends[1 - d];
+					if (border[from] && !borderEdge) continue;
+					Quadric merged = m_quadrics[from];
+					AddQuadric(merged, m_quadrics[to]);
+					double cost = Evaluate(merged, m_positions[to]);
+					if (cost < best.m_cost) best = { from, to, cost };
+				}
+				if (best.m_from != c_invalidIndex) collapses.push_back(best);
+				i = run;
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& in_a, const Collapse& in_b) { return in_a.m_cost < in_b.m_cost; });
+
+			BuildAdjacency();
+			std::vector<uint8_t> locked(m_positions.size(), 0);
+			std::vector<uint32_t> collapseTo(m_positions.size(), c_invalidIndex);
+			out_removed = 0;
+			size_t collapseCount = 0;
+			for (const Collapse& collapse : collapses)
+			{
+				if (collapse.m_cost > in_maxErrorSquared)
+				{
+					out_reachedMaxError = true;
+					break;
+				}
+				if (locked[collapse.m_from] || locked[collapse.m_to]) continue;
+				if (!IsCollapseValid(collapse.m_from, collapse.m_to)) continue;
+
+				// The one ring of from moves or changes shape, so nothing in it may collapse again this pass
+				for (uint32_t t = m_adjacencyOffsets[collapse.m_from]; t < m_adjacencyOffsets[collapse.m_from + 1]; ++t)
+				{
+					const uint32_t* tri = &m_indices[m_adjacency[t] * 3];
+					if (tri[0] == collapse.m_to || tri[1] == collapse.m_to || tri[2] == collapse.m_to) out_removed++;
+					for (int c = 0; c < 3; ++c) locked[tri[c]] = 1;
+				}
+				locked[collapse.m_to] = 1;
+				collapseTo[collapse.m_from] = collapse.m_to;
+				AddQuadric(m_quadrics[collapse.m_to], m_quadrics[collapse.m_from]);
+				inout_maxCost = std::max(inout_maxCost, collapse.m_cost);
+				collapseCount++;
+				if (out_removed >= in_trianglesToRemove) break;
+			}
+			if (collapseCount == 0) return false;
+
+			// Apply, dropping the triangles that became degenerate
+			size_t write = 0;
+			for (size_t i = 0; i < m_indices.size(); i += 3)
+			{
+				uint32_t tri[3];
+				for (int c = 0; c < 3; ++c)
+					tri[c] = collapseTo[m_indices[i + c]] != c_invalidIndex ? collapseTo[m_indices[i + c]] : m_indices[i + c];
+				if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) continue;
+				for (int c = 0; c < 3; ++c) m_indices[write++] = tri[c];
+			}
+			m_indices.resize(write);
+			return true;
+		}
+
+		std::vector<glm::dvec3> m_positions;
+		std::vector<uint32_t>   m_localToGlobal;
+		std::vector<uint32_t>   m_indices;
+		std::vector<Quadric>    m_quadrics;
+		// Vertex to triangle lookup, rebuilt every pass
+		std::vector<uint32_t>   m_adjacencyOffsets;
+		std::vector<uint32_t>   m_adjacency;
+	};
+}
+
+float MeshSimplifier::Simplify(const MeshData& in_mesh, const uint32_t* in_indices, size_t in_indexCount,
+	size_t in_targetIndexCount, float in_maxError, std::vector<uint32_t>& out_indices)
+{
+	Simplifier simplifier(in_mesh, in_indices, in_indexCount);
+	double maxErrorSquared = double(in_maxError) * double(in_maxError);
+	double errorSquared = simplifier.Run(in_targetIndexCount, maxErrorSquared);
+	simplifier.GetIndices(out_indices);
+	return static_cast<float>(std::sqrt(errorSquared));
+}
+
+uint32_t MeshSimplifier::GenerateLods(MeshData& inout_mesh, const Options& in_options, JobSystem* in_jobSystem/* = nullptr*/)
+{
+	// Start over from the first level, the levels after it are at the end of the index buffer
+	std::vector<MeshData::Submesh> previous;
+	if (!inout_mesh.m_lods.empty())
+	{
+		const MeshData::Lod& first = inout_mesh.m_lods[0];
+		previous.assign(inout_mesh.m_submeshes.begin() + first.m_firstSubmesh,
+			inout_mesh.m_submeshes.begin() + first.m_firstSubmesh + first.m_submeshCount);
+		uint32_t indexEnd = 0;
+		for (const MeshData::Submesh& submesh : previous)
+			indexEnd = std::max(indexEnd, submesh.m_firstIndex + submesh.m_indexCount);
+		inout_mesh.m_indices.resize(indexEnd);
+	}
+	else if (!inout_mesh.m_submeshes.empty())
+	{
+		previous = inout_mesh.m_submeshes;
+	}
+	else
+	{
+		previous.push_back({ 0, static_cast<uint32_t>(inout_mesh.m_indices.size()), 0 });
+	}
+	inout_mesh.m_submeshes = previous;
+	inout_mesh.m_lods.clear();
+	inout_mesh.m_meshlets.clear(); // would point at the old levels
+
+	size_t previousTriangles = 0;
+	for (const MeshData::Submesh& submesh : previous)
+		previousTriangles += submesh.m_indexCount / 3;
+	inout_mesh.m_lods.push_back({ 0, static_cast<uint32_t>(previous.size()), 0, 0, 0.0f });
+
+	float maxError = in_options.m_maxError * glm::length(inout_mesh.m_boundsMax - inout_mesh.m_boundsMin) * 0.5f;
+	float previousError = 0.0f;
+	for (uint32_t level = 1; level < in_options.m_levelCount; ++level)
+	{
+		if (previousTriangles * in_options.m_levelRatio < in_options.m_minTriangles) break;
+
+		std::vector<std::vector<uint32_t>> levelIndices(previous.size());
+		std::vector<float> errors(previous.size(), 0.0f);
+		auto simplifySubmeshes = [&](size_t in_begin, size_t in_end)
+		{
+			std::vector<uint32_t> indices;
+			for (size_t s = in_begin; s < in_end; ++s)
+			{
+				const MeshData::Submesh& submesh = previous[s];
+				indices.resize(submesh.m_indexCount);
+				for (uint32_t i = 0; i < submesh.m_indexCount; ++i)
+					indices[i] = inout_mesh.m_indices[submesh.m_firstIndex + i] + submesh.m_vertexOffset;
+				size_t target = static_cast<size_t>(submesh.m_indexCount / 3 * in_options.m_levelRatio) * 3;
+				errors[s] = Simplify(inout_mesh, indices.data(), indices.size(), target, maxError - previousError, levelIndices[s]);
+			}
+		};
+		if (in_jobSystem)
+			in_jobSystem->ParallelFor(previous.size(), 1, simplifySubmeshes);
+		else
+			simplifySubmeshes(0, previous.size());
+
+		size_t levelTriangles = 0;
+		for (const std::vector<uint32_t>& indices : levelIndices)
+			levelTriangles += indices.size() / 3;
+		// Stop once the error limit keeps a level from getting meaningfully smaller
+		if (levelTriangles > previousTriangles * (1.0f + in_options.m_levelRatio) * 0.5f) break;
+
+		MeshData::Lod lod = { static_cast<uint32_t>(inout_mesh.m_submeshes.size()), static_cast<uint32_t>(previous.size()), 0, 0, 0.0f };
+		std::vector<MeshData::Submesh> submeshes;
+		for (size_t s = 0; s < previous.size(); ++s)
+		{
+			MeshData::Submesh submesh = { static_cast<uint32_t>(inout_mesh.m_indices.size()),
+				static_cast<uint32_t>(levelIndices[s].size()), previous[s].m_vertexOffset };
+			for (uint32_t index : levelIndices[s])
+				inout_mesh.m_indices.push_back(index - submesh.m_vertexOffset);
+			submeshes.push_back(submesh);
+		}
+		// Each level is simplified from the one before, so the errors add up
+		lod.m_error = previousError + *std::max_element(errors.begin(), errors.end());
+		inout_mesh.m_submeshes.insert(inout_mesh.m_submeshes.end(), submeshes.begin(), submeshes.end());
+		inout_mesh.m_lods.push_back(lod);
+
+		previous = submeshes;
+		previousTriangles = levelTriangles;
+		previousError = lod.m_error;
+	}
+
+	uint32_t levelCount = static_cast<uint32_t>(inout_mesh.m_lods.size());
+	if (levelCount == 1)
+		inout_mesh.m_lods.clear();
+	return levelCount;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+struct MeshData;
+class JobSystem;
+
+// =======================================================================================
+//                                      MeshSimplifier
+// =======================================================================================
+
+///---------------------------------------------------------------------------------------
+/// \brief	Quadric error metric simplification and LOD chain generation
+///
+/// Edge collapses are chosen by the quadric error metric (Garland & Heckbert 1997,
+/// "Surface Simplification Using Quadric Error Metrics"). Collapses only move a vertex
+/// onto one of its neighbours, so every level indexes the vertices of the full mesh
+/// and all levels share one vertex buffer.
+///
+/// Vertices at the same position (attribute seams) are welded while simplifying, and
+/// open borders get extra quadrics and may only collapse along the border.
+///
+/// Collapses are done in passes: all edges are costed and sorted, then the cheapest ones
+/// are applied as long as they don't touch the neighbourhood of an earlier collapse in
+/// the same pass.
+///---------------------------------------------------------------------------------------
+
+namespace MeshSimplifier
+{
+	struct Options
+	{
+		Options()
+			: m_levelCount(6)
+			, m_levelRatio(0.5f)
+			, m_minTriangles(64)
+			, m_maxError(0.1f)
+		{}
+
+		uint32_t m_levelCount;   // levels including the full mesh
+		float    m_levelRatio;   // triangle count of each level relative to the one before it
+		uint32_t m_minTriangles; // stop the chain when a level gets smaller than this
+		float    m_maxError;     // largest allowed error relative to the bounds radius
+	};
+
+	// Simplify a triangle list of absolute vertex indices towards in_targetIndexCount indices.
+	// Stops early rather than exceed in_maxError (model units). Returns the error reached.
+	float Simplify(const MeshData& in_mesh, const uint32_t* in_indices, size_t in_indexCount,
+		size_t in_targetIndexCount, float in_maxError, std::vector<uint32_t>& out_indices);
+
+	// Append coarser levels of every submesh after the existing ones and fill inout_mesh.m_lods.
+	// Any previous levels beyond the first are replaced. Returns the number of levels.
+	uint32_t GenerateLods(MeshData& inout_mesh, const Options& in_options, JobSystem* in_jobSystem = nullptr);
+}
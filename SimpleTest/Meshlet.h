@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include "MathTypes.h"
+
+// A cluster of at most MeshletBuilder::c_maxVertices vertices and c_maxTriangles
+// triangles, stored as a contiguous range of the index buffer so it can be drawn with
+// a plain indexed (indirect) draw. Laid out to match the std430 struct of the culling shader.
+
+struct Meshlet
+{
+	// Bounding sphere in model space
+	float    m_center[3];
+	float    m_radius;
+	// Normal cone, all triangles face away from cameras inside the cone behind the meshlet.
+	// A cutoff of 1 disables cone culling.
+	float    m_coneAxis[3];
+	float    m_coneCutoff;
+	// Draw range
+	uint32_t m_firstIndex;
+	uint32_t m_indexCount;
+	int32_t  m_vertexOffset;
+	uint32_t m_padding;
+};
+static_assert(sizeof(Meshlet) == 48, "Meshlet must match the culling shader layout");
+
+// True if every triangle of the meshlet faces away from a camera at in_cameraPos (model space).
+// Assumes closed meshes with counter clockwise front faces.
+inline bool IsMeshletBackfacing(const Meshlet& in_meshlet, const glm::vec3& in_cameraPos)
+{
+	glm::vec3 toCenter = glm::vec3(in_meshlet.m_center[0], in_meshlet.m_center[1], in_meshlet.m_center[2]) - in_cameraPos;
+	glm::vec3 axis(in_meshlet.m_coneAxis[0], in_meshlet.m_coneAxis[1], in_meshlet.m_coneAxis[2]);
+	return glm::dot(toCenter, axis) >= in_meshlet.m_coneCutoff * glm::length(toCenter) + in_meshlet.m_radius;
+}
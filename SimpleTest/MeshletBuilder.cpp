@@ -0,0 +1,173 @@
+#include "MeshletBuilder.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "MeshData.h"
+#include "Meshlet.h"
+#include "JobSystem.h"
+
+namespace
+{
+	// Cones wider than this (half angle past ~84 degrees) can never be culled
+	const float c_minConeDot = 0.1f;
+
+	glm::vec3 GetPosition(const MeshData& in_mesh, uint32_t in_vertex)
+	{
+		const Vertex& v = in_mesh.m_vertices[in_vertex];
+		return glm::vec3(v.m_pos[0], v.m_pos[1], v.m_pos[2]);
+	}
+
+	// Ritter's bounding sphere, within a few percent of the minimal sphere
+	void CalculateBoundingSphere(const std::vector<glm::vec3>& in_points, glm::vec3& out_center, float& out_radius)
+	{
+		glm::vec3 a = in_points[0];
+		glm::vec3 b = a;
+		for (const glm::vec3& p : in_points)
+			if (glm::dot(p - a, p - a) > glm::dot(b - a, b - a)) b = p;
+		glm::vec3 c = b;
+		for (const glm::vec3& p : in_points)
+			if (glm::dot(p - b, p - b) > glm::dot(c - b, c - b)) c = p;
+
+		out_center = (b + c) * 0.5f;
+		out_radius = glm::length(c - b) * 0.5f;
+		for (const glm::vec3& p : in_points)
+		{
+			float distance = glm::length(p - out_center);
+			if (distance > out_radius)
+			{
+				// Grow just enough to touch p, moving the center towards it
+				float newRadius = (out_radius + distance) * 0.5f;
+				out_center += (p - out_center) * ((newRadius - out_radius) / distance);
+				out_radius = newRadius;
+			}
+		}
+	}
+
+	void CalculateBounds(const MeshData& in_mesh, const std::vector<uint32_t>& in_vertices, Meshlet& inout_meshlet)
+	{
+		std::vector<glm::vec3> points(in_vertices.size());
+		for (size_t i = 0; i < in_vertices.size(); ++i)
+			points[i] = GetPosition(in_mesh, in_vertices[i]);
+
+		glm::vec3 center;
+		CalculateBoundingSphere(points, center, inout_meshlet.m_radius);
+
+		// Cone around the average triangle normal, as wide as the least aligned triangle
+		std::vector<glm::vec3> normals;
+		normals.reserve(inout_meshlet.m_indexCount / 3);
+		glm::vec3 normalSum(0.0f);
+		for (uint32_t i = 0; i < inout_meshlet.m_indexCount; i += 3)
+		{
+			const uint32_t* tri = &in_mesh.m_indices[inout_meshlet.m_firstIndex + i];
+			glm::vec3 p0 = GetPosition(in_mesh, tri[0] + inout_meshlet.m_vertexOffset);
+			glm::vec3 p1 = GetPosition(in_mesh, tri[1] + inout_meshlet.m_vertexOffset);
+			glm::vec3 p2 = GetPosition(in_mesh, tri[2] + inout_meshlet.m_vertexOffset);
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float length = glm::length(normal);
+			if (length <= 0.0f) continue; // degenerate triangles face nowhere
+			normals.push_back(normal / length);
+			normalSum += normals.back();
+		}
+
+		glm::vec3 axis(0.0f);
+		float cutoff = 1.0f;
+		float axisLength = glm::length(normalSum);
+		if (!normals.empty() && axisLength > 0.0f)
+		{
+			axis = normalSum / axisLength;
+			float minDot = 1.0f;
+			for (const glm::vec3& normal : normals)
+				minDot = std::min(minDot, glm::dot(axis, normal));
+			if (minDot > c_minConeDot)
+				cutoff = std::sqrt(1.0f - minDot * minDot);
+		}
+
+		for (int i = 0; i < 3; ++i)
+		{
+			inout_meshlet.m_center[i] = center[i];
+			inout_meshlet.m_coneAxis[i] = axis[i];
+		}
+		inout_meshlet.m_coneCutoff = cutoff;
+	}
+
+	void BuildSubmesh(const MeshData& in_mesh, const MeshData::Submesh& in_submesh, std::vector<Meshlet>& out_meshlets)
+	{
+		std::vector<uint32_t> vertices; // unique vertices of the current meshlet, absolute
+		vertices.reserve(MeshletBuilder::c_maxVertices);
+
+		Meshlet meshlet = {};
+		meshlet.m_firstIndex = in_submesh.m_firstIndex;
+		meshlet.m_vertexOffset = in_submesh.m_vertexOffset;
+
+		uint32_t end = in_submesh.m_firstIndex + in_submesh.m_indexCount;
+		for (uint32_t i = in_submesh.m_firstIndex; i + 3 <= end; i += 3)
+		{
+			uint32_t tri[3];
+			uint32_t newVertices = 0;
+			for (int c = 0; c < 3; ++c)
+			{
+				tri[c] = in_mesh.m_indices[i + c] + in_submesh.m_vertexOffset;
+				bool known = std::find(vertices.begin(), vertices.end(), tri[c]) != vertices.end() ||
+					std::find(tri, tri + c, tri[c]) != tri + c;
+				if (!known) newVertices++;
+			}
+
+			if (vertices.size() + newVertices > MeshletBuilder::c_maxVertices ||
+				meshlet.m_indexCount / 3 + 1 > MeshletBuilder::c_maxTriangles)
+			{
+				CalculateBounds(in_mesh, vertices, meshlet);
+				out_meshlets.push_back(meshlet);
+				meshlet.m_firstIndex = i;
+				meshlet.m_indexCount = 0;
+				vertices.clear();
+			}
+
+			for (int c = 0; c < 3; ++c)
+			{
+				if (std::find(vertices.begin(), vertices.end(), tri[c]) == vertices.end())
+					vertices.push_back(tri[c]);
+			}
+			meshlet.m_indexCount += 3;
+		}
+
+		if (meshlet.m_indexCount > 0)
+		{
+			CalculateBounds(in_mesh, vertices, meshlet);
+			out_meshlets.push_back(meshlet);
+		}
+	}
+}
+
+void MeshletBuilder::Build(MeshData& inout_mesh, JobSystem* in_jobSystem/* = nullptr*/)
+{
+	std::vector<MeshData::Submesh> submeshes = inout_mesh.m_submeshes;
+	if (submeshes.empty())
+		submeshes.push_back({ 0, static_cast<uint32_t>(inout_mesh.m_indices.size()), 0 });
+
+	std::vector<std::vector<Meshlet>> submeshMeshlets(submeshes.size());
+	auto buildSubmeshes = [&](size_t in_begin, size_t in_end)
+	{
+		for (size_t i = in_begin; i < in_end; ++i)
+			BuildSubmesh(inout_mesh, submeshes[i], submeshMeshlets[i]);
+	};
+	if (in_jobSystem)
+		in_jobSystem->ParallelFor(submeshes.size(), 1, buildSubmeshes);
+	else
+		buildSubmeshes(0, submeshes.size());
+
+	inout_mesh.m_meshlets.clear();
+	std::vector<uint32_t> firstMeshlet;
+	for (const std::vector<Meshlet>& meshlets : submeshMeshlets)
+	{
+		firstMeshlet.push_back(static_cast<uint32_t>(inout_mesh.m_meshlets.size()));
+		inout_mesh.m_meshlets.insert(inout_mesh.m_meshlets.end(), meshlets.begin(), meshlets.end());
+	}
+	firstMeshlet.push_back(static_cast<uint32_t>(inout_mesh.m_meshlets.size()));
+
+	// Submeshes of a level are consecutive, and so are their meshlets
+	for (MeshData::Lod& lod : inout_mesh.m_lods)
+	{
+		lod.m_firstMeshlet = firstMeshlet[lod.m_firstSubmesh];
+		lod.m_meshletCount = firstMeshlet[lod.m_firstSubmesh + lod.m_submeshCount] - lod.m_firstMeshlet;
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+struct MeshData;
+class JobSystem;
+
+// =======================================================================================
+//                                      MeshletBuilder
+// =======================================================================================
+
+///---------------------------------------------------------------------------------------
+/// \brief	Splits submeshes into meshlets for per cluster culling
+///
+/// Triangles are taken in index buffer order and a new meshlet is started whenever the
+/// next triangle would exceed c_maxVertices unique vertices or c_maxTriangles triangles.
+/// Run after the vertex cache optimization, the cache friendly order keeps meshlets
+/// spatially compact, and each meshlet stays a contiguous range of the index buffer.
+///
+/// Every meshlet gets a bounding sphere for frustum culling and a normal cone for
+/// backface culling of the whole cluster (see Meshlet.h).
+///---------------------------------------------------------------------------------------
+
+namespace MeshletBuilder
+{
+	const uint32_t c_maxVertices = 64;
+	const uint32_t c_maxTriangles = 124;
+
+	// Replace inout_mesh.m_meshlets with meshlets covering every submesh, in submesh order,
+	// and point each level of detail at the meshlets of its submeshes
+	void Build(MeshData& inout_mesh, JobSystem* in_jobSystem = nullptr);
+}
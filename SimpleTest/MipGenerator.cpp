@@ -0,0 +1,298 @@
+#include "MipGenerator.h"
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include "JobSystem.h"
+#include "TextureFile.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#	define MIP_GENERATOR_SSE2
+#	include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#	define MIP_GENERATOR_NEON
+#	include <arm_neon.h>
+#endif
+
+namespace
+{
+	// Rows per band are picked so a band writes at least this much
+	const size_t c_bandBytes = 16 * 1024;
+	const uint32_t c_linearToSrgbSize = 4096;
+
+	struct SrgbTables
+	{
+		SrgbTables()
+		{
+			for (int i = 0; i < 256; ++i)
+			{
+				float c = i / 255.0f;
+				m_toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (uint32_t i = 0; i < c_linearToSrgbSize; ++i)
+			{
+				float l = i / float(c_linearToSrgbSize - 1);
+				float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+				m_toSrgb[i] = static_cast<uint8_t>(std::min(255.0f, c * 255.0f + 0.5f));
+			}
+		}
+
+		uint8_t ToSrgb(float in_linear) const
+		{
+			return m_toSrgb[static_cast<uint32_t>(in_linear * (c_linearToSrgbSize - 1) + 0.5f)];
+		}
+
+		float   m_toLinear[256];
+		uint8_t m_toSrgb[c_linearToSrgbSize];
+	};
+
+	const SrgbTables& GetSrgbTables()
+	{
+		static const SrgbTables tables;
+		return tables;
+	}
+
+	bool IsSrgb(VkFormat in_format)
+	{
+		return in_format == VK_FORMAT_R8_SRGB || in_format == VK_FORMAT_R8G8_SRGB ||
+			in_format == VK_FORMAT_R8G8B8A8_SRGB || in_format == VK_FORMAT_B8G8R8A8_SRGB;
+	}
+
+	// Source rows and columns of a destination texel, clamped for odd edges
+	struct Footprint
+	{
+		Footprint(uint32_t in_dst, uint32_t in_srcExtent)
+			: m_first(std::min(in_dst * 2, in_srcExtent - 1))
+			, m_second(std::min(in_dst * 2 + 1, in_srcExtent - 1))
+		{}
+		uint32_t m_first;
+		uint32_t m_second;
+	};
+
+	// Any 8 bit unorm layout, channel by channel
+	void DownsampleRowsUnorm8(const uint8_t* in_src, uint32_t in_width, uint32_t in_height, uint32_t in_texelSize,
+		uint8_t* out_dst, uint32_t in_firstRow, uint32_t in_endRow)
+	{
+		uint32_t dstWidth = std::max(in_width / 2, 1u);
+		size_t srcPitch = size_t(in_width) * in_texelSize;
+		size_t dstPitch = size_t(dstWidth) * in_texelSize;
+		for (uint32_t y = in_firstRow; y < in_endRow; ++y)
+		{
+			Footprint rows(y, in_height);
+			const uint8_t* row0 = in_src + rows.m_first * srcPitch;
+			const uint8_t* row1 = in_src + rows.m_second * srcPitch;
+			uint8_t* dst = out_dst + y * dstPitch;
+			uint32_t x = 0;
+#if defined(MIP_GENERATOR_SSE2)
+			// Four destination texels from eight source texels per row, needs every pair complete
+			if (in_texelSize == 4 && (in_width & 1) == 0)
+			{
+				const __m128i zero = _mm_setzero_si128();
+				const __m128i two = _mm_set1_epi16(2);
+				for (; x + 4 <= dstWidth; x += 4)
+				{
+					const uint8_t* s0 = row0 + x * 8;
+					const uint8_t* s1 = row1 + x * 8;
+					__m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s0));
+					__m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s0 + 16));
+					__m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s1));
+					__m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s1 + 16));
+					// Vertical sums, two texels per register
+					__m128i v01 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+					__m128i v23 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+					__m128i v45 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+					__m128i v67 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+					// Even texels plus odd texels
+					__m128i s0123 = _mm_add_epi16(_mm_unpacklo_epi64(v01, v23), _mm_unpackhi_epi64(v01, v23));
+					__m128i s4567 = _mm_add_epi16(_mm_unpacklo_epi64(v45, v67), _mm_unpackhi_epi64(v45, v67));
+					s0123 = _mm_srli_epi16(_mm_add_epi16(s0123, two), 2);
+					s4567 = _mm_srli_epi16(_mm_add_epi16(s4567, two), 2);
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_packus_epi16(s0123, s4567));
+				}
+			}
+#elif defined(MIP_GENERATOR_NEON)
+			if (in_texelSize == 4 && (in_width & 1) == 0)
+			{
+				for (; x + 4 <= dstWidth; x += 4)
+				{
+					// De-interleave the source texels into even and odd ones
+					uint32x4x2_t a = vld2q_u32(reinterpret_cast<const uint32_t*>(row0 + x * 8));
+					uint32x4x2_t b = vld2q_u32(reinterpret_cast<const uint32_t*>(row1 + x * 8));
+					uint8x16_t a0 = vreinterpretq_u8_u32(a.val[0]), a1 = vreinterpretq_u8_u32(a.val[1]);
+					uint8x16_t b0 = vreinterpretq_u8_u32(b.val[0]), b1 = vreinterpretq_u8_u32(b.val[1]);
+					uint16x8_t lo = vaddq_u16(vaddl_u8(vget_low_u8(a0), vget_low_u8(a1)), vaddl_u8(vget_low_u8(b0), vget_low_u8(b1)));
+					uint16x8_t hi = vaddq_u16(vaddl_u8(vget_high_u8(a0), vget_high_u8(a1)), vaddl_u8(vget_high_u8(b0), vget_high_u8(b1)));
+					vst1q_u8(dst + x * 4, vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2)));
+				}
+			}
+#endif
+			for (; x < dstWidth; ++x)
+			{
+				Footprint columns(x, in_width);
+				const uint8_t* t00 = row0 + columns.m_first * in_texelSize;
+				const uint8_t* t01 = row0 + columns.m_second * in_texelSize;
+				const uint8_t* t10 = row1 + columns.m_first * in_texelSize;
+				const uint8_t* t11 = row1 + columns.m_second * in_texelSize;
+				for (uint32_t c = 0; c < in_texelSize; ++c)
+					dst[x * in_texelSize + c] = static_cast<uint8_t>((t00[c] + t01[c] + t10[c] + t11[c] + 2) >> 2);
+			}
+		}
+	}
+
+	// Color channels through linear space, the fourth channel (alpha) as it is
+	void DownsampleRowsSrgb8(const uint8_t* in_src, uint32_t in_width, uint32_t in_height, uint32_t in_texelSize,
+		uint8_t* out_dst, uint32_t in_firstRow, uint32_t in_endRow)
+	{
+		const SrgbTables& tables = GetSrgbTables();
+		uint32_t dstWidth = std::max(in_width / 2, 1u);
+		size_t srcPitch = size_t(in_width) * in_texelSize;
+		size_t dstPitch = size_t(dstWidth) * in_texelSize;
+		uint32_t colorChannels = std::min(in_texelSize, 3u);
+		for (uint32_t y = in_firstRow; y < in_endRow; ++y)
+		{
+			Footprint rows(y, in_height);
+			const uint8_t* row0 = in_src + rows.m_first * srcPitch;
+			const uint8_t* row1 = in_src + rows.m_second * srcPitch;
+			uint8_t* dst = out_dst + y * dstPitch;
+			for (uint32_t x = 0; x < dstWidth; ++x)
+			{
+				Footprint columns(x, in_width);
+				const uint8_t* t00 = row0 + columns.m_first * in_texelSize;
+				const uint8_t* t01 = row0 + columns.m_second * in_texelSize;
+				const uint8_t* t10 = row1 + columns.m_first * in_texelSize;
+				const uint8_t* t11 = row1 + columns.m_second * in_texelSize;
+				for (uint32_t c = 0; c < colorChannels; ++c)
+				{
+					float linear = (tables.m_toLinear[t00[c]] + tables.m_toLinear[t01[c]] +
+						tables.m_toLinear[t10[c]] + tables.m_toLinear[t11[c]]) * 0.25f;
+					dst[x * in_texelSize + c] = tables.ToSrgb(linear);
+				}
+				for (uint32_t c = colorChannels; c < in_texelSize; ++c)
+					dst[x * in_texelSize + c] = static_cast<uint8_t>((t00[c] + t01[c] + t10[c] + t11[c] + 2) >> 2);
+			}
+		}
+	}
+
+	void DownsampleRowsFloat4(const uint8_t* in_src, uint32_t in_width, uint32_t in_height,
+		uint8_t* out_dst, uint32_t in_firstRow, uint32_t in_endRow)
+	{
+		uint32_t dstWidth = std::max(in_width / 2, 1u);
+		const float* src = reinterpret_cast<const float*>(in_src);
+		float* dstLevel = reinterpret_cast<float*>(out_dst);
+		for (uint32_t y = in_firstRow; y < in_endRow; ++y)
+		{
+			Footprint rows(y, in_height);
+			const float* row0 = src + size_t(rows.m_first) * in_width * 4;
+			const float* row1 = src + size_t(rows.m_second) * in_width * 4;
+			float* dst = dstLevel + size_t(y) * dstWidth * 4;
+			for (uint32_t x = 0; x < dstWidth; ++x)
+			{
+				Footprint columns(x, in_width);
+#if defined(MIP_GENERATOR_SSE2)
+				__m128 sum = _mm_add_ps(
+					_mm_add_ps(_mm_loadu_ps(row0 + columns.m_first * 4), _mm_loadu_ps(row0 + columns.m_second * 4)),
+					_mm_add_ps(_mm_loadu_ps(row1 + columns.m_first * 4), _mm_loadu_ps(row1 + columns.m_second * 4)));
+				_mm_storeu_ps(dst + x * 4, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#elif defined(MIP_GENERATOR_NEON)
+				float32x4_t sum = vaddq_f32(
+					vaddq_f32(vld1q_f32(row0 + columns.m_first * 4), vld1q_f32(row0 + columns.m_second * 4)),
+					vaddq_f32(vld1q_f32(row1 + columns.m_first * 4), vld1q_f32(row1 + columns.m_second * 4)));
+				vst1q_f32(dst + x * 4, vmulq_n_f32(sum, 0.25f));
+#else
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					dst[x * 4 + c] = (row0[columns.m_first * 4 + c] + row0[columns.m_second * 4 + c] +
+						row1[columns.m_first * 4 + c] + row1[columns.m_second * 4 + c]) * 0.25f;
+				}
+#endif
+			}
+		}
+	}
+}
+
+uint32_t MipGenerator::GetMipCount(uint32_t in_width, uint32_t in_height)
+{
+	uint32_t count = 1;
+	for (uint32_t extent = std::max(in_width, in_height); extent > 1; extent >>= 1)
+		++count;
+	return count;
+}
+
+bool MipGenerator::IsSupported(VkFormat in_format)
+{
+	switch (in_format)
+	{
+	case VK_FORMAT_R8_UNORM:
+	case VK_FORMAT_R8_SRGB:
+	case VK_FORMAT_R8G8_UNORM:
+	case VK_FORMAT_R8G8_SRGB:
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void MipGenerator::Downsample(VkFormat in_format, const uint8_t* in_src, uint32_t in_width, uint32_t in_height,
+	uint8_t* out_dst, JobSystem* in_jobSystem/* = nullptr*/)
+{
+	uint32_t texelSize, blockExtent;
+	if (!IsSupported(in_format) || !TextureFile::GetBlockInfo(in_format, texelSize, blockExtent))
+		return;
+
+	std::function<void(size_t, size_t)> downsampleRows;
+	if (in_format == VK_FORMAT_R32G32B32A32_SFLOAT)
+	{
+		downsampleRows = [=](size_t in_begin, size_t in_end)
+		{
+			DownsampleRowsFloat4(in_src, in_width, in_height, out_dst, static_cast<uint32_t>(in_begin), static_cast<uint32_t>(in_end));
+		};
+	}
+	else if (IsSrgb(in_format))
+	{
+		downsampleRows = [=](size_t in_begin, size_t in_end)
+		{
+			DownsampleRowsSrgb8(in_src, in_width, in_height, texelSize, out_dst, static_cast<uint32_t>(in_begin), static_cast<uint32_t>(in_end));
+		};
+	}
+	else
+	{
+		downsampleRows = [=](size_t in_begin, size_t in_end)
+		{
+			DownsampleRowsUnorm8(in_src, in_width, in_height, texelSize, out_dst, static_cast<uint32_t>(in_begin), static_cast<uint32_t>(in_end));
+		};
+	}
+
+	uint32_t dstHeight = std::max(in_height / 2, 1u);
+	size_t dstPitch = size_t(std::max(in_width / 2, 1u)) * texelSize;
+	size_t rowsPerBand = std::max<size_t>(1, c_bandBytes / dstPitch);
+	if (in_jobSystem && dstHeight > rowsPerBand)
+		in_jobSystem->ParallelFor(dstHeight, rowsPerBand, downsampleRows);
+	else
+		downsampleRows(0, dstHeight);
+}
+
+void MipGenerator::GenerateChain(VkFormat in_format, const uint8_t* in_level0, uint32_t in_width, uint32_t in_height,
+	std::vector<uint8_t>& out_levels, JobSystem* in_jobSystem/* = nullptr*/)
+{
+	out_levels.clear();
+	uint32_t mipCount = GetMipCount(in_width, in_height);
+	size_t totalSize = 0;
+	for (uint32_t mip = 1; mip < mipCount; ++mip)
+		totalSize += static_cast<size_t>(TextureFile::GetImageSize(in_format, std::max(in_width >> mip, 1u), std::max(in_height >> mip, 1u)));
+	out_levels.resize(totalSize);
+
+	const uint8_t* src = in_level0;
+	uint8_t* dst = out_levels.data();
+	for (uint32_t mip = 1; mip < mipCount; ++mip)
+	{
+		uint32_t width = std::max(in_width >> (mip - 1), 1u);
+		uint32_t height = std::max(in_height >> (mip - 1), 1u);
+		Downsample(in_format, src, width, height, dst, in_jobSystem);
+		src = dst;
+		dst += static_cast<size_t>(TextureFile::GetImageSize(in_format, std::max(width / 2, 1u), std::max(height / 2, 1u)));
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// =======================================================================================
+//                                      MipGenerator
+// =======================================================================================
+
+///---------------------------------------------------------------------------------------
+/// \brief	CPU mip chain generation
+///
+/// The fallback for textures without mips when the device can't blit (and linearly
+/// filter) their format, see VulkanTextureFactory. Each level is a 2x2 box filter of the
+/// one above, odd edges reuse the last row or column.
+///
+/// 8 bit formats are averaged with 16 bit SIMD lanes (SSE2 or NEON) four texels at a
+/// time, rounding to nearest. sRGB color channels are averaged in linear space through
+/// lookup tables, alpha stays linear. Levels depend on the one above, so with jobs the
+/// rows of each level are split in bands over the threads.
+///---------------------------------------------------------------------------------------
+
+namespace MipGenerator
+{
+	// Full chain down to 1x1
+	uint32_t GetMipCount(uint32_t in_width, uint32_t in_height);
+
+	// R8, R8G8, R8G8B8A8 and B8G8R8A8 (UNORM and SRGB) and R32G32B32A32_SFLOAT
+	bool IsSupported(VkFormat in_format);
+
+	// One level down: in_src is in_width * in_height texels, out_dst max(in_width / 2, 1) * max(in_height / 2, 1)
+	void Downsample(VkFormat in_format, const uint8_t* in_src, uint32_t in_width, uint32_t in_height,
+		uint8_t* out_dst, JobSystem* in_jobSystem = nullptr);
+
+	// Levels 1 and down from in_level0, back to back and tightly packed in out_levels
+	void GenerateChain(VkFormat in_format, const uint8_t* in_level0, uint32_t in_width, uint32_t in_height,
+		std::vector<uint8_t>& out_levels, JobSystem* in_jobSystem = nullptr);
+}
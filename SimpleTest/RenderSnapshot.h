@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "MathTypes.h"
+#include "VulkanMeshletCuller.h"
+#include "VulkanTextureStreamer.h"
+
+// Everything the render thread needs from the simulation to draw one frame (see VulkanGraphics::PrepareFrame).
+// Filled on the simulation thread and handed over with a SnapshotExchange, so it holds copies only.
+
+struct RenderSnapshot
+{
+	RenderSnapshot()
+		: m_simulationFrameIdx(0)
+		, m_lod(0)
+	{}
+
+	uint64_t                          m_simulationFrameIdx;
+	// Model-view-projection and camera position in the model space of the mesh bounds
+	glm::mat4                         m_cullMatrix;
+	glm::vec3                         m_cullCameraPos;
+	uint32_t                          m_lod;
+	// Meshlets to draw, if the mesh has any
+	VulkanMeshletCuller::CullResult   m_meshletCull;
+	// Model-view-projection of the visible nodes of the transform hierarchy, including the mesh
+	// dequantization. The instance buffer contents and the number of instances drawn,
+	// empty without an instance buffer.
+	std::vector<glm::mat4>            m_instanceMatrices;
+	// Screen space demand of the streamed textures
+	std::vector<VulkanTextureStreamer::Request> m_textureRequests;
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+/*!
+* \class SnapshotExchange
+*
+* \brief
+*
+* Lock free hand-over of per frame snapshots from one producer thread to one consumer thread.
+*
+* There are two slots, so the producer fills the snapshot of frame N+1 while the consumer
+* still reads frame N. Each side owns the slot it got until it ends it, and the counters
+* published with release/acquire order make the slot contents visible to the other side.
+*
+* The Begin calls return nullptr instead of blocking when no slot is ready, the caller
+* decides whether to do something else or stop. The Wait calls sleep until a slot is ready
+* or a timeout passes, the End calls wake them through a condition variable. Only a Wait
+* that finds no slot takes the mutex, and an End only takes it when such a Wait is asleep,
+* so while both sides keep up with each other no lock is taken.
+*/
+
+template<typename T>
+class SnapshotExchange
+{
+public:
+	SnapshotExchange()
+		: m_written(0)
+		, m_read(0)
+		, m_waiting(0)
+	{}
+
+	// Producer: the slot to fill, or nullptr while the consumer still holds both
+	T* BeginWrite()
+	{
+		uint64_t written = m_written.load(std::memory_order_relaxed);
+		if (written - m_read.load(std::memory_order_acquire) >= c_slotCount)
+			return nullptr;
+		return &m_slots[written % c_slotCount];
+	}
+
+	// Producer: BeginWrite, waiting at most in_timeout for a slot
+	T* WaitWrite(std::chrono::milliseconds in_timeout)
+	{
+		T* slot = BeginWrite();
+		if (!slot)
+			Wait(in_timeout, [&]() { return (slot = BeginWrite()) != nullptr; });
+		return slot;
+	}
+
+	// Producer: publish the slot from BeginWrite
+	void EndWrite()
+	{
+		m_written.store(m_written.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		Notify();
+	}
+
+	// Consumer: the oldest published snapshot, or nullptr if there is none
+	const T* BeginRead()
+	{
+		uint64_t read = m_read.load(std::memory_order_relaxed);
+		if (read == m_written.load(std::memory_order_acquire))
+			return nullptr;
+		return &m_slots[read % c_slotCount];
+	}
+
+	// Consumer: BeginRead, waiting at most in_timeout for a snapshot
+	const T* WaitRead(std::chrono::milliseconds in_timeout)
+	{
+		const T* slot = BeginRead();
+		if (!slot)
+			Wait(in_timeout, [&]() { return (slot = BeginRead()) != nullptr; });
+		return slot;
+	}
+
+	// Consumer: give the slot from BeginRead back to the producer
+	void EndRead()
+	{
+		m_read.store(m_read.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		Notify();
+	}
+
+private:
+	static const uint64_t c_slotCount = 2;
+
+	template<typename Pred>
+	void Wait(std::chrono::milliseconds in_timeout, Pred in_ready)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_waiting.fetch_add(1, std::memory_order_relaxed);
+		// Pairs with the fence in Notify: either it sees the waiter, or the predicate sees its counter
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		m_changed.wait_for(lock, in_timeout, in_ready);
+		m_waiting.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	void Notify()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_waiting.load(std::memory_order_relaxed) == 0)
+			return;
+		// A waiter checks under the lock, so taking it after the counter changed means it either saw the change or is asleep
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+		}
+		m_changed.notify_all();
+	}
+
+	SnapshotExchange(const SnapshotExchange&) = delete;
+	SnapshotExchange& operator=(const SnapshotExchange&) = delete;
+
+	T                     m_slots[c_slotCount];
+	// Snapshots published and consumed, each only written by its own side
+	std::atomic<uint64_t> m_written;
+	char                  m_padding[64];
+	std::atomic<uint64_t> m_read;
+	// Only for the Wait calls, m_waiting counts those asleep or about to be
+	std::atomic<int>        m_waiting;
+	std::mutex              m_mutex;
+	std::condition_variable m_changed;
+};
@@ -0,0 +1,372 @@
+#include "TextureFile.h"
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+	// ---- KTX2 ----
+
+	const uint8_t c_ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	struct Ktx2Header
+	{
+		uint8_t  m_identifier[12];
+		uint32_t m_vkFormat;
+		uint32_t m_typeSize;
+		uint32_t m_pixelWidth;
+		uint32_t m_pixelHeight;
+		uint32_t m_pixelDepth;
+		uint32_t m_layerCount;
+		uint32_t m_faceCount;
+		uint32_t m_levelCount;
+		uint32_t m_supercompressionScheme;
+		uint32_t m_dfdByteOffset;
+		uint32_t m_dfdByteLength;
+		uint32_t m_kvdByteOffset;
+		uint32_t m_kvdByteLength;
+		uint64_t m_sgdByteOffset;
+		uint64_t m_sgdByteLength;
+	};
+	static_assert(sizeof(Ktx2Header) == 80, "KTX2 header layout");
+
+	struct Ktx2Level
+	{
+		uint64_t m_byteOffset;
+		uint64_t m_byteLength;
+		uint64_t m_uncompressedByteLength;
+	};
+
+	// ---- DDS ----
+
+	const uint32_t c_ddsMagic = 0x20534444; // "DDS "
+
+	struct DdsPixelFormat
+	{
+		uint32_t m_size;
+		uint32_t m_flags;
+		uint32_t m_fourCC;
+		uint32_t m_rgbBitCount;
+		uint32_t m_rBitMask;
+		uint32_t m_gBitMask;
+		uint32_t m_bBitMask;
+		uint32_t m_aBitMask;
+	};
+
+	struct DdsHeader
+	{
+		uint32_t       m_size;
+		uint32_t       m_flags;
+		uint32_t       m_height;
+		uint32_t       m_width;
+		uint32_t       m_pitchOrLinearSize;
+		uint32_t       m_depth;
+		uint32_t       m_mipMapCount;
+		uint32_t       m_reserved1[11];
+		DdsPixelFormat m_pixelFormat;
+		uint32_t       m_caps;
+		uint32_t       m_caps2;
+		uint32_t       m_caps3;
+		uint32_t       m_caps4;
+		uint32_t       m_reserved2;
+	};
+	static_assert(sizeof(DdsHeader) == 124, "DDS header layout");
+
+	struct DdsHeaderDx10
+	{
+		uint32_t m_dxgiFormat;
+		uint32_t m_resourceDimension;
+		uint32_t m_miscFlag;
+		uint32_t m_arraySize;
+		uint32_t m_miscFlags2;
+	};
+
+	const uint32_t c_ddsFlagMipMapCount = 0x20000;
+	const uint32_t c_ddsPixelFormatFourCC = 0x4;
+	const uint32_t c_ddsPixelFormatRgb = 0x40;
+	const uint32_t c_ddsCaps2Cubemap = 0x200;
+	const uint32_t c_ddsCaps2Volume = 0x200000;
+	const uint32_t c_dx10MiscTextureCube = 0x4;
+	const uint32_t c_dx10DimensionTexture2D = 3;
+
+	uint32_t FourCC(char a, char b, char c, char d)
+	{
+		return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) | (uint32_t(uint8_t(c)) << 16) | (uint32_t(uint8_t(d)) << 24);
+	}
+
+	VkFormat FormatFromDxgi(uint32_t in_dxgiFormat)
+	{
+		switch (in_dxgiFormat)
+		{
+		case 2:  return VK_FORMAT_R32G32B32A32_SFLOAT;
+		case 10: return VK_FORMAT_R16G16B16A16_SFLOAT;
+		case 28: return VK_FORMAT_R8G8B8A8_UNORM;
+		case 29: return VK_FORMAT_R8G8B8A8_SRGB;
+		case 49: return VK_FORMAT_R8G8_UNORM;
+		case 61: return VK_FORMAT_R8_UNORM;
+		case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+		case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+		case 74: return VK_FORMAT_BC2_UNORM_BLOCK;
+		case 75: return VK_FORMAT_BC2_SRGB_BLOCK;
+		case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+		case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+		case 80: return VK_FORMAT_BC4_UNORM_BLOCK;
+		case 81: return VK_FORMAT_BC4_SNORM_BLOCK;
+		case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+		case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+		case 87: return VK_FORMAT_B8G8R8A8_UNORM;
+		case 91: return VK_FORMAT_B8G8R8A8_SRGB;
+		case 95: return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+		case 96: return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+		case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+		case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+		default: return VK_FORMAT_UNDEFINED;
+		}
+	}
+
+	VkFormat FormatFromLegacyDds(const DdsPixelFormat& in_pixelFormat)
+	{
+		if (in_pixelFormat.m_flags & c_ddsPixelFormatFourCC)
+		{
+			uint32_t fourCC = in_pixelFormat.m_fourCC;
+			if (fourCC == FourCC('D', 'X', 'T', '1')) return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+			if (fourCC == FourCC('D', 'X', 'T', '2') || fourCC == FourCC('D', 'X', 'T', '3')) return VK_FORMAT_BC2_UNORM_BLOCK;
+			if (fourCC == FourCC('D', 'X', 'T', '4') || fourCC == FourCC('D', 'X', 'T', '5')) return VK_FORMAT_BC3_UNORM_BLOCK;
+			if (fourCC == FourCC('A', 'T', 'I', '1') || fourCC == FourCC('B', 'C', '4', 'U')) return VK_FORMAT_BC4_UNORM_BLOCK;
+			if (fourCC == FourCC('B', 'C', '4', 'S')) return VK_FORMAT_BC4_SNORM_BLOCK;
+			if (fourCC == FourCC('A', 'T', 'I', '2') || fourCC == FourCC('B', 'C', '5', 'U')) return VK_FORMAT_BC5_UNORM_BLOCK;
+			if (fourCC == FourCC('B', 'C', '5', 'S')) return VK_FORMAT_BC5_SNORM_BLOCK;
+			// D3DFMT values stored as the four character code
+			if (fourCC == 113) return VK_FORMAT_R16G16B16A16_SFLOAT;
+			if (fourCC == 116) return VK_FORMAT_R32G32B32A32_SFLOAT;
+			return VK_FORMAT_UNDEFINED;
+		}
+		if ((in_pixelFormat.m_flags & c_ddsPixelFormatRgb) && in_pixelFormat.m_rgbBitCount == 32)
+		{
+			if (in_pixelFormat.m_rBitMask == 0x000000FF && in_pixelFormat.m_bBitMask == 0x00FF0000) return VK_FORMAT_R8G8B8A8_UNORM;
+			if (in_pixelFormat.m_rBitMask == 0x00FF0000 && in_pixelFormat.m_bBitMask == 0x000000FF) return VK_FORMAT_B8G8R8A8_UNORM;
+		}
+		return VK_FORMAT_UNDEFINED;
+	}
+
+	uint32_t MipExtent(uint32_t in_extent, uint32_t in_mip)
+	{
+		return std::max(in_extent >> in_mip, 1u);
+	}
+
+	bool ParseKtx2(const uint8_t* in_data, size_t in_size, TextureFile::Description& out_description, std::ostringstream& err)
+	{
+		if (in_size < sizeof(Ktx2Header))
+		{
+			err << "File too small for a KTX2 header. ";
+			return false;
+		}
+		const Ktx2Header& header = *reinterpret_cast<const Ktx2Header*>(in_data);
+		if (header.m_supercompressionScheme != 0)
+			err << "Supercompressed KTX2 (scheme " << header.m_supercompressionScheme << ") is not supported. ";
+		uint32_t blockBytes, blockExtent;
+		if (header.m_vkFormat == VK_FORMAT_UNDEFINED)
+			err << "KTX2 without a Vulkan format (Basis Universal) is not supported. ";
+		else if (!TextureFile::GetBlockInfo(static_cast<VkFormat>(header.m_vkFormat), blockBytes, blockExtent))
+			err << "Unsupported format " << header.m_vkFormat << ". ";
+		if (header.m_pixelDepth > 1)
+			err << "3D textures are not supported. ";
+		if (header.m_pixelWidth == 0 || header.m_pixelHeight == 0)
+			err << "1D textures are not supported. ";
+		if (header.m_faceCount != 1 && header.m_faceCount != 6)
+			err << "Bad face count " << header.m_faceCount << ". ";
+		if (!err.str().empty())
+			return false;
+
+		// Level count 0 asks the loader to generate the mips, the file then has only the top one
+		uint32_t levelCount = std::max(header.m_levelCount, 1u);
+		uint32_t layerCount = std::max(header.m_layerCount, 1u);
+		if (sizeof(Ktx2Header) + uint64_t(levelCount) * sizeof(Ktx2Level) > in_size)
+		{
+			err << "Level index out of bounds. ";
+			return false;
+		}
+
+		out_description.m_format = static_cast<VkFormat>(header.m_vkFormat);
+		out_description.m_width = header.m_pixelWidth;
+		out_description.m_height = header.m_pixelHeight;
+		out_description.m_mipCount = levelCount;
+		out_description.m_layerCount = layerCount * header.m_faceCount;
+		out_description.m_cube = header.m_faceCount == 6;
+
+		// Each level holds every layer, and within them every face, back to back
+		const Ktx2Level* levels = reinterpret_cast<const Ktx2Level*>(in_data + sizeof(Ktx2Header));
+		for (uint32_t mip = 0; mip < levelCount; ++mip)
+		{
+			uint32_t width = MipExtent(header.m_pixelWidth, mip);
+			uint32_t height = MipExtent(header.m_pixelHeight, mip);
+			uint64_t imageSize = TextureFile::GetImageSize(out_description.m_format, width, height);
+			if (levels[mip].m_byteLength != imageSize * out_description.m_layerCount ||
+				levels[mip].m_byteOffset > in_size || levels[mip].m_byteLength > in_size - levels[mip].m_byteOffset)
+			{
+				err << "Level " << mip << " out of bounds or of the wrong size. ";
+				return false;
+			}
+			for (uint32_t layer = 0; layer < out_description.m_layerCount; ++layer)
+			{
+				out_description.m_subresources.push_back({ mip, layer, width, height,
+					levels[mip].m_byteOffset + imageSize * layer, imageSize });
+			}
+		}
+		return true;
+	}
+
+	bool ParseDds(const uint8_t* in_data, size_t in_size, TextureFile::Description& out_description, std::ostringstream& err)
+	{
+		size_t dataOffset = sizeof(uint32_t) + sizeof(DdsHeader);
+		if (in_size < dataOffset)
+		{
+			err << "File too small for a DDS header. ";
+			return false;
+		}
+		const DdsHeader& header = *reinterpret_cast<const DdsHeader*>(in_data + sizeof(uint32_t));
+		if (header.m_size != sizeof(DdsHeader) || header.m_pixelFormat.m_size != sizeof(DdsPixelFormat))
+		{
+			err << "Bad DDS header size. ";
+			return false;
+		}
+
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t layerCount = 1;
+		bool cube = (header.m_caps2 & c_ddsCaps2Cubemap) != 0;
+		if ((header.m_pixelFormat.m_flags & c_ddsPixelFormatFourCC) && header.m_pixelFormat.m_fourCC == FourCC('D', 'X', '1', '0'))
+		{
+			if (in_size < dataOffset + sizeof(DdsHeaderDx10))
+			{
+				err << "File too small for a DX10 header. ";
+				return false;
+			}
+			const DdsHeaderDx10& dx10 = *reinterpret_cast<const DdsHeaderDx10*>(in_data + dataOffset);
+			dataOffset += sizeof(DdsHeaderDx10);
+			format = FormatFromDxgi(dx10.m_dxgiFormat);
+			if (format == VK_FORMAT_UNDEFINED)
+				err << "Unsupported DXGI format " << dx10.m_dxgiFormat << ". ";
+			if (dx10.m_resourceDimension != c_dx10DimensionTexture2D)
+				err << "Only 2D textures are supported. ";
+			layerCount = std::max(dx10.m_arraySize, 1u);
+			cube = (dx10.m_miscFlag & c_dx10MiscTextureCube) != 0;
+		}
+		else
+		{
+			format = FormatFromLegacyDds(header.m_pixelFormat);
+			if (format == VK_FORMAT_UNDEFINED)
+				err << "Unsupported DDS pixel format. ";
+			if (header.m_caps2 & c_ddsCaps2Volume)
+				err << "Volume textures are not supported. ";
+		}
+		if (header.m_width == 0 || header.m_height == 0)
+			err << "Empty image. ";
+		if (!err.str().empty())
+			return false;
+
+		out_description.m_format = format;
+		out_description.m_width = header.m_width;
+		out_description.m_height = header.m_height;
+		out_description.m_mipCount = (header.m_flags & c_ddsFlagMipMapCount) ? std::max(header.m_mipMapCount, 1u) : 1;
+		out_description.m_layerCount = layerCount * (cube ? 6 : 1);
+		out_description.m_cube = cube;
+
+		// Unlike KTX2, every layer (face) has all its mips before the next layer starts
+		uint64_t offset = dataOffset;
+		for (uint32_t layer = 0; layer < out_description.m_layerCount; ++layer)
+		{
+			for (uint32_t mip = 0; mip < out_description.m_mipCount; ++mip)
+			{
+				uint32_t width = MipExtent(header.m_width, mip);
+				uint32_t height = MipExtent(header.m_height, mip);
+				uint64_t imageSize = TextureFile::GetImageSize(format, width, height);
+				out_description.m_subresources.push_back({ mip, layer, width, height, offset, imageSize });
+				offset += imageSize;
+			}
+		}
+		if (offset > in_size)
+		{
+			err << "Image data out of bounds. ";
+			return false;
+		}
+		return true;
+	}
+}
+
+bool TextureFile::Parse(const uint8_t* in_data, size_t in_size, Description& out_description, std::string& out_error)
+{
+	std::ostringstream err;
+	out_description = Description();
+	bool parsed = false;
+	if (in_data != nullptr && in_size >= sizeof(c_ktx2Identifier) && memcmp(in_data, c_ktx2Identifier, sizeof(c_ktx2Identifier)) == 0)
+		parsed = ParseKtx2(in_data, in_size, out_description, err);
+	else if (in_data != nullptr && in_size >= sizeof(uint32_t) && *reinterpret_cast<const uint32_t*>(in_data) == c_ddsMagic)
+		parsed = ParseDds(in_data, in_size, out_description, err);
+	else
+		err << "Not a KTX2 or DDS file. ";
+	out_error = err.str();
+	return parsed;
+}
+
+bool TextureFile::GetBlockInfo(VkFormat in_format, uint32_t& out_blockBytes, uint32_t& out_blockExtent)
+{
+	out_blockExtent = 1;
+	switch (in_format)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	case VK_FORMAT_BC4_SNORM_BLOCK:
+		out_blockBytes = 8;
+		out_blockExtent = 4;
+		return true;
+	case VK_FORMAT_BC2_UNORM_BLOCK:
+	case VK_FORMAT_BC2_SRGB_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC5_SNORM_BLOCK:
+	case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+	case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		out_blockBytes = 16;
+		out_blockExtent = 4;
+		return true;
+	case VK_FORMAT_R8_UNORM:
+	case VK_FORMAT_R8_SRGB:
+		out_blockBytes = 1;
+		return true;
+	case VK_FORMAT_R8G8_UNORM:
+	case VK_FORMAT_R8G8_SRGB:
+		out_blockBytes = 2;
+		return true;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+		out_blockBytes = 4;
+		return true;
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+		out_blockBytes = 8;
+		return true;
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		out_blockBytes = 16;
+		return true;
+	default:
+		out_blockBytes = 0;
+		return false;
+	}
+}
+
+uint64_t TextureFile::GetImageSize(VkFormat in_format, uint32_t in_width, uint32_t in_height)
+{
+	uint32_t blockBytes, blockExtent;
+	if (!GetBlockInfo(in_format, blockBytes, blockExtent))
+		return 0;
+	uint64_t blocksX = (in_width + blockExtent - 1) / blockExtent;
+	uint64_t blocksY = (in_height + blockExtent - 1) / blockExtent;
+	return blocksX * blocksY * blockBytes;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// =======================================================================================
+//                                      TextureFile
+// =======================================================================================
+
+///---------------------------------------------------------------------------------------
+/// \brief	KTX2 and DDS texture containers
+///
+/// Parses the header of a memory mapped file into a description of the image and where
+/// every mip of every array layer is in the file, so the payload can be copied straight
+/// into staging memory (see VulkanTextureFactory). Nothing is decoded on the CPU, block
+/// compressed BC1-BC7 data is uploaded as it is.
+///
+/// Supported are 2D textures, arrays and cube maps in the BC formats and the common
+/// uncompressed 8 bit, half and float formats. KTX2 files must not be supercompressed
+/// (Basis/zstd), DDS files may have the DX10 extension header.
+///---------------------------------------------------------------------------------------
+
+namespace TextureFile
+{
+	// One mip of one array layer (cube faces are layers), as placed in the file
+	struct Subresource
+	{
+		uint32_t m_mip;
+		uint32_t m_layer;
+		uint32_t m_width;
+		uint32_t m_height;
+		uint64_t m_offset;
+		uint64_t m_size;
+	};
+
+	struct Description
+	{
+		VkFormat                 m_format;
+		uint32_t                 m_width;
+		uint32_t                 m_height;
+		uint32_t                 m_mipCount;
+		uint32_t                 m_layerCount; // six per cube
+		bool                     m_cube;
+		std::vector<Subresource> m_subresources;
+	};
+
+	// Fill out_description from a KTX2 or DDS file, picked by its identifier
+	bool Parse(const uint8_t* in_data, size_t in_size, Description& out_description, std::string& out_error);
+
+	// Bytes per block and block width/height in texels (1 for uncompressed formats).
+	// Returns false for formats the loader doesn't handle.
+	bool GetBlockInfo(VkFormat in_format, uint32_t& out_blockBytes, uint32_t& out_blockExtent);
+
+	// Size of one mip of one layer
+	uint64_t GetImageSize(VkFormat in_format, uint32_t in_width, uint32_t in_height);
+}
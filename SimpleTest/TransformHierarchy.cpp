@@ -0,0 +1,200 @@
+#include "TransformHierarchy.h"
+#include <algorithm>
+#include "ErrorReporting.h"
+#include "MatrixKernels.h"
+
+TransformHierarchy::TransformHierarchy()
+	: m_updateIdx(0)
+	, m_firstDirty(0)
+{
+}
+
+uint32_t TransformHierarchy::Add(uint32_t in_parent, const glm::vec3& in_position, const glm::quat& in_rotation, const glm::vec3& in_scale)
+{
+	uint32_t node = static_cast<uint32_t>(m_parent.size());
+	ERROR_IF(in_parent != c_noParent && in_parent >= node, "Transform parent " << in_parent << " doesn't exist");
+
+	m_parent.push_back(in_parent);
+	m_positionX.push_back(in_position.x);
+	m_positionY.push_back(in_position.y);
+	m_positionZ.push_back(in_position.z);
+	m_rotationX.push_back(in_rotation.x);
+	m_rotationY.push_back(in_rotation.y);
+	m_rotationZ.push_back(in_rotation.z);
+	m_rotationW.push_back(in_rotation.w);
+	m_scaleX.push_back(in_scale.x);
+	m_scaleY.push_back(in_scale.y);
+	m_scaleZ.push_back(in_scale.z);
+	m_dirty.push_back(1);
+	m_world.push_back(glm::mat4(1.0f));
+	m_changedUpdateIdx.push_back(0);
+	m_firstDirty = std::min<size_t>(m_firstDirty, node);
+	return node;
+}
+
+void TransformHierarchy::Reserve(size_t in_count)
+{
+	m_parent.reserve(in_count);
+	for (std::vector<float>* array : { &m_positionX, &m_positionY, &m_positionZ, &m_rotationX, &m_rotationY,
+		&m_rotationZ, &m_rotationW, &m_scaleX, &m_scaleY, &m_scaleZ })
+	{
+		array->reserve(in_count);
+	}
+	m_dirty.reserve(in_count);
+	m_world.reserve(in_count);
+	m_changedUpdateIdx.reserve(in_count);
+}
+
+void TransformHierarchy::SetPosition(uint32_t in_node, const glm::vec3& in_position)
+{
+	m_positionX[in_node] = in_position.x;
+	m_positionY[in_node] = in_position.y;
+	m_positionZ[in_node] = in_position.z;
+	MarkDirty(in_node);
+}
+
+void TransformHierarchy::SetRotation(uint32_t in_node, const glm::quat& in_rotation)
+{
+	m_rotationX[in_node] = in_rotation.x;
+	m_rotationY[in_node] = in_rotation.y;
+	m_rotationZ[in_node] = in_rotation.z;
+	m_rotationW[in_node] = in_rotation.w;
+	MarkDirty(in_node);
+}
+
+void TransformHierarchy::SetScale(uint32_t in_node, const glm::vec3& in_scale)
+{
+	m_scaleX[in_node] = in_scale.x;
+	m_scaleY[in_node] = in_scale.y;
+	m_scaleZ[in_node] = in_scale.z;
+	MarkDirty(in_node);
+}
+
+glm::vec3 TransformHierarchy::GetPosition(uint32_t in_node) const
+{
+	return glm::vec3(m_positionX[in_node], m_positionY[in_node], m_positionZ[in_node]);
+}
+
+glm::quat TransformHierarchy::GetRotation(uint32_t in_node) const
+{
+	return glm::quat(m_rotationW[in_node], m_rotationX[in_node], m_rotationY[in_node], m_rotationZ[in_node]);
+}
+
+glm::vec3 TransformHierarchy::GetScale(uint32_t in_node) const
+{
+	return glm::vec3(m_scaleX[in_node], m_scaleY[in_node], m_scaleZ[in_node]);
+}
+
+size_t TransformHierarchy::Update()
+{
+	size_t count = m_parent.size();
+	if (m_firstDirty >= count)
+		return 0;
+	++m_updateIdx;
+
+	// Nodes are collected four at a time for the local matrices
+	uint32_t batch[4];
+	size_t batchCount = 0;
+	size_t updated = 0;
+	for (size_t i = m_firstDirty; i < count; ++i)
+	{
+		// Parents come first, so a changed parent is already tagged with this update
+		uint32_t parent = m_parent[i];
+		bool parentChanged = parent != c_noParent && m_changedUpdateIdx[parent] == m_updateIdx;
+		if (!m_dirty[i] && !parentChanged)
+			continue;
+
+		m_dirty[i] = 0;
+		m_changedUpdateIdx[i] = m_updateIdx;
+		batch[batchCount++] = static_cast<uint32_t>(i);
+		if (batchCount == 4)
+		{
+			UpdateWorldMatrices(batch, batchCount);
+			batchCount = 0;
+		}
+		++updated;
+	}
+	UpdateWorldMatrices(batch, batchCount);
+	m_firstDirty = count;
+	return updated;
+}
+
+void TransformHierarchy::UpdateWorldMatrices(const uint32_t* in_nodes, size_t in_count)
+{
+#if defined(MATRIX_KERNELS_SSE2)
+	if (in_count == 4)
+	{
+		const uint32_t* n = in_nodes;
+		// Consecutive nodes, the usual case, load straight from the arrays
+		bool consecutive = n[3] - n[0] == 3;
+		auto gather = [n, consecutive](const std::vector<float>& in_array)
+		{
+			return consecutive ? _mm_loadu_ps(&in_array[n[0]]) : _mm_setr_ps(in_array[n[0]], in_array[n[1]], in_array[n[2]], in_array[n[3]]);
+		};
+		__m128 x = gather(m_rotationX), y = gather(m_rotationY), z = gather(m_rotationZ), w = gather(m_rotationW);
+		__m128 sx = gather(m_scaleX), sy = gather(m_scaleY), sz = gather(m_scaleZ);
+
+		// Rotation scaled per axis for the four nodes, element r of column c in local[c * 3 + r], then translation
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 two = _mm_set1_ps(2.0f);
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+		alignas(16) float local[12][4];
+		_mm_store_ps(local[0], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx));
+		_mm_store_ps(local[1], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx));
+		_mm_store_ps(local[2], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx));
+		_mm_store_ps(local[3], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy));
+		_mm_store_ps(local[4], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy));
+		_mm_store_ps(local[5], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy));
+		_mm_store_ps(local[6], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz));
+		_mm_store_ps(local[7], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz));
+		_mm_store_ps(local[8], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz));
+		_mm_store_ps(local[9], gather(m_positionX));
+		_mm_store_ps(local[10], gather(m_positionY));
+		_mm_store_ps(local[11], gather(m_positionZ));
+
+		// Parent times local, the local matrix has no projection so only the last column takes the parent's last.
+		// In order, a node's parent may be one of the others.
+		static const glm::mat4 identity(1.0f);
+		for (size_t i = 0; i < 4; ++i)
+		{
+			uint32_t parent = m_parent[n[i]];
+			const float* p = parent == c_noParent ? &identity[0][0] : &m_world[parent][0][0];
+			__m128 p0 = _mm_loadu_ps(p), p1 = _mm_loadu_ps(p + 4), p2 = _mm_loadu_ps(p + 8), p3 = _mm_loadu_ps(p + 12);
+			float* out = &m_world[n[i]][0][0];
+			for (int c = 0; c < 4; ++c)
+			{
+				__m128 column = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p0, _mm_set1_ps(local[c * 3][i])), _mm_mul_ps(p1, _mm_set1_ps(local[c * 3 + 1][i]))),
+					_mm_mul_ps(p2, _mm_set1_ps(local[c * 3 + 2][i])));
+				_mm_storeu_ps(out + c * 4, c == 3 ? _mm_add_ps(column, p3) : column);
+			}
+		}
+		return;
+	}
+#endif
+	for (size_t i = 0; i < in_count; ++i)
+	{
+		// Local matrix, rotation scaled per axis, then translation
+		uint32_t node = in_nodes[i];
+		float x = m_rotationX[node], y = m_rotationY[node], z = m_rotationZ[node], w = m_rotationW[node];
+		float sx = m_scaleX[node], sy = m_scaleY[node], sz = m_scaleZ[node];
+		glm::mat4 local(
+			(1.0f - 2.0f * (y * y + z * z)) * sx, 2.0f * (x * y + w * z) * sx, 2.0f * (x * z - w * y) * sx, 0.0f,
+			2.0f * (x * y - w * z) * sy, (1.0f - 2.0f * (x * x + z * z)) * sy, 2.0f * (y * z + w * x) * sy, 0.0f,
+			2.0f * (x * z + w * y) * sz, 2.0f * (y * z - w * x) * sz, (1.0f - 2.0f * (x * x + y * y)) * sz, 0.0f,
+			m_positionX[node], m_positionY[node], m_positionZ[node], 1.0f);
+
+		uint32_t parent = m_parent[node];
+		if (parent == c_noParent)
+			m_world[node] = local;
+		else
+			MatrixKernels::Multiply(m_world[parent], local, m_world[node]);
+	}
+}
+
+void TransformHierarchy::MarkDirty(uint32_t in_node)
+{
+	m_dirty[in_node] = 1;
+	m_firstDirty = std::min<size_t>(m_firstDirty, in_node);
+}
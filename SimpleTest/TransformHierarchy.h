@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "MathTypes.h"
+#include <glm/gtc/quaternion.hpp>
+
+/*!
+* \class TransformHierarchy
+*
+* \brief
+*
+* Local position, rotation and scale of scene nodes with parents, resolved to world matrices.
+*
+* The local transforms are kept as structure of arrays in topological order, every parent is
+* stored before its children (nodes can only be added under existing ones). That makes the
+* world matrix update one linear pass where a parent's world matrix is always done before it
+* is needed. The nodes to update are taken four at a time: their local matrices are built
+* from the arrays with SSE2, one node per lane, and each is then multiplied with its parent's
+* world matrix a column per vector. The multiply skips the local matrix's zero bottom row.
+*
+* Only nodes that were changed and their descendants are recomputed, a node is tagged with
+* the update it was recomputed in so its children can tell their parent changed.
+*/
+
+class TransformHierarchy
+{
+public:
+	static const uint32_t c_noParent = 0xFFFFFFFF;
+
+	TransformHierarchy();
+
+	// in_parent must be c_noParent or an existing node, returns the new node
+	uint32_t Add(uint32_t in_parent, const glm::vec3& in_position, const glm::quat& in_rotation, const glm::vec3& in_scale);
+	void Reserve(size_t in_count);
+
+	void SetPosition(uint32_t in_node, const glm::vec3& in_position);
+	void SetRotation(uint32_t in_node, const glm::quat& in_rotation);
+	void SetScale(uint32_t in_node, const glm::vec3& in_scale);
+
+	glm::vec3 GetPosition(uint32_t in_node) const;
+	glm::quat GetRotation(uint32_t in_node) const;
+	glm::vec3 GetScale(uint32_t in_node) const;
+	uint32_t  GetParent(uint32_t in_node) const { return m_parent[in_node]; }
+	size_t    GetCount() const { return m_parent.size(); }
+
+	// Recompute the world matrices of changed nodes and their descendants, returns how many were recomputed
+	size_t Update();
+
+	// As of the last Update
+	const glm::mat4& GetWorldMatrix(uint32_t in_node) const { return m_world[in_node]; }
+	// All GetCount() of them, for the batch kernels
+	const glm::mat4* GetWorldMatrices() const { return m_world.data(); }
+
+private:
+	void MarkDirty(uint32_t in_node);
+	// World matrices of up to four nodes in topological order, their parents outside of them must be done
+	void UpdateWorldMatrices(const uint32_t* in_nodes, size_t in_count);
+
+	std::vector<uint32_t> m_parent;
+	std::vector<float>    m_positionX, m_positionY, m_positionZ;
+	std::vector<float>    m_rotationX, m_rotationY, m_rotationZ, m_rotationW;
+	std::vector<float>    m_scaleX, m_scaleY, m_scaleZ;
+	std::vector<uint8_t>  m_dirty;
+
+	std::vector<glm::mat4> m_world;
+	std::vector<uint64_t>  m_changedUpdateIdx;
+	uint64_t               m_updateIdx;
+	// Nothing before this node is dirty, so the update can start here
+	size_t                 m_firstDirty;
+};
@@ -1,7 +1,25 @@
 #pragma once
 
+#include "VertexDeclaration.h"
+
 struct Vertex
 {
 	float m_pos[3];
 	float m_col[3];
-};
\ No newline at end of file
+};
+
+typedef VertexDeclaration<Vertex,
+	VERTEX_ATTRIBUTE(Vertex, 0, m_pos),
+	VERTEX_ATTRIBUTE(Vertex, 1, m_col)> VertexDecl;
+
+// Half the size of Vertex, for the same shader inputs. Positions are relative to the mesh
+// bounds, the dequantization is folded into the world matrix (see VulkanMesh).
+struct QuantizedVertex
+{
+	Snorm16x4 m_pos;
+	Unorm8x4  m_col;
+};
+
+typedef VertexDeclaration<QuantizedVertex,
+	VERTEX_ATTRIBUTE(QuantizedVertex, 0, m_pos),
+	VERTEX_ATTRIBUTE(QuantizedVertex, 1, m_col)> QuantizedVertexDecl;
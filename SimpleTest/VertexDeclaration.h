@@ -0,0 +1,79 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include <cstdint>
+#include <cstddef>
+#include "VulkanVertexLayout.h"
+
+// =======================================================================================
+//                                      VertexDeclaration
+// =======================================================================================
+
+///---------------------------------------------------------------------------------------
+/// \brief	Compile time vertex input descriptions
+///
+/// The VkFormat of an attribute follows from the C++ type of the struct member and the
+/// offset from offsetof, so a vertex struct and its Vulkan layout can't drift apart:
+///
+///   typedef VertexDeclaration<MyVertex,
+///       VERTEX_ATTRIBUTE(MyVertex, 0, m_pos),
+///       VERTEX_ATTRIBUTE(MyVertex, 1, m_col)> MyVertexDeclaration;
+///
+/// The packed types below are the storage for quantized attributes. Their encoders
+/// live in VertexQuantization.h.
+///---------------------------------------------------------------------------------------
+
+// Packed attribute storage
+struct Snorm16x4   { int16_t  m_v[4]; }; // e.g. bounds relative positions, w unused
+struct OctNormal16 { int16_t  m_v[2]; }; // octahedral encoded unit vector
+struct Unorm8x4    { uint8_t  m_v[4]; }; // colors
+struct Half2       { uint16_t m_v[2]; }; // texture coordinates
+
+// Maps a member type to its vertex input format
+template<typename T> struct VertexFormatOf;
+template<> struct VertexFormatOf<float>       { static const VkFormat c_format = VK_FORMAT_R32_SFLOAT; };
+template<> struct VertexFormatOf<float[2]>    { static const VkFormat c_format = VK_FORMAT_R32G32_SFLOAT; };
+template<> struct VertexFormatOf<float[3]>    { static const VkFormat c_format = VK_FORMAT_R32G32B32_SFLOAT; };
+template<> struct VertexFormatOf<float[4]>    { static const VkFormat c_format = VK_FORMAT_R32G32B32A32_SFLOAT; };
+template<> struct VertexFormatOf<Snorm16x4>   { static const VkFormat c_format = VK_FORMAT_R16G16B16A16_SNORM; };
+template<> struct VertexFormatOf<OctNormal16> { static const VkFormat c_format = VK_FORMAT_R16G16_SNORM; };
+template<> struct VertexFormatOf<Unorm8x4>    { static const VkFormat c_format = VK_FORMAT_R8G8B8A8_UNORM; };
+template<> struct VertexFormatOf<Half2>       { static const VkFormat c_format = VK_FORMAT_R16G16_SFLOAT; };
+
+template<uint32_t Location, typename MemberType, size_t Offset>
+struct VertexAttribute
+{
+	static const uint32_t c_location = Location;
+	static const VkFormat c_format = VertexFormatOf<MemberType>::c_format;
+	static const uint32_t c_offset = static_cast<uint32_t>(Offset);
+	static const uint32_t c_size = sizeof(MemberType);
+};
+
+#define VERTEX_ATTRIBUTE(VertexType, location, member) \
+	VertexAttribute<location, decltype(VertexType::member), offsetof(VertexType, member)>
+
+template<typename VertexType, typename... Attributes>
+struct VertexDeclaration
+{
+	typedef VertexType Vertex;
+	static const uint32_t c_stride = sizeof(VertexType);
+	static const uint32_t c_attributeCount = sizeof...(Attributes);
+
+	static void GetAttributes(uint32_t in_bindingId, VkVertexInputAttributeDescription* out_attributes)
+	{
+		const VkVertexInputAttributeDescription attributes[] = { { Attributes::c_location, in_bindingId, Attributes::c_format, Attributes::c_offset }... };
+		for (uint32_t i = 0; i < c_attributeCount; ++i)
+			out_attributes[i] = attributes[i];
+	}
+
+	static void GetLayout(uint32_t in_bindingId, VulkanVertexLayout& out_layout)
+	{
+		out_layout.m_bindingDescriptions.resize(1);
+		out_layout.m_bindingDescriptions[0].binding = in_bindingId;
+		out_layout.m_bindingDescriptions[0].stride = c_stride;
+		out_layout.m_bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		out_layout.m_attributeDescriptions.resize(c_attributeCount);
+		GetAttributes(in_bindingId, out_layout.m_attributeDescriptions.data());
+	}
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include "MathTypes.h"
+#include <glm/gtc/packing.hpp>
+#include "VertexDeclaration.h"
+
+// Encoders for the packed attribute types in VertexDeclaration.h,
+// each matches how the GPU expands the corresponding VkFormat.
+namespace VertexQuantization
+{
+	// Round to nearest, [-1,1] -> [-32767,32767]
+	inline int16_t QuantizeSnorm16(float in_value)
+	{
+		return static_cast<int16_t>(glm::round(glm::clamp(in_value, -1.0f, 1.0f) * 32767.0f));
+	}
+
+	// [0,1] -> [0,255]
+	inline uint8_t QuantizeUnorm8(float in_value)
+	{
+		return static_cast<uint8_t>(glm::round(glm::clamp(in_value, 0.0f, 1.0f) * 255.0f));
+	}
+
+	// Position relative to a box, decoded as in_center + snorm * in_halfExtent
+	inline Snorm16x4 EncodePosition(const glm::vec3& in_pos, const glm::vec3& in_center, const glm::vec3& in_halfExtent)
+	{
+		Snorm16x4 result;
+		for (int i = 0; i < 3; ++i)
+		{
+			float extent = in_halfExtent[i] > 0.0f ? in_halfExtent[i] : 1.0f;
+			result.m_v[i] = QuantizeSnorm16((in_pos[i] - in_center[i]) / extent);
+		}
+		result.m_v[3] = 32767;
+		return result;
+	}
+
+	// Octahedral mapping of a unit vector to two components (Cigolle et al. 2014)
+	inline OctNormal16 EncodeOctahedral(const glm::vec3& in_normal)
+	{
+		glm::vec3 n = in_normal / (glm::abs(in_normal.x) + glm::abs(in_normal.y) + glm::abs(in_normal.z));
+		glm::vec2 oct(n.x, n.y);
+		if (n.z < 0.0f)
+		{
+			// Fold the lower hemisphere over the diagonals
+			oct = (glm::vec2(1.0f) - glm::abs(glm::vec2(n.y, n.x))) *
+				glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+		}
+		OctNormal16 result;
+		result.m_v[0] = QuantizeSnorm16(oct.x);
+		result.m_v[1] = QuantizeSnorm16(oct.y);
+		return result;
+	}
+
+	inline glm::vec3 DecodeOctahedral(const OctNormal16& in_encoded)
+	{
+		glm::vec2 oct(glm::max(in_encoded.m_v[0] / 32767.0f, -1.0f), glm::max(in_encoded.m_v[1] / 32767.0f, -1.0f));
+		glm::vec3 n(oct.x, oct.y, 1.0f - glm::abs(oct.x) - glm::abs(oct.y));
+		if (n.z < 0.0f)
+		{
+			glm::vec2 folded = (glm::vec2(1.0f) - glm::abs(glm::vec2(n.y, n.x))) *
+				glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+			n.x = folded.x;
+			n.y = folded.y;
+		}
+		return glm::normalize(n);
+	}
+
+	inline Unorm8x4 EncodeColor(const glm::vec4& in_color)
+	{
+		Unorm8x4 result;
+		for (int i = 0; i < 4; ++i) result.m_v[i] = QuantizeUnorm8(in_color[i]);
+		return result;
+	}
+
+	inline Half2 EncodeTexCoord(const glm::vec2& in_uv)
+	{
+		Half2 result;
+		result.m_v[0] = glm::packHalf1x16(in_uv.x);
+		result.m_v[1] = glm::packHalf1x16(in_uv.y);
+		return result;
+	}
+}
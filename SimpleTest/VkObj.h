@@ -1,6 +1,7 @@
 #pragma once
 #include <functional>
 #include "DebugPrint.h"
+#include "VulkanDeletionQueue.h"
 
 /*!
 * \class VkPtr
@@ -111,6 +112,34 @@ public:
 		return &m_obj;
 	}
 
+	// Same as Replace(), but the old object is handed to the deletion queue
+	// and destroyed first when the GPU is done with the current frame.
+	// A null queue falls back on immediate destruction.
+	T* Replace(VulkanDeletionQueue* inout_deletionQueue)
+	{
+		if (inout_deletionQueue == nullptr)
+			return Replace();
+		Release(*inout_deletionQueue);
+		return &m_obj;
+	}
+
+	// Give up ownership of the object to the deletion queue
+	void Release(VulkanDeletionQueue& inout_deletionQueue)
+	{
+		if (m_obj == VK_NULL_HANDLE) return;
+#ifdef _DEBUG
+		if (!m_dbgName.empty())
+			LOG("Vulkan Object: Deferring removal: " << m_dbgName);
+		else
+			LOG("Vulkan Object: Deferring removal: (unnamed)");
+#endif // _DEBUG
+		// Capture by value, this VkObj may be gone when the queue gets to it
+		std::function<void(T)> deleter = m_deleter;
+		T obj = m_obj;
+		inout_deletionQueue.Push([deleter, obj]() { deleter(obj); });
+		m_obj = VK_NULL_HANDLE;
+	}
+
 	void Reset(T* in_init)
 	{
 		T* ptr = Replace();
@@ -0,0 +1,297 @@
+#include "VulkanBindlessTable.h"
+#include <cstring>
+#include <algorithm>
+#include "ErrorReporting.h"
+#include "vulkantools.h"
+#include "VulkanDeletionQueue.h"
+
+#ifdef _DEBUG
+#define REGISTER_VKOBJ(x, d, func, dbg) x(d, func, std::string(dbg))
+#else
+#define REGISTER_VKOBJ(x, d, func, dbg) x(d, func)
+#endif // _DEBUG
+
+namespace
+{
+	const VkDescriptorType c_descriptorTypes[VulkanBindlessTable::RESOURCE_TYPE_COUNT] =
+	{
+		VK_DESCRIPTOR_TYPE_SAMPLER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE
+	};
+
+	bool HasDeviceExtension(VkPhysicalDevice in_physicalDevice, const char* in_name)
+	{
+		uint32_t count = 0;
+		vkEnumerateDeviceExtensionProperties(in_physicalDevice, nullptr, &count, nullptr);
+		std::vector<VkExtensionProperties> extensions(count);
+		vkEnumerateDeviceExtensionProperties(in_physicalDevice, nullptr, &count, extensions.data());
+		for (const VkExtensionProperties& extension : extensions)
+		{
+			if (strcmp(extension.extensionName, in_name) == 0)
+				return true;
+		}
+		return false;
+	}
+}
+
+bool VulkanBindlessTable::GetRequiredFeatures(VkInstance in_instance, VkPhysicalDevice in_physicalDevice,
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT& out_features)
+{
+	out_features = {};
+	out_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	if (!HasDeviceExtension(in_physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) ||
+		!HasDeviceExtension(in_physicalDevice, VK_KHR_MAINTENANCE3_EXTENSION_NAME))
+		return false;
+
+	PFN_vkGetPhysicalDeviceFeatures2KHR getFeatures2 =
+		(PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(in_instance, "vkGetPhysicalDeviceFeatures2KHR");
+	if (!getFeatures2)
+		return false;
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported = {};
+	supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	VkPhysicalDeviceFeatures2KHR features2 = {};
+	features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+	features2.pNext = &supported;
+	getFeatures2(in_physicalDevice, &features2);
+
+	if (!supported.descriptorBindingSampledImageUpdateAfterBind ||
+		!supported.descriptorBindingStorageBufferUpdateAfterBind ||
+		!supported.descriptorBindingUpdateUnusedWhilePending ||
+		!supported.descriptorBindingPartiallyBound ||
+		!supported.descriptorBindingVariableDescriptorCount ||
+		!supported.runtimeDescriptorArray)
+		return false;
+
+	out_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	out_features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+	out_features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+	out_features.descriptorBindingPartiallyBound = VK_TRUE;
+	out_features.descriptorBindingVariableDescriptorCount = VK_TRUE;
+	out_features.runtimeDescriptorArray = VK_TRUE;
+	// Indices that differ within a draw (nonuniformEXT in the shaders), where available
+	out_features.shaderSampledImageArrayNonUniformIndexing = supported.shaderSampledImageArrayNonUniformIndexing;
+	out_features.shaderStorageBufferArrayNonUniformIndexing = supported.shaderStorageBufferArrayNonUniformIndexing;
+	return true;
+}
+
+VulkanBindlessTable::VulkanBindlessTable(const VkObj<VkDevice>& in_device, std::shared_ptr<VulkanDeletionQueue> in_deletionQueue,
+	uint32_t in_maxSamplers, uint32_t in_maxStorageBuffers, uint32_t in_maxSampledImages, uint32_t in_setCount/* = 1*/,
+	const std::vector<VkSampler>& in_immutableSamplers/* = std::vector<VkSampler>()*/)
+	: m_device(in_device)
+	, m_deletionQueue(in_deletionQueue)
+	, m_immutableSamplers(in_immutableSamplers)
+	, REGISTER_VKOBJ(m_layout, in_device, vkDestroyDescriptorSetLayout, "DescriptorSetLayout_Bindless")
+	, REGISTER_VKOBJ(m_pool, in_device, vkDestroyDescriptorPool, "DescriptorPool_Bindless")
+	, m_sets(in_setCount, VK_NULL_HANDLE)
+{
+	ERROR_IF(in_setCount == 0, "Bindless table without sets");
+	if (!m_immutableSamplers.empty())
+		in_maxSamplers = static_cast<uint32_t>(m_immutableSamplers.size());
+	uint32_t capacities[RESOURCE_TYPE_COUNT] = { in_maxSamplers, in_maxStorageBuffers, in_maxSampledImages };
+
+	// One array per type, the last one (the images) sized when the set is allocated
+	VkDescriptorSetLayoutBinding bindings[RESOURCE_TYPE_COUNT] = {};
+	VkDescriptorBindingFlagsEXT bindingFlags[RESOURCE_TYPE_COUNT] = {};
+	VkDescriptorPoolSize poolSizes[RESOURCE_TYPE_COUNT] = {};
+	for (uint32_t i = 0; i < RESOURCE_TYPE_COUNT; ++i)
+	{
+		ERROR_IF(capacities[i] == 0, "Bindless table without room for resource type " << i);
+		m_slots[i].m_capacity = capacities[i];
+		m_slots[i].m_highWater = 0;
+
+		bindings[i].binding = i;
+		bindings[i].descriptorType = c_descriptorTypes[i];
+		bindings[i].descriptorCount = capacities[i];
+		bindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+		bindingFlags[i] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+			VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT |
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT;
+		poolSizes[i].type = c_descriptorTypes[i];
+		poolSizes[i].descriptorCount = capacities[i] * in_setCount;
+	}
+	bindingFlags[SAMPLED_IMAGE] |= VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT;
+	// Baked into the layout, never written
+	if (!m_immutableSamplers.empty())
+	{
+		bindings[SAMPLER].pImmutableSamplers = m_immutableSamplers.data();
+		bindingFlags[SAMPLER] = 0;
+		m_slots[SAMPLER].m_highWater = capacities[SAMPLER];
+	}
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	bindingFlagsInfo.bindingCount = RESOURCE_TYPE_COUNT;
+	bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	layoutInfo.bindingCount = RESOURCE_TYPE_COUNT;
+	layoutInfo.pBindings = bindings;
+	VkResult err = vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, m_layout.Replace());
+	ERROR_IF(err, "Create bindless descriptor set layout: " << vkTools::errorString(err));
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	poolInfo.maxSets = in_setCount;
+	poolInfo.poolSizeCount = RESOURCE_TYPE_COUNT;
+	poolInfo.pPoolSizes = poolSizes;
+	err = vkCreateDescriptorPool(m_device, &poolInfo, nullptr, m_pool.Replace());
+	ERROR_IF(err, "Create bindless descriptor pool: " << vkTools::errorString(err));
+
+	std::vector<uint32_t> variableCounts(in_setCount, capacities[SAMPLED_IMAGE]);
+	VkDescriptorSetVariableDescriptorCountAllocateInfoEXT variableCountInfo = {};
+	variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
+	variableCountInfo.descriptorSetCount = in_setCount;
+	variableCountInfo.pDescriptorCounts = variableCounts.data();
+
+	std::vector<VkDescriptorSetLayout> layouts(in_setCount, m_layout);
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.pNext = &variableCountInfo;
+	allocInfo.descriptorPool = m_pool;
+	allocInfo.descriptorSetCount = in_setCount;
+	allocInfo.pSetLayouts = layouts.data();
+	err = vkAllocateDescriptorSets(m_device, &allocInfo, m_sets.data());
+	ERROR_IF(err, "Allocate bindless descriptor sets: " << vkTools::errorString(err));
+}
+
+VulkanBindlessTable::~VulkanBindlessTable()
+{
+	// The sets are freed with the pool
+}
+
+uint32_t VulkanBindlessTable::AddSampler(VkSampler in_sampler)
+{
+	if (!m_immutableSamplers.empty())
+	{
+		auto immutable = std::find(m_immutableSamplers.begin(), m_immutableSamplers.end(), in_sampler);
+		ERROR_IF(immutable == m_immutableSamplers.end(), "Sampler is not one of the immutable samplers of the bindless table");
+		return static_cast<uint32_t>(immutable - m_immutableSamplers.begin());
+	}
+	uint32_t idx = Allocate(SAMPLER);
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.sampler = in_sampler;
+	Write(SAMPLER, idx, &imageInfo, nullptr);
+	return idx;
+}
+
+uint32_t VulkanBindlessTable::AddStorageBuffer(VkBuffer in_buffer, VkDeviceSize in_offset/* = 0*/, VkDeviceSize in_range/* = VK_WHOLE_SIZE*/)
+{
+	uint32_t idx = Allocate(STORAGE_BUFFER);
+	VkDescriptorBufferInfo bufferInfo = { in_buffer, in_offset, in_range };
+	Write(STORAGE_BUFFER, idx, nullptr, &bufferInfo);
+	return idx;
+}
+
+uint32_t VulkanBindlessTable::AddSampledImage(VkImageView in_imageView, VkImageLayout in_layout/* = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL*/)
+{
+	uint32_t idx = Allocate(SAMPLED_IMAGE);
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.imageView = in_imageView;
+	imageInfo.imageLayout = in_layout;
+	Write(SAMPLED_IMAGE, idx, &imageInfo, nullptr);
+	return idx;
+}
+
+void VulkanBindlessTable::UpdateSampledImage(uint32_t in_idx, VkImageView in_imageView, VkImageLayout in_layout/* = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL*/,
+	std::shared_ptr<void> in_keepAlive/* = nullptr*/)
+{
+	ERROR_IF(in_idx >= m_slots[SAMPLED_IMAGE].m_highWater, "Updating bindless slot " << in_idx << " that was never allocated");
+	PendingUpdate update;
+	update.m_idx = in_idx;
+	update.m_imageInfo = {};
+	update.m_imageInfo.imageView = in_imageView;
+	update.m_imageInfo.imageLayout = in_layout;
+	update.m_written.assign(m_sets.size(), false);
+	update.m_remaining = static_cast<uint32_t>(m_sets.size());
+	update.m_keepAlive = in_keepAlive;
+	m_pendingUpdates.push_back(update);
+}
+
+void VulkanBindlessTable::Release(ResourceType in_type, uint32_t in_idx)
+{
+	ERROR_IF(in_idx >= m_slots[in_type].m_highWater, "Releasing bindless slot " << in_idx << " that was never allocated");
+	if (in_type == SAMPLER && !m_immutableSamplers.empty())
+		return;
+	// Updates not done yet would land on whoever gets the slot next. Sets that didn't get
+	// them still point at the old views, so those are held on to for as long as the slot.
+	if (in_type == SAMPLED_IMAGE)
+	{
+		for (auto it = m_pendingUpdates.begin(); it != m_pendingUpdates.end();)
+		{
+			if (it->m_idx == in_idx)
+			{
+				std::shared_ptr<void> keepAlive = it->m_keepAlive;
+				m_deletionQueue->Push([keepAlive]() {});
+				it = m_pendingUpdates.erase(it);
+			}
+			else
+				++it;
+		}
+	}
+	// Frames in flight may still index the slot, it is left as it is until they are done
+	Slots* slots = &m_slots[in_type];
+	m_deletionQueue->Push([slots, in_idx]() { slots->m_free.push_back(in_idx); });
+}
+
+void VulkanBindlessTable::BeginFrame(uint32_t in_setIdx)
+{
+	for (PendingUpdate& update : m_pendingUpdates)
+	{
+		if (update.m_written[in_setIdx])
+			continue;
+		Write(SAMPLED_IMAGE, update.m_idx, &update.m_imageInfo, nullptr, in_setIdx);
+		update.m_written[in_setIdx] = true;
+		--update.m_remaining;
+	}
+	// Done everywhere, work still pending used the copies of the set that were changed after
+	// its fence signaled, so nothing refers to the previous views anymore
+	m_pendingUpdates.erase(std::remove_if(m_pendingUpdates.begin(), m_pendingUpdates.end(),
+		[](const PendingUpdate& in_update) { return in_update.m_remaining == 0; }), m_pendingUpdates.end());
+}
+
+uint32_t VulkanBindlessTable::GetUsedCount(ResourceType in_type) const
+{
+	return m_slots[in_type].m_highWater - static_cast<uint32_t>(m_slots[in_type].m_free.size());
+}
+
+uint32_t VulkanBindlessTable::Allocate(ResourceType in_type)
+{
+	Slots& slots = m_slots[in_type];
+	if (!slots.m_free.empty())
+	{
+		uint32_t idx = slots.m_free.back();
+		slots.m_free.pop_back();
+		return idx;
+	}
+	ERROR_IF(slots.m_highWater >= slots.m_capacity, "Bindless table full for resource type " << in_type << " (" << slots.m_capacity << ")");
+	return slots.m_highWater++;
+}
+
+void VulkanBindlessTable::Write(ResourceType in_type, uint32_t in_idx, const VkDescriptorImageInfo* in_imageInfo, const VkDescriptorBufferInfo* in_bufferInfo,
+	uint32_t in_setIdx/* = c_invalidIdx*/)
+{
+	// Allowed while the set is bound, as long as pending command buffers don't use the slot
+	std::vector<VkWriteDescriptorSet> writes;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(m_sets.size()); ++i)
+	{
+		if (in_setIdx != c_invalidIdx && in_setIdx != i)
+			continue;
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = m_sets[i];
+		write.dstBinding = static_cast<uint32_t>(in_type);
+		write.dstArrayElement = in_idx;
+		write.descriptorCount = 1;
+		write.descriptorType = c_descriptorTypes[in_type];
+		write.pImageInfo = in_imageInfo;
+		write.pBufferInfo = in_bufferInfo;
+		writes.push_back(write);
+	}
+	vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
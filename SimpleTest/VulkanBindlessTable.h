@@ -0,0 +1,119 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include <vector>
+#include <memory>
+#include "VkObj.h"
+#include "VulkanDescriptorIndexing.h"
+
+class VulkanDeletionQueue;
+
+/*!
+* \class VulkanBindlessTable
+*
+* \brief
+*
+* One large descriptor set with every sampler, storage buffer and sampled image in use,
+* bound once and indexed by shaders with ids passed in push constants or instance data
+* (see shaders/bindless.glsl), instead of a descriptor set per material or object.
+*
+* Built on VK_EXT_descriptor_indexing: the bindings are update after bind, so resources
+* are added while command buffers using the set are pending, partially bound, so unused
+* slots may stay empty, and the sampled images are a variable count array.
+*
+* Resources get a stable index that stays theirs until released. Released indices are
+* handed out again once the frames that could still use them are finished, through the
+* deletion queue. Not thread safe, use it from the thread that draws.
+*
+* The samplers can instead be fixed in the layout as immutable samplers (typically
+* VulkanSamplerCache::GetCommonSamplers()), their indices are then their place in that
+* list and AddSampler only looks them up.
+*
+* A slot can't be rewritten while pending command buffers use it, so there is one copy of
+* the set per frame buffer. Pointing a slot in use at another image view is queued and
+* done to each copy in BeginFrame, once the fence of its frame buffer has signaled.
+*/
+
+class VulkanBindlessTable
+{
+public:
+	// Also the binding of each array
+	enum ResourceType
+	{
+		SAMPLER,
+		STORAGE_BUFFER,
+		SAMPLED_IMAGE,
+		RESOURCE_TYPE_COUNT
+	};
+
+	// For resources that have no slot in the table
+	static const uint32_t c_invalidIdx = 0xFFFFFFFF;
+
+	// Checks for the extension and the features the table needs. out_features is set up with only
+	// those enabled, to chain into the device create info (its pNext is left to the caller).
+	// The instance must have been created with VK_KHR_get_physical_device_properties2.
+	static bool GetRequiredFeatures(VkInstance in_instance, VkPhysicalDevice in_physicalDevice,
+		VkPhysicalDeviceDescriptorIndexingFeaturesEXT& out_features);
+
+	// in_setCount copies of the set, one per frame buffer. With in_immutableSamplers the sampler
+	// array is those and in_maxSamplers is ignored.
+	VulkanBindlessTable(const VkObj<VkDevice>& in_device, std::shared_ptr<VulkanDeletionQueue> in_deletionQueue,
+		uint32_t in_maxSamplers, uint32_t in_maxStorageBuffers, uint32_t in_maxSampledImages, uint32_t in_setCount = 1,
+		const std::vector<VkSampler>& in_immutableSamplers = std::vector<VkSampler>());
+	~VulkanBindlessTable();
+
+	// Write a resource to a free slot and return its index. Immutable samplers are only looked up.
+	uint32_t AddSampler(VkSampler in_sampler);
+	uint32_t AddStorageBuffer(VkBuffer in_buffer, VkDeviceSize in_offset = 0, VkDeviceSize in_range = VK_WHOLE_SIZE);
+	uint32_t AddSampledImage(VkImageView in_imageView, VkImageLayout in_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	// Point an image slot in use at another view. in_keepAlive is held (typically the owner of the
+	// previous view) until every copy of the set has been changed.
+	void UpdateSampledImage(uint32_t in_idx, VkImageView in_imageView, VkImageLayout in_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		std::shared_ptr<void> in_keepAlive = nullptr);
+
+	// The slot is reused once the frame being recorded is finished. The resource itself must live until then as well.
+	void Release(ResourceType in_type, uint32_t in_idx);
+
+	// Apply the queued updates to the set of in_setIdx, call when its frame buffer's fence has signaled
+	void BeginFrame(uint32_t in_setIdx);
+
+	VkDescriptorSetLayout GetLayout() const { return m_layout; }
+	VkDescriptorSet GetSet(uint32_t in_setIdx = 0) const { return m_sets[in_setIdx]; }
+	const std::vector<VkDescriptorSet>& GetSets() const { return m_sets; }
+	uint32_t GetUsedCount(ResourceType in_type) const;
+
+private:
+	struct Slots
+	{
+		uint32_t              m_capacity;
+		uint32_t              m_highWater; // slots above have never been used
+		std::vector<uint32_t> m_free;
+	};
+
+	// A slot change not yet done to every copy of the set
+	struct PendingUpdate
+	{
+		uint32_t              m_idx;
+		VkDescriptorImageInfo m_imageInfo;
+		std::vector<bool>     m_written; // per set
+		uint32_t              m_remaining;
+		std::shared_ptr<void> m_keepAlive;
+	};
+
+	uint32_t Allocate(ResourceType in_type);
+	// Writes to every copy of the set when in_setIdx is c_invalidIdx
+	void     Write(ResourceType in_type, uint32_t in_idx, const VkDescriptorImageInfo* in_imageInfo, const VkDescriptorBufferInfo* in_bufferInfo,
+		uint32_t in_setIdx = c_invalidIdx);
+
+	const VkObj<VkDevice>&               m_device;
+	std::shared_ptr<VulkanDeletionQueue> m_deletionQueue;
+	Slots                                m_slots[RESOURCE_TYPE_COUNT];
+	std::vector<VkSampler>               m_immutableSamplers;
+
+	VkObj<VkDescriptorSetLayout>         m_layout;
+	VkObj<VkDescriptorPool>              m_pool;
+	std::vector<VkDescriptorSet>         m_sets;
+	// In the order they were made, updates of the same slot are applied in turn
+	std::vector<PendingUpdate>           m_pendingUpdates;
+};
@@ -1,17 +1,34 @@
 #include "VulkanBufferFactory.h"
+#include <cstring>
 #include "ErrorReporting.h"
+#include "vulkantools.h"
 #include "VulkanMemoryHelper.h"
+#include "VulkanDeletionQueue.h"
 #include "Vertex.h"
 #include "VulkanMesh.h"
 #include "VulkanUniformBufferPerFrame.h"
+#include "VulkanVertexLayout.h"
+#include "MappedFile.h"
+#include "MeshFile.h"
+#include "DepthPrepass.h"
 
-VulkanBufferFactory::VulkanBufferFactory(VkDevice in_device, std::shared_ptr<VulkanMemoryHelper> in_memory)
+VulkanBufferFactory::VulkanBufferFactory(VkDevice in_device, std::shared_ptr<VulkanMemoryHelper> in_memory,
+	std::shared_ptr<VulkanDeletionQueue> in_deletionQueue/* = nullptr*/)
 	: m_device(in_device)
 	, m_memory(in_memory)
+	, m_transferQueue(VK_NULL_HANDLE)
+	, m_transferCommandPool(VK_NULL_HANDLE)
+	, m_deletionQueue(in_deletionQueue)
 {
 
 }
 
+void VulkanBufferFactory::SetTransferQueue(VkQueue in_queue, VkCommandPool in_commandPool)
+{
+	m_transferQueue = in_queue;
+	m_transferCommandPool = in_commandPool;
+}
+
 void VulkanBufferFactory::CreateTriangle(VulkanMesh& out_mesh) const
 {
 	// Data
@@ -26,41 +43,143 @@ void VulkanBufferFactory::CreateTriangle(VulkanMesh& out_mesh) const
 	uint32_t vertexBufferByteSize = vertexCount * sizeof(Vertex);
 
 	// Setup index data for triangle
-	std::vector<uint32_t> indexData = { 0, 1, 2 };
+	std::vector<uint16_t> indexData = { 0, 1, 2 };
 	uint32_t indexCount = static_cast<uint32_t>(indexData.size());
-	int indexBufferByteSize = indexCount * sizeof(uint32_t);
+	int indexBufferByteSize = indexCount * sizeof(uint16_t);
 
 	// Buffers
 
-	// TODO: staging buffers
-
 	// Create vertex buffer
-	if (CreateBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+	if (CreateDeviceLocalBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
 		vertexBufferByteSize,
 		reinterpret_cast<void*>(vertexData.data()),
-		*out_mesh.m_vertices.m_buffer.Replace(),
-		*out_mesh.m_vertices.m_gpuMem.Replace()))
+		*out_mesh.m_vertices.m_buffer.Replace(m_deletionQueue.get()),
+		*out_mesh.m_vertices.m_gpuMem.Replace(m_deletionQueue.get())))
 	{
 		out_mesh.m_vertices.m_count = vertexCount;
 	}
 
 	// Create index buffer
-	if (CreateBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+	if (CreateDeviceLocalBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
 		indexBufferByteSize,
 		reinterpret_cast<void*>(indexData.data()),
-		*out_mesh.m_indices.m_buffer.Replace(),
-		*out_mesh.m_indices.m_gpuMem.Replace()))
+		*out_mesh.m_indices.m_buffer.Replace(m_deletionQueue.get()),
+		*out_mesh.m_indices.m_gpuMem.Replace(m_deletionQueue.get())))
 	{
 		out_mesh.m_indices.m_count = indexCount;
+		out_mesh.m_indices.m_type = VK_INDEX_TYPE_UINT16;
 	}
+	out_mesh.m_positions.m_count = 0;
+	out_mesh.m_submeshes.clear();
+	out_mesh.m_meshlets.clear();
+	out_mesh.m_lods.clear();
+	out_mesh.m_boundsMin = glm::vec3(-1.0f, -1.0f, 0.0f);
+	out_mesh.m_boundsMax = glm::vec3(1.0f, 1.0f, 0.0f);
+	out_mesh.m_dequantize = glm::mat4();
 }
 
-void VulkanBufferFactory::CreateUniformBufferPerFrame(VulkanUniformBufferPerFrame& out_buffer,
-	const glm::mat4& in_projMat, const glm::mat4& in_worldMat, const glm::mat4 in_viewMat) const
+bool VulkanBufferFactory::CreateMeshFromFile(const std::string& in_path, uint32_t in_vertexBufferBindId,
+	VulkanMesh& out_mesh, VulkanVertexLayout* out_vertexLayout/* = nullptr*/, bool in_positionStream/* = false*/) const
 {
-	out_buffer.m_data.m_projectionMatrix = in_projMat;
-	out_buffer.m_data.m_worldMatrix = in_worldMat;
-	out_buffer.m_data.m_viewMatrix = in_viewMat;
+	// Map the file and point the uploads straight into it, the only copy made on the
+	// CPU is the one from the page cache into the staging buffer
+	MappedFile file;
+	if (!file.Open(in_path))
+	{
+		LOG("Could not open mesh file: " << in_path);
+		return false;
+	}
+
+	std::string validationError;
+	if (!MeshFile::Validate(file.GetData(), file.GetSize(), validationError))
+	{
+		LOG("Invalid mesh file " << in_path << ": " << validationError);
+		return false;
+	}
+
+	const MeshFile::Header& header = *reinterpret_cast<const MeshFile::Header*>(file.GetData());
+
+	if (!CreateDeviceLocalBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		header.m_vertexSize,
+		file.GetData() + header.m_vertexOffset,
+		*out_mesh.m_vertices.m_buffer.Replace(m_deletionQueue.get()),
+		*out_mesh.m_vertices.m_gpuMem.Replace(m_deletionQueue.get())))
+	{
+		return false;
+	}
+	out_mesh.m_vertices.m_count = header.m_vertexCount;
+
+	// Positions once more on their own, so position only passes fetch a fraction of the bytes
+	out_mesh.m_positions.m_count = 0;
+	if (in_positionStream)
+	{
+		VulkanVertexLayout fileLayout;
+		MeshFile::GetVertexLayout(header, in_vertexBufferBindId, fileLayout);
+		std::vector<uint8_t> positions;
+		if (DepthPrepass::ExtractPositions(file.GetData() + header.m_vertexOffset, header.m_vertexCount, fileLayout,
+			positions, out_mesh.m_positionFormat) &&
+			CreateDeviceLocalBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			positions.size(),
+			positions.data(),
+			*out_mesh.m_positions.m_buffer.Replace(m_deletionQueue.get()),
+			*out_mesh.m_positions.m_gpuMem.Replace(m_deletionQueue.get())))
+		{
+			out_mesh.m_positions.m_count = header.m_vertexCount;
+		}
+	}
+
+	// Encoded index streams are decoded straight into staging memory, raw ones are copied from the mapping
+	auto readIndices = [&](void* out_indices)
+	{
+		if (MeshFile::ReadIndices(file.GetData(), header, out_indices))
+			return true;
+		LOG("Corrupt index stream in mesh file " << in_path);
+		return false;
+	};
+	if (!CreateDeviceLocalBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+		header.m_indexSize,
+		readIndices,
+		*out_mesh.m_indices.m_buffer.Replace(m_deletionQueue.get()),
+		*out_mesh.m_indices.m_gpuMem.Replace(m_deletionQueue.get())))
+	{
+		return false;
+	}
+	out_mesh.m_indices.m_count = header.m_indexCount;
+	out_mesh.m_indices.m_type = static_cast<VkIndexType>(header.m_indexType);
+
+	const MeshFile::Submesh* submeshes = reinterpret_cast<const MeshFile::Submesh*>(file.GetData() + header.m_submeshOffset);
+	out_mesh.m_submeshes.resize(header.m_submeshCount);
+	for (uint32_t i = 0; i < header.m_submeshCount; ++i)
+	{
+		out_mesh.m_submeshes[i].m_firstIndex = submeshes[i].m_firstIndex;
+		out_mesh.m_submeshes[i].m_indexCount = submeshes[i].m_indexCount;
+		out_mesh.m_submeshes[i].m_vertexOffset = submeshes[i].m_vertexOffset;
+	}
+	const Meshlet* meshlets = reinterpret_cast<const Meshlet*>(file.GetData() + header.m_meshletOffset);
+	out_mesh.m_meshlets.assign(meshlets, meshlets + header.m_meshletCount);
+	const MeshFile::Lod* lods = reinterpret_cast<const MeshFile::Lod*>(file.GetData() + header.m_lodOffset);
+	out_mesh.m_lods.resize(header.m_lodCount);
+	for (uint32_t i = 0; i < header.m_lodCount; ++i)
+	{
+		out_mesh.m_lods[i].m_firstSubmesh = lods[i].m_firstSubmesh;
+		out_mesh.m_lods[i].m_submeshCount = lods[i].m_submeshCount;
+		out_mesh.m_lods[i].m_firstMeshlet = lods[i].m_firstMeshlet;
+		out_mesh.m_lods[i].m_meshletCount = lods[i].m_meshletCount;
+		out_mesh.m_lods[i].m_error = lods[i].m_error;
+	}
+	out_mesh.m_boundsMin = glm::vec3(header.m_boundsMin[0], header.m_boundsMin[1], header.m_boundsMin[2]);
+	out_mesh.m_boundsMax = glm::vec3(header.m_boundsMax[0], header.m_boundsMax[1], header.m_boundsMax[2]);
+	out_mesh.m_dequantize = MeshFile::GetDequantizeTransform(header);
+
+	if (out_vertexLayout)
+		MeshFile::GetVertexLayout(header, in_vertexBufferBindId, *out_vertexLayout);
+
+	return true;
+}
+
+void VulkanBufferFactory::CreateUniformBufferPerFrame(VulkanUniformBufferPerFrame& out_buffer, const glm::mat4& in_modelViewProjection) const
+{
+	out_buffer.m_data.m_modelViewProjection = in_modelViewProjection;
 
 	VkDeviceSize dataSize = sizeof(out_buffer.m_data);
 
@@ -68,8 +187,8 @@ void VulkanBufferFactory::CreateUniformBufferPerFrame(VulkanUniformBufferPerFram
 	if (CreateBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 		dataSize,
 		reinterpret_cast<void*>(&out_buffer.m_data),
-		*out_buffer.m_allocation.m_buffer.Replace(),
-		*out_buffer.m_allocation.m_gpuMem.Replace()))
+		*out_buffer.m_allocation.m_buffer.Replace(m_deletionQueue.get()),
+		*out_buffer.m_allocation.m_gpuMem.Replace(m_deletionQueue.get())))
 	{
 		// Store buffer information in the descriptor
 		out_buffer.m_allocation.m_descriptorBufferInfo.buffer = out_buffer.m_allocation.m_buffer;
@@ -80,16 +199,17 @@ void VulkanBufferFactory::CreateUniformBufferPerFrame(VulkanUniformBufferPerFram
 
 bool VulkanBufferFactory::CreateBuffer(VkBufferUsageFlags in_usage,
 	VkDeviceSize in_size, 
-	void* in_data,
+	const void* in_data,
 	VkBuffer& out_buffer,
-	VkDeviceMemory& out_allocatedDeviceMemory) const
+	VkDeviceMemory& out_allocatedDeviceMemory,
+	VkMemoryPropertyFlags in_memoryProperties/* = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT*/) const
 {
 	if (m_memory == nullptr) return false;
 
 	VkMemoryRequirements memoryRequirements;
 
 	// Creation information structs
-	static VkMemoryAllocateInfo memoryAllocationInfo = {};
+	VkMemoryAllocateInfo memoryAllocationInfo = {};
 	memoryAllocationInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 	memoryAllocationInfo.pNext = nullptr;
 	memoryAllocationInfo.allocationSize = 0; // is set later when we have the memory requirements
@@ -109,15 +229,16 @@ bool VulkanBufferFactory::CreateBuffer(VkBufferUsageFlags in_usage,
 	// Allocate memory on gpu
 	vkGetBufferMemoryRequirements(m_device, out_buffer, &memoryRequirements);
 	memoryAllocationInfo.allocationSize = memoryRequirements.size;
-	// Get the appropriate memory type for allocation, where the memory is only visible to the host
-	m_memory->GetMemoryType(memoryRequirements.memoryTypeBits, 
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, 
+	// Get the appropriate memory type for allocation with the requested properties
+	VkBool32 foundType = m_memory->GetMemoryType(memoryRequirements.memoryTypeBits, 
+		in_memoryProperties, 
 		&memoryAllocationInfo.memoryTypeIndex);
+	ERROR_IF(!foundType, "No memory type for buffer with properties " << in_memoryProperties);
 	err = vkAllocateMemory(m_device, &memoryAllocationInfo, nullptr, &out_allocatedDeviceMemory);
 	ERROR_IF(err, "Allocate memory on device for buffer");
 
 	// If we have initialization data, then copy it to the gpu
-	if (in_data != nullptr)
+	if (in_data != nullptr && (in_memoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
 	{
 		// TODO: Maybe move map/unmap operations to a helper class or make a generic buffer base class that has this sort of stuff
 		void *mapped;
@@ -133,3 +254,145 @@ bool VulkanBufferFactory::CreateBuffer(VkBufferUsageFlags in_usage,
 
 	return true;
 }
+
+bool VulkanBufferFactory::CreateDeviceLocalBuffer(VkBufferUsageFlags in_usage,
+	VkDeviceSize in_size,
+	const void* in_data,
+	VkBuffer& out_buffer,
+	VkDeviceMemory& out_allocatedDeviceMemory) const
+{
+	if (m_transferQueue == VK_NULL_HANDLE || m_transferCommandPool == VK_NULL_HANDLE)
+		return CreateBuffer(in_usage, in_size, in_data, out_buffer, out_allocatedDeviceMemory);
+
+	// Host visible staging buffer that we fill and copy from
+	VkBuffer stagingBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+	if (!CreateBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, in_size, in_data, stagingBuffer, stagingMemory,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+	{
+		return false;
+	}
+
+	// Device local target buffer
+	bool created = CreateBuffer(in_usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, in_size, nullptr,
+		out_buffer, out_allocatedDeviceMemory, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	if (created && in_data != nullptr)
+		CopyBuffer(stagingBuffer, out_buffer, in_size);
+
+	// The copy has been waited on, so staging can go right away
+	vkDestroyBuffer(m_device, stagingBuffer, nullptr);
+	vkFreeMemory(m_device, stagingMemory, nullptr);
+	return created;
+}
+
+bool VulkanBufferFactory::CreateDeviceLocalBuffer(VkBufferUsageFlags in_usage,
+	VkDeviceSize in_size,
+	const std::function<bool(void* out_data)>& in_fill,
+	VkBuffer& out_buffer,
+	VkDeviceMemory& out_allocatedDeviceMemory) const
+{
+	if (m_transferQueue == VK_NULL_HANDLE || m_transferCommandPool == VK_NULL_HANDLE)
+	{
+		return CreateBuffer(in_usage, in_size, nullptr, out_buffer, out_allocatedDeviceMemory) &&
+			FillMemory(out_allocatedDeviceMemory, in_size, in_fill);
+	}
+
+	VkBuffer stagingBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+	if (!CreateBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, in_size, nullptr, stagingBuffer, stagingMemory,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+	{
+		return false;
+	}
+
+	bool created = FillMemory(stagingMemory, in_size, in_fill) &&
+		CreateBuffer(in_usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, in_size, nullptr,
+		out_buffer, out_allocatedDeviceMemory, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	if (created)
+		CopyBuffer(stagingBuffer, out_buffer, in_size);
+
+	vkDestroyBuffer(m_device, stagingBuffer, nullptr);
+	vkFreeMemory(m_device, stagingMemory, nullptr);
+	return created;
+}
+
+bool VulkanBufferFactory::FillMemory(VkDeviceMemory in_memory, VkDeviceSize in_size, const std::function<bool(void* out_data)>& in_fill) const
+{
+	void* mapped;
+	VkResult err = vkMapMemory(m_device, in_memory, 0, in_size, 0, &mapped);
+	ERROR_IF(err, "Map data for buffer");
+	bool filled = in_fill(mapped);
+	vkUnmapMemory(m_device, in_memory);
+	return filled;
+}
+
+void VulkanBufferFactory::CopyBuffer(VkBuffer in_src, VkBuffer in_dst, VkDeviceSize in_size) const
+{
+	SubmitOneShot([in_src, in_dst, in_size](VkCommandBuffer in_commandBuffer)
+	{
+		VkBufferCopy copyRegion = {};
+		copyRegion.size = in_size;
+		vkCmdCopyBuffer(in_commandBuffer, in_src, in_dst, 1, &copyRegion);
+	});
+}
+
+void VulkanBufferFactory::SubmitOneShot(const std::function<void(VkCommandBuffer)>& in_record) const
+{
+	FinishOneShot(SubmitOneShotAsync(in_record), true);
+}
+
+VulkanBufferFactory::OneShot VulkanBufferFactory::SubmitOneShotAsync(const std::function<void(VkCommandBuffer)>& in_record) const
+{
+	ERROR_IF(m_transferQueue == VK_NULL_HANDLE || m_transferCommandPool == VK_NULL_HANDLE, "One-shot submit without a transfer queue");
+
+	VkCommandBufferAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocateInfo.commandPool = m_transferCommandPool;
+	allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocateInfo.commandBufferCount = 1;
+
+	VkCommandBuffer copyCmd;
+	VkResult err = vkAllocateCommandBuffers(m_device, &allocateInfo, &copyCmd);
+	ERROR_IF(err, "Allocate copy command buffer: " << vkTools::errorString(err));
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	err = vkBeginCommandBuffer(copyCmd, &beginInfo);
+	ERROR_IF(err, "Begin copy command buffer: " << vkTools::errorString(err));
+
+	in_record(copyCmd);
+
+	err = vkEndCommandBuffer(copyCmd);
+	ERROR_IF(err, "End copy command buffer: " << vkTools::errorString(err));
+
+	// Submit, the fence tells when it is done
+	VkFenceCreateInfo fenceCreateInfo = {};
+	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	VkFence fence;
+	err = vkCreateFence(m_device, &fenceCreateInfo, nullptr, &fence);
+	ERROR_IF(err, "Create copy fence: " << vkTools::errorString(err));
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &copyCmd;
+	err = vkQueueSubmit(m_transferQueue, 1, &submitInfo, fence);
+	ERROR_IF(err, "Submit copy: " << vkTools::errorString(err));
+
+	OneShot oneShot = { copyCmd, fence };
+	return oneShot;
+}
+
+bool VulkanBufferFactory::FinishOneShot(const OneShot& in_oneShot, bool in_wait) const
+{
+	VkResult err = in_wait ? vkWaitForFences(m_device, 1, &in_oneShot.m_fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT) :
+		vkGetFenceStatus(m_device, in_oneShot.m_fence);
+	if (err == VK_NOT_READY)
+		return false;
+	ERROR_IF(err, "Wait for copy: " << vkTools::errorString(err));
+
+	vkDestroyFence(m_device, in_oneShot.m_fence, nullptr);
+	vkFreeCommandBuffers(m_device, m_transferCommandPool, 1, &in_oneShot.m_commandBuffer);
+	return true;
+}
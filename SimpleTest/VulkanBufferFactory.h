@@ -3,30 +3,84 @@
 #include "vulkan/vulkan.h"
 #include <vector>
 #include <memory>
+#include <string>
+#include <functional>
 #include "MathTypes.h"
 
 class VulkanMemoryHelper;
+class VulkanDeletionQueue;
 class VulkanMesh;
+struct VulkanVertexLayout;
 struct VulkanUniformBufferPerFrame;
 
 class VulkanBufferFactory
 {
 public:
-	VulkanBufferFactory(VkDevice in_device, std::shared_ptr<VulkanMemoryHelper> in_memory);
+	VulkanBufferFactory(VkDevice in_device, std::shared_ptr<VulkanMemoryHelper> in_memory,
+		std::shared_ptr<VulkanDeletionQueue> in_deletionQueue = nullptr);
+
+	// Queue and pool used for one-shot staging uploads, without it buffers are left in host visible memory
+	void SetTransferQueue(VkQueue in_queue, VkCommandPool in_commandPool);
+	bool HasTransferQueue() const { return m_transferQueue != VK_NULL_HANDLE && m_transferCommandPool != VK_NULL_HANDLE; }
+
+	// Record commands with in_record into a one-shot command buffer, submit it on the transfer queue and wait
+	void SubmitOneShot(const std::function<void(VkCommandBuffer)>& in_record) const;
+
+	// A one-shot submit that has not been waited on
+	struct OneShot
+	{
+		VkCommandBuffer m_commandBuffer;
+		VkFence         m_fence;
+	};
+	// As SubmitOneShot without the wait, pass it to FinishOneShot until that returns true
+	OneShot SubmitOneShotAsync(const std::function<void(VkCommandBuffer)>& in_record) const;
+	// Free in_oneShot if it is done, waiting for it first with in_wait. Returns false if it is still executing.
+	bool FinishOneShot(const OneShot& in_oneShot, bool in_wait) const;
 
 	void CreateTriangle(VulkanMesh& out_mesh) const;
+
+	// Load a mesh file (see MeshFile.h), the file is memory mapped and its streams
+	// copied straight into staging memory. Optionally outputs the vertex layout stored in the file,
+	// and creates the packed position stream (VulkanMesh::m_positions).
+	bool CreateMeshFromFile(const std::string& in_path, uint32_t in_vertexBufferBindId,
+		VulkanMesh& out_mesh, VulkanVertexLayout* out_vertexLayout = nullptr, bool in_positionStream = false) const;
 	
-	void CreateUniformBufferPerFrame(VulkanUniformBufferPerFrame& out_buffer,
-		const glm::mat4& in_projMat, const glm::mat4& in_worldMat, const glm::mat4 in_viewMat) const;
+	void CreateUniformBufferPerFrame(VulkanUniformBufferPerFrame& out_buffer, const glm::mat4& in_modelViewProjection) const;
 	
 	// Create a buffer, allocate gpu memory, copy optional init data and bind the buffer
 	bool CreateBuffer(VkBufferUsageFlags in_usage,
 		VkDeviceSize in_size,
-		void* in_data,
+		const void* in_data,
+		VkBuffer& out_buffer,
+		VkDeviceMemory& out_allocatedDeviceMemory,
+		VkMemoryPropertyFlags in_memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) const;
+
+	// Create a device local buffer and fill it through a staging buffer,
+	// falls back on CreateBuffer if no transfer queue has been set
+	bool CreateDeviceLocalBuffer(VkBufferUsageFlags in_usage,
+		VkDeviceSize in_size,
+		const void* in_data,
+		VkBuffer& out_buffer,
+		VkDeviceMemory& out_allocatedDeviceMemory) const;
+
+	// As above, with in_fill writing the in_size bytes of initial data straight into mapped memory
+	// (the staging buffer, or the buffer itself without a transfer queue). Fails if in_fill does.
+	bool CreateDeviceLocalBuffer(VkBufferUsageFlags in_usage,
+		VkDeviceSize in_size,
+		const std::function<bool(void* out_data)>& in_fill,
 		VkBuffer& out_buffer,
 		VkDeviceMemory& out_allocatedDeviceMemory) const;
 
 private:
+	// Record, submit and wait for a one-shot copy between two buffers
+	void CopyBuffer(VkBuffer in_src, VkBuffer in_dst, VkDeviceSize in_size) const;
+	// Map host visible memory and let in_fill write in_size bytes to it
+	bool FillMemory(VkDeviceMemory in_memory, VkDeviceSize in_size, const std::function<bool(void* out_data)>& in_fill) const;
+
 	VkDevice m_device;
 	std::shared_ptr<VulkanMemoryHelper> m_memory;
+	VkQueue       m_transferQueue;
+	VkCommandPool m_transferCommandPool;
+	// Replaced buffers are destroyed through this when set, so they can be swapped while in flight
+	std::shared_ptr<VulkanDeletionQueue> m_deletionQueue;
 };
\ No newline at end of file
@@ -2,23 +2,112 @@
 #include "ErrorReporting.h"
 #include "VulkanDepthStencil.h"
 #include "VulkanSwapChain.h"
+#include "VulkanMeshletCuller.h"
+#include "VulkanInstanceBuffer.h"
+#include "VulkanHiZPyramid.h"
+#include "VulkanSecondaryCommandCache.h"
+#include "VulkanGpuTimer.h"
+#include "DrawList.h"
+#include "DepthPrepass.h"
 #include "vulkantools.h"
+#include <cstring>
+#include <algorithm>
 
+namespace
+{
+	// Push the data of draw in_drawIdx, unless it is what the previous draw pushed
+	void PushDrawData(VkCommandBuffer in_commandBuffer, VkPipelineLayout in_pipelineLayout,
+		const std::vector<VulkanPushConstants::DrawData>* in_drawData, size_t in_drawIdx,
+		const VulkanPushConstants::DrawData*& inout_lastPushed)
+	{
+		if (!in_drawData || in_drawData->empty())
+			return;
+		const VulkanPushConstants::DrawData& data = (*in_drawData)[std::min(in_drawIdx, in_drawData->size() - 1)];
+		if (inout_lastPushed && memcmp(inout_lastPushed, &data, sizeof(data)) == 0)
+			return;
+		VulkanPushConstants::Push(in_commandBuffer, in_pipelineLayout, data);
+		inout_lastPushed = &data;
+	}
+
+	// Everything recorded into the draws of a render pass that may change, other than the render pass and
+	// frame buffer. Buffer contents written per frame (instances, indirect draws) are read when executed.
+	VulkanSecondaryCommandCache::Inputs MakeSecondaryInputs(uint32_t in_bufferIdx,
+		const VulkanCommandBufferFactory::DrawCommandBufferDependencies& in_dependencyObjects,
+		int in_width, int in_height, VulkanMeshletCuller::Phase in_phase)
+	{
+		VulkanSecondaryCommandCache::Inputs inputs;
+		inputs.Add(in_width);
+		inputs.Add(in_height);
+		inputs.Add(in_phase);
+		inputs.Add(*in_dependencyObjects.m_pipelineLayout);
+		inputs.Add(*in_dependencyObjects.m_pipeline);
+		inputs.Add(in_dependencyObjects.m_depthPrepassPipeline ? *in_dependencyObjects.m_depthPrepassPipeline : VK_NULL_HANDLE);
+		for (VkDescriptorSet set : *in_dependencyObjects.m_descriptorSets)
+			inputs.Add(set);
+		if (in_dependencyObjects.m_perBufferDescriptorSets)
+			inputs.Add((*in_dependencyObjects.m_perBufferDescriptorSets)[in_bufferIdx]);
+
+		const VulkanMesh& mesh = *in_dependencyObjects.m_mesh;
+		inputs.Add(static_cast<VkBuffer>(mesh.m_vertices.m_buffer));
+		inputs.Add(static_cast<VkBuffer>(mesh.m_positions.m_buffer));
+		inputs.Add(static_cast<VkBuffer>(mesh.m_indices.m_buffer));
+		inputs.Add(mesh.m_indices.m_count);
+		if (!mesh.m_submeshes.empty())
+			inputs.AddBytes(mesh.m_submeshes.data(), mesh.m_submeshes.size() * sizeof(VulkanMesh::Submesh));
+		inputs.Add(in_dependencyObjects.m_meshletCuller);
+		inputs.Add(in_dependencyObjects.m_instanceBuffer);
+		inputs.Add(in_dependencyObjects.m_gpuTimer);
+		if (in_dependencyObjects.m_drawData && !in_dependencyObjects.m_drawData->empty())
+		{
+			inputs.AddBytes(in_dependencyObjects.m_drawData->data(),
+				in_dependencyObjects.m_drawData->size() * sizeof(VulkanPushConstants::DrawData));
+		}
+		return inputs;
+	}
+}
 
 VulkanCommandBufferFactory::DrawCommandBufferDependencies::DrawCommandBufferDependencies(const VkPipelineLayout* in_pipelineLayout, const VkPipeline* in_pipeline, std::vector<VkDescriptorSet>* in_descriptorSets,
-	int in_vertexBufferBindId, VulkanMesh* in_mesh, VulkanSwapChain* in_swapChain)
+	int in_vertexBufferBindId, VulkanMesh* in_mesh, VulkanSwapChain* in_swapChain,
+	const VulkanMeshletCuller* in_meshletCuller/* = nullptr*/,
+	const VulkanInstanceBuffer* in_instanceBuffer/* = nullptr*/, int in_instanceBufferBindId/* = 1*/,
+	const std::vector<VulkanPushConstants::DrawData>* in_drawData/* = nullptr*/,
+	const std::vector<VkDescriptorSet>* in_perBufferDescriptorSets/* = nullptr*/,
+	const VkPipeline* in_depthPrepassPipeline/* = nullptr*/,
+	const VulkanHiZPyramid* in_hiZPyramid/* = nullptr*/, const VkRenderPass* in_lateRenderPass/* = nullptr*/,
+	const VulkanGpuTimer* in_gpuTimer/* = nullptr*/)
 	: m_pipelineLayout(in_pipelineLayout)
 	, m_pipeline(in_pipeline)
+	, m_depthPrepassPipeline(in_depthPrepassPipeline)
 	, m_descriptorSets(in_descriptorSets)
+	, m_perBufferDescriptorSets(in_perBufferDescriptorSets)
 	, m_vertexBufferBindId(in_vertexBufferBindId)
 	, m_mesh(in_mesh)
+	, m_meshletCuller(in_meshletCuller)
+	, m_hiZPyramid(in_hiZPyramid)
+	, m_lateRenderPass(in_lateRenderPass)
+	, m_instanceBuffer(in_instanceBuffer)
+	, m_instanceBufferBindId(in_instanceBufferBindId)
+	, m_drawData(in_drawData)
+	, m_gpuTimer(in_gpuTimer)
 	, m_swapChain(in_swapChain)
 {
 }
 
 
+VulkanCommandBufferFactory::BoundState::BoundState()
+	: m_pipeline(VK_NULL_HANDLE)
+	, m_vertexBuffer(VK_NULL_HANDLE)
+	, m_indexBuffer(VK_NULL_HANDLE)
+	, m_descriptorSets(false)
+	, m_instanceBuffer(false)
+{
+}
+
+
 VulkanCommandBufferFactory::VulkanCommandBufferFactory(VkDevice in_device)
 	: m_device(in_device)
+	, m_bindStats()
+	, m_jobSystem(nullptr)
 {
 }
 
@@ -39,7 +128,7 @@ VkResult VulkanCommandBufferFactory::AllocateCommandBuffers(VkCommandPool in_com
 void VulkanCommandBufferFactory::ConstructDrawCommandBuffer(std::vector<VkCommandBuffer>& inout_buffers, const std::vector<VkFramebuffer>& in_targetFrameBuffers, 
 	DrawCommandBufferDependencies& in_dependencyObjects,
 	const VkRenderPass& in_renderPass, const VkClearColorValue& in_clearColor,
-	int in_width, int in_height)
+	int in_width, int in_height, VulkanSecondaryCommandCache* in_secondaryCache/* = nullptr*/)
 {
 	// The following buffer lists should all be of the same size, as they represent the size of the buffers in the swap chain
 	ERROR_IF(inout_buffers.size() != in_targetFrameBuffers.size(), "ConstructDrawCommandBuffer: Frame buffers count not equal to command buffers count.");
@@ -53,10 +142,28 @@ void VulkanCommandBufferFactory::ConstructDrawCommandBuffer(std::vector<VkComman
 
 	std::vector<VulkanSwapChain::SwapChainBuffer>& swapchainBuffers = in_dependencyObjects.m_swapChain->GetBuffers();
 	ERROR_IF(inout_buffers.size() != in_dependencyObjects.m_swapChain->GetBuffersCount(), "ConstructDrawCommandBuffer: Swap chain buffers count not equal to command buffers count.");
+	ERROR_IF(in_dependencyObjects.m_perBufferDescriptorSets && in_dependencyObjects.m_perBufferDescriptorSets->size() != inout_buffers.size(),
+		"ConstructDrawCommandBuffer: Per buffer descriptor sets count not equal to command buffers count.");
 
+	m_bindStats = BindStats();
+	for (uint32_t i = 0; i < inout_buffers.size(); ++i)
+	{
+		RecordDrawCommandBuffer(inout_buffers[i], i, in_targetFrameBuffers[i], in_dependencyObjects,
+			in_renderPass, in_clearColor, in_width, in_height, in_secondaryCache);
+	}
+}
+
+
+void VulkanCommandBufferFactory::RecordDrawCommandBuffer(VkCommandBuffer in_commandBuffer, uint32_t in_bufferIdx, VkFramebuffer in_frameBuffer,
+	const DrawCommandBufferDependencies& in_dependencyObjects,
+	const VkRenderPass& in_renderPass, const VkClearColorValue& in_clearColor,
+	int in_width, int in_height, VulkanSecondaryCommandCache* in_secondaryCache/* = nullptr*/)
+{
+	// Recorded every frame when the draws are cached
 	VkCommandBufferBeginInfo cmdBufInfo = {};
 	cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	cmdBufInfo.pNext = nullptr;
+	cmdBufInfo.flags = in_secondaryCache ? VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT : 0;
 
 	VkClearValue clearValues[2];
 	clearValues[0].color = in_clearColor;
@@ -72,71 +179,305 @@ void VulkanCommandBufferFactory::ConstructDrawCommandBuffer(std::vector<VkComman
 	renderPassBeginInfo.renderArea.extent.height = in_height;
 	renderPassBeginInfo.clearValueCount = 2;
 	renderPassBeginInfo.pClearValues = clearValues;
+	// Set target frame buffer
+	renderPassBeginInfo.framebuffer = in_frameBuffer;
+
+	bool occlusionCulling = in_dependencyObjects.m_meshletCuller && in_dependencyObjects.m_meshletCuller->IsOcclusionCulling() &&
+		in_dependencyObjects.m_hiZPyramid && in_dependencyObjects.m_lateRenderPass;
+
+	// Begin new command buffer for the target frame buffer
+	VkResult err = vkBeginCommandBuffer(in_commandBuffer, &cmdBufInfo);
+	ERROR_IF(err, "Begin command buffer for drawing to frame buffer" << std::to_string(in_bufferIdx) << ": " << vkTools::errorString(err));
+
+	const VulkanGpuTimer* gpuTimer = in_dependencyObjects.m_gpuTimer;
+	if (gpuTimer)
+		gpuTimer->RecordReset(in_commandBuffer, in_bufferIdx);
+
+	// Compute work has to go in before the render pass
+	if (in_dependencyObjects.m_meshletCuller)
+		in_dependencyObjects.m_meshletCuller->RecordCull(in_commandBuffer, in_bufferIdx);
+
+	if (gpuTimer)
+		gpuTimer->RecordTimestamp(in_commandBuffer, in_bufferIdx, VulkanGpuTimer::TIMESTAMP_BEGIN);
+
+	// Bound state carries over between the render passes
+	BoundState state;
+	RecordRenderPass(in_commandBuffer, in_bufferIdx, in_dependencyObjects, renderPassBeginInfo, state,
+		in_width, in_height, VulkanMeshletCuller::PHASE_EARLY, in_secondaryCache);
 
-	VkResult err;
+	// Occlusion culling, the meshlets the early cull found occluded by the previous frame are tested
+	// again against the depth drawn so far, and the ones that turned visible drawn on top
+	if (occlusionCulling)
+	{
+		in_dependencyObjects.m_hiZPyramid->RecordBuild(in_commandBuffer);
+		in_dependencyObjects.m_meshletCuller->RecordCull(in_commandBuffer, in_bufferIdx, VulkanMeshletCuller::PHASE_LATE);
+		VkRenderPassBeginInfo lateRenderPassBeginInfo = renderPassBeginInfo;
+		lateRenderPassBeginInfo.renderPass = *in_dependencyObjects.m_lateRenderPass;
+		RecordRenderPass(in_commandBuffer, in_bufferIdx, in_dependencyObjects, lateRenderPassBeginInfo, state,
+			in_width, in_height, VulkanMeshletCuller::PHASE_LATE, in_secondaryCache);
+	}
+
+	if (gpuTimer)
+		gpuTimer->RecordTimestamp(in_commandBuffer, in_bufferIdx, VulkanGpuTimer::TIMESTAMP_END);
+
+	// Ending the render pass will add an implicit barrier transitioning the frame buffer color attachment to 
+	// VK_IMAGE_LAYOUT_PRESENT_SRC_KHR for presenting it to the windowing system
+	err = vkEndCommandBuffer(in_commandBuffer);
+	ERROR_IF(err, "End command buffer for drawing to frame buffer" << std::to_string(in_bufferIdx) << ": " << vkTools::errorString(err));
+}
+
+
+// One draw per pipeline and range, keyed by pipeline, material, vertex buffer and the view depth of
+// the range's draw data, relative to the farthest one. Without draw data the ranges of a key keep
+// their order in the mesh.
+void VulkanCommandBufferFactory::BuildDrawList(const DrawCommandBufferDependencies& in_dependencyObjects,
+	std::vector<ListedDraw>& out_draws) const
+{
+	const VulkanMesh& mesh = *in_dependencyObjects.m_mesh;
+	std::vector<size_t> ranges;
+	if (in_dependencyObjects.m_meshletCuller || mesh.m_submeshes.empty())
+	{
+		ranges.push_back(0);
+	}
+	else
+	{
+		// Without per frame culling the level of detail can't change, so draw the full one
+		size_t firstSubmesh = mesh.m_lods.empty() ? 0 : mesh.m_lods[0].m_firstSubmesh;
+		size_t submeshCount = mesh.m_lods.empty() ? mesh.m_submeshes.size() : mesh.m_lods[0].m_submeshCount;
+		for (size_t s = firstSubmesh; s < firstSubmesh + submeshCount; ++s)
+			ranges.push_back(s);
+	}
+
+	// The depth prepass draws everything before the main pipeline, from the position stream when there is one
+	std::vector<ListedDraw> draws;
+	const VulkanPushConstants::DrawData* drawData = in_dependencyObjects.m_drawData && !in_dependencyObjects.m_drawData->empty() ?
+		in_dependencyObjects.m_drawData->data() : nullptr;
+	size_t drawDataCount = drawData ? in_dependencyObjects.m_drawData->size() : 0;
+	float maxViewDepth = 0.0f;
+	for (size_t range : ranges)
+	{
+		if (drawData)
+			maxViewDepth = std::max(maxViewDepth, DepthPrepass::GetViewDepth(drawData[std::min(range, drawDataCount - 1)].m_modelViewProjection));
+	}
+	DrawList drawList;
+	for (uint32_t pipelineIdx = 0; pipelineIdx < 2; ++pipelineIdx)
+	{
+		bool prepass = pipelineIdx == 0;
+		if (prepass && !in_dependencyObjects.m_depthPrepassPipeline)
+			continue;
+		ListedDraw draw;
+		draw.m_pipeline = prepass ? *in_dependencyObjects.m_depthPrepassPipeline : *in_dependencyObjects.m_pipeline;
+		bool positionStream = prepass && mesh.m_positions.m_count > 0;
+		draw.m_vertexBuffer = positionStream ? mesh.m_positions.m_buffer : mesh.m_vertices.m_buffer;
+		for (size_t range : ranges)
+		{
+			draw.m_range = range;
+			const VulkanPushConstants::DrawData* rangeData = drawData ? &drawData[std::min(range, drawDataCount - 1)] : nullptr;
+			uint32_t material = rangeData ? rangeData->m_materialIdx : 0;
+			float depth = rangeData && maxViewDepth > 0.0f ? DepthPrepass::GetViewDepth(rangeData->m_modelViewProjection) / maxViewDepth : 0.0f;
+			drawList.Add(DrawList::MakeKey(pipelineIdx, material, positionStream ? 1 : 0, depth));
+			draws.push_back(draw);
+		}
+	}
 
-	for (int32_t i = 0; i < inout_buffers.size(); ++i)
+	drawList.Sort(m_jobSystem);
+	out_draws.clear();
+	for (uint32_t drawIdx : drawList.GetOrder())
+		out_draws.push_back(draws[drawIdx]);
+}
+
+
+// Begin the render pass, record the draws and end it. The draw data is pushed again, as the
+// compute work between passes may have disturbed the pushed constants.
+void VulkanCommandBufferFactory::RecordRenderPass(VkCommandBuffer in_commandBuffer, uint32_t in_bufferIdx,
+	const DrawCommandBufferDependencies& in_dependencyObjects, const VkRenderPassBeginInfo& in_renderPassBeginInfo,
+	BoundState& inout_state, int in_width, int in_height, VulkanMeshletCuller::Phase in_phase,
+	VulkanSecondaryCommandCache* in_secondaryCache)
+{
+	if (in_secondaryCache)
 	{
-		// Set target frame buffer
-		renderPassBeginInfo.framebuffer = in_targetFrameBuffers[i];
-		// Begin new command buffer for the target frame buffer
-		err = vkBeginCommandBuffer(inout_buffers[i], &cmdBufInfo);
-		ERROR_IF(err, "Begin command buffer for drawing to frame buffer" << std::to_string(i) << ": " << vkTools::errorString(err));
-
-		vkCmdBeginRenderPass(inout_buffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-		// Update dynamic viewport state
-		VkViewport viewport = {};
-		viewport.width = static_cast<float>(in_width);
-		viewport.height = static_cast<float>(in_height);
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-		vkCmdSetViewport(inout_buffers[i], 0, 1, &viewport);
-
-		// Update dynamic scissor state
-		VkRect2D scissor = {};
-		scissor.extent.width = in_width;
-		scissor.extent.height = in_height;
-		scissor.offset.x = 0;
-		scissor.offset.y = 0;
-		vkCmdSetScissor(inout_buffers[i], 0, 1, &scissor);
-
-		// Bind descriptor sets describing shader binding points
-		vkCmdBindDescriptorSets(inout_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, 
-			*in_dependencyObjects.m_pipelineLayout, 
-			0, static_cast<uint32_t>(in_dependencyObjects.m_descriptorSets->size()), in_dependencyObjects.m_descriptorSets->data(), 0, nullptr);
-
-		// Bind the rendering pipeline (including the shaders)
-		vkCmdBindPipeline(inout_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, *in_dependencyObjects.m_pipeline);
-
-		// Draw mesh!
-		// -----------------------------------------------------------
-		VulkanMesh& mesh = *in_dependencyObjects.m_mesh;
-		// Bind triangle vertices
-		VkDeviceSize offsets[1] = { 0 };
-		const uint32_t bindingCount = 1; // how many vertex buffer bindings to update
-		vkCmdBindVertexBuffers(inout_buffers[i], in_dependencyObjects.m_vertexBufferBindId,
-			bindingCount, &mesh.m_vertices.m_buffer, offsets);
-
-
-		// Bind triangle indices
-		vkCmdBindIndexBuffer(inout_buffers[i], mesh.m_indices.m_buffer, 0, VK_INDEX_TYPE_UINT32);
-
-		// Draw indexed triangle
-		vkCmdDrawIndexed(inout_buffers[i], mesh.m_indices.m_count, 
+		// A secondary command buffer starts with nothing bound, so it keeps its own state
+		VulkanSecondaryCommandCache::Inputs inputs = MakeSecondaryInputs(in_bufferIdx, in_dependencyObjects, in_width, in_height, in_phase);
+		VkCommandBuffer draws = in_secondaryCache->Get(in_phase, in_bufferIdx, in_renderPassBeginInfo.renderPass, 0,
+			in_renderPassBeginInfo.framebuffer, inputs, [&](VkCommandBuffer in_secondary)
+		{
+			std::vector<ListedDraw> listedDraws;
+			BuildDrawList(in_dependencyObjects, listedDraws);
+			BoundState secondaryState;
+			RecordPassContents(in_secondary, in_bufferIdx, in_dependencyObjects, listedDraws, secondaryState, in_width, in_height, in_phase);
+		});
+		vkCmdBeginRenderPass(in_commandBuffer, &in_renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		vkCmdExecuteCommands(in_commandBuffer, 1, &draws);
+		vkCmdEndRenderPass(in_commandBuffer);
+		return;
+	}
+
+	std::vector<ListedDraw> listedDraws;
+	BuildDrawList(in_dependencyObjects, listedDraws);
+	vkCmdBeginRenderPass(in_commandBuffer, &in_renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	RecordPassContents(in_commandBuffer, in_bufferIdx, in_dependencyObjects, listedDraws, inout_state, in_width, in_height, in_phase);
+	vkCmdEndRenderPass(in_commandBuffer);
+}
+
+
+void VulkanCommandBufferFactory::RecordPassContents(VkCommandBuffer in_commandBuffer, uint32_t in_bufferIdx,
+	const DrawCommandBufferDependencies& in_dependencyObjects, const std::vector<ListedDraw>& in_draws,
+	BoundState& inout_state, int in_width, int in_height, VulkanMeshletCuller::Phase in_phase)
+{
+	// Update dynamic viewport state
+	VkViewport viewport = {};
+	viewport.width = static_cast<float>(in_width);
+	viewport.height = static_cast<float>(in_height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(in_commandBuffer, 0, 1, &viewport);
+
+	// Update dynamic scissor state
+	VkRect2D scissor = {};
+	scissor.extent.width = in_width;
+	scissor.extent.height = in_height;
+	scissor.offset.x = 0;
+	scissor.offset.y = 0;
+	vkCmdSetScissor(in_commandBuffer, 0, 1, &scissor);
+
+	// Bind descriptor sets describing shader binding points
+	BindDescriptorSets(in_commandBuffer, inout_state, in_bufferIdx, in_dependencyObjects);
+
+	// Draw mesh!
+	// -----------------------------------------------------------
+	VulkanMesh& mesh = *in_dependencyObjects.m_mesh;
+	// Bind the instance matrices of this frame buffer
+	if (in_dependencyObjects.m_instanceBuffer)
+	{
+		if (!inout_state.m_instanceBuffer)
+		{
+			in_dependencyObjects.m_instanceBuffer->Bind(in_commandBuffer, in_bufferIdx, in_dependencyObjects.m_instanceBufferBindId);
+			inout_state.m_instanceBuffer = true;
+			m_bindStats.m_vertexBufferBinds++;
+		}
+		else
+		{
+			m_bindStats.m_vertexBufferBindsSkipped++;
+		}
+	}
+
+	// Bind triangle indices
+	BindIndexBuffer(in_commandBuffer, inout_state, mesh.m_indices.m_buffer, mesh.m_indices.m_type);
+
+	// Draw indexed triangles, binding the pipeline (including the shaders) and vertices as they change.
+	// The pipeline layout is shared so the pushed data stays valid across pipelines.
+	const VulkanPushConstants::DrawData* lastPushed = nullptr;
+	bool timedPrepass = !in_dependencyObjects.m_gpuTimer || in_phase != VulkanMeshletCuller::PHASE_EARLY;
+	for (const ListedDraw& draw : in_draws)
+	{
+		// The prepass draws come first, without a prepass it takes no time
+		if (!timedPrepass && draw.m_pipeline == *in_dependencyObjects.m_pipeline)
+		{
+			in_dependencyObjects.m_gpuTimer->RecordTimestamp(in_commandBuffer, in_bufferIdx, VulkanGpuTimer::TIMESTAMP_PREPASS_END);
+			timedPrepass = true;
+		}
+		BindPipeline(in_commandBuffer, inout_state, draw.m_pipeline);
+		BindVertexBuffer(in_commandBuffer, inout_state, in_dependencyObjects.m_vertexBufferBindId, draw.m_vertexBuffer);
+		RecordRangeDraws(in_commandBuffer, in_bufferIdx, in_dependencyObjects, draw.m_range, lastPushed, in_phase);
+	}
+	// -----------------------------------------------------------
+}
+
+
+// Draw calls for the mesh, its meshlets or a submesh, with whatever pipeline is bound
+void VulkanCommandBufferFactory::RecordRangeDraws(VkCommandBuffer in_commandBuffer, uint32_t in_bufferIdx,
+	const DrawCommandBufferDependencies& in_dependencyObjects, size_t in_range,
+	const VulkanPushConstants::DrawData*& inout_lastPushed, VulkanMeshletCuller::Phase in_phase)
+{
+	const VulkanMesh& mesh = *in_dependencyObjects.m_mesh;
+	PushDrawData(in_commandBuffer, *in_dependencyObjects.m_pipelineLayout, in_dependencyObjects.m_drawData, in_range, inout_lastPushed);
+	if (in_dependencyObjects.m_meshletCuller)
+	{
+		// Only the meshlets that survived culling, read from this frame buffer's indirect buffer
+		in_dependencyObjects.m_meshletCuller->RecordDraws(in_commandBuffer, in_bufferIdx, in_phase);
+	}
+	else if (in_dependencyObjects.m_instanceBuffer)
+	{
+		// The visible instances, their count is read from this frame buffer's indirect buffer
+		in_dependencyObjects.m_instanceBuffer->RecordDraw(in_commandBuffer, in_bufferIdx, in_range);
+	}
+	else if (mesh.m_submeshes.empty())
+	{
+		vkCmdDrawIndexed(in_commandBuffer, mesh.m_indices.m_count, 
 			1, // Instance count
 			0, // Index offset
 			0, // Vertex offset (added to value from index buffer)
-			1); // Not sure about this one.. "Specifies the starting value of the internally generated instance count."
-		// -----------------------------------------------------------
+			0); // First instance
+	}
+	else
+	{
+		const VulkanMesh::Submesh& submesh = mesh.m_submeshes[in_range];
+		vkCmdDrawIndexed(in_commandBuffer, submesh.m_indexCount, 1, submesh.m_firstIndex, submesh.m_vertexOffset, 0);
+	}
+}
 
-		vkCmdEndRenderPass(inout_buffers[i]);
 
-		// Ending the render pass will add an implicit barrier transitioning the frame buffer color attachment to 
-		// VK_IMAGE_LAYOUT_PRESENT_SRC_KHR for presenting it to the windowing system
-		err = vkEndCommandBuffer(inout_buffers[i]);
-		ERROR_IF(err, "End command buffer for drawing to frame buffer" << std::to_string(i) << ": " << vkTools::errorString(err));
+void VulkanCommandBufferFactory::BindPipeline(VkCommandBuffer in_commandBuffer, BoundState& inout_state, VkPipeline in_pipeline)
+{
+	if (inout_state.m_pipeline == in_pipeline)
+	{
+		m_bindStats.m_pipelineBindsSkipped++;
+		return;
+	}
+	vkCmdBindPipeline(in_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, in_pipeline);
+	inout_state.m_pipeline = in_pipeline;
+	m_bindStats.m_pipelineBinds++;
+}
+
+
+void VulkanCommandBufferFactory::BindVertexBuffer(VkCommandBuffer in_commandBuffer, BoundState& inout_state, uint32_t in_bindId, VkBuffer in_buffer)
+{
+	if (inout_state.m_vertexBuffer == in_buffer)
+	{
+		m_bindStats.m_vertexBufferBindsSkipped++;
+		return;
+	}
+	VkDeviceSize offsets[1] = { 0 };
+	vkCmdBindVertexBuffers(in_commandBuffer, in_bindId, 1, &in_buffer, offsets);
+	inout_state.m_vertexBuffer = in_buffer;
+	m_bindStats.m_vertexBufferBinds++;
+}
+
+
+void VulkanCommandBufferFactory::BindIndexBuffer(VkCommandBuffer in_commandBuffer, BoundState& inout_state, VkBuffer in_buffer, VkIndexType in_type)
+{
+	if (inout_state.m_indexBuffer == in_buffer)
+	{
+		m_bindStats.m_indexBufferBindsSkipped++;
+		return;
+	}
+	vkCmdBindIndexBuffer(in_commandBuffer, in_buffer, 0, in_type);
+	inout_state.m_indexBuffer = in_buffer;
+	m_bindStats.m_indexBufferBinds++;
+}
+
+
+// The sets are the same for every draw of a command buffer, bound once
+void VulkanCommandBufferFactory::BindDescriptorSets(VkCommandBuffer in_commandBuffer, BoundState& inout_state, uint32_t in_bufferIdx,
+	const DrawCommandBufferDependencies& in_dependencyObjects)
+{
+	uint32_t bindCount = in_dependencyObjects.m_perBufferDescriptorSets ? 2 : 1;
+	if (inout_state.m_descriptorSets)
+	{
+		m_bindStats.m_descriptorSetBindsSkipped += bindCount;
+		return;
+	}
+	vkCmdBindDescriptorSets(in_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 
+		*in_dependencyObjects.m_pipelineLayout, 
+		0, static_cast<uint32_t>(in_dependencyObjects.m_descriptorSets->size()), in_dependencyObjects.m_descriptorSets->data(), 0, nullptr);
+	if (in_dependencyObjects.m_perBufferDescriptorSets)
+	{
+		vkCmdBindDescriptorSets(in_commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+			*in_dependencyObjects.m_pipelineLayout,
+			static_cast<uint32_t>(in_dependencyObjects.m_descriptorSets->size()), 1, &(*in_dependencyObjects.m_perBufferDescriptorSets)[in_bufferIdx], 0, nullptr);
 	}
+	inout_state.m_descriptorSets = true;
+	m_bindStats.m_descriptorSetBinds += bindCount;
 }
 
 
@@ -5,8 +5,15 @@
 #include <memory>
 #include "VulkanMesh.h"
 #include "VkObj.h"
+#include "VulkanPushConstants.h"
+#include "VulkanMeshletCuller.h"
 
 class VulkanSwapChain;
+class VulkanInstanceBuffer;
+class VulkanHiZPyramid;
+class VulkanSecondaryCommandCache;
+class VulkanGpuTimer;
+class JobSystem;
 struct VulkanDepthStencil;
 
 class VulkanCommandBufferFactory
@@ -17,42 +24,143 @@ public:
 	{
 	public:
 		DrawCommandBufferDependencies(const VkPipelineLayout* in_pipelineLayout, const VkPipeline* in_pipeline, std::vector<VkDescriptorSet>* in_descriptorSets,
-			int in_vertexBufferBindId, VulkanMesh* in_mesh, VulkanSwapChain* in_swapChain);
+			int in_vertexBufferBindId, VulkanMesh* in_mesh, VulkanSwapChain* in_swapChain,
+			const VulkanMeshletCuller* in_meshletCuller = nullptr,
+			const VulkanInstanceBuffer* in_instanceBuffer = nullptr, int in_instanceBufferBindId = 1,
+			const std::vector<VulkanPushConstants::DrawData>* in_drawData = nullptr,
+			const std::vector<VkDescriptorSet>* in_perBufferDescriptorSets = nullptr,
+			const VkPipeline* in_depthPrepassPipeline = nullptr,
+			const VulkanHiZPyramid* in_hiZPyramid = nullptr, const VkRenderPass* in_lateRenderPass = nullptr,
+			const VulkanGpuTimer* in_gpuTimer = nullptr);
 
 		// What pipeline layout and pipeline
 		const VkPipelineLayout*              m_pipelineLayout;
 		const VkPipeline*                    m_pipeline;
+		// Draws the mesh once with this first, from VulkanMesh::m_positions when it has them (see DepthPrepass)
+		const VkPipeline*                    m_depthPrepassPipeline;
 		// Descriptor sets
 		std::vector<VkDescriptorSet>*  m_descriptorSets;
+		// One set per command buffer, bound after m_descriptorSets (e.g. VulkanBindlessTable::GetSets())
+		const std::vector<VkDescriptorSet>* m_perBufferDescriptorSets;
 
 		// Mesh to draw
 		int m_vertexBufferBindId;
 		VulkanMesh* m_mesh;
+		// Draws the visible meshlets of the mesh instead of its submeshes when set
+		const VulkanMeshletCuller* m_meshletCuller;
+		// With both, and a meshlet culler that occlusion culls, the render pass given to ConstructDrawCommandBuffer
+		// is the early one. The pyramid is built after it and the late pass draws what the late cull found.
+		const VulkanHiZPyramid* m_hiZPyramid;
+		const VkRenderPass*     m_lateRenderPass;
+		// Per instance matrices, without it a single instance is drawn
+		const VulkanInstanceBuffer* m_instanceBuffer;
+		int m_instanceBufferBindId;
+		// Pushed before each draw, one per submesh (or one for the whole mesh and its meshlets).
+		// The pipeline layout needs VulkanPushConstants::GetRange().
+		const std::vector<VulkanPushConstants::DrawData>* m_drawData;
+		// Times the prepass and main draws of each frame when set
+		const VulkanGpuTimer* m_gpuTimer;
 
 		// Swap chain
 		VulkanSwapChain* m_swapChain;
 	};
 
 
+	// Binds recorded, and skipped as the state was already bound, since the last ConstructDrawCommandBuffer
+	struct BindStats
+	{
+		uint32_t m_pipelineBinds;
+		uint32_t m_pipelineBindsSkipped;
+		uint32_t m_descriptorSetBinds;
+		uint32_t m_descriptorSetBindsSkipped;
+		uint32_t m_vertexBufferBinds;
+		uint32_t m_vertexBufferBindsSkipped;
+		uint32_t m_indexBufferBinds;
+		uint32_t m_indexBufferBindsSkipped;
+	};
+
+
 	VulkanCommandBufferFactory(VkDevice in_device); 
 
+	// Jobs for sorting the draw lists, optional
+	void SetJobSystem(JobSystem* in_jobSystem) { m_jobSystem = in_jobSystem; }
+
 	// Allocations
 	VkResult AllocateCommandBuffer(VkCommandPool in_commandPool, VkCommandBufferLevel in_level, VkCommandBuffer& out_buffer);
 	VkResult AllocateCommandBuffers(VkCommandPool in_commandPool, VkCommandBufferLevel in_level, std::vector<VkCommandBuffer>& out_buffers);
 
 
 
-	// Constructs (needs allocation first)
+	// Constructs (needs allocation first). The draws are recorded in DrawList order, binding only
+	// what differs from the previous draw.
 	void ConstructDrawCommandBuffer(std::vector<VkCommandBuffer>& inout_buffers, const std::vector<VkFramebuffer>& in_frameBuffers,
 		DrawCommandBufferDependencies& in_dependencyObjects,
 		const VkRenderPass& in_renderPass, const VkClearColorValue& in_clearColor,
-		int in_width, int in_height);
+		int in_width, int in_height, VulkanSecondaryCommandCache* in_secondaryCache = nullptr);
+
+	// Records the command buffer of one frame buffer. With in_secondaryCache the draws of each render pass are
+	// secondary command buffers from the cache, recorded again only when what they draw changes, so this is
+	// cheap enough to call every frame once the command buffer isn't in use.
+	void RecordDrawCommandBuffer(VkCommandBuffer in_commandBuffer, uint32_t in_bufferIdx, VkFramebuffer in_frameBuffer,
+		const DrawCommandBufferDependencies& in_dependencyObjects,
+		const VkRenderPass& in_renderPass, const VkClearColorValue& in_clearColor,
+		int in_width, int in_height, VulkanSecondaryCommandCache* in_secondaryCache = nullptr);
+
+	const BindStats& GetBindStats() const { return m_bindStats; }
 
 
 private:
+	// What a command buffer has bound so far
+	struct BoundState
+	{
+		BoundState();
+		VkPipeline m_pipeline;
+		VkBuffer   m_vertexBuffer;
+		VkBuffer   m_indexBuffer;
+		bool       m_descriptorSets;
+		bool       m_instanceBuffer;
+	};
+
+	// One draw of the mesh: a range (its meshlets, the whole mesh or a submesh) with a pipeline
+	struct ListedDraw
+	{
+		VkPipeline m_pipeline;
+		VkBuffer   m_vertexBuffer;
+		size_t     m_range;
+	};
+
 	VkCommandBufferAllocateInfo MakeInfoStruct(VkCommandPool in_commandPool, VkCommandBufferLevel in_level, int in_bufferCount = 1);
 
 	VkDevice m_device;
+	BindStats m_bindStats;
+	JobSystem* m_jobSystem;
+
+	// The draws of a render pass in sort key order (see DrawList)
+	void BuildDrawList(const DrawCommandBufferDependencies& in_dependencyObjects, std::vector<ListedDraw>& out_draws) const;
+
+	// The render pass with the draws recorded, in_phase picks the meshlets drawn when occlusion culling.
+	// The draws are executed from a secondary command buffer of in_secondaryCache when given, else recorded inline.
+	void RecordRenderPass(VkCommandBuffer in_commandBuffer, uint32_t in_bufferIdx,
+		const DrawCommandBufferDependencies& in_dependencyObjects, const VkRenderPassBeginInfo& in_renderPassBeginInfo,
+		BoundState& inout_state, int in_width, int in_height, VulkanMeshletCuller::Phase in_phase,
+		VulkanSecondaryCommandCache* in_secondaryCache);
+
+	// Viewport, scissor, binds and draws of in_draws inside a render pass
+	void RecordPassContents(VkCommandBuffer in_commandBuffer, uint32_t in_bufferIdx,
+		const DrawCommandBufferDependencies& in_dependencyObjects, const std::vector<ListedDraw>& in_draws,
+		BoundState& inout_state, int in_width, int in_height, VulkanMeshletCuller::Phase in_phase);
+
+	// Draw calls for one range of the mesh with the bound pipeline and buffers
+	void RecordRangeDraws(VkCommandBuffer in_commandBuffer, uint32_t in_bufferIdx,
+		const DrawCommandBufferDependencies& in_dependencyObjects, size_t in_range,
+		const VulkanPushConstants::DrawData*& inout_lastPushed, VulkanMeshletCuller::Phase in_phase);
+
+	// Bind unless already bound, counted in m_bindStats
+	void BindPipeline(VkCommandBuffer in_commandBuffer, BoundState& inout_state, VkPipeline in_pipeline);
+	void BindVertexBuffer(VkCommandBuffer in_commandBuffer, BoundState& inout_state, uint32_t in_bindId, VkBuffer in_buffer);
+	void BindIndexBuffer(VkCommandBuffer in_commandBuffer, BoundState& inout_state, VkBuffer in_buffer, VkIndexType in_type);
+	void BindDescriptorSets(VkCommandBuffer in_commandBuffer, BoundState& inout_state, uint32_t in_bufferIdx,
+		const DrawCommandBufferDependencies& in_dependencyObjects);
 
 	// Image layout helper
 	void AddImageLayoutChangeToCommandBuffer(VkCommandBuffer inout_cmdbuffer, VkImage in_image, VkImageAspectFlags in_aspectMask, VkImageLayout in_oldImageLayout, VkImageLayout in_newImageLayout);
@@ -0,0 +1,76 @@
+#include "VulkanDeletionQueue.h"
+#include <vector>
+#include "DebugPrint.h"
+
+VulkanDeletionQueue::VulkanDeletionQueue()
+	: m_entries()
+	, m_currentFrameIdx(0)
+{
+}
+
+VulkanDeletionQueue::~VulkanDeletionQueue()
+{
+	if (!m_entries.empty())
+	{
+		LOG("Deletion queue: Destroying " << m_entries.size() << " pending objects on shutdown");
+	}
+	Flush();
+}
+
+void VulkanDeletionQueue::BeginFrame(uint64_t in_frameIdx)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_currentFrameIdx = in_frameIdx;
+}
+
+uint64_t VulkanDeletionQueue::GetCurrentFrame() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_currentFrameIdx;
+}
+
+void VulkanDeletionQueue::Push(std::function<void()> in_deleter)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries.push_back({ m_currentFrameIdx, in_deleter });
+}
+
+void VulkanDeletionQueue::Collect(uint64_t in_completedFrameIdx)
+{
+	// Move the finished entries out before calling the deleters, so a deleter
+	// is free to push new entries without deadlocking on the mutex
+	std::vector<std::function<void()>> finished;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		while (!m_entries.empty() && m_entries.front().m_frameIdx <= in_completedFrameIdx)
+		{
+			finished.push_back(m_entries.front().m_deleter);
+			m_entries.pop_front();
+		}
+	}
+
+	for (auto& deleter : finished)
+	{
+		deleter();
+	}
+}
+
+void VulkanDeletionQueue::Flush()
+{
+	std::deque<Entry> all;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		all.swap(m_entries);
+	}
+
+	for (auto& entry : all)
+	{
+		entry.m_deleter();
+	}
+}
+
+size_t VulkanDeletionQueue::GetPendingCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_entries.size();
+}
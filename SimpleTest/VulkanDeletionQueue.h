@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+/*!
+* \class VulkanDeletionQueue
+*
+* \brief
+*
+* Deferred destruction of Vulkan objects.
+* Objects that are released or replaced while the GPU might still be using them
+* are pushed here together with the index of the frame being recorded.
+* They are destroyed first when the fence of that frame (or a later one) has
+* signaled, so replacing a mesh, pipeline or buffer at runtime doesn't need a vkDeviceWaitIdle.
+*/
+
+class VulkanDeletionQueue
+{
+public:
+	VulkanDeletionQueue();
+	~VulkanDeletionQueue();
+
+	// Set the index of the frame currently being recorded, new entries are tagged with this
+	void     BeginFrame(uint64_t in_frameIdx);
+	uint64_t GetCurrentFrame() const;
+
+	// Queue a destroy call for the current frame
+	void     Push(std::function<void()> in_deleter);
+
+	// Run the destroy calls of all entries tagged with in_completedFrameIdx or earlier
+	void     Collect(uint64_t in_completedFrameIdx);
+
+	// Destroy everything right away, only safe when the device is idle
+	void     Flush();
+
+	size_t   GetPendingCount() const;
+
+private:
+	struct Entry
+	{
+		uint64_t              m_frameIdx;
+		std::function<void()> m_deleter;
+	};
+
+	// Entries are pushed in frame order, so the oldest are always at the front
+	std::deque<Entry>  m_entries;
+	uint64_t           m_currentFrameIdx;
+	mutable std::mutex m_mutex;
+};
@@ -8,11 +8,25 @@ VulkanDepthStencil::VulkanDepthStencil(const VkObj<VkDevice>& in_device)
 	: m_image(in_device, vkDestroyImage)
 	, m_gpuMem(in_device, vkFreeMemory)
 	, m_imageView(in_device, vkDestroyImageView)
+	, m_sampledView(in_device, vkDestroyImageView)
 {
 #ifdef _DEBUG
 	m_image.SetDbgName(std::string("DepthStencilImage"));
 	m_gpuMem.SetDbgName(std::string("DepthStencilMemory"));
 	m_imageView.SetDbgName(std::string("DepthStencilImageView"));
+	m_sampledView.SetDbgName(std::string("DepthStencilSampledView"));
+#endif // _DEBUG
+}
+
+VulkanMultisampleColor::VulkanMultisampleColor(const VkObj<VkDevice>& in_device)
+	: m_image(in_device, vkDestroyImage)
+	, m_gpuMem(in_device, vkFreeMemory)
+	, m_imageView(in_device, vkDestroyImageView)
+{
+#ifdef _DEBUG
+	m_image.SetDbgName(std::string("MultisampleColorImage"));
+	m_gpuMem.SetDbgName(std::string("MultisampleColorMemory"));
+	m_imageView.SetDbgName(std::string("MultisampleColorImageView"));
 #endif // _DEBUG
 }
 
@@ -24,11 +38,48 @@ VulkanDepthStencilFactory::VulkanDepthStencilFactory(VkDevice in_device, const s
 }
 
 void VulkanDepthStencilFactory::CreateDepthStencil(VkFormat in_format, uint32_t in_width, uint32_t in_height,
-	VulkanDepthStencil& out_depthStencil)
+	VulkanDepthStencil& out_depthStencil, VkSampleCountFlagBits in_samples/* = VK_SAMPLE_COUNT_1_BIT*/, bool in_sampled/* = false*/)
+{
+	// Transient attachments can't be copied from, or sampled
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	if (in_sampled)
+		usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+	if (in_samples == VK_SAMPLE_COUNT_1_BIT)
+		usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	else if (!in_sampled)
+		usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+	CreateAttachment(in_format, in_width, in_height, in_samples, usage, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
+		out_depthStencil.m_image, out_depthStencil.m_gpuMem, out_depthStencil.m_imageView);
+	if (!in_sampled || m_memory == nullptr) return;
+
+	// A sampled view can only have one aspect
+	VkImageViewCreateInfo viewCreationInfo = {};
+	viewCreationInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewCreationInfo.image = out_depthStencil.m_image;
+	viewCreationInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewCreationInfo.format = in_format;
+	viewCreationInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	viewCreationInfo.subresourceRange.levelCount = 1;
+	viewCreationInfo.subresourceRange.layerCount = 1;
+	VkResult err = vkCreateImageView(m_device, &viewCreationInfo, nullptr, out_depthStencil.m_sampledView.Replace());
+	ERROR_IF(err, "Create sampled depth view: " << vkTools::errorString(err));
+}
+
+void VulkanDepthStencilFactory::CreateMultisampleColor(VkFormat in_format, uint32_t in_width, uint32_t in_height, VkSampleCountFlagBits in_samples,
+	VulkanMultisampleColor& out_color, bool in_stored/* = false*/)
+{
+	CreateAttachment(in_format, in_width, in_height, in_samples,
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (in_stored ? 0 : VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT), VK_IMAGE_ASPECT_COLOR_BIT,
+		out_color.m_image, out_color.m_gpuMem, out_color.m_imageView);
+}
+
+void VulkanDepthStencilFactory::CreateAttachment(VkFormat in_format, uint32_t in_width, uint32_t in_height, VkSampleCountFlagBits in_samples,
+	VkImageUsageFlags in_usage, VkImageAspectFlags in_aspectMask,
+	VkObj<VkImage>& out_image, VkObj<VkDeviceMemory>& out_gpuMem, VkObj<VkImageView>& out_imageView)
 {
 	if (m_memory == nullptr) return;
 
-	// Creation information for the depth stencil image
+	// Creation information for the attachment image
 	VkImageCreateInfo imageCreationInfo = {};
 	imageCreationInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	imageCreationInfo.pNext = nullptr;
@@ -37,9 +88,9 @@ void VulkanDepthStencilFactory::CreateDepthStencil(VkFormat in_format, uint32_t
 	imageCreationInfo.extent = { in_width, in_height, 1 };
 	imageCreationInfo.mipLevels = 1;
 	imageCreationInfo.arrayLayers = 1;
-	imageCreationInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCreationInfo.samples = in_samples;
 	imageCreationInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-	imageCreationInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	imageCreationInfo.usage = in_usage;
 	imageCreationInfo.flags = 0;
 	
 	VkMemoryAllocateInfo memoryAllocInfo = {};
@@ -48,41 +99,50 @@ void VulkanDepthStencilFactory::CreateDepthStencil(VkFormat in_format, uint32_t
 	memoryAllocInfo.allocationSize = 0;
 	memoryAllocInfo.memoryTypeIndex = 0;
 
-	VkImageViewCreateInfo depthStencilViewCreationInfo = {};
-	depthStencilViewCreationInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	depthStencilViewCreationInfo.pNext = nullptr;
-	depthStencilViewCreationInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	depthStencilViewCreationInfo.format = in_format;
-	depthStencilViewCreationInfo.flags = 0;
-	depthStencilViewCreationInfo.subresourceRange = {};
-	depthStencilViewCreationInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
-	depthStencilViewCreationInfo.subresourceRange.baseMipLevel = 0;
-	depthStencilViewCreationInfo.subresourceRange.levelCount = 1;
-	depthStencilViewCreationInfo.subresourceRange.baseArrayLayer = 0;
-	depthStencilViewCreationInfo.subresourceRange.layerCount = 1;
+	VkImageViewCreateInfo viewCreationInfo = {};
+	viewCreationInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewCreationInfo.pNext = nullptr;
+	viewCreationInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewCreationInfo.format = in_format;
+	viewCreationInfo.flags = 0;
+	viewCreationInfo.subresourceRange = {};
+	viewCreationInfo.subresourceRange.aspectMask = in_aspectMask;
+	viewCreationInfo.subresourceRange.baseMipLevel = 0;
+	viewCreationInfo.subresourceRange.levelCount = 1;
+	viewCreationInfo.subresourceRange.baseArrayLayer = 0;
+	viewCreationInfo.subresourceRange.layerCount = 1;
 
 
 	VkMemoryRequirements memoryRequirements;
 	VkResult err;
 
 	// Create the image
-	err = vkCreateImage(m_device, &imageCreationInfo, nullptr, out_depthStencil.m_image.Replace());
-	ERROR_IF(err, "Create depth stencil image: " << vkTools::errorString(err));
+	err = vkCreateImage(m_device, &imageCreationInfo, nullptr, out_image.Replace());
+	ERROR_IF(err, "Create attachment image: " << vkTools::errorString(err));
 
 	// Allocate memory for the image on the gpu
-	vkGetImageMemoryRequirements(m_device, out_depthStencil.m_image, &memoryRequirements);
+	vkGetImageMemoryRequirements(m_device, out_image, &memoryRequirements);
 	memoryAllocInfo.allocationSize = memoryRequirements.size;
-	m_memory->GetMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryAllocInfo.memoryTypeIndex);
-	err = vkAllocateMemory(m_device, &memoryAllocInfo, nullptr, out_depthStencil.m_gpuMem.Replace());
-	ERROR_IF(err, "Allocate depth stencil memory on GPU: " << vkTools::errorString(err));
+	if (in_usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+	{
+		bool lazilyAllocated = false;
+		m_memory->GetTransientMemoryType(memoryRequirements.memoryTypeBits, &memoryAllocInfo.memoryTypeIndex, &lazilyAllocated);
+		LOG("Transient attachment, " << in_samples << " samples, " << (lazilyAllocated ? "lazily allocated" : "device local") <<
+			" (" << memoryRequirements.size / 1024 << " KiB)");
+	}
+	else
+	{
+		m_memory->GetMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memoryAllocInfo.memoryTypeIndex);
+	}
+	err = vkAllocateMemory(m_device, &memoryAllocInfo, nullptr, out_gpuMem.Replace());
+	ERROR_IF(err, "Allocate attachment memory on GPU: " << vkTools::errorString(err));
 
 	// Bind the image to the allocated memory
-	err = vkBindImageMemory(m_device, out_depthStencil.m_image, out_depthStencil.m_gpuMem, 0);
-	ERROR_IF(err, "Bind depth stencil image to GPU memory: " << vkTools::errorString(err));
+	err = vkBindImageMemory(m_device, out_image, out_gpuMem, 0);
+	ERROR_IF(err, "Bind attachment image to GPU memory: " << vkTools::errorString(err));
 
 	// Set up our view to the image
-	depthStencilViewCreationInfo.image = out_depthStencil.m_image;
-	err = vkCreateImageView(m_device, &depthStencilViewCreationInfo, nullptr, out_depthStencil.m_imageView.Replace());
-	ERROR_IF(err, "Create depth stencil image view: " << vkTools::errorString(err));
+	viewCreationInfo.image = out_image;
+	err = vkCreateImageView(m_device, &viewCreationInfo, nullptr, out_imageView.Replace());
+	ERROR_IF(err, "Create attachment image view: " << vkTools::errorString(err));
 }
-
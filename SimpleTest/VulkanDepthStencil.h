@@ -12,6 +12,17 @@ struct VulkanDepthStencil
 	VkObj<VkImage> m_image;
 	VkObj<VkDeviceMemory> m_gpuMem;
 	VkObj<VkImageView> m_imageView;
+	// Depth aspect only, for reading the depth in shaders. Only created when sampled.
+	VkObj<VkImageView> m_sampledView;
+};
+
+// Multisampled color target, resolved into the swap chain image at the end of the subpass
+struct VulkanMultisampleColor
+{
+	VulkanMultisampleColor(const VkObj<VkDevice>& in_device);
+	VkObj<VkImage> m_image;
+	VkObj<VkDeviceMemory> m_gpuMem;
+	VkObj<VkImageView> m_imageView;
 };
 
 class VulkanDepthStencilFactory
@@ -19,10 +30,22 @@ class VulkanDepthStencilFactory
 public:
 	VulkanDepthStencilFactory(VkDevice in_device, std::shared_ptr<VulkanMemoryHelper> in_memory);
 
+	// Multisampled depth is only used within the render pass, so it is transient,
+	// unless in_sampled when it is read by shaders after the pass (see VulkanHiZPyramid)
 	void CreateDepthStencil(VkFormat in_format, uint32_t in_width, uint32_t in_height,
-		VulkanDepthStencil& out_depthStencil);
+		VulkanDepthStencil& out_depthStencil, VkSampleCountFlagBits in_samples = VK_SAMPLE_COUNT_1_BIT, bool in_sampled = false);
+
+	// Transient, in lazily allocated memory where available. On tilers the samples then
+	// only ever live in tile memory, only the resolved image is written out. Unless
+	// in_stored, when the samples are kept between render passes.
+	void CreateMultisampleColor(VkFormat in_format, uint32_t in_width, uint32_t in_height, VkSampleCountFlagBits in_samples,
+		VulkanMultisampleColor& out_color, bool in_stored = false);
 
 private:
+	void CreateAttachment(VkFormat in_format, uint32_t in_width, uint32_t in_height, VkSampleCountFlagBits in_samples,
+		VkImageUsageFlags in_usage, VkImageAspectFlags in_aspectMask,
+		VkObj<VkImage>& out_image, VkObj<VkDeviceMemory>& out_gpuMem, VkObj<VkImageView>& out_imageView);
+
 	VkDevice m_device;
 	std::shared_ptr<VulkanMemoryHelper> m_memory;
-};
\ No newline at end of file
+};
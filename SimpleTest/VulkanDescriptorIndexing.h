@@ -0,0 +1,86 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+
+// The parts of VK_EXT_descriptor_indexing and the extensions it depends on that VulkanBindlessTable uses,
+// for Vulkan headers older than them (the bundled one is version 37). Values are the ones from the registry.
+
+#ifndef VK_KHR_get_physical_device_properties2
+#define VK_KHR_get_physical_device_properties2 1
+#define VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME "VK_KHR_get_physical_device_properties2"
+
+const VkStructureType VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR = static_cast<VkStructureType>(1000059000);
+
+typedef struct VkPhysicalDeviceFeatures2KHR {
+	VkStructureType             sType;
+	void*                       pNext;
+	VkPhysicalDeviceFeatures    features;
+} VkPhysicalDeviceFeatures2KHR;
+
+typedef void (VKAPI_PTR *PFN_vkGetPhysicalDeviceFeatures2KHR)(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures2KHR* pFeatures);
+#endif
+
+#ifndef VK_KHR_maintenance3
+#define VK_KHR_maintenance3 1
+#define VK_KHR_MAINTENANCE3_EXTENSION_NAME "VK_KHR_maintenance3"
+#endif
+
+#ifndef VK_EXT_descriptor_indexing
+#define VK_EXT_descriptor_indexing 1
+#define VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME "VK_EXT_descriptor_indexing"
+
+const VkStructureType VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT = static_cast<VkStructureType>(1000161000);
+const VkStructureType VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT = static_cast<VkStructureType>(1000161001);
+const VkStructureType VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT = static_cast<VkStructureType>(1000161003);
+
+const VkDescriptorPoolCreateFlags VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT = 0x00000002;
+const VkDescriptorSetLayoutCreateFlags VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT = 0x00000002;
+
+typedef enum VkDescriptorBindingFlagBitsEXT {
+	VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT = 0x00000001,
+	VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT = 0x00000002,
+	VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT = 0x00000004,
+	VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT = 0x00000008,
+	VK_DESCRIPTOR_BINDING_FLAG_BITS_MAX_ENUM_EXT = 0x7FFFFFFF
+} VkDescriptorBindingFlagBitsEXT;
+typedef VkFlags VkDescriptorBindingFlagsEXT;
+
+typedef struct VkDescriptorSetLayoutBindingFlagsCreateInfoEXT {
+	VkStructureType                       sType;
+	const void*                           pNext;
+	uint32_t                              bindingCount;
+	const VkDescriptorBindingFlagsEXT*    pBindingFlags;
+} VkDescriptorSetLayoutBindingFlagsCreateInfoEXT;
+
+typedef struct VkPhysicalDeviceDescriptorIndexingFeaturesEXT {
+	VkStructureType    sType;
+	void*              pNext;
+	VkBool32           shaderInputAttachmentArrayDynamicIndexing;
+	VkBool32           shaderUniformTexelBufferArrayDynamicIndexing;
+	VkBool32           shaderStorageTexelBufferArrayDynamicIndexing;
+	VkBool32           shaderUniformBufferArrayNonUniformIndexing;
+	VkBool32           shaderSampledImageArrayNonUniformIndexing;
+	VkBool32           shaderStorageBufferArrayNonUniformIndexing;
+	VkBool32           shaderStorageImageArrayNonUniformIndexing;
+	VkBool32           shaderInputAttachmentArrayNonUniformIndexing;
+	VkBool32           shaderUniformTexelBufferArrayNonUniformIndexing;
+	VkBool32           shaderStorageTexelBufferArrayNonUniformIndexing;
+	VkBool32           descriptorBindingUniformBufferUpdateAfterBind;
+	VkBool32           descriptorBindingSampledImageUpdateAfterBind;
+	VkBool32           descriptorBindingStorageImageUpdateAfterBind;
+	VkBool32           descriptorBindingStorageBufferUpdateAfterBind;
+	VkBool32           descriptorBindingUniformTexelBufferUpdateAfterBind;
+	VkBool32           descriptorBindingStorageTexelBufferUpdateAfterBind;
+	VkBool32           descriptorBindingUpdateUnusedWhilePending;
+	VkBool32           descriptorBindingPartiallyBound;
+	VkBool32           descriptorBindingVariableDescriptorCount;
+	VkBool32           runtimeDescriptorArray;
+} VkPhysicalDeviceDescriptorIndexingFeaturesEXT;
+
+typedef struct VkDescriptorSetVariableDescriptorCountAllocateInfoEXT {
+	VkStructureType    sType;
+	const void*        pNext;
+	uint32_t           descriptorSetCount;
+	const uint32_t*    pDescriptorCounts;
+} VkDescriptorSetVariableDescriptorCountAllocateInfoEXT;
+#endif
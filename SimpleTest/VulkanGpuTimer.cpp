@@ -0,0 +1,80 @@
+#include "VulkanGpuTimer.h"
+#include "ErrorReporting.h"
+#include "vulkantools.h"
+
+#ifdef _DEBUG
+#define REGISTER_VKOBJ(x, d, func, dbg) x(d, func, std::string(dbg))
+#else
+#define REGISTER_VKOBJ(x, d, func, dbg) x(d, func)
+#endif // _DEBUG
+
+namespace
+{
+	// Bits of the timestamps written by the queues of in_queueFamilyIdx, 0 when they don't write any
+	uint32_t GetTimestampValidBits(VkPhysicalDevice in_physicalDevice, uint32_t in_queueFamilyIdx)
+	{
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(in_physicalDevice, &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(in_physicalDevice, &queueFamilyCount, queueFamilies.data());
+		return in_queueFamilyIdx < queueFamilyCount ? queueFamilies[in_queueFamilyIdx].timestampValidBits : 0;
+	}
+}
+
+bool VulkanGpuTimer::IsSupported(VkPhysicalDevice in_physicalDevice, uint32_t in_queueFamilyIdx)
+{
+	return GetTimestampValidBits(in_physicalDevice, in_queueFamilyIdx) > 0;
+}
+
+VulkanGpuTimer::VulkanGpuTimer(const VkObj<VkDevice>& in_device, VkPhysicalDevice in_physicalDevice, uint32_t in_queueFamilyIdx,
+	uint32_t in_frameBufferCount)
+	: m_device(in_device)
+	, REGISTER_VKOBJ(m_queryPool, in_device, vkDestroyQueryPool, "GpuTimerQueryPool")
+	, m_msPerTick(0.0)
+	, m_validMask(0)
+	, m_submitted(in_frameBufferCount, false)
+{
+	uint32_t validBits = GetTimestampValidBits(in_physicalDevice, in_queueFamilyIdx);
+	ERROR_IF(validBits == 0, "GPU timer on a queue without timestamps");
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(in_physicalDevice, &properties);
+	m_msPerTick = static_cast<double>(properties.limits.timestampPeriod) / 1000000.0;
+	m_validMask = validBits >= 64 ? ~uint64_t(0) : (uint64_t(1) << validBits) - 1;
+
+	VkQueryPoolCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	createInfo.queryCount = in_frameBufferCount * TIMESTAMP_COUNT;
+	VkResult err = vkCreateQueryPool(m_device, &createInfo, nullptr, m_queryPool.Replace());
+	ERROR_IF(err, "Create timestamp query pool: " << vkTools::errorString(err));
+}
+
+void VulkanGpuTimer::RecordReset(VkCommandBuffer in_commandBuffer, uint32_t in_frameBufferIdx) const
+{
+	vkCmdResetQueryPool(in_commandBuffer, m_queryPool, in_frameBufferIdx * TIMESTAMP_COUNT, TIMESTAMP_COUNT);
+}
+
+void VulkanGpuTimer::RecordTimestamp(VkCommandBuffer in_commandBuffer, uint32_t in_frameBufferIdx, Timestamp in_timestamp) const
+{
+	vkCmdWriteTimestamp(in_commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, in_frameBufferIdx * TIMESTAMP_COUNT + in_timestamp);
+}
+
+bool VulkanGpuTimer::Read(uint32_t in_frameBufferIdx, Times& out_times)
+{
+	if (!m_submitted[in_frameBufferIdx])
+		return false;
+	m_submitted[in_frameBufferIdx] = false;
+
+	// The fence has been waited on, so they are all available
+	uint64_t ticks[TIMESTAMP_COUNT];
+	VkResult err = vkGetQueryPoolResults(m_device, m_queryPool, in_frameBufferIdx * TIMESTAMP_COUNT, TIMESTAMP_COUNT,
+		sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (err == VK_NOT_READY)
+		return false;
+	ERROR_IF(err, "Get timestamps: " << vkTools::errorString(err));
+
+	out_times.m_prepassMs = static_cast<double>((ticks[TIMESTAMP_PREPASS_END] - ticks[TIMESTAMP_BEGIN]) & m_validMask) * m_msPerTick;
+	out_times.m_mainMs = static_cast<double>((ticks[TIMESTAMP_END] - ticks[TIMESTAMP_PREPASS_END]) & m_validMask) * m_msPerTick;
+	return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include <vector>
+#include "VkObj.h"
+
+// Log the GPU time of the depth prepass and the main pass, build with and without USE_DEPTH_PREPASS to compare
+//#define USE_GPU_TIMER
+
+/*!
+* \class VulkanGpuTimer
+*
+* \brief
+*
+* Timestamp queries around the passes of the draw command buffers, a set per frame buffer.
+* The timestamps are reset and written by the command buffer itself, so they are measured
+* again every time it is submitted, recorded once or every frame.
+*
+* The results of a frame buffer are read after its fence has been waited on, the frame
+* they come from is done so nothing stalls.
+*/
+
+class VulkanGpuTimer
+{
+public:
+	// Where in the command buffer a timestamp is written
+	enum Timestamp
+	{
+		TIMESTAMP_BEGIN,       // before the first render pass, after the compute culling
+		TIMESTAMP_PREPASS_END, // before the first draw of the main pipeline in the early pass
+		TIMESTAMP_END,         // after the last render pass
+		TIMESTAMP_COUNT
+	};
+
+	// Milliseconds between the timestamps of one frame
+	struct Times
+	{
+		double m_prepassMs;
+		double m_mainMs; // including the late pass when occlusion culling
+	};
+
+	// False when the queues of in_queueFamilyIdx don't write timestamps
+	static bool IsSupported(VkPhysicalDevice in_physicalDevice, uint32_t in_queueFamilyIdx);
+
+	VulkanGpuTimer(const VkObj<VkDevice>& in_device, VkPhysicalDevice in_physicalDevice, uint32_t in_queueFamilyIdx,
+		uint32_t in_frameBufferCount);
+
+	// Outside of a render pass, before the timestamps of in_frameBufferIdx
+	void RecordReset(VkCommandBuffer in_commandBuffer, uint32_t in_frameBufferIdx) const;
+	// Written once the commands before it are done
+	void RecordTimestamp(VkCommandBuffer in_commandBuffer, uint32_t in_frameBufferIdx, Timestamp in_timestamp) const;
+
+	// Call after submitting the command buffer of in_frameBufferIdx
+	void Submitted(uint32_t in_frameBufferIdx) { m_submitted[in_frameBufferIdx] = true; }
+	// The times of the last submit of in_frameBufferIdx, after its fence has been waited on.
+	// Returns false when it hasn't been submitted since the last Read.
+	bool Read(uint32_t in_frameBufferIdx, Times& out_times);
+
+private:
+	const VkObj<VkDevice>& m_device;
+	VkObj<VkQueryPool>     m_queryPool;
+	double                 m_msPerTick;
+	uint64_t               m_validMask; // of the timestamp bits
+	std::vector<bool>      m_submitted;
+};
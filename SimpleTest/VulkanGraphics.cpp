@@ -3,6 +3,7 @@
 // Standard libs and overall helpers
 #include <string>
 #include <array>
+#include <cstring>
 #include <vector>
 #include "ErrorReporting.h"
 #include "vulkantools.h" // error string help
@@ -12,7 +13,9 @@
 #include "VulkanHelper.h"
 #include "VulkanSwapChain.h"
 #include "VulkanCommandBufferFactory.h"
+#include "VulkanSecondaryCommandCache.h"
 #include "VulkanMemoryHelper.h"
+#include "VulkanDeletionQueue.h"
 #include "VulkanRenderPassFactory.h"
 #include "VulkanBufferFactory.h"
 #include "VulkanShaderLoader.h"
@@ -21,6 +24,23 @@
 #include "Vertex.h"
 #include "VulkanVertexLayout.h"
 #include "VulkanMesh.h"
+#include "VulkanMeshletCuller.h"
+#include "LodSelection.h"
+#include "RenderSnapshot.h"
+#include "TransformHierarchy.h"
+#include "MatrixKernels.h"
+#include "FrustumCuller.h"
+#include "Frustum.h"
+#include "VulkanInstanceBuffer.h"
+#include "VulkanBindlessTable.h"
+#include "VulkanTextureFactory.h"
+#include "VulkanSamplerCache.h"
+#include "VulkanTexture.h"
+#include "VulkanTextureStreamer.h"
+#include "DepthPrepass.h"
+#include "VulkanHiZPyramid.h"
+#include "VulkanGpuTimer.h"
+#include "JobSystem.h"
 
 // Uniform buffers
 #include "VulkanUniformBufferPerFrame.h"
@@ -29,8 +49,21 @@
 #define ENABLE_VALIDATION true // set to true to enable debug layer (requires LunarG SDK)
 //#define USE_GLSL
 
+// Multisampling, 2, 4 or 8 (1 for none). Lowered to what the device supports for both color and depth.
+#define MSAA_SAMPLES 4
+
 // Binding IDs
 #define VERTEX_BUFFER_BIND_ID 0
+#define INSTANCE_BUFFER_BIND_ID 1
+
+// Frames the GPU times are averaged over before they are logged
+#define GPU_TIMED_FRAMES 256
+
+// Bindless table sizes, sampled images is an upper bound for the variable count array.
+// The samplers are the immutable common ones of the sampler cache, the count is only used without them.
+#define BINDLESS_MAX_SAMPLERS 64
+#define BINDLESS_MAX_STORAGE_BUFFERS 1024
+#define BINDLESS_MAX_SAMPLED_IMAGES 4096
 
 #ifdef _DEBUG
 #define REGISTER_VKOBJ(x, d, func, dbg) x(d, func, std::string(dbg))
@@ -47,29 +80,59 @@ namespace
 
 
 
-VulkanGraphics::VulkanGraphics(HWND in_hWnd, HINSTANCE in_hInstance, uint32_t in_width, uint32_t in_height)
+VulkanGraphics::VulkanGraphics(HWND in_hWnd, HINSTANCE in_hInstance, uint32_t in_width, uint32_t in_height,
+	const std::string& in_meshPath/* = ""*/, const std::string& in_texturePath/* = ""*/)
 	//////////////////////////////////////////////////////////////////////////
 	// VkObjects needs to be created with pointers to their destruction functions.
 	// Most also need a reference to the device wrapper for their destruction.
 	// Wrapped data assigned later upon initialization.
 	//////////////////////////////////////////////////////////////////////////
 	: m_vulkanInstance(vkDestroyInstance)
+	, m_multiDrawIndirect(false)
+	, m_bindless(false)
+#ifdef USE_DEPTH_PREPASS
+	, m_depthPrepass(true)
+#else
+	, m_depthPrepass(false)
+#endif
+#if defined(USE_OCCLUSION_CULLING) && defined(USE_GPU_MESHLET_CULLING)
+	, m_occlusionCulling(true)
+#else
+	, m_occlusionCulling(false)
+#endif
 	, m_device(vkDestroyDevice)
 	, REGISTER_VKOBJ(m_surface, m_vulkanInstance, vkDestroySurfaceKHR, "Present Surface")
 	, REGISTER_VKOBJ(m_commandPool, m_device, vkDestroyCommandPool, "CommandPool")
 	, REGISTER_VKOBJ(m_pipelineCache, m_device, vkDestroyPipelineCache, "PipelineCache")
 	, REGISTER_VKOBJ(m_renderPass, m_device, vkDestroyRenderPass, "RenderPass")
+	, REGISTER_VKOBJ(m_earlyRenderPass, m_device, vkDestroyRenderPass, "RenderPass_OcclusionEarly")
+	, REGISTER_VKOBJ(m_lateRenderPass, m_device, vkDestroyRenderPass, "RenderPass_OcclusionLate")
 	, REGISTER_VKOBJ(m_descriptorPool, m_device, vkDestroyDescriptorPool, "DescriptorPool")
 	, REGISTER_VKOBJ(m_presentComplete, m_device, vkDestroySemaphore, "PresentCompleteSemaphore")
 	, REGISTER_VKOBJ(m_renderComplete, m_device, vkDestroySemaphore, "RenderCompleteSemaphore")
 	, REGISTER_VKOBJ(m_descriptorSetLayoutPerFrame_TriangleProgram, m_device, vkDestroyDescriptorSetLayout, "DescriptorSetLayoutPerFrame_TriangleProgram")
 	, REGISTER_VKOBJ(m_pipelineLayout_TriangleProgram, m_device, vkDestroyPipelineLayout, "PipelineLayout_TriangleProgram")
 	, REGISTER_VKOBJ(m_pipeline_TriangleProgram, m_device, vkDestroyPipeline, "Pipeline_TriangleProgram")
+	, REGISTER_VKOBJ(m_pipeline_DepthPrepass, m_device, vkDestroyPipeline, "Pipeline_DepthPrepass")
 	//////////////////////////////////////////////////////////////////////////
 	, m_depthStencil(m_device)
 	, m_graphicsQueueIdx()
+	, m_multisampleColor(m_device)
+	, m_sampleCount(VK_SAMPLE_COUNT_1_BIT)
 	//, m_postPresentCommandBuffers(VK_NULL_HANDLE)
 	, m_currentFrameBufferIdx(0)
+	, m_meshPath(in_meshPath)
+	, m_texturePath(in_texturePath)
+	, m_textureIdx(VulkanBindlessTable::c_invalidIdx)
+	, m_streamedTexture(VulkanTextureStreamer::c_invalidHandle)
+	, m_meshNode(0)
+	, m_lodProjectionScale(1.0f)
+	, m_simulationFrameIdx(0)
+	, m_frameIdx(1) // frame 0 counts as already completed
+	, m_completedFrameIdx(0)
+	, m_gpuPrepassMs(0.0)
+	, m_gpuMainMs(0.0)
+	, m_gpuTimedFrames(0)
 	, m_width(in_width)
 	, m_height(in_height)
 {
@@ -88,10 +151,87 @@ VulkanGraphics::~VulkanGraphics()
 
 
 void VulkanGraphics::Render()
+{
+	RenderSnapshot snapshot;
+	PrepareFrame(snapshot);
+	Render(snapshot);
+}
+
+void VulkanGraphics::PrepareFrame(RenderSnapshot& out_snapshot)
+{
+	out_snapshot.m_simulationFrameIdx = m_simulationFrameIdx++;
+
+	m_transforms->Update();
+	glm::mat4 viewProjectionMatrix;
+	MatrixKernels::Multiply(m_projectionMatrix, m_viewMatrix, viewProjectionMatrix);
+
+	// Meshlet bounds are in real model space
+	const glm::mat4& worldMatrix = m_transforms->GetWorldMatrix(m_meshNode);
+	MatrixKernels::Multiply(viewProjectionMatrix, worldMatrix, out_snapshot.m_cullMatrix);
+	out_snapshot.m_cullCameraPos = glm::vec3(glm::inverse(m_viewMatrix * worldMatrix) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+
+	// The complete transform of every node, so the vertex shader has a single matrix to apply.
+	// Only the instance buffer takes them, the uniform buffer and pushed data are set at initialization.
+	std::vector<glm::mat4>& instanceMatrices = out_snapshot.m_instanceMatrices;
+	instanceMatrices.clear();
+	if (m_instanceBuffer)
+	{
+		// Every node draws the mesh, culled by the mesh bounds around its world matrix
+		const glm::mat4* worldMatrices = m_transforms->GetWorldMatrices();
+		size_t nodeCount = m_transforms->GetCount();
+		m_instanceCuller->Clear();
+		for (size_t node = 0; node < nodeCount; ++node)
+		{
+			glm::vec3 boxMin, boxMax;
+			MatrixKernels::TransformAabbs(worldMatrices[node], &m_mesh->m_boundsMin, &m_mesh->m_boundsMax, &boxMin, &boxMax, 1);
+			m_instanceCuller->Add(boxMin, boxMax);
+		}
+		size_t visibleCount = m_instanceCuller->Cull(Frustum::FromMatrix(viewProjectionMatrix), m_visibleInstances, m_jobSystem.get());
+
+		instanceMatrices.resize(visibleCount);
+		for (size_t i = 0; i < visibleCount; ++i)
+			instanceMatrices[i] = worldMatrices[m_visibleInstances[i]];
+		MatrixKernels::MultiplyBatch(viewProjectionMatrix, instanceMatrices.data(), instanceMatrices.data(), visibleCount);
+		// The vertices are quantized
+		MatrixKernels::MultiplyBatch(instanceMatrices.data(), m_mesh->m_dequantize, instanceMatrices.data(), visibleCount);
+		// Instances are drawn in buffer order, nearest first lets the prepass reject the most
+		if (m_depthPrepass)
+			DepthPrepass::SortFrontToBack(instanceMatrices);
+	}
+
+	// Coarsest level that stays within a pixel of the full mesh
+	uint8_t lod = 0;
+	if (!m_mesh->m_lods.empty())
+	{
+		std::vector<float> lodErrors;
+		for (const VulkanMesh::Lod& level : m_mesh->m_lods)
+			lodErrors.push_back(level.m_error);
+		LodSelection::View view = { out_snapshot.m_cullCameraPos, m_lodProjectionScale, 1.0f };
+		glm::vec4 bounds((m_mesh->m_boundsMin + m_mesh->m_boundsMax) * 0.5f, glm::length(m_mesh->m_boundsMax - m_mesh->m_boundsMin) * 0.5f);
+		LodSelection::Select(view, lodErrors.data(), static_cast<uint32_t>(lodErrors.size()), &bounds, nullptr, 1, &lod);
+	}
+	out_snapshot.m_lod = lod;
+
+	// Texels needed across the texture, from the size of the mesh on screen
+	out_snapshot.m_textureRequests.clear();
+	if (m_streamedTexture != VulkanTextureStreamer::c_invalidHandle)
+	{
+		glm::vec3 center = (m_mesh->m_boundsMin + m_mesh->m_boundsMax) * 0.5f;
+		float radius = glm::length(m_mesh->m_boundsMax - m_mesh->m_boundsMin) * 0.5f;
+		float distance = std::max(glm::length(out_snapshot.m_cullCameraPos - center), 0.001f);
+		VulkanTextureStreamer::Request request = { m_streamedTexture, 2.0f * radius * m_lodProjectionScale / distance };
+		out_snapshot.m_textureRequests.push_back(request);
+	}
+
+	if (m_meshletCuller)
+		m_meshletCuller->Cull(out_snapshot.m_cullMatrix, out_snapshot.m_cullCameraPos, lod, out_snapshot.m_meshletCull);
+}
+
+void VulkanGraphics::Render(const RenderSnapshot& in_snapshot)
 {
 	if (!m_device)
-		return;
-	Draw();
+		return;
+	Draw(in_snapshot);
 }
 
 // Main initialization of Vulkan stuff
@@ -131,13 +271,23 @@ void VulkanGraphics::Init(HWND in_hWnd, HINSTANCE in_hInstance)
 	// ---------------------------------------------------------------------------
 
 
+	// JOBS : Worker threads
+	// ---------------------------------------------------------------------------
+	// Created on the thread preparing the frames, which then runs jobs as well while it waits on them
+	m_jobSystem = std::make_unique<JobSystem>();
+	// ---------------------------------------------------------------------------
+
 	// FACTORIES : Init factories
 	// ---------------------------------------------------------------------------
 	m_memoryHelper = std::make_shared<VulkanMemoryHelper>(m_physicalDevice);
+	m_deletionQueue = std::make_shared<VulkanDeletionQueue>();
+	m_deletionQueue->BeginFrame(m_frameIdx);
 	m_commandBufferFactory = std::make_unique<VulkanCommandBufferFactory>(m_device);
+	m_commandBufferFactory->SetJobSystem(m_jobSystem.get());
 	m_renderPassFactory = std::make_unique<VulkanRenderPassFactory>(m_device);
 	m_depthStencilFactory = std::make_unique<VulkanDepthStencilFactory>(m_device, m_memoryHelper);
-	m_bufferFactory = std::make_unique<VulkanBufferFactory>(m_device, m_memoryHelper);
+	m_bufferFactory = std::make_unique<VulkanBufferFactory>(m_device, m_memoryHelper, m_deletionQueue);
+	m_samplerCache = std::make_shared<VulkanSamplerCache>(m_device, m_physicalDevice);
 	// ---------------------------------------------------------------------------
 
 
@@ -154,6 +304,8 @@ void VulkanGraphics::Init(HWND in_hWnd, HINSTANCE in_hInstance)
 	// DEPTH FORMAT : Get and set depth format
 	// ---------------------------------------------------------------------------
 	if (!GetDepthFormat(&m_depthFormat)) ERROR_ALWAYS("Set up the depth format.");
+	m_sampleCount = GetSampleCount(MSAA_SAMPLES);
+	LOG("Multisampling: " << m_sampleCount << "x");
 	// ---------------------------------------------------------------------------
 
 	// SWAP CHAIN : Create a swap chain representation
@@ -167,6 +319,12 @@ void VulkanGraphics::Init(HWND in_hWnd, HINSTANCE in_hInstance)
 	// ---------------------------------------------------------------------------
 	err = CreateCommandPool(m_commandPool.Replace());
 	ERROR_IF(err, "Create command pool: " << vkTools::errorString(err));
+	// Buffer uploads go through staging buffers on the graphics queue
+	m_bufferFactory->SetTransferQueue(m_queue, m_commandPool);
+	m_textureFactory = std::make_unique<VulkanTextureFactory>(m_device, m_physicalDevice, m_memoryHelper, *m_bufferFactory.get(), m_deletionQueue,
+		m_samplerCache);
+	// Mips the GPU can't blit are generated on the CPU, split over the workers
+	m_textureFactory->SetJobSystem(m_jobSystem.get());
 	// ---------------------------------------------------------------------------
 
 	// COMMAND BUFFERS : Create command buffers for each frame image buffer in the swap chain, for rendering
@@ -174,14 +332,34 @@ void VulkanGraphics::Init(HWND in_hWnd, HINSTANCE in_hInstance)
 	AllocateRenderCommandBuffers();
 	// ---------------------------------------------------------------------------
 
+	// BINDLESS : One copy of the table per command buffer, so slots in use can be changed
+	// ---------------------------------------------------------------------------
+	if (m_bindless)
+	{
+		m_bindlessTable = std::make_unique<VulkanBindlessTable>(m_device, m_deletionQueue,
+			BINDLESS_MAX_SAMPLERS, BINDLESS_MAX_STORAGE_BUFFERS, BINDLESS_MAX_SAMPLED_IMAGES,
+			static_cast<uint32_t>(m_drawCommandBuffers.size()), m_samplerCache->GetCommonSamplers());
+	}
+	LOG("Bindless descriptors " << (m_bindless ? "enabled" : "not supported"));
+	// ---------------------------------------------------------------------------
+
 	// DEPTH STENCIL IMAGE VIEWS : Setup depth stencil
 	// ---------------------------------------------------------------------------
-	m_depthStencilFactory->CreateDepthStencil(m_depthFormat, m_width, m_height, m_depthStencil);
+	// Sampled for the Hi-Z pyramid when occlusion culling
+	m_depthStencilFactory->CreateDepthStencil(m_depthFormat, m_width, m_height, m_depthStencil, m_sampleCount, m_occlusionCulling);
+	// ---------------------------------------------------------------------------
+
+	// MULTISAMPLE COLOR : Drawn to when multisampling, resolved into the swap chain image
+	// ---------------------------------------------------------------------------
+	if (m_sampleCount != VK_SAMPLE_COUNT_1_BIT)
+		m_depthStencilFactory->CreateMultisampleColor(m_swapChain->GetColorFormat(), m_width, m_height, m_sampleCount, m_multisampleColor,
+			m_occlusionCulling);
 	// ---------------------------------------------------------------------------
 
 	// RENDERPARSS : Create the render pass
 	// ---------------------------------------------------------------------------
-	err = m_renderPassFactory->CreateStandardRenderPass(m_swapChain->GetColorFormat(), m_depthFormat, *m_renderPass.Replace());
+	err = m_renderPassFactory->CreateStandardRenderPass(m_swapChain->GetColorFormat(), m_depthFormat, *m_renderPass.Replace(), m_sampleCount,
+		m_width, m_height);
 	ERROR_IF(err, "Create render pass: " << vkTools::errorString(err));
 	// ---------------------------------------------------------------------------
 
@@ -207,16 +385,70 @@ void VulkanGraphics::Init(HWND in_hWnd, HINSTANCE in_hInstance)
 	// 3. Prepare application specific usage of Vulkan
 	// ================================================
 
-	// Create triangle mesh
-	m_triangleMesh = std::make_shared<VulkanMesh>(m_device);
-	m_bufferFactory->CreateTriangle(*m_triangleMesh.get());
-
 	// TODO: The following methods are currently specialized for a triangle example
 	// but should probably be more generalized in the future:
 	// -------------------------------------
 	// Set up a simple vertex layout for our mesh
 	CreateTriangleProgramVertexLayouts();
 
+	// Load the mesh file if we got one (its vertex layout replaces the simple one), otherwise create the triangle
+	m_mesh = std::make_shared<VulkanMesh>(m_device);
+	if (m_meshPath.empty() || 
+		!m_bufferFactory->CreateMeshFromFile(m_meshPath, VERTEX_BUFFER_BIND_ID, *m_mesh.get(), m_simpleVertexLayout.get(), m_depthPrepass))
+	{
+		m_bufferFactory->CreateTriangle(*m_mesh.get());
+	}
+	// Optional texture, shaders find it in the bindless table through the material index
+	if (!m_texturePath.empty())
+	{
+#ifdef USE_TEXTURE_STREAMING
+		// Starts out with its smallest mips, the rest come as the mesh covers more of the screen
+		m_textureStreamer = std::make_unique<VulkanTextureStreamer>(m_device, m_memoryHelper, *m_bufferFactory.get(), *m_textureFactory.get(),
+			m_deletionQueue, m_jobSystem.get());
+		m_streamedTexture = m_textureStreamer->Add(m_texturePath);
+		if (m_streamedTexture != VulkanTextureStreamer::c_invalidHandle)
+			m_texture = m_textureStreamer->GetTexture(m_streamedTexture);
+#else
+		m_texture = m_textureFactory->CreateTextureFromFile(m_texturePath);
+#endif // USE_TEXTURE_STREAMING
+		if (m_texture && m_bindlessTable)
+		{
+			m_textureIdx = m_bindlessTable->AddSampledImage(m_texture->m_imageView);
+			m_bindlessTable->AddSampler(m_textureFactory->GetSampler());
+		}
+		if (m_textureStreamer)
+		{
+			// The previous version stays alive until every copy of the table points at the new one
+			m_textureStreamer->SetResidencyCallback([this](VulkanTextureStreamer::Handle /*in_handle*/,
+				const std::shared_ptr<VulkanTexture>& in_texture, const std::shared_ptr<VulkanTexture>& in_previous)
+			{
+				m_texture = in_texture;
+				if (m_bindlessTable && m_textureIdx != VulkanBindlessTable::c_invalidIdx)
+				{
+					m_bindlessTable->UpdateSampledImage(m_textureIdx, in_texture->m_imageView,
+						VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, in_previous);
+				}
+			});
+		}
+	}
+	// Meshlets are drawn with one indirect call per frame, without multi draw indirect the submeshes are drawn instead
+	if (!m_mesh->m_meshlets.empty() && !m_multiDrawIndirect)
+		LOG("No multi draw indirect, drawing submeshes instead of culled meshlets");
+	if (!m_mesh->m_meshlets.empty() && m_multiDrawIndirect)
+	{
+		// Occlusion culling works on meshlets, drawing them in two passes around the pyramid build
+		if (m_occlusionCulling)
+		{
+			m_hiZPyramid = std::make_unique<VulkanHiZPyramid>(m_device, *m_textureFactory.get(), *m_bufferFactory.get(),
+				m_depthStencil.m_sampledView, m_width, m_height, m_sampleCount);
+			err = m_renderPassFactory->CreateOcclusionRenderPasses(m_swapChain->GetColorFormat(), m_depthFormat,
+				*m_earlyRenderPass.Replace(), *m_lateRenderPass.Replace(), m_sampleCount, m_width, m_height);
+			ERROR_IF(err, "Create occlusion culling render passes: " << vkTools::errorString(err));
+		}
+		m_meshletCuller = std::make_unique<VulkanMeshletCuller>(m_device, *m_bufferFactory.get(), *m_mesh.get(),
+			static_cast<uint32_t>(m_drawCommandBuffers.size()), m_hiZPyramid.get());
+	}
+
 	// Set up the uniform buffers
 	CreateTriangleProgramUniformBuffers();
 
@@ -227,7 +459,12 @@ void VulkanGraphics::Init(HWND in_hWnd, HINSTANCE in_hInstance)
 	// Descriptor sets are useful groups as they can be grouped based on update frequency.
 	CreateTriangleProgramDescriptorSetLayout(); // Describes the various bind stages of our descriptors
 	// The pipeline then can be seen sorta like a function taking some structs as parameters, where then the parameter types are the descriptor sets layout(s) (1 layout used here atm)
-	CreatePipelineLayout(m_descriptorSetLayoutPerFrame_TriangleProgram, *m_pipelineLayout_TriangleProgram.Replace()); // Create a pipeline which can handle the specified descriptor set layout
+	// The bindless table is set 1 when there is one, bound once per command buffer for all its draws
+	std::vector<VkDescriptorSetLayout> setLayouts = { m_descriptorSetLayoutPerFrame_TriangleProgram };
+	if (m_bindlessTable)
+		setLayouts.push_back(m_bindlessTable->GetLayout());
+	CreatePipelineLayout(setLayouts, *m_pipelineLayout_TriangleProgram.Replace(), // Create a pipeline which can handle the specified descriptor set layouts
+		{ VulkanPushConstants::GetRange() }); // and the per draw data
 	CreateTriangleProgramPipelineAndLoadShaders();
 	// Set up the descriptor set pool, this from where
 	CreateTriangleProgramDescriptorPool();
@@ -235,24 +472,69 @@ void VulkanGraphics::Init(HWND in_hWnd, HINSTANCE in_hInstance)
 	CreateTriangleProgramDescriptorSet();
 	// -------------------------------------
 
+#ifdef USE_GPU_TIMER
+	if (VulkanGpuTimer::IsSupported(m_physicalDevice, m_graphicsQueueIdx))
+		m_gpuTimer = std::make_unique<VulkanGpuTimer>(m_device, m_physicalDevice, m_graphicsQueueIdx, static_cast<uint32_t>(m_drawCommandBuffers.size()));
+	else
+		LOG("No timestamps on the graphics queue, the passes are not timed");
+#endif
+
 	// Set up a command buffer for drawing the mesh
+#ifdef USE_SECONDARY_COMMAND_BUFFERS
+	m_secondaryCommandCache = std::make_unique<VulkanSecondaryCommandCache>(m_device, m_commandPool,
+		static_cast<uint32_t>(m_drawCommandBuffers.size()));
+#endif
+	RecordDrawCommandBuffers(c_allFrameBuffers);
+
+
+
+	// When all the above is implemented we can create the render method that will be called each frame
+}
+
+void VulkanGraphics::RecordDrawCommandBuffers(uint32_t in_frameBufferIdx)
+{
+	// Each binds its own copy of the bindless table
 	std::vector<VkDescriptorSet> descriptors = { m_descriptorSetPerFrame };
 	VulkanCommandBufferFactory::DrawCommandBufferDependencies drawInfo(
 		&m_pipelineLayout_TriangleProgram,
 		&m_pipeline_TriangleProgram,
 		&descriptors,
 		VERTEX_BUFFER_BIND_ID,
-		m_triangleMesh.get(),
-		m_swapChain.get()
+		m_mesh.get(),
+		m_swapChain.get(),
+		m_meshletCuller.get(),
+		m_instanceBuffer.get(),
+		INSTANCE_BUFFER_BIND_ID,
+		&m_drawData,
+		m_bindlessTable ? &m_bindlessTable->GetSets() : nullptr,
+		m_depthPrepass ? &m_pipeline_DepthPrepass : nullptr,
+		m_hiZPyramid.get(),
+		m_hiZPyramid ? &m_lateRenderPass : nullptr,
+		m_gpuTimer.get()
 		);
 	VkClearColorValue clearCol = { { 0.0f, 0.0f, 1.0f, 1.0f } };
+	if (in_frameBufferIdx != c_allFrameBuffers)
+	{
+		// Only the draws that changed are recorded again
+		uint32_t recorded = m_secondaryCommandCache ? m_secondaryCommandCache->GetStats().m_recorded : 0;
+		m_commandBufferFactory->RecordDrawCommandBuffer(m_drawCommandBuffers[in_frameBufferIdx], in_frameBufferIdx,
+			m_frameBuffers[in_frameBufferIdx], drawInfo, m_hiZPyramid ? m_earlyRenderPass : m_renderPass,
+			clearCol, m_width, m_height, m_secondaryCommandCache.get());
+		if (m_secondaryCommandCache && m_secondaryCommandCache->GetStats().m_recorded != recorded)
+		{
+			LOG("Recorded " << m_secondaryCommandCache->GetStats().m_recorded - recorded <<
+				" secondary command buffers for frame buffer " << in_frameBufferIdx);
+		}
+		return;
+	}
 	m_commandBufferFactory->ConstructDrawCommandBuffer(m_drawCommandBuffers, m_frameBuffers, 
-		drawInfo, m_renderPass, 
-		clearCol, m_width, m_height);
-
-
-
-	// When all the above is implemented we can create the render method that will be called each frame
+		drawInfo, m_hiZPyramid ? m_earlyRenderPass : m_renderPass, 
+		clearCol, m_width, m_height, m_secondaryCommandCache.get());
+	const VulkanCommandBufferFactory::BindStats& bindStats = m_commandBufferFactory->GetBindStats();
+	LOG("Draw command buffers: " << bindStats.m_pipelineBinds << " pipeline, " << bindStats.m_descriptorSetBinds << " descriptor set, "
+		<< bindStats.m_vertexBufferBinds << " vertex buffer and " << bindStats.m_indexBufferBinds << " index buffer binds, "
+		<< bindStats.m_pipelineBindsSkipped + bindStats.m_descriptorSetBindsSkipped + bindStats.m_vertexBufferBindsSkipped
+		+ bindStats.m_indexBufferBindsSkipped << " redundant binds skipped");
 }
 
 void VulkanGraphics::CreateInstance()
@@ -271,6 +553,17 @@ void VulkanGraphics::CreateInstance()
 	// Windows specific
 	enabledExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 
+	// Needed to query the descriptor indexing features for the bindless table
+	uint32_t availableExtensionCount = 0;
+	vkEnumerateInstanceExtensionProperties(nullptr, &availableExtensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensions(availableExtensionCount);
+	vkEnumerateInstanceExtensionProperties(nullptr, &availableExtensionCount, availableExtensions.data());
+	for (const VkExtensionProperties& extension : availableExtensions)
+	{
+		if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0)
+			enabledExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+	}
+
 	// Set up and create the Vulkan main instance
 	VkInstanceCreateInfo instanceCreateInfo = {};
 	instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO; // Mandatory
@@ -371,17 +664,33 @@ void VulkanGraphics::Destroy()
 
 	// TODO: Replace remaining with VkObjs
 
-	// Flush device to make sure all resources can be freed 
+	// Flush device to make sure all resources can be freed 
+	// This is the only place we do a full wait, runtime replacements go through the deletion queue
 	vkDeviceWaitIdle(m_device);
 
+	OutputDebugString("Vulkan: Removing textures\n");
+	m_textureStreamer.reset();
+	m_texture.reset(); // goes through the deletion queue
+
+	OutputDebugString("Vulkan: Removing deferred objects\n");
+	if (m_deletionQueue)
+		m_deletionQueue->Flush();
+	// Holds on to the textures of descriptor changes not yet made to every set
+	m_bindlessTable.reset();
+	if (m_deletionQueue)
+		m_deletionQueue->Flush();
+
 	OutputDebugString("Vulkan: Removing swap chain\n");
 	m_swapChain.reset();
 
 	OutputDebugString("Vulkan: Removing command buffers\n");
+	m_secondaryCommandCache.reset();
 	DestroyCommandBuffers();
 
 	OutputDebugString("Vulkan: Removing renderpass\n");
 	m_renderPass.Reset(nullptr);
+	m_earlyRenderPass.Reset(nullptr);
+	m_lateRenderPass.Reset(nullptr);
 
 	OutputDebugString("Vulkan: Removing frame buffers\n");
 	for (uint32_t i = 0; i < static_cast<uint32_t>(m_frameBuffers.size()); i++)
@@ -462,7 +771,27 @@ void VulkanGraphics::CreateLogicalDevice()
 	VkDeviceCreateInfo deviceCreateInfo = {};
 	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	deviceCreateInfo.pNext = nullptr;
-	deviceCreateInfo.pEnabledFeatures = nullptr;
+	// Only enable the features we use, and only if they're there
+	VkPhysicalDeviceFeatures supportedFeatures = {};
+	vkGetPhysicalDeviceFeatures(m_physicalDevice, &supportedFeatures);
+	VkPhysicalDeviceFeatures enabledFeatures = {};
+	enabledFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+	m_multiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+	// Meshlets are only culled and drawn with it, see below
+	m_occlusionCulling = m_occlusionCulling && m_multiDrawIndirect;
+	deviceCreateInfo.pEnabledFeatures = &enabledFeatures;
+	// Descriptor indexing for the bindless table, chained in as it is an extension feature
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures = {};
+	// Its sampled images are indexed with the material index of each draw (see triangle.frag)
+	m_bindless = VulkanBindlessTable::GetRequiredFeatures(m_vulkanInstance, m_physicalDevice, descriptorIndexingFeatures) &&
+		supportedFeatures.shaderSampledImageArrayDynamicIndexing == VK_TRUE;
+	enabledFeatures.shaderSampledImageArrayDynamicIndexing = m_bindless ? VK_TRUE : VK_FALSE;
+	if (m_bindless)
+	{
+		enabledExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+		enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+		deviceCreateInfo.pNext = &descriptorIndexingFeatures;
+	}
 	// Set queue(s) to device
 	deviceCreateInfo.queueCreateInfoCount = 1; // one queue for now
 	deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
@@ -513,6 +842,20 @@ bool VulkanGraphics::GetDepthFormat(VkFormat* out_format) const
 	return depthFormatFound;
 }
 
+VkSampleCountFlagBits VulkanGraphics::GetSampleCount(uint32_t in_requested) const
+{
+	// The highest count at or below the requested one that color and depth attachments both support
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+	VkSampleCountFlags supported = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+	for (uint32_t samples = VK_SAMPLE_COUNT_64_BIT; samples > VK_SAMPLE_COUNT_1_BIT; samples >>= 1)
+	{
+		if (samples <= in_requested && (supported & samples))
+			return static_cast<VkSampleCountFlagBits>(samples);
+	}
+	return VK_SAMPLE_COUNT_1_BIT;
+}
+
 VkResult VulkanGraphics::CreateCommandPool(VkCommandPool* out_commandPool)
 {
 	VkCommandPoolCreateInfo cmdPoolInfo = {};
@@ -552,10 +895,15 @@ void VulkanGraphics::CreateFrameBuffers()
 {
 	// Create frame buffers which use the buffers in the swap chain to
 	// render to and the render pass to be compatible with.
-	VkImageView attachments[2];
+	VkImageView attachments[3];
 
 	// Depthstencil attachment is the same for all frame buffers
 	attachments[1] = m_depthStencil.m_imageView;
+	// As is the multisampled color, the swap chain image is then the resolve target
+	const bool multisampled = m_sampleCount != VK_SAMPLE_COUNT_1_BIT;
+	const uint32_t colorIdx = multisampled ? 2 : 0;
+	if (multisampled)
+		attachments[0] = m_multisampleColor.m_imageView;
 
 
 	// Create frame buffers for every swap chain image
@@ -566,14 +914,14 @@ void VulkanGraphics::CreateFrameBuffers()
 	{
 		// Update first creation attachment struct with the associated image view
 		// The second struct in the attachment array remains the depthstencil view
-		attachments[0] = swapchainBuffers[i].m_imageView;
+		attachments[colorIdx] = swapchainBuffers[i].m_imageView;
 
 		VkFramebufferCreateInfo frameBufferCreateInfo = {};
 		frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 		frameBufferCreateInfo.pNext = nullptr;
 		frameBufferCreateInfo.renderPass = m_renderPass;
-		frameBufferCreateInfo.attachmentCount = 2;
-		frameBufferCreateInfo.pAttachments = attachments; // attach the image view and the depthstencil view
+		frameBufferCreateInfo.attachmentCount = multisampled ? 3 : 2;
+		frameBufferCreateInfo.pAttachments = attachments; // attach the image view and the depthstencil view (and the resolve target)
 		frameBufferCreateInfo.width = m_width;
 		frameBufferCreateInfo.height = m_height;
 		frameBufferCreateInfo.layers = 1;
@@ -607,6 +955,7 @@ void VulkanGraphics::CreateSemaphoresAndFences()
 	// Create in signaled state so we don't wait on first render of each command buffer
 	fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 	m_waitFences.resize(m_drawCommandBuffers.size());
+	m_waitFenceFrameIdx.assign(m_drawCommandBuffers.size(), 0);
 	for (auto& pFence : m_waitFences)
 	{
 		pFence = std::make_unique<FenceType>(m_device, vkDestroyFence
@@ -644,26 +993,9 @@ VkDescriptorSetLayoutCreateInfo VulkanGraphics::CreateDescriptorSetLayoutCreateI
 void VulkanGraphics::CreateTriangleProgramVertexLayouts()
 {
 	m_simpleVertexLayout = std::make_shared<VulkanVertexLayout>();
-	VulkanVertexLayout& vertices = *m_simpleVertexLayout.get();
-	// Binding description
-	vertices.m_bindingDescriptions.resize(1);
-	vertices.m_bindingDescriptions[0].binding = VERTEX_BUFFER_BIND_ID;
-	vertices.m_bindingDescriptions[0].stride = sizeof(Vertex);
-	vertices.m_bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-	// An entry for each data type in the vertex, for example: [0]:pos, [1]:col
-	vertices.m_attributeDescriptions.resize(2);
-	// Position
-	vertices.m_attributeDescriptions[0].binding = VERTEX_BUFFER_BIND_ID;
-	vertices.m_attributeDescriptions[0].location = 0;
-	vertices.m_attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-	vertices.m_attributeDescriptions[0].offset = 0;
-	// Color
-	vertices.m_attributeDescriptions[1].binding = VERTEX_BUFFER_BIND_ID;
-	vertices.m_attributeDescriptions[1].location = 1;
-	vertices.m_attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-	vertices.m_attributeDescriptions[1].offset = sizeof(float) * 3; // size of position is offset
-
+	// Binding and attributes ([0]:pos, [1]:col) come from the declaration of Vertex,
+	// mesh files replace this with the layout they were written with
+	VertexDecl::GetLayout(VERTEX_BUFFER_BIND_ID, *m_simpleVertexLayout.get());
 }
 
 void VulkanGraphics::CreateTriangleProgramUniformBuffers()
@@ -672,18 +1004,47 @@ void VulkanGraphics::CreateTriangleProgramUniformBuffers()
 	// --------------------------------------------------------------------------------------------------------
 
 	// Create buffer for projection-, view- and world matrices.
-	glm::mat4 projectionMatrix = glm::perspective(deg_to_rad(60.0f), (float)m_width / (float)m_height, 
+	const float fovY = deg_to_rad(60.0f);
+	glm::mat4 projectionMatrix = glm::perspective(fovY, (float)m_width / (float)m_height, 
 		0.1f, // near
 		1000.0f); // far
-	glm::mat4 viewMatrix = glm::translate(glm::mat4(), glm::vec3(0.0f, 0.0f, -3.0f)); // camera start location
-	m_rotation = glm::vec3();
-	glm::mat4 worldMatrix = glm::mat4();
-	worldMatrix = glm::rotate(worldMatrix, deg_to_rad(m_rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
-	worldMatrix = glm::rotate(worldMatrix, deg_to_rad(m_rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
-	worldMatrix = glm::rotate(worldMatrix, deg_to_rad(m_rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+	// Camera start location, far enough back to fit the mesh bounds in view
+	glm::vec3 boundsCenter = (m_mesh->m_boundsMin + m_mesh->m_boundsMax) * 0.5f;
+	float boundsRadius = glm::length(m_mesh->m_boundsMax - m_mesh->m_boundsMin) * 0.5f;
+	float cameraDistance = glm::max(3.0f, boundsRadius / glm::tan(deg_to_rad(30.0f)));
+	glm::mat4 viewMatrix = glm::translate(glm::mat4(), glm::vec3(0.0f, 0.0f, -cameraDistance) - boundsCenter);
+	m_projectionMatrix = projectionMatrix;
+	m_viewMatrix = viewMatrix;
+	m_lodProjectionScale = LodSelection::GetProjectionScale(fovY, static_cast<float>(m_height));
+
+	// The mesh is the root of the scene
+	m_transforms = std::make_unique<TransformHierarchy>();
+	glm::vec3 rotation = glm::vec3(); // euler degrees
+	glm::quat meshRotation = glm::angleAxis(deg_to_rad(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f)) *
+		glm::angleAxis(deg_to_rad(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f)) *
+		glm::angleAxis(deg_to_rad(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+	m_meshNode = m_transforms->Add(TransformHierarchy::c_noParent, glm::vec3(), meshRotation, glm::vec3(1.0f));
+	m_transforms->Update();
+
+#ifdef USE_INSTANCE_BUFFER
+	// Takes the whole transform of each node, computed per frame (see PrepareFrame)
+	m_instanceBuffer = std::make_unique<VulkanInstanceBuffer>(m_device, *m_bufferFactory.get(), *m_mesh.get(),
+		static_cast<uint32_t>(m_drawCommandBuffers.size()), static_cast<uint32_t>(m_transforms->GetCount()));
+	m_instanceCuller = std::make_unique<FrustumCuller>();
+#endif
+	// Only used without the instance buffer
+	glm::mat4 worldMatrix = m_transforms->GetWorldMatrix(m_meshNode) * m_mesh->m_dequantize;
+	glm::mat4 modelViewProjection = projectionMatrix * viewMatrix * worldMatrix;
 
 	m_ubufPerFrame = std::make_shared<VulkanUniformBufferPerFrame>(m_device);
-	m_bufferFactory->CreateUniformBufferPerFrame(*m_ubufPerFrame.get(), projectionMatrix, worldMatrix, viewMatrix);
+	m_bufferFactory->CreateUniformBufferPerFrame(*m_ubufPerFrame.get(), modelViewProjection);
+
+	// The same for every submesh until they get materials of their own
+	VulkanPushConstants::DrawData drawData = {};
+	drawData.m_modelViewProjection = modelViewProjection;
+	drawData.m_objectIdx = m_meshNode;
+	drawData.m_materialIdx = m_textureIdx;
+	m_drawData.assign(std::max<size_t>(1, m_mesh->m_submeshes.size()), drawData);
 	// --------------------------------------------------------------------------------------------------------
 
 	// TODO: other buffers based on how often they're updated
@@ -763,7 +1124,7 @@ void VulkanGraphics::CreateTriangleProgramDescriptorSet()
 	vkUpdateDescriptorSets(m_device, 1, &writeDescriptorSet, 0, nullptr);
 }
 
-void VulkanGraphics::Draw()
+void VulkanGraphics::Draw(const RenderSnapshot& in_snapshot)
 {
 	VkResult err;
 
@@ -777,6 +1138,49 @@ void VulkanGraphics::Draw()
 	err = vkResetFences(m_device, 1, &(*m_waitFences[m_currentFrameBufferIdx].get()));
 	ERROR_IF(err, "Reset fence");
 
+	// The fence tells us that the frame last submitted with it is done, so anything released up to it can go
+	CollectFinishedFrame(m_currentFrameBufferIdx);
+
+	// So are the timestamps of that frame
+	VulkanGpuTimer::Times gpuTimes;
+	if (m_gpuTimer && m_gpuTimer->Read(m_currentFrameBufferIdx, gpuTimes))
+	{
+		m_gpuPrepassMs += gpuTimes.m_prepassMs;
+		m_gpuMainMs += gpuTimes.m_mainMs;
+		if (++m_gpuTimedFrames == GPU_TIMED_FRAMES)
+		{
+			LOG("GPU time of the last " << GPU_TIMED_FRAMES << " frames: depth prepass " << m_gpuPrepassMs / GPU_TIMED_FRAMES << " ms, main pass " <<
+				m_gpuMainMs / GPU_TIMED_FRAMES << " ms" << (m_depthPrepass ? "" : " (no depth prepass)"));
+			m_gpuPrepassMs = 0.0;
+			m_gpuMainMs = 0.0;
+			m_gpuTimedFrames = 0;
+		}
+	}
+
+	// New texture versions go into the copy of the bindless table of this frame buffer, it isn't in use now
+	if (m_textureStreamer)
+	{
+		m_textureStreamer->Update(in_snapshot.m_textureRequests);
+		const VulkanTextureStreamer::Stats& stats = m_textureStreamer->GetStats();
+		if (stats.m_streamedBytes > 0 || stats.m_evictedBytes > 0)
+		{
+			LOG("Texture streaming: " << stats.m_streamedBytes / 1024 << " KiB in, " << stats.m_evictedBytes / 1024 << " KiB out, " <<
+				stats.m_residentBytes / 1024 << "/" << stats.m_budget / 1024 << " KiB resident, hit rate " << stats.GetHitRate());
+		}
+	}
+	if (m_bindlessTable)
+		m_bindlessTable->BeginFrame(m_currentFrameBufferIdx);
+
+	// The indirect buffer of this frame buffer is free now as well
+	if (m_meshletCuller)
+		m_meshletCuller->Update(m_currentFrameBufferIdx, in_snapshot.m_meshletCull);
+	if (m_instanceBuffer)
+		m_instanceBuffer->Write(m_currentFrameBufferIdx, in_snapshot.m_instanceMatrices.data(), in_snapshot.m_instanceMatrices.size());
+
+	// With the draws cached the command buffer is recorded every frame, it isn't in use either
+	if (m_secondaryCommandCache)
+		RecordDrawCommandBuffers(m_currentFrameBufferIdx);
+
 	// Pipeline stage at which the queue submission will wait (via pWaitSemaphores)
 	VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 	// The submit info structure specifies a command buffer queue submission batch
@@ -793,6 +1197,13 @@ void VulkanGraphics::Draw()
 	// Submit to the graphics queue passing a wait fence
 	err = vkQueueSubmit(m_queue, 1, &submitInfo, *m_waitFences[m_currentFrameBufferIdx]);
 	ERROR_IF(err, "Draw queue submit");
+	if (m_gpuTimer)
+		m_gpuTimer->Submitted(m_currentFrameBufferIdx);
+
+	// Tag the fence with this frame, and let new releases belong to the next one
+	m_waitFenceFrameIdx[m_currentFrameBufferIdx] = m_frameIdx;
+	m_frameIdx++;
+	m_deletionQueue->BeginFrame(m_frameIdx);
 
 	// Present the current buffer to the swap chain
 	// Pass the semaphore signaled by the command buffer submission from the submit info as the wait semaphore for swap chain presentation
@@ -802,7 +1213,18 @@ void VulkanGraphics::Draw()
 	ERROR_IF(err, "Swapchain present");
 }
 
-void VulkanGraphics::CreatePipelineLayout(const VkDescriptorSetLayout& in_descriptorSetLayout, VkPipelineLayout& out_pipelineLayout)
+void VulkanGraphics::CollectFinishedFrame(uint32_t in_frameBufferIdx)
+{
+	// Submits go to a single queue in order, so when one frame is
+	// done all frames before it are done as well
+	uint64_t finishedFrameIdx = m_waitFenceFrameIdx[in_frameBufferIdx];
+	if (finishedFrameIdx > m_completedFrameIdx)
+		m_completedFrameIdx = finishedFrameIdx;
+	m_deletionQueue->Collect(m_completedFrameIdx);
+}
+
+void VulkanGraphics::CreatePipelineLayout(const std::vector<VkDescriptorSetLayout>& in_descriptorSetLayouts, VkPipelineLayout& out_pipelineLayout,
+	const std::vector<VkPushConstantRange>& in_pushConstantRanges/* = std::vector<VkPushConstantRange>()*/)
 {
 	// Create a pipeline layout which is to be used to create the pipeline which 
 	// uses the given descriptor set layout
@@ -812,8 +1234,11 @@ void VulkanGraphics::CreatePipelineLayout(const VkDescriptorSetLayout& in_descri
 	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
 	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	pipelineLayoutCreateInfo.pNext = nullptr;
-	pipelineLayoutCreateInfo.setLayoutCount = 1;
-	pipelineLayoutCreateInfo.pSetLayouts = &in_descriptorSetLayout;
+	pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(in_descriptorSetLayouts.size());
+	pipelineLayoutCreateInfo.pSetLayouts = in_descriptorSetLayouts.data();
+	// Small per draw data written directly into the command buffer
+	pipelineLayoutCreateInfo.pushConstantRangeCount = static_cast<uint32_t>(in_pushConstantRanges.size());
+	pipelineLayoutCreateInfo.pPushConstantRanges = in_pushConstantRanges.data();
 
 	VkResult err = vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, nullptr, &out_pipelineLayout);
 	ERROR_IF(err, "Create pipeline layout: " << vkTools::errorString(err));
@@ -880,12 +1305,13 @@ void VulkanGraphics::CreateTriangleProgramPipelineAndLoadShaders()
 	dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
 	dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
 
-	// Depth and stencil states (depth write, depth test, depth compare <=, no stencil)
+	// Depth and stencil states (depth write, depth test, depth compare <=, no stencil).
+	// After a depth prepass the depth is final, so only the fragments that wrote it pass and nothing is written.
 	VkPipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo = {};
 	depthStencilStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 	depthStencilStateCreateInfo.depthTestEnable = VK_TRUE;
-	depthStencilStateCreateInfo.depthWriteEnable = VK_TRUE;
-	depthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	depthStencilStateCreateInfo.depthWriteEnable = m_depthPrepass ? VK_FALSE : VK_TRUE;
+	depthStencilStateCreateInfo.depthCompareOp = m_depthPrepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS_OR_EQUAL;
 	depthStencilStateCreateInfo.depthBoundsTestEnable = VK_FALSE;
 	depthStencilStateCreateInfo.back.failOp = VK_STENCIL_OP_KEEP;
 	depthStencilStateCreateInfo.back.passOp = VK_STENCIL_OP_KEEP;
@@ -893,21 +1319,30 @@ void VulkanGraphics::CreateTriangleProgramPipelineAndLoadShaders()
 	depthStencilStateCreateInfo.stencilTestEnable = VK_FALSE;
 	depthStencilStateCreateInfo.front = depthStencilStateCreateInfo.back;
 
-	// Multi sampling state (disabled)
+	// Multi sampling state, must match the attachments of the render pass
 	VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo = {};
 	multisampleStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
 	multisampleStateCreateInfo.pSampleMask = nullptr;
-	multisampleStateCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT; // disabled
+	multisampleStateCreateInfo.rasterizationSamples = m_sampleCount;
 
 	// Load shaders
 	VkPipelineShaderStageCreateInfo shaderStagesCreateInfo[2] = { {},{} };
 
+#if defined(USE_INSTANCE_BUFFER)
+	const std::string vertexShader = "./../shaders/triangle_instanced.vert";
+#elif defined(USE_PUSH_CONSTANTS)
+	const std::string vertexShader = "./../shaders/triangle_push.vert";
+#else
+	const std::string vertexShader = "./../shaders/triangle.vert";
+#endif
 #ifdef USE_GLSL
-	shaderStagesCreateInfo[0] = VulkanShaderLoader::LoadShaderGLSL("./../shaders/triangle.vert", "main", m_device, VK_SHADER_STAGE_VERTEX_BIT);
+	shaderStagesCreateInfo[0] = VulkanShaderLoader::LoadShaderGLSL(vertexShader, "main", m_device, VK_SHADER_STAGE_VERTEX_BIT);
 	shaderStagesCreateInfo[1] = VulkanShaderLoader::LoadShaderGLSL("./../shaders/triangle.frag", "main", m_device, VK_SHADER_STAGE_FRAGMENT_BIT);
 #else
-	shaderStagesCreateInfo[0] = VulkanShaderLoader::LoadShaderSPIRV("./../shaders/triangle.vert.spv", "main", m_device, VK_SHADER_STAGE_VERTEX_BIT);
-	shaderStagesCreateInfo[1] = VulkanShaderLoader::LoadShaderSPIRV("./../shaders/triangle.frag.spv", "main", m_device, VK_SHADER_STAGE_FRAGMENT_BIT);
+	shaderStagesCreateInfo[0] = VulkanShaderLoader::LoadShaderSPIRV(vertexShader + ".spv", "main", m_device, VK_SHADER_STAGE_VERTEX_BIT);
+	// With the bindless table the material texture is sampled from it
+	const std::string fragmentShader = m_bindlessTable ? "./../shaders/triangle_bindless.frag" : "./../shaders/triangle.frag";
+	shaderStagesCreateInfo[1] = VulkanShaderLoader::LoadShaderSPIRV(fragmentShader + ".spv", "main", m_device, VK_SHADER_STAGE_FRAGMENT_BIT);
 #endif
 	// Store shader modules until after pipeline creation for proper cleanup
 	std::vector<ShaderModulePtr> shaderModules;
@@ -922,13 +1357,16 @@ void VulkanGraphics::CreateTriangleProgramPipelineAndLoadShaders()
 	}
 
 	// Vertex input state (use our simple vertex layout with position and color for this pipeline)
+	VulkanVertexLayout vertexLayout = *m_simpleVertexLayout.get();
+	if (m_instanceBuffer)
+		VulkanInstanceBuffer::AddToLayout(INSTANCE_BUFFER_BIND_ID, 2, vertexLayout); // matrix at locations 2-5
 	VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo = {};
 	vertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 	vertexInputStateCreateInfo.pNext = nullptr;
-	vertexInputStateCreateInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(m_simpleVertexLayout->m_bindingDescriptions.size());
-	vertexInputStateCreateInfo.pVertexBindingDescriptions = m_simpleVertexLayout->m_bindingDescriptions.data();
-	vertexInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(m_simpleVertexLayout->m_attributeDescriptions.size());
-	vertexInputStateCreateInfo.pVertexAttributeDescriptions = m_simpleVertexLayout->m_attributeDescriptions.data();
+	vertexInputStateCreateInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(vertexLayout.m_bindingDescriptions.size());
+	vertexInputStateCreateInfo.pVertexBindingDescriptions = vertexLayout.m_bindingDescriptions.data();
+	vertexInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexLayout.m_attributeDescriptions.size());
+	vertexInputStateCreateInfo.pVertexAttributeDescriptions = vertexLayout.m_attributeDescriptions.data();
 
 	// Assign all the states create infos to the main pipeline create info
 	pipelineCreateInfo.pVertexInputState = &vertexInputStateCreateInfo;
@@ -944,9 +1382,72 @@ void VulkanGraphics::CreateTriangleProgramPipelineAndLoadShaders()
 	pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
 
 	// Create the pipeline
-	err = vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &pipelineCreateInfo, nullptr, m_pipeline_TriangleProgram.Replace());
+	err = vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &pipelineCreateInfo, nullptr, m_pipeline_TriangleProgram.Replace(m_deletionQueue.get()));
 	ERROR_IF(err, "Create graphics pipeline: " << vkTools::errorString(err));
 
+	if (m_depthPrepass)
+		CreateDepthPrepassPipeline(pipelineCreateInfo);
+
 	// Shader modules can be destroyed after pipeline has been set up
 	shaderModules.clear();
 }
+
+void VulkanGraphics::CreateDepthPrepassPipeline(const VkGraphicsPipelineCreateInfo& in_mainPipelineCreateInfo)
+{
+	// The main pipeline's states, but only positions in, no fragment shader and no color writes
+	VkGraphicsPipelineCreateInfo pipelineCreateInfo = in_mainPipelineCreateInfo;
+	VkResult err;
+
+	VkPipelineColorBlendStateCreateInfo blendStateCreateInfo = *in_mainPipelineCreateInfo.pColorBlendState;
+	VkPipelineColorBlendAttachmentState blendAttachmentState[1] = {};
+	blendAttachmentState[0].colorWriteMask = 0;
+	blendAttachmentState[0].blendEnable = VK_FALSE;
+	blendStateCreateInfo.pAttachments = blendAttachmentState;
+
+	VkPipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo = *in_mainPipelineCreateInfo.pDepthStencilState;
+	depthStencilStateCreateInfo.depthWriteEnable = VK_TRUE;
+	depthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+	// Same position math as the main vertex shaders, with gl_Position invariant in both
+#if defined(USE_INSTANCE_BUFFER)
+	const std::string vertexShader = "./../shaders/depth_prepass_instanced.vert";
+#elif defined(USE_PUSH_CONSTANTS)
+	const std::string vertexShader = "./../shaders/depth_prepass_push.vert";
+#else
+	const std::string vertexShader = "./../shaders/depth_prepass.vert";
+#endif
+#ifdef USE_GLSL
+	VkPipelineShaderStageCreateInfo shaderStageCreateInfo = VulkanShaderLoader::LoadShaderGLSL(vertexShader, "main", m_device, VK_SHADER_STAGE_VERTEX_BIT);
+#else
+	VkPipelineShaderStageCreateInfo shaderStageCreateInfo = VulkanShaderLoader::LoadShaderSPIRV(vertexShader + ".spv", "main", m_device, VK_SHADER_STAGE_VERTEX_BIT);
+#endif
+	ShaderModuleType shaderModule(m_device, vkDestroyShaderModule,
+#ifdef _DEBUG
+		std::string("ShaderModule"),
+#endif
+		shaderStageCreateInfo.module);
+
+	// The packed position stream when the mesh has one, otherwise the positions of the full vertices
+	VulkanVertexLayout vertexLayout;
+	if (m_mesh->m_positions.m_count > 0)
+		DepthPrepass::GetPositionStreamLayout(m_mesh->m_positionFormat, VERTEX_BUFFER_BIND_ID, vertexLayout);
+	else
+		DepthPrepass::GetPositionLayout(*m_simpleVertexLayout.get(), vertexLayout);
+	if (m_instanceBuffer)
+		VulkanInstanceBuffer::AddToLayout(INSTANCE_BUFFER_BIND_ID, 2, vertexLayout); // matrix at locations 2-5
+	VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo = {};
+	vertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputStateCreateInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(vertexLayout.m_bindingDescriptions.size());
+	vertexInputStateCreateInfo.pVertexBindingDescriptions = vertexLayout.m_bindingDescriptions.data();
+	vertexInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexLayout.m_attributeDescriptions.size());
+	vertexInputStateCreateInfo.pVertexAttributeDescriptions = vertexLayout.m_attributeDescriptions.data();
+
+	pipelineCreateInfo.pVertexInputState = &vertexInputStateCreateInfo;
+	pipelineCreateInfo.pColorBlendState = &blendStateCreateInfo;
+	pipelineCreateInfo.pDepthStencilState = &depthStencilStateCreateInfo;
+	pipelineCreateInfo.pStages = &shaderStageCreateInfo;
+	pipelineCreateInfo.stageCount = 1; // vertex shader only
+
+	err = vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &pipelineCreateInfo, nullptr, m_pipeline_DepthPrepass.Replace(m_deletionQueue.get()));
+	ERROR_IF(err, "Create depth prepass pipeline: " << vkTools::errorString(err));
+}
@@ -1,22 +1,39 @@
 #pragma once
 #include <memory>
 #include <vector>
+#include <string>
 #include "MathTypes.h"
 #include "vulkan/vulkan.h"
 #include "VulkanDepthStencil.h"
 #include "VkObj.h"
+#include "VulkanPushConstants.h"
 
 
 class VulkanSwapChain;
 class VulkanCommandBufferFactory;
+class VulkanSecondaryCommandCache;
 class VulkanRenderPassFactory;
 class VulkanBufferFactory;
 class VulkanMemoryHelper;
+class VulkanDeletionQueue;
+class VulkanBindlessTable;
+class VulkanTextureFactory;
+class VulkanSamplerCache;
+class VulkanTexture;
+class VulkanTextureStreamer;
+class JobSystem;
 
 struct VulkanVertexLayout;
 class VulkanMesh;
+class VulkanMeshletCuller;
+class VulkanHiZPyramid;
+class VulkanInstanceBuffer;
+class VulkanGpuTimer;
+class FrustumCuller;
+class TransformHierarchy;
 
 struct VulkanUniformBufferPerFrame;
+struct RenderSnapshot;
 
 /*!
  * \class VulkanGraphics
@@ -38,10 +55,21 @@ struct VulkanUniformBufferPerFrame;
 class VulkanGraphics
 {
 public:
-	VulkanGraphics(HWND in_hWnd, HINSTANCE in_hInstance, uint32_t in_width, uint32_t in_height);
+	// in_meshPath is an optional mesh file (see MeshFile.h) to draw instead of the triangle,
+	// in_texturePath an optional KTX2 or DDS file for it (see TextureFile.h)
+	VulkanGraphics(HWND in_hWnd, HINSTANCE in_hInstance, uint32_t in_width, uint32_t in_height,
+		const std::string& in_meshPath = "", const std::string& in_texturePath = "");
 	~VulkanGraphics();
 
+	// Prepare and draw a frame on the calling thread
 	void Render();
+
+	// Split in two stages, so the next frame can be prepared on one thread while the current is
+	// drawn on another (see main.cpp). PrepareFrame does the scene side work (level of detail
+	// selection, culling) and only reads state that is fixed after construction, apart from
+	// its own frame counter. Render(snapshot) records, submits and presents.
+	void PrepareFrame(RenderSnapshot& out_snapshot);
+	void Render(const RenderSnapshot& in_snapshot);
 private:
 	// General
 	// Top level initialization steps
@@ -55,10 +83,13 @@ private:
 	// Destruction
 	void     Destroy();
 	void     DestroyCommandBuffers();
+	// Free objects released by frames the GPU has finished
+	void     CollectFinishedFrame(uint32_t in_frameBufferIdx);
 
 	// Initialization helpers
 	uint32_t GetGraphicsQueueInternalIndex() const;
 	bool     GetDepthFormat(VkFormat* out_format) const;
+	VkSampleCountFlagBits GetSampleCount(uint32_t in_requested) const;
 	VkResult CreateCommandPool(VkCommandPool* out_commandPool);
 	void     AllocateRenderCommandBuffers();
 	VkResult CreatePipelineCache();
@@ -75,11 +106,17 @@ private:
 	void CreateTriangleProgramDescriptorSetLayout();
 	void CreateTriangleProgramDescriptorPool();
 	void CreateTriangleProgramDescriptorSet();
-	void Draw();
+	void Draw(const RenderSnapshot& in_snapshot);
 
 	// TODO: Maybe move out to factory?:
-	void CreatePipelineLayout(const VkDescriptorSetLayout& in_descriptorSetLayout, VkPipelineLayout& out_pipelineLayout);
+	void CreatePipelineLayout(const std::vector<VkDescriptorSetLayout>& in_descriptorSetLayouts, VkPipelineLayout& out_pipelineLayout,
+		const std::vector<VkPushConstantRange>& in_pushConstantRanges = std::vector<VkPushConstantRange>());
 	void CreateTriangleProgramPipelineAndLoadShaders();
+	// Position only version of the main pipeline, for laying down depth before it
+	void CreateDepthPrepassPipeline(const VkGraphicsPipelineCreateInfo& in_mainPipelineCreateInfo);
+	// Record the draw command buffer of in_frameBufferIdx, or all of them with c_allFrameBuffers
+	static const uint32_t c_allFrameBuffers = ~0u;
+	void RecordDrawCommandBuffers(uint32_t in_frameBufferIdx);
 
 
 	// Data
@@ -91,11 +128,22 @@ private:
 	VkObj<VkInstance> m_vulkanInstance;
 	// Physical device object (ie. the real gpu)
 	VkPhysicalDevice m_physicalDevice; // Destroyed when instance is destroyed
+	// Optional device features that were available and enabled
+	bool m_multiDrawIndirect;
+	// Descriptor indexing is supported and enabled, see VulkanBindlessTable
+	bool m_bindless;
+	// Draw depth first and shade only visible fragments (USE_DEPTH_PREPASS)
+	bool m_depthPrepass;
+	// Cull occluded meshlets against the depth of the frame (USE_OCCLUSION_CULLING)
+	bool m_occlusionCulling;
 
 	// Vulkan memory handler
 	std::shared_ptr<VulkanMemoryHelper> m_memoryHelper;
 	// Logical device object (the app's view of the gpu)
 	VkObj<VkDevice> m_device;
+	// Deferred destruction of objects that may still be in use by frames in flight.
+	// Declared after m_device so it is destroyed, and its last entries run, before the device.
+	std::shared_ptr<VulkanDeletionQueue> m_deletionQueue;
 
 	// Queue supporting graphics
 	uint32_t m_graphicsQueueIdx;
@@ -105,8 +153,15 @@ private:
 	VkFormat m_depthFormat;
 	// Depth stencil object
 	VulkanDepthStencil m_depthStencil;
+	// Multisampled color target and the sample count of both, when multisampling
+	VulkanMultisampleColor m_multisampleColor;
+	VkSampleCountFlagBits m_sampleCount;
 	// Render pass for frame buffer writing
 	VkObj<VkRenderPass> m_renderPass;
+	// The render pass split in two around the Hi-Z pyramid build, when occlusion culling.
+	// Compatible with m_renderPass, so its pipelines and frame buffers are used with them.
+	VkObj<VkRenderPass> m_earlyRenderPass;
+	VkObj<VkRenderPass> m_lateRenderPass;
 
 	// Command buffer pool, command buffers are allocated from this
 	VkObj<VkCommandPool> m_commandPool;
@@ -116,6 +171,9 @@ private:
 	// They each store separate references to frame buffer id's
 	// - Command buffers for rendering
 	std::vector<VkCommandBuffer> m_drawCommandBuffers;
+	// The draws of the mesh, when USE_SECONDARY_COMMAND_BUFFERS. The draw command buffers are then
+	// recorded every frame and execute these, which are only recorded again when the draws change.
+	std::unique_ptr<VulkanSecondaryCommandCache> m_secondaryCommandCache;
 
 	// Surface for presenting
 	VkObj<VkSurfaceKHR> m_surface;
@@ -132,14 +190,45 @@ private:
 	std::unique_ptr<VulkanRenderPassFactory>    m_renderPassFactory;
 	std::unique_ptr<VulkanDepthStencilFactory>  m_depthStencilFactory;
 	std::unique_ptr<VulkanBufferFactory>        m_bufferFactory;
+	std::unique_ptr<VulkanTextureFactory>       m_textureFactory;
+	// Every sampler, shared by all textures and baked into the bindless table layout
+	std::shared_ptr<VulkanSamplerCache>         m_samplerCache;
+	// Workers for the parallel work of the frames and the texture loads
+	std::unique_ptr<JobSystem>                  m_jobSystem;
 
 	// Geometry
 	std::shared_ptr<VulkanVertexLayout> m_simpleVertexLayout;
-	std::shared_ptr<VulkanMesh> m_triangleMesh;
+	std::shared_ptr<VulkanMesh> m_mesh;
+	std::string m_meshPath;
+	std::shared_ptr<VulkanTexture> m_texture;
+	std::string m_texturePath;
+	uint32_t m_textureIdx; // in the bindless table
+	// Streams the mips of the texture when USE_TEXTURE_STREAMING, reading the file in jobs
+	std::unique_ptr<VulkanTextureStreamer> m_textureStreamer;
+	uint32_t m_streamedTexture;
+	// Culls and draws the meshlets of the mesh, if it has any
+	std::unique_ptr<VulkanMeshletCuller> m_meshletCuller;
+	// Farthest depth of the frame per screen region, the meshlet culler tests against it when occlusion culling
+	std::unique_ptr<VulkanHiZPyramid> m_hiZPyramid;
+	// Scene nodes, the mesh is drawn at m_meshNode. Only touched by PrepareFrame after initialization.
+	std::unique_ptr<TransformHierarchy> m_transforms;
+	uint32_t m_meshNode;
+	// Model-view-projection of the nodes per frame buffer, when drawing instanced (USE_INSTANCE_BUFFER)
+	std::unique_ptr<VulkanInstanceBuffer> m_instanceBuffer;
+	// World bounds of the nodes, to leave the ones outside the view out of the instance buffer
+	std::unique_ptr<FrustumCuller> m_instanceCuller;
+	std::vector<uint32_t> m_visibleInstances;
 
 	// Uniform buffers (think sorta like constant buffers in DX)
 	std::shared_ptr<VulkanUniformBufferPerFrame> m_ubufPerFrame;
-	glm::vec3 m_rotation; // temp rotation vector of view 
+	// Pushed per draw of the mesh, recorded with the draw command buffers
+	std::vector<VulkanPushConstants::DrawData> m_drawData;
+	glm::mat4 m_viewMatrix;
+	glm::mat4 m_projectionMatrix;
+	// Pixels per model unit at distance 1, for picking the level of detail
+	float     m_lodProjectionScale;
+	// Frames prepared, only touched by PrepareFrame
+	uint64_t  m_simulationFrameIdx;
 
 	// Pipeline layout
 	VkObj<VkPipelineLayout> m_pipelineLayout_TriangleProgram;
@@ -147,6 +236,8 @@ private:
 	VkObj<VkPipelineCache> m_pipelineCache;
 	// Pipeline
 	VkObj<VkPipeline> m_pipeline_TriangleProgram;
+	// Depth only, drawn before m_pipeline_TriangleProgram when m_depthPrepass
+	VkObj<VkPipeline> m_pipeline_DepthPrepass;
 
 	// Semaphores
 	VkObj<VkSemaphore> m_presentComplete;
@@ -157,12 +248,23 @@ private:
 	typedef VkObj<VkFence>             FenceType;
 	typedef std::unique_ptr<FenceType> FencePtr;
 	std::vector<FencePtr> m_waitFences;
+	// The frame index last submitted with each fence, and the newest frame known to be finished
+	std::vector<uint64_t> m_waitFenceFrameIdx;
+	uint64_t m_frameIdx;
+	uint64_t m_completedFrameIdx;
+	// Times the passes of the draw command buffers when USE_GPU_TIMER, summed until they are logged
+	std::unique_ptr<VulkanGpuTimer> m_gpuTimer;
+	double   m_gpuPrepassMs;
+	double   m_gpuMainMs;
+	uint32_t m_gpuTimedFrames;
 
 	// Descriptor sets
 	VkDescriptorSet                 m_descriptorSetPerFrame; // All descriptors to be used per frame
 	VkObj<VkDescriptorSetLayout>    m_descriptorSetLayoutPerFrame_TriangleProgram;
 	// Descriptor set pool
 	VkObj<VkDescriptorPool>  m_descriptorPool;
+	// Every texture and buffer in one set (set 1) indexed from shaders, when m_bindless. One copy per frame buffer.
+	std::unique_ptr<VulkanBindlessTable> m_bindlessTable;
 
 	// Function pointers
 	PFN_vkGetPhysicalDeviceSurfaceSupportKHR fpGetPhysicalDeviceSurfaceSupportKHR;
@@ -0,0 +1,267 @@
+#include "VulkanHiZPyramid.h"
+#include <algorithm>
+#include "ErrorReporting.h"
+#include "vulkantools.h"
+#include "VulkanTexture.h"
+#include "VulkanTextureFactory.h"
+#include "VulkanBufferFactory.h"
+#include "VulkanShaderLoader.h"
+#include "TextureFile.h"
+
+#ifdef _DEBUG
+#define REGISTER_VKOBJ(x, d, func, dbg) x(d, func, std::string(dbg))
+#else
+#define REGISTER_VKOBJ(x, d, func, dbg) x(d, func)
+#endif // _DEBUG
+
+namespace
+{
+	// Must match local_size_x and local_size_y of hiz_reduce.comp
+	const uint32_t c_reduceGroupSize = 8;
+
+	uint32_t HalfRoundedUp(uint32_t in_size)
+	{
+		return std::max((in_size + 1) / 2, 1u);
+	}
+}
+
+VulkanHiZPyramid::VulkanHiZPyramid(const VkObj<VkDevice>& in_device, VulkanTextureFactory& in_textureFactory,
+	const VulkanBufferFactory& in_bufferFactory, VkImageView in_depthView,
+	uint32_t in_width, uint32_t in_height, VkSampleCountFlagBits in_samples)
+	: m_device(in_device)
+	, m_depthWidth(in_width)
+	, m_depthHeight(in_height)
+	, m_samples(in_samples)
+	, m_pyramid(new VulkanTexture(in_device))
+	, REGISTER_VKOBJ(m_descriptorSetLayout, in_device, vkDestroyDescriptorSetLayout, "DescriptorSetLayout_HiZ")
+	, REGISTER_VKOBJ(m_descriptorPool, in_device, vkDestroyDescriptorPool, "DescriptorPool_HiZ")
+	, REGISTER_VKOBJ(m_pipelineLayout, in_device, vkDestroyPipelineLayout, "PipelineLayout_HiZ")
+	, REGISTER_VKOBJ(m_pipeline, in_device, vkDestroyPipeline, "Pipeline_HiZ")
+	, REGISTER_VKOBJ(m_multisamplePipeline, in_device, vkDestroyPipeline, "Pipeline_HiZMultisample")
+{
+	// Halved down to 1x1
+	TextureFile::Description description = {};
+	description.m_format = VK_FORMAT_R32_SFLOAT;
+	description.m_width = HalfRoundedUp(in_width);
+	description.m_height = HalfRoundedUp(in_height);
+	description.m_mipCount = 1;
+	for (uint32_t size = std::max(description.m_width, description.m_height); size > 1; size = HalfRoundedUp(size))
+		description.m_mipCount++;
+	description.m_layerCount = 1;
+	description.m_cube = false;
+	bool created = in_textureFactory.CreateImage(description,
+		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, *m_pyramid);
+	ERROR_IF(!created, "Create Hi-Z pyramid image");
+	m_sampler = in_textureFactory.GetSampler(VulkanTextureFactory::SamplerDesc(VK_FILTER_NEAREST,
+		VK_SAMPLER_MIPMAP_MODE_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
+
+	// Kept in the general layout, written as storage and read by the reduction and the culling
+	VkImage image = m_pyramid->m_image;
+	in_bufferFactory.SubmitOneShot([image](VkCommandBuffer in_commandBuffer)
+	{
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1 };
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(in_commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		VkClearColorValue farPlane = {};
+		farPlane.float32[0] = 1.0f;
+		vkCmdClearColorImage(in_commandBuffer, image, VK_IMAGE_LAYOUT_GENERAL, &farPlane, 1, &barrier.subresourceRange);
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(in_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+	});
+
+	for (uint32_t i = 0; i < description.m_mipCount; ++i)
+		m_levelViews.push_back(CreateLevelView(i));
+
+	// Binding 0 : the level above or the depth, 1 : the level written
+	VkDescriptorSetLayoutBinding bindings[2] = {};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = 2;
+	layoutCreateInfo.pBindings = bindings;
+	VkResult err = vkCreateDescriptorSetLayout(m_device, &layoutCreateInfo, nullptr, m_descriptorSetLayout.Replace());
+	ERROR_IF(err, "Create Hi-Z descriptor set layout: " << vkTools::errorString(err));
+
+	VkDescriptorPoolSize poolSizes[2];
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[0].descriptorCount = description.m_mipCount;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[1].descriptorCount = description.m_mipCount;
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.poolSizeCount = 2;
+	poolCreateInfo.pPoolSizes = poolSizes;
+	poolCreateInfo.maxSets = description.m_mipCount;
+	err = vkCreateDescriptorPool(m_device, &poolCreateInfo, nullptr, m_descriptorPool.Replace());
+	ERROR_IF(err, "Create Hi-Z descriptor pool: " << vkTools::errorString(err));
+
+	for (uint32_t i = 0; i < description.m_mipCount; ++i)
+	{
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = m_descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &m_descriptorSetLayout;
+		VkDescriptorSet descriptorSet;
+		err = vkAllocateDescriptorSets(m_device, &allocInfo, &descriptorSet);
+		ERROR_IF(err, "Allocate Hi-Z descriptor set: " << vkTools::errorString(err));
+
+		VkDescriptorImageInfo source = {};
+		source.sampler = m_sampler;
+		source.imageView = i == 0 ? in_depthView : m_levelViews[i - 1];
+		source.imageLayout = i == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+		VkDescriptorImageInfo destination = {};
+		destination.imageView = m_levelViews[i];
+		destination.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VkWriteDescriptorSet writes[2] = {};
+		for (uint32_t j = 0; j < 2; ++j)
+		{
+			writes[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[j].dstSet = descriptorSet;
+			writes[j].dstBinding = j;
+			writes[j].descriptorCount = 1;
+			writes[j].descriptorType = bindings[j].descriptorType;
+		}
+		writes[0].pImageInfo = &source;
+		writes[1].pImageInfo = &destination;
+		vkUpdateDescriptorSets(m_device, 2, writes, 0, nullptr);
+		m_descriptorSets.push_back(descriptorSet);
+	}
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.size = sizeof(ReduceSizes);
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &m_descriptorSetLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+	err = vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, nullptr, m_pipelineLayout.Replace());
+	ERROR_IF(err, "Create Hi-Z pipeline layout: " << vkTools::errorString(err));
+
+	*m_pipeline.Replace() = CreateReducePipeline("./../shaders/hiz_reduce.comp.spv");
+	if (m_samples != VK_SAMPLE_COUNT_1_BIT)
+		*m_multisamplePipeline.Replace() = CreateReducePipeline("./../shaders/hiz_reduce_ms.comp.spv");
+}
+
+VulkanHiZPyramid::~VulkanHiZPyramid()
+{
+	// Sets are freed with the pool
+	for (VkImageView view : m_levelViews)
+		vkDestroyImageView(m_device, view, nullptr);
+}
+
+void VulkanHiZPyramid::RecordBuild(VkCommandBuffer in_commandBuffer) const
+{
+	// The previous frame's late cull is done reading, and the render pass writing the depth
+	// has made it visible to compute (see the render pass dependencies)
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = m_pyramid->m_image;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1 };
+	barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(in_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	vkCmdBindPipeline(in_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+		m_samples != VK_SAMPLE_COUNT_1_BIT ? m_multisamplePipeline : m_pipeline);
+
+	ReduceSizes sizes;
+	sizes.m_sourceSize[0] = m_depthWidth;
+	sizes.m_sourceSize[1] = m_depthHeight;
+	sizes.m_sampleCount = static_cast<uint32_t>(m_samples);
+	for (uint32_t i = 0; i < m_levelViews.size(); ++i)
+	{
+		if (i == 1 && m_samples != VK_SAMPLE_COUNT_1_BIT)
+			vkCmdBindPipeline(in_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+
+		sizes.m_destinationSize[0] = HalfRoundedUp(sizes.m_sourceSize[0]);
+		sizes.m_destinationSize[1] = HalfRoundedUp(sizes.m_sourceSize[1]);
+		vkCmdBindDescriptorSets(in_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSets[i], 0, nullptr);
+		vkCmdPushConstants(in_commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ReduceSizes), &sizes);
+		vkCmdDispatch(in_commandBuffer, (sizes.m_destinationSize[0] + c_reduceGroupSize - 1) / c_reduceGroupSize,
+			(sizes.m_destinationSize[1] + c_reduceGroupSize - 1) / c_reduceGroupSize, 1);
+
+		// The next level reads this one, and the culling all of them after the last
+		barrier.subresourceRange.baseMipLevel = i;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(in_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		sizes.m_sourceSize[0] = sizes.m_destinationSize[0];
+		sizes.m_sourceSize[1] = sizes.m_destinationSize[1];
+		sizes.m_sampleCount = 1;
+	}
+}
+
+VkDescriptorImageInfo VulkanHiZPyramid::GetDescriptor() const
+{
+	VkDescriptorImageInfo info = {};
+	info.sampler = m_sampler;
+	info.imageView = m_pyramid->m_imageView;
+	info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	return info;
+}
+
+uint32_t VulkanHiZPyramid::GetLevelCount() const
+{
+	return m_pyramid->m_mipCount;
+}
+
+VkPipeline VulkanHiZPyramid::CreateReducePipeline(const char* in_shaderPath) const
+{
+	VkComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.layout = m_pipelineLayout;
+	pipelineCreateInfo.stage = VulkanShaderLoader::LoadShaderSPIRV(in_shaderPath, "main", m_device, VK_SHADER_STAGE_COMPUTE_BIT);
+	VkPipeline pipeline;
+	VkResult err = vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &pipeline);
+	ERROR_IF(err, "Create Hi-Z reduce pipeline: " << vkTools::errorString(err));
+
+	// The module isn't needed after pipeline creation
+	vkDestroyShaderModule(m_device, pipelineCreateInfo.stage.module, nullptr);
+	return pipeline;
+}
+
+VkImageView VulkanHiZPyramid::CreateLevelView(uint32_t in_level) const
+{
+	VkImageViewCreateInfo viewCreateInfo = {};
+	viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewCreateInfo.image = m_pyramid->m_image;
+	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewCreateInfo.format = m_pyramid->m_format;
+	viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, in_level, 1, 0, 1 };
+	VkImageView view;
+	VkResult err = vkCreateImageView(m_device, &viewCreateInfo, nullptr, &view);
+	ERROR_IF(err, "Create Hi-Z level view: " << vkTools::errorString(err));
+	return view;
+}
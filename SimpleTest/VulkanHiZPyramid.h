@@ -0,0 +1,87 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include <vector>
+#include <memory>
+#include "VkObj.h"
+
+class VulkanTextureFactory;
+class VulkanBufferFactory;
+class VulkanTexture;
+
+// Cull meshlets hidden behind the depth of the frame, needs USE_GPU_MESHLET_CULLING
+//#define USE_OCCLUSION_CULLING
+
+/*!
+* \class VulkanHiZPyramid
+*
+* \brief
+*
+* Hierarchical depth: a mip chain where every texel holds the farthest depth of the four
+* below it. Level 0 is half the size of the depth attachment, and a bounds rectangle is
+* tested against a level where it covers at most 2x2 texels. Anything nearer than the
+* farthest depth there may be visible, anything behind it is occluded.
+*
+* Built by a compute reduction (hiz_reduce.comp) from the depth attachment after it has
+* been written, recorded in the draw command buffers between the early and late passes
+* of occlusion culling (see VulkanMeshletCuller and
+* VulkanRenderPassFactory::CreateOcclusionRenderPasses). Multisampled depth is reduced
+* over its samples as well.
+*
+* There is one pyramid shared by all frame buffers. Frames are submitted in order on one
+* queue and the build is surrounded by barriers, so the next frame's early cull always
+* sees the pyramid of the frame before it. It starts out at the far plane, which occludes
+* nothing.
+*/
+
+class VulkanHiZPyramid
+{
+public:
+	// in_depthView is the depth aspect of the attachment (see VulkanDepthStencil::m_sampledView),
+	// in_width and in_height its size
+	VulkanHiZPyramid(const VkObj<VkDevice>& in_device, VulkanTextureFactory& in_textureFactory,
+		const VulkanBufferFactory& in_bufferFactory, VkImageView in_depthView,
+		uint32_t in_width, uint32_t in_height, VkSampleCountFlagBits in_samples);
+	~VulkanHiZPyramid();
+
+	// Record the reduction of the depth attachment into the pyramid, outside of a render pass and after
+	// the one writing the depth. The pyramid is left for reading in compute shaders.
+	void RecordBuild(VkCommandBuffer in_commandBuffer) const;
+
+	// All levels with a nearest sampler, for texelFetch in compute shaders
+	VkDescriptorImageInfo GetDescriptor() const;
+
+	// Size of the depth attachment the pyramid is built from, level 0 is half of it rounded up
+	uint32_t GetDepthWidth() const { return m_depthWidth; }
+	uint32_t GetDepthHeight() const { return m_depthHeight; }
+	uint32_t GetLevelCount() const;
+
+private:
+	// Matches the push constants of hiz_reduce.comp
+	struct ReduceSizes
+	{
+		uint32_t m_sourceSize[2];
+		uint32_t m_destinationSize[2];
+		uint32_t m_sampleCount;
+	};
+
+	VkPipeline CreateReducePipeline(const char* in_shaderPath) const;
+	VkImageView CreateLevelView(uint32_t in_level) const;
+
+	const VkObj<VkDevice>& m_device;
+	uint32_t               m_depthWidth;
+	uint32_t               m_depthHeight;
+	VkSampleCountFlagBits  m_samples;
+	VkSampler              m_sampler; // owned by the sampler cache
+
+	std::unique_ptr<VulkanTexture> m_pyramid;
+	std::vector<VkImageView>       m_levelViews;     // storage views, one per level
+	std::vector<VkDescriptorSet>   m_descriptorSets; // reads the level above (or the depth), writes the level
+
+	VkObj<VkDescriptorSetLayout> m_descriptorSetLayout;
+	VkObj<VkDescriptorPool>      m_descriptorPool;
+	VkObj<VkPipelineLayout>      m_pipelineLayout;
+	VkObj<VkPipeline>            m_pipeline;
+	// Reduces the samples of multisampled depth into level 0
+	VkObj<VkPipeline>            m_multisamplePipeline;
+};
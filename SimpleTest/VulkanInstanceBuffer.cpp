@@ -0,0 +1,115 @@
+#include "VulkanInstanceBuffer.h"
+#include <cstring>
+#include <algorithm>
+#include "ErrorReporting.h"
+#include "vulkantools.h"
+#include "VulkanBufferFactory.h"
+#include "VulkanMesh.h"
+#include "VulkanVertexLayout.h"
+
+#ifdef _DEBUG
+#define REGISTER_VKOBJ(x, d, func, dbg) x(d, func, std::string(dbg))
+#else
+#define REGISTER_VKOBJ(x, d, func, dbg) x(d, func)
+#endif // _DEBUG
+
+VulkanInstanceBuffer::FrameResources::FrameResources(const VkObj<VkDevice>& in_device)
+	: REGISTER_VKOBJ(m_buffer, in_device, vkDestroyBuffer, "InstanceBuffer")
+	, REGISTER_VKOBJ(m_memory, in_device, vkFreeMemory, "InstanceMemory")
+	, m_mapped(nullptr)
+	, REGISTER_VKOBJ(m_indirectBuffer, in_device, vkDestroyBuffer, "InstanceIndirectBuffer")
+	, REGISTER_VKOBJ(m_indirectMemory, in_device, vkFreeMemory, "InstanceIndirectMemory")
+	, m_commands(nullptr)
+{
+}
+
+VulkanInstanceBuffer::VulkanInstanceBuffer(const VkObj<VkDevice>& in_device, const VulkanBufferFactory& in_bufferFactory,
+	const VulkanMesh& in_mesh, uint32_t in_frameBufferCount, uint32_t in_instanceCount)
+	: m_device(in_device)
+	, m_instanceCount(in_instanceCount)
+	, m_drawCount(0)
+{
+	ERROR_IF(in_instanceCount == 0, "Instance buffer without instances");
+	VkDeviceSize size = VkDeviceSize(m_instanceCount) * sizeof(glm::mat4);
+	// Identity until written, so nothing is collapsed to a point if a frame is drawn first
+	std::vector<glm::mat4> identities(m_instanceCount, glm::mat4());
+
+	// The same draws as RecordRangeDraws of the command buffer factory, without instances until written
+	std::vector<VkDrawIndexedIndirectCommand> commands;
+	if (in_mesh.m_submeshes.empty())
+	{
+		commands.push_back({ in_mesh.m_indices.m_count, 0, 0, 0, 0 });
+	}
+	for (const VulkanMesh::Submesh& submesh : in_mesh.m_submeshes)
+	{
+		commands.push_back({ submesh.m_indexCount, 0, submesh.m_firstIndex, submesh.m_vertexOffset, 0 });
+	}
+	m_drawCount = static_cast<uint32_t>(commands.size());
+	VkDeviceSize indirectSize = VkDeviceSize(m_drawCount) * sizeof(VkDrawIndexedIndirectCommand);
+
+	for (uint32_t i = 0; i < in_frameBufferCount; ++i)
+	{
+		std::unique_ptr<FrameResources> frame = std::make_unique<FrameResources>(m_device);
+		in_bufferFactory.CreateBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, size, identities.data(),
+			*frame->m_buffer.Replace(), *frame->m_memory.Replace(),
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		VkResult err = vkMapMemory(m_device, frame->m_memory, 0, size, 0, &frame->m_mapped);
+		ERROR_IF(err, "Map instance buffer: " << vkTools::errorString(err));
+
+		in_bufferFactory.CreateBuffer(VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, indirectSize, commands.data(),
+			*frame->m_indirectBuffer.Replace(), *frame->m_indirectMemory.Replace(),
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		void* mapped = nullptr;
+		err = vkMapMemory(m_device, frame->m_indirectMemory, 0, indirectSize, 0, &mapped);
+		ERROR_IF(err, "Map instance indirect buffer: " << vkTools::errorString(err));
+		frame->m_commands = static_cast<VkDrawIndexedIndirectCommand*>(mapped);
+		m_frames.push_back(std::move(frame));
+	}
+}
+
+VulkanInstanceBuffer::~VulkanInstanceBuffer()
+{
+	// Memory is implicitly unmapped when freed
+}
+
+void VulkanInstanceBuffer::Write(uint32_t in_frameBufferIdx, const glm::mat4* in_matrices, size_t in_count)
+{
+	FrameResources& frame = *m_frames[in_frameBufferIdx];
+	size_t count = std::min(in_count, size_t(m_instanceCount));
+	if (count > 0)
+		memcpy(frame.m_mapped, in_matrices, count * sizeof(glm::mat4));
+	for (uint32_t i = 0; i < m_drawCount; ++i)
+		frame.m_commands[i].instanceCount = static_cast<uint32_t>(count);
+}
+
+void VulkanInstanceBuffer::Bind(VkCommandBuffer in_commandBuffer, uint32_t in_frameBufferIdx, uint32_t in_bindId) const
+{
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(in_commandBuffer, in_bindId, 1, &m_frames[in_frameBufferIdx]->m_buffer, &offset);
+}
+
+void VulkanInstanceBuffer::RecordDraw(VkCommandBuffer in_commandBuffer, uint32_t in_frameBufferIdx, size_t in_range) const
+{
+	ERROR_IF(in_range >= m_drawCount, "Instanced draw of a missing submesh");
+	vkCmdDrawIndexedIndirect(in_commandBuffer, m_frames[in_frameBufferIdx]->m_indirectBuffer,
+		VkDeviceSize(in_range) * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void VulkanInstanceBuffer::AddToLayout(uint32_t in_bindId, uint32_t in_firstLocation, VulkanVertexLayout& inout_layout)
+{
+	VkVertexInputBindingDescription binding = {};
+	binding.binding = in_bindId;
+	binding.stride = sizeof(glm::mat4);
+	binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+	inout_layout.m_bindingDescriptions.push_back(binding);
+
+	for (uint32_t column = 0; column < 4; ++column)
+	{
+		VkVertexInputAttributeDescription attribute = {};
+		attribute.binding = in_bindId;
+		attribute.location = in_firstLocation + column;
+		attribute.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attribute.offset = column * sizeof(glm::vec4);
+		inout_layout.m_attributeDescriptions.push_back(attribute);
+	}
+}
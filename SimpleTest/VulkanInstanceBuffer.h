@@ -0,0 +1,72 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include <vector>
+#include <memory>
+#include "MathTypes.h"
+#include "VkObj.h"
+
+class VulkanBufferFactory;
+class VulkanMesh;
+struct VulkanVertexLayout;
+
+// Draw with a model-view-projection per instance read from the instance buffer (triangle_instanced.vert),
+// otherwise the one of the per frame uniform buffer is used
+//#define USE_INSTANCE_BUFFER
+
+/*!
+* \class VulkanInstanceBuffer
+*
+* \brief
+*
+* Per instance matrices as a vertex buffer stepped per instance, one buffer per frame buffer
+* so the next frame can be written while the previous ones are still drawn.
+*
+* The buffers are host visible and stay mapped, Write() copies straight into the one of the
+* frame buffer about to be drawn, after its fence has been waited on.
+*
+* Only the written instances are drawn: each frame buffer also has an indirect buffer with a
+* VkDrawIndexedIndirectCommand per submesh (or one for the whole mesh) and Write() sets their
+* instance count, so recorded command buffers stay valid while the visible count changes.
+*
+* A matrix takes four vertex attributes, one per column.
+*/
+
+class VulkanInstanceBuffer
+{
+public:
+	VulkanInstanceBuffer(const VkObj<VkDevice>& in_device, const VulkanBufferFactory& in_bufferFactory,
+		const VulkanMesh& in_mesh, uint32_t in_frameBufferCount, uint32_t in_instanceCount);
+	~VulkanInstanceBuffer();
+
+	// Copy in_count matrices to the buffer of in_frameBufferIdx, starting at instance 0,
+	// and draw that many instances from it
+	void Write(uint32_t in_frameBufferIdx, const glm::mat4* in_matrices, size_t in_count);
+
+	// Bind the buffer of in_frameBufferIdx to in_bindId
+	void Bind(VkCommandBuffer in_commandBuffer, uint32_t in_frameBufferIdx, uint32_t in_bindId) const;
+
+	// Draw the written instances of submesh in_range (0 without submeshes), the index buffer must be bound
+	void RecordDraw(VkCommandBuffer in_commandBuffer, uint32_t in_frameBufferIdx, size_t in_range) const;
+
+	// Add the per instance binding in_bindId and the matrix columns at in_firstLocation..+3 to inout_layout
+	static void AddToLayout(uint32_t in_bindId, uint32_t in_firstLocation, VulkanVertexLayout& inout_layout);
+
+private:
+	struct FrameResources
+	{
+		FrameResources(const VkObj<VkDevice>& in_device);
+		VkObj<VkBuffer>       m_buffer;
+		VkObj<VkDeviceMemory> m_memory;
+		void*                 m_mapped;
+		VkObj<VkBuffer>       m_indirectBuffer;
+		VkObj<VkDeviceMemory> m_indirectMemory;
+		VkDrawIndexedIndirectCommand* m_commands; // mapped
+	};
+
+	const VkObj<VkDevice>& m_device;
+	uint32_t               m_instanceCount;
+	uint32_t               m_drawCount;
+
+	std::vector<std::unique_ptr<FrameResources>> m_frames;
+};
@@ -27,3 +27,10 @@ VkBool32 VulkanMemoryHelper::GetMemoryType(uint32_t typeBits, VkFlags properties
 	return false;
 }
 
+VkBool32 VulkanMemoryHelper::GetTransientMemoryType(uint32_t typeBits, uint32_t * typeIndex, bool * out_lazilyAllocated/* = nullptr*/) const
+{
+	bool lazilyAllocated = GetMemoryType(typeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, typeIndex) == VK_TRUE;
+	if (out_lazilyAllocated)
+		*out_lazilyAllocated = lazilyAllocated;
+	return lazilyAllocated || GetMemoryType(typeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, typeIndex);
+}
@@ -9,6 +9,9 @@ public:
 	~VulkanMemoryHelper();
 
 	VkBool32 GetMemoryType(uint32_t typeBits, VkFlags properties, uint32_t * typeIndex) const;
+	// For transient attachments: lazily allocated device local memory where there is such (tilers),
+	// which may never be backed at all. Otherwise plain device local.
+	VkBool32 GetTransientMemoryType(uint32_t typeBits, uint32_t * typeIndex, bool * out_lazilyAllocated = nullptr) const;
 	VkPhysicalDeviceMemoryProperties GetAvailableMemoryProperties() { return m_physicalDeviceMemProp; }
 private:
 	// Available memory properties for the physical device
@@ -2,7 +2,9 @@
 
 #include "vulkan/vulkan.h"
 #include <vector>
+#include "MathTypes.h"
 #include "VkObj.h"
+#include "Meshlet.h"
 
 class VulkanMesh
 {
@@ -28,6 +30,7 @@ public:
 	{
 		Indices(const VkObj<VkDevice>& in_device)
 			: m_count()
+			, m_type(VK_INDEX_TYPE_UINT32)
 			, m_buffer(in_device, vkDestroyBuffer)
 			, m_gpuMem(in_device, vkFreeMemory)
 		{
@@ -37,18 +40,75 @@ public:
 #endif // _DEBUG
 		}
 		uint32_t m_count;
+		VkIndexType m_type; // 16 bit when all indices fit
 		VkObj<VkBuffer> m_buffer;
 		VkObj<VkDeviceMemory> m_gpuMem;
 	};
 
+	// A range of the index buffer, drawn with its own vertex offset
+	struct Submesh
+	{
+		uint32_t m_firstIndex;
+		uint32_t m_indexCount;
+		int32_t  m_vertexOffset;
+	};
+
+	// A level of detail, a run of submeshes and meshlets (see MeshData::Lod)
+	struct Lod
+	{
+		uint32_t m_firstSubmesh;
+		uint32_t m_submeshCount;
+		uint32_t m_firstMeshlet;
+		uint32_t m_meshletCount;
+		float    m_error;
+	};
+
 	VulkanMesh(const VkObj<VkDevice>& in_device)
 		: m_vertices(in_device)
+		, m_positions(in_device)
+		, m_positionFormat(VK_FORMAT_UNDEFINED)
 		, m_indices(in_device)
+		, m_boundsMin()
+		, m_boundsMax()
+		, m_dequantize()
 	{}
 
+	// Hand all buffers over to the deletion queue, for swapping out a mesh that may still be drawn
+	void Release(VulkanDeletionQueue& inout_deletionQueue)
+	{
+		m_vertices.m_buffer.Release(inout_deletionQueue);
+		m_vertices.m_gpuMem.Release(inout_deletionQueue);
+		m_vertices.m_count = 0;
+		m_positions.m_buffer.Release(inout_deletionQueue);
+		m_positions.m_gpuMem.Release(inout_deletionQueue);
+		m_positions.m_count = 0;
+		m_indices.m_buffer.Release(inout_deletionQueue);
+		m_indices.m_gpuMem.Release(inout_deletionQueue);
+		m_indices.m_count = 0;
+		m_submeshes.clear();
+		m_meshlets.clear();
+		m_lods.clear();
+	}
+
 	Vertices m_vertices;
+	// Optional copy of just the positions, packed, for position only passes (see DepthPrepass)
+	Vertices m_positions;
+	VkFormat m_positionFormat;
 	Indices  m_indices;
 
+	// Empty means draw all indices as one range
+	std::vector<Submesh> m_submeshes;
+	// Optional clusters of the submeshes for culling, see VulkanMeshletCuller
+	std::vector<Meshlet> m_meshlets;
+	// Empty means the submeshes are a single level
+	std::vector<Lod> m_lods;
+	glm::vec3 m_boundsMin;
+	glm::vec3 m_boundsMax;
+
+	// Maps the stored vertex positions to model space, applied as part of the world matrix.
+	// Identity unless the mesh has quantized positions.
+	glm::mat4 m_dequantize;
+
 private:
 
 };
\ No newline at end of file
@@ -0,0 +1,389 @@
+#include "VulkanMeshletCuller.h"
+#include <cstring>
+#include <algorithm>
+#include "ErrorReporting.h"
+#include "vulkantools.h"
+#include "VulkanMesh.h"
+#include "VulkanBufferFactory.h"
+#include "VulkanShaderLoader.h"
+#include "VulkanHiZPyramid.h"
+#include "Frustum.h"
+
+#ifdef _DEBUG
+#define REGISTER_VKOBJ(x, d, func, dbg) x(d, func, std::string(dbg))
+#else
+#define REGISTER_VKOBJ(x, d, func, dbg) x(d, func)
+#endif // _DEBUG
+
+namespace
+{
+	// Must match local_size_x of meshlet_cull.comp
+	const uint32_t c_cullGroupSize = 64;
+}
+
+VulkanMeshletCuller::FrameResources::FrameResources(const VkObj<VkDevice>& in_device)
+	: REGISTER_VKOBJ(m_indirectBuffer, in_device, vkDestroyBuffer, "MeshletIndirectBuffer")
+	, REGISTER_VKOBJ(m_indirectMemory, in_device, vkFreeMemory, "MeshletIndirectMemory")
+	, REGISTER_VKOBJ(m_lateIndirectBuffer, in_device, vkDestroyBuffer, "MeshletLateIndirectBuffer")
+	, REGISTER_VKOBJ(m_lateIndirectMemory, in_device, vkFreeMemory, "MeshletLateIndirectMemory")
+	, REGISTER_VKOBJ(m_candidateBuffer, in_device, vkDestroyBuffer, "MeshletCandidateBuffer")
+	, REGISTER_VKOBJ(m_candidateMemory, in_device, vkFreeMemory, "MeshletCandidateMemory")
+	, REGISTER_VKOBJ(m_paramsBuffer, in_device, vkDestroyBuffer, "MeshletCullParamsBuffer")
+	, REGISTER_VKOBJ(m_paramsMemory, in_device, vkFreeMemory, "MeshletCullParamsMemory")
+	, m_mapped(nullptr)
+	, m_descriptorSet(VK_NULL_HANDLE)
+	, m_lastVisible(0)
+{
+}
+
+VulkanMeshletCuller::VulkanMeshletCuller(const VkObj<VkDevice>& in_device, const VulkanBufferFactory& in_bufferFactory,
+	const VulkanMesh& in_mesh, uint32_t in_frameBufferCount,
+	const VulkanHiZPyramid* in_hiZPyramid/* = nullptr*/)
+	: m_device(in_device)
+	, m_mesh(in_mesh)
+#ifdef USE_GPU_MESHLET_CULLING
+	, m_gpuCulling(true)
+#else
+	, m_gpuCulling(false)
+#endif
+	, m_stats()
+	, m_hiZPyramid(nullptr)
+	, m_hasPreviousFrame(false)
+	, REGISTER_VKOBJ(m_meshletBuffer, in_device, vkDestroyBuffer, "MeshletBuffer")
+	, REGISTER_VKOBJ(m_meshletMemory, in_device, vkFreeMemory, "MeshletMemory")
+	, REGISTER_VKOBJ(m_descriptorSetLayout, in_device, vkDestroyDescriptorSetLayout, "DescriptorSetLayout_MeshletCull")
+	, REGISTER_VKOBJ(m_descriptorPool, in_device, vkDestroyDescriptorPool, "DescriptorPool_MeshletCull")
+	, REGISTER_VKOBJ(m_pipelineLayout, in_device, vkDestroyPipelineLayout, "PipelineLayout_MeshletCull")
+	, REGISTER_VKOBJ(m_pipeline, in_device, vkDestroyPipeline, "Pipeline_MeshletCull")
+{
+	m_maxDrawCount = static_cast<uint32_t>(m_mesh.m_meshlets.size());
+	if (!m_mesh.m_lods.empty())
+	{
+		m_maxDrawCount = 0;
+		for (const VulkanMesh::Lod& lod : m_mesh.m_lods)
+			m_maxDrawCount = std::max(m_maxDrawCount, lod.m_meshletCount);
+	}
+	m_stats.m_meshletCount = m_maxDrawCount;
+	if (m_gpuCulling)
+		m_hiZPyramid = in_hiZPyramid;
+	m_stats.m_visible = 0;
+	m_indirectSize = c_commandsOffset + VkDeviceSize(m_maxDrawCount) * sizeof(VkDrawIndexedIndirectCommand);
+	std::vector<uint8_t> zeroes(static_cast<size_t>(m_indirectSize), 0);
+
+	for (uint32_t i = 0; i < in_frameBufferCount; ++i)
+	{
+		std::unique_ptr<FrameResources> frame = std::make_unique<FrameResources>(m_device);
+		VkResult err;
+		if (m_gpuCulling)
+		{
+			// Written by the cull shader, the CPU only updates the parameters
+			in_bufferFactory.CreateBuffer(VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				m_indirectSize, nullptr, *frame->m_indirectBuffer.Replace(), *frame->m_indirectMemory.Replace(),
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			in_bufferFactory.CreateBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, sizeof(CullParams), nullptr,
+				*frame->m_paramsBuffer.Replace(), *frame->m_paramsMemory.Replace(),
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			err = vkMapMemory(m_device, frame->m_paramsMemory, 0, sizeof(CullParams), 0, &frame->m_mapped);
+			if (m_hiZPyramid != nullptr)
+			{
+				in_bufferFactory.CreateBuffer(VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					m_indirectSize, nullptr, *frame->m_lateIndirectBuffer.Replace(), *frame->m_lateIndirectMemory.Replace(),
+					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+				in_bufferFactory.CreateBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					c_commandsOffset + VkDeviceSize(m_maxDrawCount) * sizeof(uint32_t), nullptr,
+					*frame->m_candidateBuffer.Replace(), *frame->m_candidateMemory.Replace(), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			}
+		}
+		else
+		{
+			// Written directly by the CPU cull, kept mapped
+			in_bufferFactory.CreateBuffer(VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, m_indirectSize, zeroes.data(),
+				*frame->m_indirectBuffer.Replace(), *frame->m_indirectMemory.Replace(),
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			err = vkMapMemory(m_device, frame->m_indirectMemory, 0, m_indirectSize, 0, &frame->m_mapped);
+		}
+		ERROR_IF(err, "Map meshlet culling buffer: " << vkTools::errorString(err));
+		m_frames.push_back(std::move(frame));
+	}
+
+	if (m_gpuCulling)
+	{
+		in_bufferFactory.CreateDeviceLocalBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			sizeof(Meshlet) * m_mesh.m_meshlets.size(), m_mesh.m_meshlets.data(),
+			*m_meshletBuffer.Replace(), *m_meshletMemory.Replace());
+		CreateCullPipeline();
+	}
+}
+
+VulkanMeshletCuller::~VulkanMeshletCuller()
+{
+	// Sets are freed with the pool, and memory is implicitly unmapped when freed
+}
+
+void VulkanMeshletCuller::Cull(const glm::mat4& in_modelViewProjection, const glm::vec3& in_cameraPos, uint32_t in_lod,
+	CullResult& out_result) const
+{
+	Frustum frustum = Frustum::FromMatrix(in_modelViewProjection);
+
+	uint32_t firstMeshlet = 0;
+	uint32_t meshletCount = static_cast<uint32_t>(m_mesh.m_meshlets.size());
+	if (!m_mesh.m_lods.empty())
+	{
+		in_lod = std::min(in_lod, static_cast<uint32_t>(m_mesh.m_lods.size()) - 1);
+		firstMeshlet = m_mesh.m_lods[in_lod].m_firstMeshlet;
+		meshletCount = m_mesh.m_lods[in_lod].m_meshletCount;
+	}
+	Stats& stats = out_result.m_stats;
+	stats = Stats();
+	stats.m_lod = in_lod;
+	stats.m_meshletCount = meshletCount;
+	out_result.m_commands.clear();
+
+	if (m_gpuCulling)
+	{
+		CullParams& params = out_result.m_params;
+		params = CullParams();
+		for (int i = 0; i < Frustum::PLANE_COUNT; ++i)
+			params.m_frustumPlanes[i] = frustum.m_planes[i];
+		params.m_cameraPos = glm::vec4(in_cameraPos, 1.0f);
+		params.m_modelViewProjection = in_modelViewProjection;
+		params.m_previousModelViewProjection = in_modelViewProjection;
+		if (m_hiZPyramid != nullptr)
+		{
+			params.m_pyramidSize = glm::vec4(static_cast<float>(m_hiZPyramid->GetDepthWidth()),
+				static_cast<float>(m_hiZPyramid->GetDepthHeight()), static_cast<float>(m_hiZPyramid->GetLevelCount()), 0.0f);
+		}
+		params.m_meshletCount = meshletCount;
+		params.m_firstMeshlet = firstMeshlet;
+		return;
+	}
+
+	for (uint32_t i = firstMeshlet; i < firstMeshlet + meshletCount; ++i)
+	{
+		const Meshlet& meshlet = m_mesh.m_meshlets[i];
+		if (!frustum.IntersectsSphere(glm::vec3(meshlet.m_center[0], meshlet.m_center[1], meshlet.m_center[2]), meshlet.m_radius))
+		{
+			stats.m_frustumCulled++;
+			continue;
+		}
+		if (IsMeshletBackfacing(meshlet, in_cameraPos))
+		{
+			stats.m_backfaceCulled++;
+			continue;
+		}
+		VkDrawIndexedIndirectCommand command;
+		command.indexCount = meshlet.m_indexCount;
+		command.instanceCount = 1;
+		command.firstIndex = meshlet.m_firstIndex;
+		command.vertexOffset = meshlet.m_vertexOffset;
+		command.firstInstance = 0;
+		out_result.m_commands.push_back(command);
+	}
+	stats.m_visible = static_cast<uint32_t>(out_result.m_commands.size());
+}
+
+void VulkanMeshletCuller::Update(uint32_t in_frameBufferIdx, const CullResult& in_result)
+{
+	FrameResources& frame = *m_frames[in_frameBufferIdx];
+	m_stats = in_result.m_stats;
+
+	if (m_gpuCulling)
+	{
+		memcpy(frame.m_mapped, &in_result.m_params, sizeof(CullParams));
+		if (m_hiZPyramid != nullptr)
+		{
+			// Frames are submitted in the order they are updated, so the pyramid the early phase reads
+			// was drawn with the last update's matrix. Before the first frame it occludes nothing.
+			CullParams* params = static_cast<CullParams*>(frame.m_mapped);
+			if (m_hasPreviousFrame)
+				params->m_previousModelViewProjection = m_previousModelViewProjection;
+			m_previousModelViewProjection = in_result.m_params.m_modelViewProjection;
+			m_hasPreviousFrame = true;
+		}
+		return;
+	}
+
+	// The fence of this frame buffer has been waited on, so the GPU is done reading the buffer
+	uint8_t* mapped = static_cast<uint8_t*>(frame.m_mapped);
+	VkDrawIndexedIndirectCommand* commands = reinterpret_cast<VkDrawIndexedIndirectCommand*>(mapped + c_commandsOffset);
+	uint32_t visible = static_cast<uint32_t>(in_result.m_commands.size());
+	if (visible > 0)
+		memcpy(commands, in_result.m_commands.data(), visible * sizeof(VkDrawIndexedIndirectCommand));
+
+	// Zero what is left of the last frame's commands
+	if (frame.m_lastVisible > visible)
+		memset(commands + visible, 0, (frame.m_lastVisible - visible) * sizeof(VkDrawIndexedIndirectCommand));
+	memcpy(mapped, &visible, sizeof(uint32_t));
+	frame.m_lastVisible = visible;
+}
+
+void VulkanMeshletCuller::RecordCull(VkCommandBuffer in_commandBuffer, uint32_t in_frameBufferIdx, Phase in_phase/* = PHASE_EARLY*/) const
+{
+	if (!m_gpuCulling) return;
+	if (in_phase == PHASE_LATE && m_hiZPyramid == nullptr) return;
+	const FrameResources& frame = *m_frames[in_frameBufferIdx];
+	VkBuffer indirectBuffer = in_phase == PHASE_LATE ? frame.m_lateIndirectBuffer : frame.m_indirectBuffer;
+
+	// Clear count and commands, the shader appends the visible meshlets.
+	// The candidates are appended by the early phase and read by the late.
+	ClearForCull(in_commandBuffer, indirectBuffer, m_indirectSize);
+	if (in_phase == PHASE_EARLY && m_hiZPyramid != nullptr)
+		ClearForCull(in_commandBuffer, frame.m_candidateBuffer, c_commandsOffset);
+
+	vkCmdBindPipeline(in_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+	vkCmdBindDescriptorSets(in_commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &frame.m_descriptorSet, 0, nullptr);
+	if (m_hiZPyramid != nullptr)
+	{
+		uint32_t late = in_phase == PHASE_LATE ? 1 : 0;
+		vkCmdPushConstants(in_commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &late);
+	}
+	// Enough groups for the largest level, the shader skips what is past the current one (or the candidates)
+	vkCmdDispatch(in_commandBuffer, (m_maxDrawCount + c_cullGroupSize - 1) / c_cullGroupSize, 1, 1);
+
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = indirectBuffer;
+	barrier.offset = 0;
+	barrier.size = m_indirectSize;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	vkCmdPipelineBarrier(in_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+		0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	if (in_phase == PHASE_EARLY && m_hiZPyramid != nullptr)
+	{
+		barrier.buffer = frame.m_candidateBuffer;
+		barrier.size = VK_WHOLE_SIZE;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(in_commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+}
+
+void VulkanMeshletCuller::RecordDraws(VkCommandBuffer in_commandBuffer, uint32_t in_frameBufferIdx, Phase in_phase/* = PHASE_EARLY*/) const
+{
+	if (in_phase == PHASE_LATE && m_hiZPyramid == nullptr) return;
+	const FrameResources& frame = *m_frames[in_frameBufferIdx];
+	VkBuffer indirectBuffer = in_phase == PHASE_LATE ? frame.m_lateIndirectBuffer : frame.m_indirectBuffer;
+	vkCmdDrawIndexedIndirect(in_commandBuffer, indirectBuffer, c_commandsOffset, m_maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void VulkanMeshletCuller::ClearForCull(VkCommandBuffer in_commandBuffer, VkBuffer in_buffer, VkDeviceSize in_size)
+{
+	vkCmdFillBuffer(in_commandBuffer, in_buffer, 0, in_size, 0);
+
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = in_buffer;
+	barrier.offset = 0;
+	barrier.size = in_size;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(in_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void VulkanMeshletCuller::CreateCullPipeline()
+{
+	// Binding 0 : cull parameters, 1 : meshlets, 2 : indirect draw commands,
+	// with occlusion culling 3 : late indirect draw commands, 4 : candidates, 5 : Hi-Z pyramid
+	const uint32_t bindingCount = m_hiZPyramid != nullptr ? 6 : 3;
+	VkDescriptorSetLayoutBinding bindings[6] = {};
+	VkDescriptorType types[6] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER };
+	for (uint32_t i = 0; i < bindingCount; ++i)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = types[i];
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+	layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutCreateInfo.bindingCount = bindingCount;
+	layoutCreateInfo.pBindings = bindings;
+	VkResult err = vkCreateDescriptorSetLayout(m_device, &layoutCreateInfo, nullptr, m_descriptorSetLayout.Replace());
+	ERROR_IF(err, "Create meshlet cull descriptor set layout: " << vkTools::errorString(err));
+
+	uint32_t frameCount = static_cast<uint32_t>(m_frames.size());
+	VkDescriptorPoolSize poolSizes[3];
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = frameCount;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = frameCount * (m_hiZPyramid != nullptr ? 4 : 2);
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[2].descriptorCount = frameCount;
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.poolSizeCount = m_hiZPyramid != nullptr ? 3 : 2;
+	poolCreateInfo.pPoolSizes = poolSizes;
+	poolCreateInfo.maxSets = frameCount;
+	err = vkCreateDescriptorPool(m_device, &poolCreateInfo, nullptr, m_descriptorPool.Replace());
+	ERROR_IF(err, "Create meshlet cull descriptor pool: " << vkTools::errorString(err));
+
+	for (std::unique_ptr<FrameResources>& frame : m_frames)
+	{
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = m_descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &m_descriptorSetLayout;
+		err = vkAllocateDescriptorSets(m_device, &allocInfo, &frame->m_descriptorSet);
+		ERROR_IF(err, "Allocate meshlet cull descriptor set: " << vkTools::errorString(err));
+
+		VkDescriptorBufferInfo bufferInfos[5] = {
+			{ frame->m_paramsBuffer, 0, sizeof(CullParams) },
+			{ m_meshletBuffer, 0, VK_WHOLE_SIZE },
+			{ frame->m_indirectBuffer, 0, VK_WHOLE_SIZE },
+			{ frame->m_lateIndirectBuffer, 0, VK_WHOLE_SIZE },
+			{ frame->m_candidateBuffer, 0, VK_WHOLE_SIZE } };
+		VkDescriptorImageInfo pyramidInfo = {};
+		if (m_hiZPyramid != nullptr)
+			pyramidInfo = m_hiZPyramid->GetDescriptor();
+		VkWriteDescriptorSet writes[6] = {};
+		for (uint32_t i = 0; i < bindingCount; ++i)
+		{
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = frame->m_descriptorSet;
+			writes[i].dstBinding = i;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = types[i];
+			if (types[i] == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER)
+				writes[i].pImageInfo = &pyramidInfo;
+			else
+				writes[i].pBufferInfo = &bufferInfos[i];
+		}
+		vkUpdateDescriptorSets(m_device, bindingCount, writes, 0, nullptr);
+	}
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &m_descriptorSetLayout;
+	// The occlusion culling phase
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.size = sizeof(uint32_t);
+	if (m_hiZPyramid != nullptr)
+	{
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+	}
+	err = vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, nullptr, m_pipelineLayout.Replace());
+	ERROR_IF(err, "Create meshlet cull pipeline layout: " << vkTools::errorString(err));
+
+	VkComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.layout = m_pipelineLayout;
+	const char* shaderPath = m_hiZPyramid != nullptr ? "./../shaders/meshlet_cull_occlusion.comp.spv" : "./../shaders/meshlet_cull.comp.spv";
+	pipelineCreateInfo.stage = VulkanShaderLoader::LoadShaderSPIRV(shaderPath, "main", m_device, VK_SHADER_STAGE_COMPUTE_BIT);
+	err = vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, m_pipeline.Replace());
+	ERROR_IF(err, "Create meshlet cull pipeline: " << vkTools::errorString(err));
+
+	// The module isn't needed after pipeline creation
+	vkDestroyShaderModule(m_device, pipelineCreateInfo.stage.module, nullptr);
+}
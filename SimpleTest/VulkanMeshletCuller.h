@@ -0,0 +1,155 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include <vector>
+#include <memory>
+#include "MathTypes.h"
+#include "VkObj.h"
+
+class VulkanMesh;
+class VulkanBufferFactory;
+class VulkanHiZPyramid;
+
+// Cull meshlets on the GPU with a compute shader (meshlet_cull.comp), otherwise on the CPU
+//#define USE_GPU_MESHLET_CULLING
+
+/*!
+* \class VulkanMeshletCuller
+*
+* \brief
+*
+* Frustum and normal cone culling of the meshlets of a mesh (see Meshlet.h).
+* The surviving meshlets are written compacted to an indirect buffer per frame buffer,
+* so the pre-recorded draw command buffers stay valid while what they draw changes every frame.
+*
+* Only the meshlets of the selected level of detail are considered.
+*
+* Indirect buffer layout: [draw count, 16 bytes][VkDrawIndexedIndirectCommand * largest level meshlet count]
+* Commands past the draw count are zeroed, so drawing all of them is the same as drawing the visible ones.
+* They are drawn with a single multi draw indirect call, so the multiDrawIndirect device feature is
+* required. Without it one call per command would cost more than drawing the submeshes.
+*
+* Cull() works out what to draw and may run on any thread, ahead of the frame. Update() writes the
+* result to the frame buffer's buffers once its previous frame is finished. The CPU path culls in
+* Cull() and Update() copies the commands, the GPU path only passes on the cull parameters and the
+* dispatch is recorded in front of the render pass.
+*
+* Given a Hi-Z pyramid the GPU path also culls occluded meshlets, in two phases (PHASE_EARLY
+* and PHASE_LATE). The early phase draws what was visible in the previous frame's pyramid,
+* with the previous frame's model-view-projection, and keeps the rest as candidates. After the
+* pyramid is rebuilt from the early depth the late phase draws the candidates that are visible
+* in it, which catches what was uncovered this frame. Each phase has its own indirect buffer.
+*/
+
+class VulkanMeshletCuller
+{
+public:
+	struct Stats
+	{
+		uint32_t m_lod;
+		uint32_t m_meshletCount;
+		uint32_t m_frustumCulled;
+		uint32_t m_backfaceCulled;
+		uint32_t m_visible;
+	};
+
+	// Which of the two occlusion culling passes, without occlusion culling there is only the early one
+	enum Phase
+	{
+		PHASE_EARLY,
+		PHASE_LATE
+	};
+
+	// Matches the uniform block of meshlet_cull.comp
+	struct CullParams
+	{
+		glm::vec4 m_frustumPlanes[6];
+		glm::vec4 m_cameraPos;
+		glm::mat4 m_modelViewProjection;
+		glm::mat4 m_previousModelViewProjection; // set by Update()
+		glm::vec4 m_pyramidSize;
+		uint32_t  m_meshletCount;
+		uint32_t  m_firstMeshlet;
+		uint32_t  m_padding[2];
+	};
+
+	// Output of Cull(), input of Update()
+	struct CullResult
+	{
+		Stats                                     m_stats;
+		CullParams                                m_params;   // GPU path
+		std::vector<VkDrawIndexedIndirectCommand> m_commands; // CPU path, the visible meshlets
+	};
+
+	// Needs the multiDrawIndirect device feature.
+	// in_hiZPyramid enables occlusion culling on the GPU path, it is ignored by the CPU path.
+	VulkanMeshletCuller(const VkObj<VkDevice>& in_device, const VulkanBufferFactory& in_bufferFactory,
+		const VulkanMesh& in_mesh, uint32_t in_frameBufferCount,
+		const VulkanHiZPyramid* in_hiZPyramid = nullptr);
+	~VulkanMeshletCuller();
+
+	// Cull (or set up culling) the meshlets of level in_lod. Only reads the mesh, so it is safe
+	// to call from another thread while frames are drawn. in_modelViewProjection and
+	// in_cameraPos are in the model space of the meshlet bounds.
+	void Cull(const glm::mat4& in_modelViewProjection, const glm::vec3& in_cameraPos, uint32_t in_lod,
+		CullResult& out_result) const;
+
+	// Hand a cull result to the frame about to be drawn to in_frameBufferIdx
+	void Update(uint32_t in_frameBufferIdx, const CullResult& in_result);
+
+	// Record the culling dispatch, outside of a render pass. Does nothing for the CPU path.
+	// The late phase goes after the pyramid has been built from the early phase's depth.
+	void RecordCull(VkCommandBuffer in_commandBuffer, uint32_t in_frameBufferIdx, Phase in_phase = PHASE_EARLY) const;
+
+	// Record the meshlet draws, with the pipeline and the mesh buffers already bound
+	void RecordDraws(VkCommandBuffer in_commandBuffer, uint32_t in_frameBufferIdx, Phase in_phase = PHASE_EARLY) const;
+
+	bool IsGpuCulling() const { return m_gpuCulling; }
+	bool IsOcclusionCulling() const { return m_hiZPyramid != nullptr; }
+
+	// Results of the last update, the GPU path only knows the level and its meshlet count
+	const Stats& GetStats() const { return m_stats; }
+
+private:
+	struct FrameResources
+	{
+		FrameResources(const VkObj<VkDevice>& in_device);
+		VkObj<VkBuffer>       m_indirectBuffer;
+		VkObj<VkDeviceMemory> m_indirectMemory;
+		VkObj<VkBuffer>       m_lateIndirectBuffer;   // occlusion culling
+		VkObj<VkDeviceMemory> m_lateIndirectMemory;
+		VkObj<VkBuffer>       m_candidateBuffer;      // occlusion culling, [count, 16 bytes][meshlet index * m_maxDrawCount]
+		VkObj<VkDeviceMemory> m_candidateMemory;
+		VkObj<VkBuffer>       m_paramsBuffer;
+		VkObj<VkDeviceMemory> m_paramsMemory;
+		void*                 m_mapped; // indirect buffer on the CPU path, params on the GPU path
+		VkDescriptorSet       m_descriptorSet;
+		uint32_t              m_lastVisible; // commands written by the previous CPU cull
+	};
+
+	static const VkDeviceSize c_commandsOffset = 16;
+
+	void CreateCullPipeline();
+	// Zero in_size bytes of in_buffer and make them visible to the cull shader
+	static void ClearForCull(VkCommandBuffer in_commandBuffer, VkBuffer in_buffer, VkDeviceSize in_size);
+
+	const VkObj<VkDevice>& m_device;
+	const VulkanMesh&      m_mesh;
+	bool                   m_gpuCulling;
+	uint32_t               m_maxDrawCount; // meshlets of the largest level
+	VkDeviceSize           m_indirectSize;
+	Stats                  m_stats;
+	const VulkanHiZPyramid* m_hiZPyramid;
+	glm::mat4              m_previousModelViewProjection;
+	bool                   m_hasPreviousFrame;
+
+	std::vector<std::unique_ptr<FrameResources>> m_frames;
+
+	// GPU culling
+	VkObj<VkBuffer>              m_meshletBuffer;
+	VkObj<VkDeviceMemory>        m_meshletMemory;
+	VkObj<VkDescriptorSetLayout> m_descriptorSetLayout;
+	VkObj<VkDescriptorPool>      m_descriptorPool;
+	VkObj<VkPipelineLayout>      m_pipelineLayout;
+	VkObj<VkPipeline>            m_pipeline;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include "MathTypes.h"
+
+// Draw with the model-view-projection pushed per draw (triangle_push.vert),
+// otherwise the one of the per frame uniform buffer is used
+//#define USE_PUSH_CONSTANTS
+
+// Per draw data pushed straight into the command buffer, so drawing several objects
+// needs neither a descriptor set nor a buffer per object.
+// Matches the push_constant block of triangle_push.vert, and stays within the
+// 128 bytes every device supports.
+
+struct VulkanPushConstants
+{
+	// Data of one draw
+	struct DrawData
+	{
+		glm::mat4 m_modelViewProjection;
+		uint32_t  m_objectIdx;   // transform node, and instance of the instance buffer
+		uint32_t  m_materialIdx; // texture in the bindless table, VulkanBindlessTable::c_invalidIdx for none
+		uint32_t  m_padding[2];
+	};
+
+	static const VkShaderStageFlags c_stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	// The range to add to pipeline layouts of programs drawn with DrawData
+	static VkPushConstantRange GetRange()
+	{
+		VkPushConstantRange range = {};
+		range.stageFlags = c_stages;
+		range.offset = 0;
+		range.size = sizeof(DrawData);
+		return range;
+	}
+
+	static void Push(VkCommandBuffer in_commandBuffer, VkPipelineLayout in_pipelineLayout, const DrawData& in_data)
+	{
+		vkCmdPushConstants(in_commandBuffer, in_pipelineLayout, c_stages, 0, sizeof(DrawData), &in_data);
+	}
+};
+
+static_assert(sizeof(VulkanPushConstants::DrawData) <= 128, "Push constants beyond the guaranteed maxPushConstantsSize");
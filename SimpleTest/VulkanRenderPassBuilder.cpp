@@ -0,0 +1,228 @@
+#include "VulkanRenderPassBuilder.h"
+#include "ErrorReporting.h"
+
+namespace
+{
+	VkAttachmentLoadOp GetLoadOp(VulkanRenderPassBuilder::Input in_input)
+	{
+		switch (in_input)
+		{
+		case VulkanRenderPassBuilder::INPUT_CLEAR:    return VK_ATTACHMENT_LOAD_OP_CLEAR;
+		case VulkanRenderPassBuilder::INPUT_PREVIOUS: return VK_ATTACHMENT_LOAD_OP_LOAD;
+		default:                                      return VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		}
+	}
+}
+
+uint32_t VulkanRenderPassBuilder::AddColor(VkFormat in_format, Input in_input, bool in_readAfter,
+	VkImageLayout in_finalLayout/* = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR*/, VkSampleCountFlagBits in_samples/* = VK_SAMPLE_COUNT_1_BIT*/,
+	VkImageLayout in_initialLayout/* = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL*/)
+{
+	Attachment attachment = { in_format, in_samples, in_input, in_readAfter, false, false, in_initialLayout, in_finalLayout, c_none, true };
+	m_attachments.push_back(attachment);
+	return static_cast<uint32_t>(m_attachments.size() - 1);
+}
+
+uint32_t VulkanRenderPassBuilder::AddDepth(VkFormat in_format, Input in_input, bool in_readAfter, bool in_stencil/* = false*/,
+	VkImageLayout in_finalLayout/* = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL*/, VkSampleCountFlagBits in_samples/* = VK_SAMPLE_COUNT_1_BIT*/,
+	VkImageLayout in_initialLayout/* = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL*/)
+{
+	for (const Attachment& attachment : m_attachments)
+		ERROR_IF(attachment.m_depth, "Render pass with more than one depth attachment");
+	Attachment attachment = { in_format, in_samples, in_input, in_readAfter, true, in_stencil, in_initialLayout, in_finalLayout, c_none, true };
+	m_attachments.push_back(attachment);
+	return static_cast<uint32_t>(m_attachments.size() - 1);
+}
+
+uint32_t VulkanRenderPassBuilder::AddResolve(uint32_t in_colorIdx, bool in_readAfter, VkImageLayout in_finalLayout/* = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR*/)
+{
+	ERROR_IF(in_colorIdx >= m_attachments.size() || m_attachments[in_colorIdx].m_depth ||
+		m_attachments[in_colorIdx].m_samples == VK_SAMPLE_COUNT_1_BIT, "Resolve of attachment " << in_colorIdx << " that isn't multisampled color");
+	Attachment attachment = { m_attachments[in_colorIdx].m_format, VK_SAMPLE_COUNT_1_BIT, INPUT_NONE, in_readAfter, false, false,
+		VK_IMAGE_LAYOUT_UNDEFINED, in_finalLayout, in_colorIdx, true };
+	m_attachments.push_back(attachment);
+	return static_cast<uint32_t>(m_attachments.size() - 1);
+}
+
+uint32_t VulkanRenderPassBuilder::AddUnused(VkFormat in_format)
+{
+	Attachment attachment = { in_format, VK_SAMPLE_COUNT_1_BIT, INPUT_NONE, false, false, false,
+		VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, c_none, false };
+	m_attachments.push_back(attachment);
+	return static_cast<uint32_t>(m_attachments.size() - 1);
+}
+
+std::vector<VkAttachmentDescription> VulkanRenderPassBuilder::GetAttachmentDescriptions() const
+{
+	std::vector<VkAttachmentDescription> descriptions;
+	for (const Attachment& attachment : m_attachments)
+	{
+		VkImageLayout subpassLayout = attachment.m_depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		VkAttachmentDescription description = {};
+		description.format = attachment.m_format;
+		description.samples = attachment.m_samples;
+		description.loadOp = GetLoadOp(attachment.m_input);
+		description.storeOp = attachment.m_readAfter ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		description.stencilLoadOp = attachment.m_stencil ? description.loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		description.stencilStoreOp = attachment.m_stencil ? description.storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		// Undefined lets the old contents go, only loading needs them in a known layout
+		description.initialLayout = attachment.m_input == INPUT_PREVIOUS ? attachment.m_initialLayout : VK_IMAGE_LAYOUT_UNDEFINED;
+		description.finalLayout = attachment.m_readAfter ? attachment.m_finalLayout : subpassLayout;
+		descriptions.push_back(description);
+	}
+	return descriptions;
+}
+
+VkResult VulkanRenderPassBuilder::Build(VkDevice in_device, VkRenderPass& out_renderPass) const
+{
+	std::vector<VkAttachmentDescription> descriptions = GetAttachmentDescriptions();
+
+	// Resolves line up with the color attachments they resolve, unused where there is none
+	std::vector<VkAttachmentReference> colorReferences;
+	std::vector<VkAttachmentReference> resolveReferences;
+	VkAttachmentReference depthReference = { VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+	bool hasResolve = false;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(m_attachments.size()); ++i)
+	{
+		const Attachment& attachment = m_attachments[i];
+		if (!attachment.m_used)
+		{
+			continue;
+		}
+		else if (attachment.m_depth)
+		{
+			depthReference.attachment = i;
+		}
+		else if (attachment.m_resolveOf == c_none)
+		{
+			colorReferences.push_back({ i, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+			resolveReferences.push_back({ VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+		}
+	}
+	for (uint32_t i = 0; i < static_cast<uint32_t>(m_attachments.size()); ++i)
+	{
+		if (m_attachments[i].m_resolveOf == c_none)
+			continue;
+		for (size_t c = 0; c < colorReferences.size(); ++c)
+		{
+			if (colorReferences[c].attachment == m_attachments[i].m_resolveOf)
+				resolveReferences[c].attachment = i;
+		}
+		hasResolve = true;
+	}
+	bool hasDepth = depthReference.attachment != VK_ATTACHMENT_UNUSED;
+	bool loadsColor = false;
+	bool depthReadAfter = false;
+	for (const Attachment& attachment : m_attachments)
+	{
+		loadsColor |= !attachment.m_depth && attachment.m_input == INPUT_PREVIOUS;
+		depthReadAfter |= attachment.m_depth && attachment.m_readAfter;
+	}
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+	subpass.pColorAttachments = colorReferences.data();
+	subpass.pResolveAttachments = hasResolve ? resolveReferences.data() : nullptr;
+	subpass.pDepthStencilAttachment = hasDepth ? &depthReference : nullptr;
+
+	// As the standard pass: the layout transitions wait for the previous use of the images
+	// and the consumers wait for the pass. Depth is cleared or discarded, which is a write
+	// the previous frame's depth tests have to be done before. Loaded contents have to be
+	// written first, and depth read after the pass is sampled by shaders.
+	VkSubpassDependency dependencies[2] = {};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+	if (hasDepth)
+	{
+		dependencies[0].srcStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	}
+	if (loadsColor)
+	{
+		dependencies[0].srcStageMask |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	}
+
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+	dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+	if (depthReadAfter)
+	{
+		dependencies[1].srcStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[1].dstStageMask |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		dependencies[1].srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask |= VK_ACCESS_SHADER_READ_BIT;
+		// Read anywhere in the image, not just the region written
+		dependencies[1].dependencyFlags = 0;
+	}
+
+	VkRenderPassCreateInfo renderPassInfo = {};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = static_cast<uint32_t>(descriptions.size());
+	renderPassInfo.pAttachments = descriptions.data();
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpass;
+	renderPassInfo.dependencyCount = 2;
+	renderPassInfo.pDependencies = dependencies;
+
+	return vkCreateRenderPass(in_device, &renderPassInfo, nullptr, &out_renderPass);
+}
+
+VulkanRenderPassBuilder::Bandwidth VulkanRenderPassBuilder::GetBandwidth(uint32_t in_width, uint32_t in_height) const
+{
+	Bandwidth bandwidth = { 0, 0 };
+	std::vector<VkAttachmentDescription> descriptions = GetAttachmentDescriptions();
+	for (size_t i = 0; i < m_attachments.size(); ++i)
+	{
+		const Attachment& attachment = m_attachments[i];
+		if (!attachment.m_used)
+			continue;
+		uint64_t size = static_cast<uint64_t>(in_width) * in_height * GetFormatBytes(attachment.m_format) * attachment.m_samples;
+		if (descriptions[i].loadOp == VK_ATTACHMENT_LOAD_OP_LOAD)
+			bandwidth.m_bytes += size;
+		if (descriptions[i].storeOp == VK_ATTACHMENT_STORE_OP_STORE)
+			bandwidth.m_bytes += size;
+		// Resolves are written whatever the ops, and never loaded
+		if (attachment.m_resolveOf == c_none && attachment.m_input != INPUT_CLEAR)
+			bandwidth.m_baselineBytes += size;
+		bandwidth.m_baselineBytes += size;
+	}
+	return bandwidth;
+}
+
+uint32_t VulkanRenderPassBuilder::GetFormatBytes(VkFormat in_format)
+{
+	switch (in_format)
+	{
+	case VK_FORMAT_R8_UNORM:
+	case VK_FORMAT_R8_SRGB:
+		return 1;
+	case VK_FORMAT_R8G8_UNORM:
+	case VK_FORMAT_R16_SFLOAT:
+	case VK_FORMAT_D16_UNORM:
+		return 2;
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+		return 3;
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+	case VK_FORMAT_R32G32_SFLOAT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return 8;
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		return 16;
+	default:
+		// The 32 bit color formats, D24S8 and D32
+		return 4;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include <cstdint>
+#include <vector>
+
+/*!
+* \class VulkanRenderPassBuilder
+*
+* \brief
+*
+* Builds a single subpass render pass from how the frame uses each attachment, rather
+* than from load and store ops. An attachment declares what the pass starts from
+* (nothing, a clear or the previous contents) and whether anything after the pass reads
+* it (presenting, sampling, a later pass). The ops follow from that: LOAD only when the
+* previous contents are needed, CLEAR when cleared, otherwise DONT_CARE, and STORE only
+* when read after. Attachments not read after stay in their subpass layout.
+*
+* Every load and store is a full read or write of the attachment in memory, on tilers
+* the bulk of the frame's bandwidth. GetBandwidth estimates the traffic against a pass
+* that loads what it doesn't clear and stores everything.
+*/
+
+class VulkanRenderPassBuilder
+{
+public:
+	// What the pass starts from
+	enum Input
+	{
+		INPUT_NONE,     // every pixel is written, or the contents don't matter
+		INPUT_CLEAR,
+		INPUT_PREVIOUS  // the contents from before the pass
+	};
+
+	// Estimated bytes moved between tile and memory per frame
+	struct Bandwidth
+	{
+		uint64_t m_bytes;         // with the inferred ops
+		uint64_t m_baselineBytes; // loading what isn't cleared and storing everything
+		uint64_t GetSavedBytes() const { return m_baselineBytes - m_bytes; }
+	};
+
+	// in_finalLayout is the layout for the consumer when in_readAfter, in_initialLayout the one
+	// the contents are in when loaded. Both are ignored otherwise. Returns the attachment index.
+	uint32_t AddColor(VkFormat in_format, Input in_input, bool in_readAfter,
+		VkImageLayout in_finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VkSampleCountFlagBits in_samples = VK_SAMPLE_COUNT_1_BIT,
+		VkImageLayout in_initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	// in_stencil when the pass uses the stencil, it follows the same rules as depth
+	uint32_t AddDepth(VkFormat in_format, Input in_input, bool in_readAfter, bool in_stencil = false,
+		VkImageLayout in_finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VkSampleCountFlagBits in_samples = VK_SAMPLE_COUNT_1_BIT,
+		VkImageLayout in_initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+	// Single sampled target of the multisampled color attachment in_colorIdx, fully written by the resolve
+	uint32_t AddResolve(uint32_t in_colorIdx, bool in_readAfter, VkImageLayout in_finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	// In the frame buffer but not used by the subpass, never loaded, stored or resolved to. Stands in for
+	// the resolve of a pass that resolves, which stays compatible as the resolve doesn't count with one subpass.
+	uint32_t AddUnused(VkFormat in_format);
+
+	VkResult Build(VkDevice in_device, VkRenderPass& out_renderPass) const;
+
+	// The descriptions with the inferred ops, valid after the attachments are added
+	std::vector<VkAttachmentDescription> GetAttachmentDescriptions() const;
+	Bandwidth GetBandwidth(uint32_t in_width, uint32_t in_height) const;
+
+private:
+	struct Attachment
+	{
+		VkFormat              m_format;
+		VkSampleCountFlagBits m_samples;
+		Input                 m_input;
+		bool                  m_readAfter;
+		bool                  m_depth;
+		bool                  m_stencil;
+		VkImageLayout         m_initialLayout;
+		VkImageLayout         m_finalLayout;
+		uint32_t              m_resolveOf; // color attachment index, c_none when not a resolve target
+		bool                  m_used;      // referenced by the subpass
+	};
+
+	static const uint32_t c_none = 0xFFFFFFFF;
+
+	// Bytes per sample, an estimate for depth formats as their layout is up to the implementation
+	static uint32_t GetFormatBytes(VkFormat in_format);
+
+	std::vector<Attachment> m_attachments;
+};
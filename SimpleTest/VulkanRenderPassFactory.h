@@ -1,6 +1,7 @@
 #pragma once
 
 #include "vulkan/vulkan.h"
+#include <cstdint>
 
 class VulkanRenderPassFactory
 {
@@ -8,7 +9,18 @@ public:
 	VulkanRenderPassFactory(VkDevice in_device);
 
 	// Initializations
-	VkResult CreateStandardRenderPass(VkFormat in_colorFormat, VkFormat in_depthFormat, VkRenderPass& out_renderPass);
+	// Color (0) and depth (1), cleared. With more than one sample both are multisampled and only live through
+	// the pass, and the color is resolved into a single sampled attachment (2) that is stored for presenting.
+	// Depth is never stored. Given the size, the estimated attachment bandwidth per frame is logged.
+	VkResult CreateStandardRenderPass(VkFormat in_colorFormat, VkFormat in_depthFormat, VkRenderPass& out_renderPass,
+		VkSampleCountFlagBits in_samples = VK_SAMPLE_COUNT_1_BIT, uint32_t in_width = 0, uint32_t in_height = 0);
+	// The standard pass split in two for occlusion culling (see VulkanHiZPyramid), both compatible with it.
+	// The early pass clears and stores color and depth, depth for sampling. The late pass continues from
+	// them and finishes as the standard pass does. Multisampled color is stored by the early pass, which
+	// leaves the resolve attachment unused, and resolved by the late one.
+	VkResult CreateOcclusionRenderPasses(VkFormat in_colorFormat, VkFormat in_depthFormat,
+		VkRenderPass& out_earlyRenderPass, VkRenderPass& out_lateRenderPass,
+		VkSampleCountFlagBits in_samples = VK_SAMPLE_COUNT_1_BIT, uint32_t in_width = 0, uint32_t in_height = 0);
 private:
 	VkDevice m_device;
 };
\ No newline at end of file
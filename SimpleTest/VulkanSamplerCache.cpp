@@ -0,0 +1,111 @@
+#include "VulkanSamplerCache.h"
+#include <cstring>
+#include "ErrorReporting.h"
+#include "vulkantools.h"
+
+namespace
+{
+	uint32_t FloatBits(float in_value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &in_value, sizeof(bits));
+		return bits;
+	}
+}
+
+VulkanSamplerCache::VulkanSamplerCache(const VkObj<VkDevice>& in_device, VkPhysicalDevice in_physicalDevice)
+	: m_device(in_device)
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(in_physicalDevice, &properties);
+	m_maxSamplerCount = properties.limits.maxSamplerAllocationCount;
+
+	// In the order of CommonSampler
+	m_commonSamplers.push_back(Get(MakeCreateInfo(VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT)));
+	m_commonSamplers.push_back(Get(MakeCreateInfo(VK_FILTER_LINEAR, VK_SAMPLER_MIPMAP_MODE_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)));
+	m_commonSamplers.push_back(Get(MakeCreateInfo(VK_FILTER_NEAREST, VK_SAMPLER_MIPMAP_MODE_NEAREST, VK_SAMPLER_ADDRESS_MODE_REPEAT)));
+	m_commonSamplers.push_back(Get(MakeCreateInfo(VK_FILTER_NEAREST, VK_SAMPLER_MIPMAP_MODE_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)));
+}
+
+VulkanSamplerCache::~VulkanSamplerCache()
+{
+	for (auto& sampler : m_samplers)
+		vkDestroySampler(m_device, sampler.second, nullptr);
+}
+
+VkSamplerCreateInfo VulkanSamplerCache::MakeCreateInfo(VkFilter in_filter/* = VK_FILTER_LINEAR*/,
+	VkSamplerMipmapMode in_mipmapMode/* = VK_SAMPLER_MIPMAP_MODE_LINEAR*/,
+	VkSamplerAddressMode in_addressMode/* = VK_SAMPLER_ADDRESS_MODE_REPEAT*/)
+{
+	VkSamplerCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	createInfo.magFilter = in_filter;
+	createInfo.minFilter = in_filter;
+	createInfo.mipmapMode = in_mipmapMode;
+	createInfo.addressModeU = in_addressMode;
+	createInfo.addressModeV = in_addressMode;
+	createInfo.addressModeW = in_addressMode;
+	createInfo.maxAnisotropy = 1.0f;
+	createInfo.compareOp = VK_COMPARE_OP_NEVER;
+	createInfo.minLod = 0.0f;
+	createInfo.maxLod = VK_LOD_CLAMP_NONE;
+	createInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	return createInfo;
+}
+
+VkSampler VulkanSamplerCache::Get(const VkSamplerCreateInfo& in_createInfo)
+{
+	ERROR_IF(in_createInfo.pNext != nullptr, "Sampler cache doesn't key on pNext chains");
+	Key key = MakeKey(in_createInfo);
+	auto cached = m_samplers.find(key);
+	if (cached != m_samplers.end())
+		return cached->second;
+
+	ERROR_IF(m_samplers.size() >= m_maxSamplerCount, "Sampler cache at maxSamplerAllocationCount (" << m_maxSamplerCount << ")");
+	VkSampler sampler;
+	VkResult err = vkCreateSampler(m_device, &in_createInfo, nullptr, &sampler);
+	ERROR_IF(err, "Create sampler: " << vkTools::errorString(err));
+	m_samplers[key] = sampler;
+	return sampler;
+}
+
+bool VulkanSamplerCache::Key::operator==(const Key& in_other) const
+{
+	return memcmp(m_fields, in_other.m_fields, sizeof(m_fields)) == 0;
+}
+
+size_t VulkanSamplerCache::KeyHash::operator()(const Key& in_key) const
+{
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < Key::c_fieldCount; ++i)
+	{
+		hash ^= in_key.m_fields[i];
+		hash *= 1099511628211ull;
+	}
+	return static_cast<size_t>(hash);
+}
+
+VulkanSamplerCache::Key VulkanSamplerCache::MakeKey(const VkSamplerCreateInfo& in_createInfo)
+{
+	// -0.0 and 0.0 sample the same but get different samplers, that's harmless
+	Key key;
+	uint32_t* field = key.m_fields;
+	*field++ = in_createInfo.flags;
+	*field++ = in_createInfo.magFilter;
+	*field++ = in_createInfo.minFilter;
+	*field++ = in_createInfo.mipmapMode;
+	*field++ = in_createInfo.addressModeU;
+	*field++ = in_createInfo.addressModeV;
+	*field++ = in_createInfo.addressModeW;
+	*field++ = FloatBits(in_createInfo.mipLodBias);
+	*field++ = in_createInfo.anisotropyEnable;
+	*field++ = in_createInfo.anisotropyEnable ? FloatBits(in_createInfo.maxAnisotropy) : 0;
+	*field++ = in_createInfo.compareEnable;
+	*field++ = in_createInfo.compareEnable ? in_createInfo.compareOp : 0;
+	*field++ = FloatBits(in_createInfo.minLod);
+	*field++ = FloatBits(in_createInfo.maxLod);
+	*field++ = in_createInfo.borderColor;
+	*field++ = in_createInfo.unnormalizedCoordinates;
+	return key;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include <vector>
+#include <unordered_map>
+#include "VkObj.h"
+
+/*!
+* \class VulkanSamplerCache
+*
+* \brief
+*
+* One VkSampler per distinct sampler state, shared by every texture and descriptor that
+* uses it. Samplers aren't tied to an image, so a scene with thousands of textures still
+* only needs a handful, while a sampler per texture runs into maxSamplerAllocationCount
+* (often 4000) fast.
+*
+* The state of a VkSamplerCreateInfo is hashed into a small table. The common samplers
+* are created up front in a fixed order, so they can be embedded as immutable samplers
+* in descriptor set layouts and be found at known indices (see VulkanBindlessTable and
+* shaders/bindless.glsl). Samplers live as long as the cache.
+*/
+
+class VulkanSamplerCache
+{
+public:
+	// Index of each common sampler in GetCommonSamplers(), mips are filtered like texels
+	enum CommonSampler
+	{
+		LINEAR_REPEAT,
+		LINEAR_CLAMP,
+		NEAREST_REPEAT,
+		NEAREST_CLAMP,
+		COMMON_SAMPLER_COUNT
+	};
+
+	VulkanSamplerCache(const VkObj<VkDevice>& in_device, VkPhysicalDevice in_physicalDevice);
+	~VulkanSamplerCache();
+
+	// Create info for the usual case of one filter and address mode for all directions and no anisotropy
+	static VkSamplerCreateInfo MakeCreateInfo(VkFilter in_filter = VK_FILTER_LINEAR,
+		VkSamplerMipmapMode in_mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+		VkSamplerAddressMode in_addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT);
+
+	// The sampler with the state of in_createInfo, created on first use. pNext must be null, it isn't part of the key.
+	VkSampler Get(const VkSamplerCreateInfo& in_createInfo);
+	VkSampler Get(CommonSampler in_sampler) const { return m_commonSamplers[in_sampler]; }
+
+	const std::vector<VkSampler>& GetCommonSamplers() const { return m_commonSamplers; }
+	size_t GetCount() const { return m_samplers.size(); }
+
+private:
+	VulkanSamplerCache(const VulkanSamplerCache&) = delete;
+	VulkanSamplerCache& operator=(const VulkanSamplerCache&) = delete;
+
+	// Every field of VkSamplerCreateInfo but sType and pNext, floats by their bits
+	struct Key
+	{
+		static const size_t c_fieldCount = 16;
+		uint32_t m_fields[c_fieldCount];
+
+		bool operator==(const Key& in_other) const;
+	};
+	struct KeyHash
+	{
+		size_t operator()(const Key& in_key) const;
+	};
+	static Key MakeKey(const VkSamplerCreateInfo& in_createInfo);
+
+	const VkObj<VkDevice>&                    m_device;
+	uint32_t                                  m_maxSamplerCount;
+	std::unordered_map<Key, VkSampler, KeyHash> m_samplers;
+	std::vector<VkSampler>                    m_commonSamplers;
+};
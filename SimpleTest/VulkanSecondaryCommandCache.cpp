@@ -0,0 +1,121 @@
+#include "VulkanSecondaryCommandCache.h"
+#include "ErrorReporting.h"
+#include "vulkantools.h"
+
+void VulkanSecondaryCommandCache::Inputs::AddBytes(const void* in_data, size_t in_size)
+{
+	// FNV-1a, the size goes in as well so data and a shorter prefix of it differ
+	uint64_t hash = 14695981039346656037ull;
+	const uint8_t* bytes = static_cast<const uint8_t*>(in_data);
+	for (size_t i = 0; i < in_size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	Add(hash);
+	Add(static_cast<uint64_t>(in_size));
+}
+
+
+VulkanSecondaryCommandCache::Entry::Entry()
+	: m_commandBuffer(VK_NULL_HANDLE)
+	, m_recorded(false)
+{
+}
+
+
+VulkanSecondaryCommandCache::VulkanSecondaryCommandCache(VkDevice in_device, VkCommandPool in_commandPool, uint32_t in_frameBufferCount)
+	: m_device(in_device)
+	, m_commandPool(in_commandPool)
+	, m_frameBufferCount(in_frameBufferCount)
+	, m_stats()
+{
+}
+
+VulkanSecondaryCommandCache::~VulkanSecondaryCommandCache()
+{
+	for (std::vector<Entry>& batch : m_batches)
+	{
+		for (Entry& entry : batch)
+		{
+			if (entry.m_commandBuffer != VK_NULL_HANDLE)
+				vkFreeCommandBuffers(m_device, m_commandPool, 1, &entry.m_commandBuffer);
+		}
+	}
+}
+
+
+VkCommandBuffer VulkanSecondaryCommandCache::Get(uint32_t in_batch, uint32_t in_frameBufferIdx, VkRenderPass in_renderPass, uint32_t in_subpass,
+	VkFramebuffer in_frameBuffer, const Inputs& in_inputs, const RecordFunction& in_record)
+{
+	ERROR_IF(in_frameBufferIdx >= m_frameBufferCount, "Secondary command buffer for frame buffer " << in_frameBufferIdx << " of " << m_frameBufferCount);
+	if (in_batch >= m_batches.size())
+		m_batches.resize(in_batch + 1, std::vector<Entry>(m_frameBufferCount));
+	Entry& entry = m_batches[in_batch][in_frameBufferIdx];
+
+	Inputs inputs = in_inputs;
+	inputs.Add(in_renderPass);
+	inputs.Add(in_subpass);
+	inputs.Add(in_frameBuffer);
+	if (entry.m_recorded && entry.m_inputs == inputs)
+	{
+		m_stats.m_reused++;
+		return entry.m_commandBuffer;
+	}
+
+	VkResult err;
+	if (entry.m_commandBuffer == VK_NULL_HANDLE)
+	{
+		VkCommandBufferAllocateInfo allocateInfo = {};
+		allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocateInfo.commandPool = m_commandPool;
+		allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocateInfo.commandBufferCount = 1;
+		err = vkAllocateCommandBuffers(m_device, &allocateInfo, &entry.m_commandBuffer);
+		ERROR_IF(err, "Allocate secondary command buffer: " << vkTools::errorString(err));
+	}
+
+	// The frame buffer is optional, but knowing it may let the driver record better commands
+	VkCommandBufferInheritanceInfo inheritanceInfo = {};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = in_renderPass;
+	inheritanceInfo.subpass = in_subpass;
+	inheritanceInfo.framebuffer = in_frameBuffer;
+
+	// Beginning resets it, the pool allows resetting single command buffers
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+	err = vkBeginCommandBuffer(entry.m_commandBuffer, &beginInfo);
+	ERROR_IF(err, "Begin secondary command buffer: " << vkTools::errorString(err));
+	in_record(entry.m_commandBuffer);
+	err = vkEndCommandBuffer(entry.m_commandBuffer);
+	ERROR_IF(err, "End secondary command buffer: " << vkTools::errorString(err));
+
+	entry.m_inputs = inputs;
+	entry.m_recorded = true;
+	m_stats.m_recorded++;
+	return entry.m_commandBuffer;
+}
+
+
+void VulkanSecondaryCommandCache::Invalidate(uint32_t in_batch)
+{
+	if (in_batch >= m_batches.size())
+		return;
+	for (Entry& entry : m_batches[in_batch])
+		entry.m_recorded = false;
+}
+
+void VulkanSecondaryCommandCache::InvalidateAll()
+{
+	for (uint32_t batch = 0; batch < m_batches.size(); ++batch)
+		Invalidate(batch);
+}
+
+
+void VulkanSecondaryCommandCache::ResetStats()
+{
+	m_stats = Stats();
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include <vector>
+#include <cstring>
+#include <functional>
+
+// Record the draws of the mesh once into secondary command buffers and execute them from draw
+// command buffers recorded every frame, instead of recording everything once at initialization
+//#define USE_SECONDARY_COMMAND_BUFFERS
+
+/*!
+* \class VulkanSecondaryCommandCache
+*
+* \brief
+*
+* Secondary command buffers that continue a render pass, kept per batch and frame buffer and
+* only recorded again when what they were recorded from changes. The primary command buffer
+* can then be recorded every frame for the work that changes (culling, the passes themselves)
+* at the cost of a vkCmdExecuteCommands per batch, while the static draws are recorded once.
+*
+* What a batch depends on is given as Inputs each time it is asked for: the handles bound
+* (pipelines, buffers, descriptor sets), the size of the frame and hashes of data baked into
+* the commands (like pushed constants). The render pass and frame buffer are always part of
+* it. A swap chain resize, pipeline reload or mesh change shows up as different inputs, and
+* Invalidate() covers anything that changes without its handle changing.
+*
+* A batch is recorded again only when the command buffer of its frame buffer is about to be,
+* after the frame's fence, so the secondary isn't pending anywhere else. Each secondary binds
+* all its own state, none is inherited from the primary or other secondaries.
+*/
+
+class VulkanSecondaryCommandCache
+{
+public:
+	// What recording a batch depends on, it is recorded again when any of it differs
+	class Inputs
+	{
+	public:
+		// A handle, pointer or value, compared as it is
+		template<typename T>
+		void Add(const T& in_value)
+		{
+			static_assert(sizeof(T) <= sizeof(uint64_t), "Inputs::Add takes values of at most 64 bits, use AddBytes");
+			uint64_t value = 0;
+			memcpy(&value, &in_value, sizeof(T));
+			m_values.push_back(value);
+		}
+
+		// Data recorded into the commands, compared by hash
+		void AddBytes(const void* in_data, size_t in_size);
+
+		bool operator==(const Inputs& in_other) const { return m_values == in_other.m_values; }
+		bool operator!=(const Inputs& in_other) const { return m_values != in_other.m_values; }
+
+	private:
+		std::vector<uint64_t> m_values;
+	};
+
+	// Records the draws of a batch into a begun secondary command buffer
+	typedef std::function<void(VkCommandBuffer in_commandBuffer)> RecordFunction;
+
+	// Batches recorded and reused by Get() since the last ResetStats()
+	struct Stats
+	{
+		uint32_t m_recorded;
+		uint32_t m_reused;
+	};
+
+	VulkanSecondaryCommandCache(VkDevice in_device, VkCommandPool in_commandPool, uint32_t in_frameBufferCount);
+	~VulkanSecondaryCommandCache();
+
+	// The command buffer of in_batch for in_frameBufferIdx, continuing in_subpass of in_renderPass in in_frameBuffer.
+	// Recorded with in_record first unless it already was with the same inputs. Call only once the previous
+	// command buffer of in_frameBufferIdx is done, and record that again as it may no longer be valid.
+	VkCommandBuffer Get(uint32_t in_batch, uint32_t in_frameBufferIdx, VkRenderPass in_renderPass, uint32_t in_subpass,
+		VkFramebuffer in_frameBuffer, const Inputs& in_inputs, const RecordFunction& in_record);
+
+	// Record in_batch again the next time it is asked for, for every frame buffer
+	void Invalidate(uint32_t in_batch);
+	void InvalidateAll();
+
+	const Stats& GetStats() const { return m_stats; }
+	void ResetStats();
+
+private:
+	struct Entry
+	{
+		Entry();
+		VkCommandBuffer m_commandBuffer;
+		Inputs          m_inputs;
+		bool            m_recorded;
+	};
+
+	VkDevice      m_device;
+	VkCommandPool m_commandPool; // needs VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT
+	uint32_t      m_frameBufferCount;
+	std::vector<std::vector<Entry> > m_batches; // by batch, then frame buffer
+	Stats         m_stats;
+};
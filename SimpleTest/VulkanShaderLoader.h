@@ -7,7 +7,7 @@
 namespace VulkanShaderLoader
 {
 
-	VkPipelineShaderStageCreateInfo LoadShaderSPIRV(const std::string& in_fileName, const char* in_methodName, const VkDevice& in_device, VkShaderStageFlagBits in_stage)
+	inline VkPipelineShaderStageCreateInfo LoadShaderSPIRV(const std::string& in_fileName, const char* in_methodName, const VkDevice& in_device, VkShaderStageFlagBits in_stage)
 	{
 		VkPipelineShaderStageCreateInfo shaderStage = {};
 		shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -18,7 +18,7 @@ namespace VulkanShaderLoader
 		return shaderStage;
 	}
 
-	VkPipelineShaderStageCreateInfo LoadShaderGLSL(const std::string& in_fileName, const char* in_methodName, const VkDevice& in_device, VkShaderStageFlagBits in_stage)
+	inline VkPipelineShaderStageCreateInfo LoadShaderGLSL(const std::string& in_fileName, const char* in_methodName, const VkDevice& in_device, VkShaderStageFlagBits in_stage)
 	{
 		VkPipelineShaderStageCreateInfo shaderStage = {};
 		shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include <memory>
+#include "VkObj.h"
+#include "VulkanDeletionQueue.h"
+
+/*!
+* \class VulkanTexture
+*
+* \brief
+*
+* A sampled image with all its mips and array layers, and a view of all of them.
+* Created and shared through VulkanTextureFactory. Samplers are kept apart from the
+* image, any sampler from the factory can be combined with it.
+*
+* When the last reference goes away the objects are handed to the deletion queue,
+* as frames in flight may still sample the image.
+*/
+
+class VulkanTexture
+{
+public:
+	VulkanTexture(const VkObj<VkDevice>& in_device, std::shared_ptr<VulkanDeletionQueue> in_deletionQueue = nullptr)
+		: m_image(in_device, vkDestroyImage)
+		, m_gpuMem(in_device, vkFreeMemory)
+		, m_imageView(in_device, vkDestroyImageView)
+		, m_format(VK_FORMAT_UNDEFINED)
+		, m_width(0)
+		, m_height(0)
+		, m_mipCount(0)
+		, m_layerCount(0)
+		, m_cube(false)
+		, m_memorySize(0)
+		, m_deletionQueue(in_deletionQueue)
+	{
+#ifdef _DEBUG
+		m_image.SetDbgName(std::string("TextureImage"));
+		m_gpuMem.SetDbgName(std::string("TextureMemory"));
+		m_imageView.SetDbgName(std::string("TextureImageView"));
+#endif // _DEBUG
+	}
+
+	~VulkanTexture()
+	{
+		if (m_deletionQueue)
+		{
+			m_imageView.Release(*m_deletionQueue);
+			m_image.Release(*m_deletionQueue);
+			m_gpuMem.Release(*m_deletionQueue);
+		}
+	}
+
+	VkDescriptorImageInfo GetDescriptor(VkSampler in_sampler) const
+	{
+		VkDescriptorImageInfo info = {};
+		info.sampler = in_sampler;
+		info.imageView = m_imageView;
+		info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		return info;
+	}
+
+	VkObj<VkImage>        m_image;
+	VkObj<VkDeviceMemory> m_gpuMem;
+	VkObj<VkImageView>    m_imageView;
+	VkFormat              m_format;
+	uint32_t              m_width;
+	uint32_t              m_height;
+	uint32_t              m_mipCount;
+	uint32_t              m_layerCount; // six per cube
+	bool                  m_cube;
+	VkDeviceSize          m_memorySize;
+
+private:
+	VulkanTexture(const VulkanTexture&) = delete;
+	VulkanTexture& operator=(const VulkanTexture&) = delete;
+
+	std::shared_ptr<VulkanDeletionQueue> m_deletionQueue;
+};
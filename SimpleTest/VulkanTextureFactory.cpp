@@ -0,0 +1,352 @@
+#include "VulkanTextureFactory.h"
+#include <cstring>
+#include <algorithm>
+#include "ErrorReporting.h"
+#include "vulkantools.h"
+#include "VulkanMemoryHelper.h"
+#include "VulkanDeletionQueue.h"
+#include "VulkanBufferFactory.h"
+#include "VulkanTexture.h"
+#include "VulkanSamplerCache.h"
+#include "MappedFile.h"
+#include "TextureFile.h"
+#include "MipGenerator.h"
+
+namespace
+{
+	// Copy offsets must be a multiple of the texel block size and of 4, 16 covers every format
+	const VkDeviceSize c_stagingAlignment = 16;
+
+	VkDeviceSize AlignUp(VkDeviceSize in_value, VkDeviceSize in_alignment)
+	{
+		return (in_value + in_alignment - 1) & ~(in_alignment - 1);
+	}
+}
+
+VulkanTextureFactory::VulkanTextureFactory(const VkObj<VkDevice>& in_device, VkPhysicalDevice in_physicalDevice,
+	std::shared_ptr<VulkanMemoryHelper> in_memory, const VulkanBufferFactory& in_bufferFactory,
+	std::shared_ptr<VulkanDeletionQueue> in_deletionQueue/* = nullptr*/, std::shared_ptr<VulkanSamplerCache> in_samplerCache/* = nullptr*/)
+	: m_device(in_device)
+	, m_physicalDevice(in_physicalDevice)
+	, m_memory(in_memory)
+	, m_bufferFactory(in_bufferFactory)
+	, m_deletionQueue(in_deletionQueue)
+	, m_samplerCache(in_samplerCache)
+	, m_jobSystem(nullptr)
+{
+	if (!m_samplerCache)
+		m_samplerCache = std::make_shared<VulkanSamplerCache>(in_device, in_physicalDevice);
+}
+
+VulkanTextureFactory::~VulkanTextureFactory()
+{
+
+}
+
+std::shared_ptr<VulkanTexture> VulkanTextureFactory::CreateTextureFromFile(const std::string& in_path, bool in_generateMips/* = true*/)
+{
+	auto cached = m_textures.find(in_path);
+	if (cached != m_textures.end())
+	{
+		std::shared_ptr<VulkanTexture> texture = cached->second.lock();
+		if (texture)
+			return texture;
+	}
+
+	MappedFile file;
+	if (!file.Open(in_path))
+	{
+		LOG("Could not open texture file: " << in_path);
+		return nullptr;
+	}
+
+	TextureFile::Description description;
+	std::string parseError;
+	if (!TextureFile::Parse(file.GetData(), file.GetSize(), description, parseError))
+	{
+		LOG("Invalid texture file " << in_path << ": " << parseError);
+		return nullptr;
+	}
+
+	// BC formats are optional in Vulkan, mostly missing on mobile GPUs
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(m_physicalDevice, description.m_format, &formatProperties);
+	if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+	{
+		LOG("Texture format " << description.m_format << " of " << in_path << " can't be sampled on this device");
+		return nullptr;
+	}
+
+	// Every subresource comes straight from the file, unless its mips are generated here
+	std::vector<const uint8_t*> sources;
+	for (const TextureFile::Subresource& subresource : description.m_subresources)
+		sources.push_back(file.GetData() + subresource.m_offset);
+
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	bool blitMips = false;
+	std::vector<std::vector<uint8_t>> generatedLevels;
+	uint32_t fullMipCount = MipGenerator::GetMipCount(description.m_width, description.m_height);
+	if (in_generateMips && description.m_mipCount == 1 && fullMipCount > 1)
+	{
+		uint32_t blockBytes, blockExtent;
+		TextureFile::GetBlockInfo(description.m_format, blockBytes, blockExtent);
+		const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+			VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		if (blockExtent > 1)
+		{
+			LOG("Block compressed texture " << in_path << " has no mips, they can't be generated at load");
+		}
+		else if ((formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures)
+		{
+			blitMips = true;
+			usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			description.m_mipCount = fullMipCount;
+		}
+		else if (MipGenerator::IsSupported(description.m_format))
+		{
+			// Layers are independent, each gets its chain from its top level
+			uint32_t layerCount = description.m_layerCount;
+			generatedLevels.resize(layerCount);
+			for (uint32_t layer = 0; layer < layerCount; ++layer)
+			{
+				MipGenerator::GenerateChain(description.m_format, sources[layer], description.m_width, description.m_height,
+					generatedLevels[layer], m_jobSystem);
+				uint64_t offset = 0;
+				for (uint32_t mip = 1; mip < fullMipCount; ++mip)
+				{
+					uint32_t width = std::max(description.m_width >> mip, 1u);
+					uint32_t height = std::max(description.m_height >> mip, 1u);
+					uint64_t size = TextureFile::GetImageSize(description.m_format, width, height);
+					description.m_subresources.push_back({ mip, layer, width, height, offset, size });
+					sources.push_back(generatedLevels[layer].data() + offset);
+					offset += size;
+				}
+			}
+			description.m_mipCount = fullMipCount;
+		}
+		else
+		{
+			LOG("Can't generate mips for texture format " << description.m_format << " of " << in_path);
+		}
+	}
+
+	std::shared_ptr<VulkanTexture> texture = std::make_shared<VulkanTexture>(m_device, m_deletionQueue);
+	if (!CreateImage(description, usage, *texture) || !Upload(description, sources, blitMips, *texture))
+		return nullptr;
+
+	for (auto it = m_textures.begin(); it != m_textures.end();)
+	{
+		if (it->second.expired())
+			it = m_textures.erase(it);
+		else
+			++it;
+	}
+	m_textures[in_path] = texture;
+	return texture;
+}
+
+VkSampler VulkanTextureFactory::GetSampler(const SamplerDesc& in_desc/* = SamplerDesc()*/)
+{
+	return m_samplerCache->Get(VulkanSamplerCache::MakeCreateInfo(in_desc.m_filter, in_desc.m_mipmapMode, in_desc.m_addressMode));
+}
+
+size_t VulkanTextureFactory::GetLoadedTextureCount() const
+{
+	size_t count = 0;
+	for (auto& texture : m_textures)
+	{
+		if (!texture.second.expired())
+			++count;
+	}
+	return count;
+}
+
+bool VulkanTextureFactory::CreateImage(const TextureFile::Description& in_description, VkImageUsageFlags in_usage, VulkanTexture& out_texture) const
+{
+	if (m_memory == nullptr) return false;
+
+	VkImageCreateInfo imageCreateInfo = {};
+	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.format = in_description.m_format;
+	imageCreateInfo.extent = { in_description.m_width, in_description.m_height, 1 };
+	imageCreateInfo.mipLevels = in_description.m_mipCount;
+	imageCreateInfo.arrayLayers = in_description.m_layerCount;
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.usage = in_usage;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageCreateInfo.flags = in_description.m_cube ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
+
+	VkResult err = vkCreateImage(m_device, &imageCreateInfo, nullptr, out_texture.m_image.Replace());
+	ERROR_IF(err, "Create texture image: " << vkTools::errorString(err));
+
+	VkMemoryRequirements memoryRequirements;
+	vkGetImageMemoryRequirements(m_device, out_texture.m_image, &memoryRequirements);
+	VkMemoryAllocateInfo memoryAllocInfo = {};
+	memoryAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memoryAllocInfo.allocationSize = memoryRequirements.size;
+	VkBool32 foundType = m_memory->GetMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		&memoryAllocInfo.memoryTypeIndex);
+	ERROR_IF(!foundType, "No device local memory type for texture");
+	err = vkAllocateMemory(m_device, &memoryAllocInfo, nullptr, out_texture.m_gpuMem.Replace());
+	ERROR_IF(err, "Allocate texture memory on GPU: " << vkTools::errorString(err));
+	err = vkBindImageMemory(m_device, out_texture.m_image, out_texture.m_gpuMem, 0);
+	ERROR_IF(err, "Bind texture image to GPU memory: " << vkTools::errorString(err));
+
+	VkImageViewCreateInfo viewCreateInfo = {};
+	viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewCreateInfo.image = out_texture.m_image;
+	if (in_description.m_cube)
+		viewCreateInfo.viewType = in_description.m_layerCount > 6 ? VK_IMAGE_VIEW_TYPE_CUBE_ARRAY : VK_IMAGE_VIEW_TYPE_CUBE;
+	else
+		viewCreateInfo.viewType = in_description.m_layerCount > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+	viewCreateInfo.format = in_description.m_format;
+	viewCreateInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+	viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewCreateInfo.subresourceRange.baseMipLevel = 0;
+	viewCreateInfo.subresourceRange.levelCount = in_description.m_mipCount;
+	viewCreateInfo.subresourceRange.baseArrayLayer = 0;
+	viewCreateInfo.subresourceRange.layerCount = in_description.m_layerCount;
+	err = vkCreateImageView(m_device, &viewCreateInfo, nullptr, out_texture.m_imageView.Replace());
+	ERROR_IF(err, "Create texture image view: " << vkTools::errorString(err));
+
+	out_texture.m_format = in_description.m_format;
+	out_texture.m_width = in_description.m_width;
+	out_texture.m_height = in_description.m_height;
+	out_texture.m_mipCount = in_description.m_mipCount;
+	out_texture.m_layerCount = in_description.m_layerCount;
+	out_texture.m_cube = in_description.m_cube;
+	out_texture.m_memorySize = memoryRequirements.size;
+	return true;
+}
+
+VkDeviceSize VulkanTextureFactory::AddStagingRegion(const TextureFile::Subresource& in_subresource, VkDeviceSize& inout_stagingSize,
+	std::vector<VkBufferImageCopy>& inout_regions)
+{
+	VkBufferImageCopy region = {};
+	region.bufferOffset = inout_stagingSize;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = in_subresource.m_mip;
+	region.imageSubresource.baseArrayLayer = in_subresource.m_layer;
+	region.imageSubresource.layerCount = 1;
+	region.imageExtent = { in_subresource.m_width, in_subresource.m_height, 1 };
+	inout_regions.push_back(region);
+	inout_stagingSize = AlignUp(inout_stagingSize + in_subresource.m_size, c_stagingAlignment);
+	return region.bufferOffset;
+}
+
+bool VulkanTextureFactory::Upload(const TextureFile::Description& in_description, const std::vector<const uint8_t*>& in_sources,
+	bool in_blitMips, VulkanTexture& inout_texture) const
+{
+	if (!m_bufferFactory.HasTransferQueue())
+	{
+		LOG("Textures need a transfer queue for their upload");
+		return false;
+	}
+
+	// Lay every subresource out in one staging buffer and describe them all in one copy
+	std::vector<VkBufferImageCopy> regions;
+	regions.reserve(in_description.m_subresources.size());
+	VkDeviceSize stagingSize = 0;
+	for (const TextureFile::Subresource& subresource : in_description.m_subresources)
+		AddStagingRegion(subresource, stagingSize, regions);
+
+	// Freed when leaving, also when an error is thrown. The buffer goes first.
+	VkObj<VkDeviceMemory> stagingMemory(m_device, vkFreeMemory);
+	VkObj<VkBuffer> stagingBuffer(m_device, vkDestroyBuffer);
+	if (!m_bufferFactory.CreateBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, stagingSize, nullptr, *stagingBuffer.Replace(), *stagingMemory.Replace(),
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+	{
+		return false;
+	}
+
+	// Mostly straight from the mapped file, the page cache is the only other copy
+	uint8_t* mapped;
+	VkResult err = vkMapMemory(m_device, stagingMemory, 0, stagingSize, 0, reinterpret_cast<void**>(&mapped));
+	ERROR_IF(err, "Map texture staging buffer: " << vkTools::errorString(err));
+	for (size_t i = 0; i < regions.size(); ++i)
+	{
+		memcpy(mapped + regions[i].bufferOffset, in_sources[i], static_cast<size_t>(in_description.m_subresources[i].m_size));
+	}
+	vkUnmapMemory(m_device, stagingMemory);
+
+	VkImage image = inout_texture.m_image;
+	VkImageSubresourceRange allSubresources = {};
+	allSubresources.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	allSubresources.levelCount = in_description.m_mipCount;
+	allSubresources.layerCount = in_description.m_layerCount;
+	m_bufferFactory.SubmitOneShot([&](VkCommandBuffer in_commandBuffer)
+	{
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange = allSubresources;
+
+		// Nothing to keep from before, the whole image is written
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		vkCmdPipelineBarrier(in_commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		vkCmdCopyBufferToImage(in_commandBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<uint32_t>(regions.size()), regions.data());
+
+		// Each level is read as soon as it is written, the level above it is done by then.
+		// All but the last level end up as transfer sources.
+		uint32_t blitCount = in_blitMips ? in_description.m_mipCount - 1 : 0;
+		barrier.subresourceRange.levelCount = 1;
+		for (uint32_t mip = 1; mip <= blitCount; ++mip)
+		{
+			barrier.subresourceRange.baseMipLevel = mip - 1;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			vkCmdPipelineBarrier(in_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			VkImageBlit blit = {};
+			blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - 1, 0, in_description.m_layerCount };
+			blit.srcOffsets[1] = { static_cast<int32_t>(std::max(in_description.m_width >> (mip - 1), 1u)),
+				static_cast<int32_t>(std::max(in_description.m_height >> (mip - 1), 1u)), 1 };
+			blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, in_description.m_layerCount };
+			blit.dstOffsets[1] = { static_cast<int32_t>(std::max(in_description.m_width >> mip, 1u)),
+				static_cast<int32_t>(std::max(in_description.m_height >> mip, 1u)), 1 };
+			vkCmdBlitImage(in_commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				1, &blit, VK_FILTER_LINEAR);
+		}
+
+		VkImageMemoryBarrier finalBarriers[2] = { barrier, barrier };
+		uint32_t finalBarrierCount = 0;
+		if (blitCount > 0)
+		{
+			VkImageMemoryBarrier& sources = finalBarriers[finalBarrierCount++];
+			sources.subresourceRange.baseMipLevel = 0;
+			sources.subresourceRange.levelCount = blitCount;
+			sources.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			sources.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		}
+		VkImageMemoryBarrier& destinations = finalBarriers[finalBarrierCount++];
+		destinations.subresourceRange.baseMipLevel = blitCount;
+		destinations.subresourceRange.levelCount = in_description.m_mipCount - blitCount;
+		destinations.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		destinations.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		for (uint32_t i = 0; i < finalBarrierCount; ++i)
+		{
+			finalBarriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			finalBarriers[i].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		}
+		vkCmdPipelineBarrier(in_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, finalBarrierCount, finalBarriers);
+	});
+
+	// The copy has been waited on, so staging can go right away
+	return true;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "VkObj.h"
+
+class VulkanMemoryHelper;
+class VulkanDeletionQueue;
+class VulkanBufferFactory;
+class VulkanTexture;
+class VulkanSamplerCache;
+class JobSystem;
+namespace TextureFile { struct Description; struct Subresource; }
+
+/*!
+* \class VulkanTextureFactory
+*
+* \brief
+*
+* Loads KTX2 and DDS files (see TextureFile.h) into device local images. The file is
+* memory mapped, every mip of every layer is copied from it into one staging buffer and
+* uploaded with a single vkCmdCopyBufferToImage. Block compressed formats stay
+* compressed on the GPU, BC1/BC4 take an eighth and BC2/3/5/6H/7 a quarter of the
+* memory (and sampling bandwidth) of RGBA8.
+*
+* Files without mips get a full chain at load. It is blitted level by level on the GPU
+* when the format supports blits with linear filtering, otherwise generated on the CPU
+* (see MipGenerator.h) and uploaded with the rest. Block compressed files must come
+* with their mips, they can't be blitted to.
+*
+* Textures are shared per path, loading the same file again while it is alive gives
+* the same image and view. Samplers come from a VulkanSamplerCache, shared with the rest
+* of the renderer when one is given.
+*/
+
+class VulkanTextureFactory
+{
+public:
+	struct SamplerDesc
+	{
+		SamplerDesc(VkFilter in_filter = VK_FILTER_LINEAR,
+			VkSamplerMipmapMode in_mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+			VkSamplerAddressMode in_addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT)
+			: m_filter(in_filter), m_mipmapMode(in_mipmapMode), m_addressMode(in_addressMode) {}
+
+		VkFilter             m_filter;
+		VkSamplerMipmapMode  m_mipmapMode;
+		VkSamplerAddressMode m_addressMode;
+	};
+
+	VulkanTextureFactory(const VkObj<VkDevice>& in_device, VkPhysicalDevice in_physicalDevice,
+		std::shared_ptr<VulkanMemoryHelper> in_memory, const VulkanBufferFactory& in_bufferFactory,
+		std::shared_ptr<VulkanDeletionQueue> in_deletionQueue = nullptr, std::shared_ptr<VulkanSamplerCache> in_samplerCache = nullptr);
+	~VulkanTextureFactory();
+
+	// Jobs for the CPU mip generation, optional
+	void SetJobSystem(JobSystem* in_jobSystem) { m_jobSystem = in_jobSystem; }
+
+	// Load a texture file, or get the one already loaded from in_path. Null if it couldn't be loaded.
+	std::shared_ptr<VulkanTexture> CreateTextureFromFile(const std::string& in_path, bool in_generateMips = true);
+
+	// Get the sampler matching in_desc from the cache
+	VkSampler GetSampler(const SamplerDesc& in_desc = SamplerDesc());
+
+	size_t GetLoadedTextureCount() const;
+
+	// Device local image, memory and a view of all of it for in_description, without contents
+	bool CreateImage(const TextureFile::Description& in_description, VkImageUsageFlags in_usage, VulkanTexture& out_texture) const;
+
+	// Lay in_subresource out after the inout_stagingSize bytes already in a staging buffer and add its copy to the image
+	// to inout_regions. inout_stagingSize grows to cover it, returns where it goes in staging.
+	static VkDeviceSize AddStagingRegion(const TextureFile::Subresource& in_subresource, VkDeviceSize& inout_stagingSize,
+		std::vector<VkBufferImageCopy>& inout_regions);
+
+private:
+	// Copy the subresources of in_description from in_sources (one per subresource) to the image.
+	// With in_blitMips only the top level is uploaded and the others are blitted from it.
+	bool Upload(const TextureFile::Description& in_description, const std::vector<const uint8_t*>& in_sources,
+		bool in_blitMips, VulkanTexture& inout_texture) const;
+
+	const VkObj<VkDevice>&               m_device;
+	VkPhysicalDevice                     m_physicalDevice;
+	std::shared_ptr<VulkanMemoryHelper>  m_memory;
+	const VulkanBufferFactory&           m_bufferFactory;
+	std::shared_ptr<VulkanDeletionQueue> m_deletionQueue;
+	std::shared_ptr<VulkanSamplerCache>  m_samplerCache;
+	JobSystem*                           m_jobSystem;
+
+	// Loaded textures by path, entries whose texture has been released are pruned on the next load
+	std::unordered_map<std::string, std::weak_ptr<VulkanTexture>> m_textures;
+};
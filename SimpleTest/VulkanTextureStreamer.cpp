@@ -0,0 +1,499 @@
+#include "VulkanTextureStreamer.h"
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include "ErrorReporting.h"
+#include "vulkantools.h"
+#include "VulkanMemoryHelper.h"
+#include "VulkanDeletionQueue.h"
+#include "VulkanBufferFactory.h"
+#include "VulkanTextureFactory.h"
+#include "VulkanTexture.h"
+#include "MappedFile.h"
+#include "JobSystem.h"
+
+namespace
+{
+	// Uploads per Update, loads finished beyond it wait for the next frames
+	const VkDeviceSize c_defaultMaxUploadPerFrame = 16 * 1024 * 1024;
+	// Textures not asked for in this many updates only want their tail
+	const uint64_t c_idleUpdates = 120;
+
+	const VkPipelineStageFlags c_shaderStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+}
+
+const float VulkanTextureStreamer::c_defaultBudgetFraction = 0.5f;
+
+VulkanTextureStreamer::VulkanTextureStreamer(const VkObj<VkDevice>& in_device, std::shared_ptr<VulkanMemoryHelper> in_memory,
+	const VulkanBufferFactory& in_bufferFactory, const VulkanTextureFactory& in_textureFactory,
+	std::shared_ptr<VulkanDeletionQueue> in_deletionQueue, JobSystem* in_jobSystem/* = nullptr*/, VkDeviceSize in_budget/* = 0*/)
+	: m_device(in_device)
+	, m_memory(in_memory)
+	, m_bufferFactory(in_bufferFactory)
+	, m_textureFactory(in_textureFactory)
+	, m_deletionQueue(in_deletionQueue)
+	, m_jobSystem(in_jobSystem)
+	, m_maxUploadPerFrame(c_defaultMaxUploadPerFrame)
+	, m_updateIdx(0)
+{
+	m_stats.m_budget = in_budget;
+	if (m_stats.m_budget == 0 && m_memory)
+	{
+		VkPhysicalDeviceMemoryProperties memoryProperties = m_memory->GetAvailableMemoryProperties();
+		VkDeviceSize largestHeap = 0;
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i)
+		{
+			if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+				largestHeap = std::max(largestHeap, memoryProperties.memoryHeaps[i].size);
+		}
+		m_stats.m_budget = static_cast<uint64_t>(static_cast<double>(largestHeap) * c_defaultBudgetFraction);
+	}
+}
+
+VulkanTextureStreamer::~VulkanTextureStreamer()
+{
+	// The GPU may still be copying out of staging, the new images are dropped
+	for (const Submission& submission : m_submissions)
+		m_bufferFactory.FinishOneShot(submission.m_oneShot, true);
+	// A job may still be copying into staging
+	for (auto& entry : m_entries)
+	{
+		if (entry->m_load)
+		{
+			if (m_jobSystem)
+				m_jobSystem->Wait(entry->m_load->m_done);
+			FreeLoad(*entry->m_load);
+		}
+	}
+}
+
+VulkanTextureStreamer::Handle VulkanTextureStreamer::Add(const std::string& in_path)
+{
+	std::unique_ptr<Entry> entry = std::make_unique<Entry>();
+	entry->m_handle = static_cast<Handle>(m_entries.size());
+	entry->m_path = in_path;
+	entry->m_file = std::make_unique<MappedFile>();
+	if (!entry->m_file->Open(in_path))
+	{
+		LOG("Could not open texture file: " << in_path);
+		return c_invalidHandle;
+	}
+	std::string parseError;
+	if (!TextureFile::Parse(entry->m_file->GetData(), entry->m_file->GetSize(), entry->m_description, parseError))
+	{
+		LOG("Invalid texture file " << in_path << ": " << parseError);
+		return c_invalidHandle;
+	}
+
+	// Files without mips are resident as a whole
+	const TextureFile::Description& description = entry->m_description;
+	entry->m_tailMip = description.m_mipCount - 1;
+	for (uint32_t mip = 0; mip < description.m_mipCount; ++mip)
+	{
+		if (std::max(description.m_width >> mip, 1u) <= c_tailSize && std::max(description.m_height >> mip, 1u) <= c_tailSize)
+		{
+			entry->m_tailMip = mip;
+			break;
+		}
+	}
+	entry->m_residentMip = description.m_mipCount;
+	entry->m_wantedMip = entry->m_tailMip;
+	entry->m_lastRequest = m_updateIdx;
+	entry->m_changing = false;
+
+	entry->m_load = StartLoad(*entry, entry->m_tailMip);
+	if (!entry->m_load)
+		return c_invalidHandle;
+	if (m_jobSystem)
+		m_jobSystem->Wait(entry->m_load->m_done);
+	std::vector<Change> changes;
+	if (!PrepareChange(*entry, entry->m_tailMip, changes))
+	{
+		FreeLoad(*entry->m_load);
+		return c_invalidHandle;
+	}
+	// The tail is needed right away
+	ApplyChanges(changes);
+	FinishChanges(true);
+
+	m_stats.m_residentBytes += entry->m_texture->m_memorySize;
+	m_entries.push_back(std::move(entry));
+	return m_entries.back()->m_handle;
+}
+
+void VulkanTextureStreamer::Update(const std::vector<Request>& in_requests)
+{
+	++m_updateIdx;
+	m_stats.m_streamedBytes = 0;
+	m_stats.m_evictedBytes = 0;
+	m_stats.m_requests = 0;
+	m_stats.m_hits = 0;
+
+	FinishChanges(false);
+
+	// The finest mip asked for this frame, a hit if it is already there
+	for (const Request& request : in_requests)
+	{
+		if (request.m_handle >= m_entries.size())
+			continue;
+		Entry& entry = *m_entries[request.m_handle];
+		const TextureFile::Description& description = entry.m_description;
+		uint32_t mip = std::min(GetDesiredMip(description.m_width, description.m_height, request.m_screenSize), entry.m_tailMip);
+		entry.m_wantedMip = entry.m_lastRequest == m_updateIdx ? std::min(entry.m_wantedMip, mip) : mip;
+		entry.m_lastRequest = m_updateIdx;
+		++m_stats.m_requests;
+		if (entry.m_residentMip <= mip)
+			++m_stats.m_hits;
+	}
+	for (auto& entry : m_entries)
+	{
+		if (m_updateIdx - entry->m_lastRequest > c_idleUpdates)
+			entry->m_wantedMip = entry->m_tailMip;
+	}
+
+	std::vector<Change> changes;
+
+	// Finished loads, at least one per frame however big
+	for (auto& entry : m_entries)
+	{
+		Load* load = entry->m_load.get();
+		if (!load || entry->m_changing || m_stats.m_streamedBytes >= m_maxUploadPerFrame)
+			continue;
+		if (!load->m_done.IsDone())
+			continue;
+		// Only lets the finished job release the counter
+		if (m_jobSystem)
+			m_jobSystem->Wait(load->m_done);
+		if (PrepareChange(*entry, load->m_topMip, changes))
+		{
+			m_stats.m_streamedBytes += load->m_size;
+		}
+		else
+		{
+			FreeLoad(*load);
+			entry->m_load.reset();
+		}
+	}
+
+	// New loads, the textures furthest from what they need first
+	uint64_t projectedBytes = 0;
+	std::vector<Entry*> candidates;
+	for (auto& entry : m_entries)
+	{
+		projectedBytes += entry->m_texture->m_memorySize;
+		if (entry->m_load)
+			projectedBytes += entry->m_load->m_size;
+		else if (!entry->m_changing && entry->m_wantedMip < entry->m_residentMip && entry->m_lastRequest == m_updateIdx)
+			candidates.push_back(entry.get());
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const Entry* in_a, const Entry* in_b)
+	{
+		return in_a->m_residentMip - in_a->m_wantedMip > in_b->m_residentMip - in_b->m_wantedMip;
+	});
+	for (Entry* entry : candidates)
+	{
+		// As many of the wanted mips as fit, from the bottom up
+		uint32_t topMip = entry->m_wantedMip;
+		for (; topMip < entry->m_residentMip; ++topMip)
+		{
+			if (MakeRoom(GetPayloadSize(*entry, topMip, entry->m_residentMip), entry, projectedBytes, changes))
+				break;
+		}
+		if (topMip < entry->m_residentMip)
+		{
+			entry->m_load = StartLoad(*entry, topMip);
+			if (entry->m_load)
+				projectedBytes += entry->m_load->m_size;
+		}
+	}
+
+	ApplyChanges(changes);
+
+	m_stats.m_residentBytes = 0;
+	m_stats.m_pendingBytes = 0;
+	for (auto& entry : m_entries)
+	{
+		m_stats.m_residentBytes += entry->m_texture->m_memorySize;
+		if (entry->m_load)
+			m_stats.m_pendingBytes += entry->m_load->m_size;
+	}
+}
+
+const std::shared_ptr<VulkanTexture>& VulkanTextureStreamer::GetTexture(Handle in_handle) const
+{
+	ERROR_IF(in_handle >= m_entries.size(), "Invalid streamed texture handle " << in_handle);
+	return m_entries[in_handle]->m_texture;
+}
+
+uint32_t VulkanTextureStreamer::GetResidentMip(Handle in_handle) const
+{
+	ERROR_IF(in_handle >= m_entries.size(), "Invalid streamed texture handle " << in_handle);
+	return m_entries[in_handle]->m_residentMip;
+}
+
+uint32_t VulkanTextureStreamer::GetDesiredMip(uint32_t in_width, uint32_t in_height, float in_screenSize)
+{
+	float texels = static_cast<float>(std::max(in_width, in_height));
+	if (!(in_screenSize > 0.0f))
+		return 31;
+	if (in_screenSize >= texels)
+		return 0;
+	return static_cast<uint32_t>(std::floor(std::log2(texels / in_screenSize)));
+}
+
+uint64_t VulkanTextureStreamer::GetPayloadSize(const Entry& in_entry, uint32_t in_topMip, uint32_t in_endMip) const
+{
+	uint64_t size = 0;
+	for (const TextureFile::Subresource& subresource : in_entry.m_description.m_subresources)
+	{
+		if (subresource.m_mip >= in_topMip && subresource.m_mip < in_endMip)
+			size += subresource.m_size;
+	}
+	return size;
+}
+
+std::unique_ptr<VulkanTextureStreamer::Load> VulkanTextureStreamer::StartLoad(const Entry& in_entry, uint32_t in_topMip)
+{
+	std::unique_ptr<Load> load = std::make_unique<Load>();
+	load->m_topMip = in_topMip;
+	load->m_size = 0;
+
+	// Where each subresource goes in staging, and where it comes from in the file
+	struct Copy
+	{
+		VkDeviceSize   m_dstOffset;
+		const uint8_t* m_src;
+		size_t         m_size;
+	};
+	std::vector<Copy> copies;
+	for (const TextureFile::Subresource& subresource : in_entry.m_description.m_subresources)
+	{
+		if (subresource.m_mip < in_topMip || subresource.m_mip >= in_entry.m_residentMip)
+			continue;
+		VkDeviceSize offset = VulkanTextureFactory::AddStagingRegion(subresource, load->m_size, load->m_regions);
+		copies.push_back({ offset, in_entry.m_file->GetData() + subresource.m_offset, static_cast<size_t>(subresource.m_size) });
+	}
+
+	if (!m_bufferFactory.CreateBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, load->m_size, nullptr, load->m_stagingBuffer, load->m_stagingMemory,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+	{
+		LOG("Could not create staging for " << in_entry.m_path << " mip " << in_topMip);
+		return nullptr;
+	}
+	VkResult err = vkMapMemory(m_device, load->m_stagingMemory, 0, load->m_size, 0, reinterpret_cast<void**>(&load->m_mapped));
+	ERROR_IF(err, "Map texture streaming staging buffer: " << vkTools::errorString(err));
+
+	// Reading the file is what takes time, the pages are faulted in by the copy
+	uint8_t* mapped = load->m_mapped;
+	std::function<void()> copy = [mapped, copies]()
+	{
+		for (const Copy& part : copies)
+			memcpy(mapped + part.m_dstOffset, part.m_src, part.m_size);
+	};
+	if (m_jobSystem)
+		m_jobSystem->Run(copy, &load->m_done);
+	else
+		copy();
+	return load;
+}
+
+void VulkanTextureStreamer::FreeLoad(Load& inout_load) const
+{
+	vkUnmapMemory(m_device, inout_load.m_stagingMemory);
+	vkDestroyBuffer(m_device, inout_load.m_stagingBuffer, nullptr);
+	vkFreeMemory(m_device, inout_load.m_stagingMemory, nullptr);
+}
+
+bool VulkanTextureStreamer::MakeRoom(uint64_t in_bytes, const Entry* in_except, uint64_t& inout_projectedBytes, std::vector<Change>& inout_changes)
+{
+	if (inout_projectedBytes + in_bytes <= m_stats.m_budget)
+		return true;
+
+	// Textures with mips above what they want, least recently asked for first.
+	// The ones changing or loading already are left alone.
+	std::vector<Entry*> victims;
+	for (auto& entry : m_entries)
+	{
+		if (entry.get() == in_except || entry->m_load || entry->m_changing || entry->m_residentMip >= entry->m_wantedMip)
+			continue;
+		bool changing = false;
+		for (const Change& change : inout_changes)
+			changing |= change.m_entry == entry.get();
+		if (!changing)
+			victims.push_back(entry.get());
+	}
+	std::sort(victims.begin(), victims.end(), [](const Entry* in_a, const Entry* in_b)
+	{
+		return in_a->m_lastRequest < in_b->m_lastRequest;
+	});
+
+	for (Entry* victim : victims)
+	{
+		uint64_t freed = GetPayloadSize(*victim, victim->m_residentMip, victim->m_wantedMip);
+		if (!PrepareChange(*victim, victim->m_wantedMip, inout_changes))
+			continue;
+		// Gone first when the frames in flight are done with it, the budget is a target rather than a hard limit
+		inout_projectedBytes -= std::min(freed, inout_projectedBytes);
+		m_stats.m_evictedBytes += freed;
+		if (inout_projectedBytes + in_bytes <= m_stats.m_budget)
+			return true;
+	}
+	return false;
+}
+
+bool VulkanTextureStreamer::PrepareChange(Entry& inout_entry, uint32_t in_topMip, std::vector<Change>& inout_changes)
+{
+	const TextureFile::Description& description = inout_entry.m_description;
+	TextureFile::Description residentDescription;
+	residentDescription.m_format = description.m_format;
+	residentDescription.m_width = std::max(description.m_width >> in_topMip, 1u);
+	residentDescription.m_height = std::max(description.m_height >> in_topMip, 1u);
+	residentDescription.m_mipCount = description.m_mipCount - in_topMip;
+	residentDescription.m_layerCount = description.m_layerCount;
+	residentDescription.m_cube = description.m_cube;
+
+	// Source of the copies when the range changes again
+	std::shared_ptr<VulkanTexture> texture = std::make_shared<VulkanTexture>(m_device, m_deletionQueue);
+	if (!m_textureFactory.CreateImage(residentDescription,
+		VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, *texture))
+	{
+		LOG("Could not create the image for mip " << in_topMip << " of " << inout_entry.m_path);
+		return false;
+	}
+	inout_changes.push_back({ &inout_entry, in_topMip, texture });
+	return true;
+}
+
+void VulkanTextureStreamer::ApplyChanges(std::vector<Change>& inout_changes)
+{
+	if (inout_changes.empty())
+		return;
+
+	Submission submission;
+	submission.m_oneShot = m_bufferFactory.SubmitOneShotAsync([&](VkCommandBuffer in_commandBuffer)
+	{
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+
+		// New images are written whole, the kept mips of the old ones are read after the
+		// frames submitted before have sampled them
+		std::vector<VkImageMemoryBarrier> preBarriers;
+		std::vector<VkImageMemoryBarrier> postBarriers;
+		for (const Change& change : inout_changes)
+		{
+			const Entry& entry = *change.m_entry;
+			const VulkanTexture& texture = *change.m_texture;
+			barrier.image = texture.m_image;
+			barrier.subresourceRange.baseMipLevel = 0;
+			barrier.subresourceRange.levelCount = texture.m_mipCount;
+			barrier.subresourceRange.layerCount = texture.m_layerCount;
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			preBarriers.push_back(barrier);
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			postBarriers.push_back(barrier);
+
+			uint32_t keptMip = std::max(change.m_topMip, entry.m_residentMip);
+			if (entry.m_texture && keptMip < entry.m_description.m_mipCount)
+			{
+				barrier.image = entry.m_texture->m_image;
+				barrier.subresourceRange.baseMipLevel = keptMip - entry.m_residentMip;
+				barrier.subresourceRange.levelCount = entry.m_description.m_mipCount - keptMip;
+				barrier.srcAccessMask = 0;
+				barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+				barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+				preBarriers.push_back(barrier);
+				// Back for the frames that still sample it
+				barrier.srcAccessMask = 0;
+				barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+				barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				postBarriers.push_back(barrier);
+			}
+		}
+		vkCmdPipelineBarrier(in_commandBuffer, c_shaderStages, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(preBarriers.size()), preBarriers.data());
+
+		for (const Change& change : inout_changes)
+		{
+			const Entry& entry = *change.m_entry;
+			const TextureFile::Description& description = entry.m_description;
+			VkImage image = change.m_texture->m_image;
+
+			std::vector<VkImageCopy> imageCopies;
+			for (uint32_t mip = std::max(change.m_topMip, entry.m_residentMip); entry.m_texture && mip < description.m_mipCount; ++mip)
+			{
+				VkImageCopy imageCopy = {};
+				imageCopy.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - entry.m_residentMip, 0, description.m_layerCount };
+				imageCopy.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - change.m_topMip, 0, description.m_layerCount };
+				imageCopy.extent = { std::max(description.m_width >> mip, 1u), std::max(description.m_height >> mip, 1u), 1 };
+				imageCopies.push_back(imageCopy);
+			}
+			if (!imageCopies.empty())
+			{
+				vkCmdCopyImage(in_commandBuffer, entry.m_texture->m_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(imageCopies.size()), imageCopies.data());
+			}
+
+			const Load* load = entry.m_load.get();
+			if (load && load->m_topMip == change.m_topMip)
+			{
+				std::vector<VkBufferImageCopy> regions = load->m_regions;
+				for (VkBufferImageCopy& region : regions)
+					region.imageSubresource.mipLevel -= change.m_topMip;
+				vkCmdCopyBufferToImage(in_commandBuffer, load->m_stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					static_cast<uint32_t>(regions.size()), regions.data());
+			}
+		}
+
+		vkCmdPipelineBarrier(in_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, c_shaderStages,
+			0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(postBarriers.size()), postBarriers.data());
+	});
+
+	for (Change& change : inout_changes)
+		change.m_entry->m_changing = true;
+	submission.m_changes.swap(inout_changes);
+	m_submissions.push_back(std::move(submission));
+}
+
+void VulkanTextureStreamer::FinishChanges(bool in_wait)
+{
+	// Submits execute in order, the first one not done yet holds up the rest
+	size_t finished = 0;
+	for (; finished < m_submissions.size(); ++finished)
+	{
+		Submission& submission = m_submissions[finished];
+		if (!m_bufferFactory.FinishOneShot(submission.m_oneShot, in_wait))
+			break;
+
+		// The copies are done, staging can go right away. The previous
+		// versions go through the deletion queue when their last user drops them.
+		for (Change& change : submission.m_changes)
+		{
+			Entry& entry = *change.m_entry;
+			if (entry.m_load && entry.m_load->m_topMip == change.m_topMip)
+			{
+				FreeLoad(*entry.m_load);
+				entry.m_load.reset();
+			}
+			std::shared_ptr<VulkanTexture> previous = entry.m_texture;
+			entry.m_texture = change.m_texture;
+			entry.m_residentMip = change.m_topMip;
+			entry.m_changing = false;
+			if (previous && m_residencyCallback)
+				m_residencyCallback(entry.m_handle, entry.m_texture, previous);
+		}
+	}
+	m_submissions.erase(m_submissions.begin(), m_submissions.begin() + finished);
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "vulkan/vulkan.h"
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include "VkObj.h"
+#include "TextureFile.h"
+#include "JobSystem.h"
+#include "VulkanBufferFactory.h"
+
+// Stream the texture of VulkanGraphics instead of loading all of it up front
+//#define USE_TEXTURE_STREAMING
+
+class VulkanMemoryHelper;
+class VulkanDeletionQueue;
+class VulkanTextureFactory;
+class VulkanTexture;
+class MappedFile;
+
+/*!
+* \class VulkanTextureStreamer
+*
+* \brief
+*
+* Keeps only the mips of a texture that are needed on screen in GPU memory, so texture
+* sets larger than the device local heap can be used. Each texture has a resident range,
+* from its finest resident mip down to the smallest. The mips of c_tailSize and below
+* are loaded when the texture is added and always stay.
+*
+* Demand comes as requests with the screen size of each texture, once per frame. Missing
+* mips are read from the memory mapped file into staging memory as jobs, and put in
+* on a later Update, a limited number of bytes per frame. When the resident mips would go
+* over the budget, mips above what was last asked for are evicted, least recently
+* requested textures first. Mips that are asked for are never evicted for another texture,
+* its load is cut down to what fits instead.
+*
+* There is no sparse binding, a new resident range means a new image. The mips kept are
+* copied over from the old image on the GPU, new ones from staging, all the changes of an
+* Update in one submit. The submit is not waited on, a later Update polls its fence and only
+* then the new image and view replace the old as a new VulkanTexture, and the previous one
+* is passed to the residency callback. Textures stay out of new changes until then. Dropping it hands its objects
+* to the deletion queue, so frames in flight can keep sampling it (see
+* VulkanBindlessTable::UpdateSampledImage for moving a descriptor over).
+*
+* Not thread safe, Add and Update go on the thread that draws.
+*/
+
+class VulkanTextureStreamer
+{
+public:
+	typedef uint32_t Handle;
+	static const Handle c_invalidHandle = 0xFFFFFFFF;
+
+	// Mips with a width and height at or below this are always resident
+	static const uint32_t c_tailSize = 64;
+
+	// The budget when none is given, of the largest device local heap
+	static const float c_defaultBudgetFraction;
+
+	// Demand of one texture for one frame
+	struct Request
+	{
+		Handle m_handle;
+		// Pixels on screen across the longest side of the texture, the finest mip needed has about as many texels
+		float  m_screenSize;
+	};
+
+	// Counters of the last Update, and totals
+	struct Stats
+	{
+		Stats() : m_streamedBytes(0), m_evictedBytes(0), m_requests(0), m_hits(0), m_residentBytes(0), m_pendingBytes(0), m_budget(0) {}
+
+		// Fraction of the requests that had their mip resident when asked
+		float GetHitRate() const { return m_requests > 0 ? static_cast<float>(m_hits) / static_cast<float>(m_requests) : 1.0f; }
+
+		uint64_t m_streamedBytes; // uploaded this frame
+		uint64_t m_evictedBytes;  // dropped this frame
+		uint32_t m_requests;
+		uint32_t m_hits;
+		uint64_t m_residentBytes;
+		uint64_t m_pendingBytes;  // loads in flight
+		uint64_t m_budget;
+	};
+
+	// Called when a texture got a new image and view, with the previous version
+	typedef std::function<void(Handle in_handle, const std::shared_ptr<VulkanTexture>& in_texture,
+		const std::shared_ptr<VulkanTexture>& in_previous)> ResidencyCallback;
+
+	// An in_budget of 0 takes c_defaultBudgetFraction of the largest device local heap.
+	// Without a job system the loads are done in Update.
+	VulkanTextureStreamer(const VkObj<VkDevice>& in_device, std::shared_ptr<VulkanMemoryHelper> in_memory,
+		const VulkanBufferFactory& in_bufferFactory, const VulkanTextureFactory& in_textureFactory,
+		std::shared_ptr<VulkanDeletionQueue> in_deletionQueue, JobSystem* in_jobSystem = nullptr, VkDeviceSize in_budget = 0);
+	~VulkanTextureStreamer();
+
+	// Open a KTX2 or DDS file and load its smallest mips. The file stays mapped while streamed.
+	Handle Add(const std::string& in_path);
+
+	void SetResidencyCallback(const ResidencyCallback& in_callback) { m_residencyCallback = in_callback; }
+	void SetBudget(VkDeviceSize in_budget) { m_stats.m_budget = in_budget; }
+	void SetMaxUploadPerFrame(VkDeviceSize in_bytes) { m_maxUploadPerFrame = in_bytes; }
+
+	// Once per frame, after the fence wait. Puts in finished loads, starts new ones for
+	// in_requests and evicts to stay in the budget.
+	void Update(const std::vector<Request>& in_requests);
+
+	const std::shared_ptr<VulkanTexture>& GetTexture(Handle in_handle) const;
+	uint32_t                              GetResidentMip(Handle in_handle) const;
+	const Stats&                          GetStats() const { return m_stats; }
+
+	// Finest mip worth having for a texture covering in_screenSize pixels
+	static uint32_t GetDesiredMip(uint32_t in_width, uint32_t in_height, float in_screenSize);
+
+private:
+	// Mips [m_topMip, the resident mip of the texture) read into staging
+	struct Load
+	{
+		uint32_t                       m_topMip;
+		VkBuffer                       m_stagingBuffer;
+		VkDeviceMemory                 m_stagingMemory;
+		uint8_t*                       m_mapped;
+		VkDeviceSize                   m_size;
+		std::vector<VkBufferImageCopy> m_regions; // absolute mip levels
+		JobCounter                     m_done; // the copy into staging
+	};
+
+	struct Entry
+	{
+		Handle                         m_handle;
+		std::string                    m_path;
+		std::unique_ptr<MappedFile>    m_file;
+		TextureFile::Description       m_description;
+		std::shared_ptr<VulkanTexture> m_texture;
+		uint32_t                       m_residentMip;
+		uint32_t                       m_tailMip;
+		uint32_t                       m_wantedMip;
+		uint64_t                       m_lastRequest; // update index
+		std::unique_ptr<Load>          m_load;
+		bool                           m_changing; // in a submission
+	};
+
+	// A texture getting a new resident range in this Update
+	struct Change
+	{
+		Entry*                         m_entry;
+		uint32_t                       m_topMip;
+		std::shared_ptr<VulkanTexture> m_texture;
+	};
+
+	// The changes of one ApplyChanges, while the GPU copies them
+	struct Submission
+	{
+		VulkanBufferFactory::OneShot   m_oneShot;
+		std::vector<Change>            m_changes;
+	};
+
+	// Size in the file of mips [in_topMip, in_endMip) of every layer
+	uint64_t GetPayloadSize(const Entry& in_entry, uint32_t in_topMip, uint32_t in_endMip) const;
+
+	std::unique_ptr<Load> StartLoad(const Entry& in_entry, uint32_t in_topMip);
+	void                  FreeLoad(Load& inout_load) const;
+	// Drop mips above the wanted ones of other textures until in_bytes fit, returns false if they don't
+	bool                  MakeRoom(uint64_t in_bytes, const Entry* in_except, uint64_t& inout_projectedBytes, std::vector<Change>& inout_changes);
+	bool                  PrepareChange(Entry& inout_entry, uint32_t in_topMip, std::vector<Change>& inout_changes);
+	// Copy the kept and loaded mips of every change into the new images in one submit
+	void                  ApplyChanges(std::vector<Change>& inout_changes);
+	// Swap in the new images of the submissions that are done, or of all of them with in_wait
+	void                  FinishChanges(bool in_wait);
+
+	const VkObj<VkDevice>&               m_device;
+	std::shared_ptr<VulkanMemoryHelper>  m_memory;
+	const VulkanBufferFactory&           m_bufferFactory;
+	const VulkanTextureFactory&          m_textureFactory;
+	std::shared_ptr<VulkanDeletionQueue> m_deletionQueue;
+	JobSystem*                           m_jobSystem;
+
+	std::vector<std::unique_ptr<Entry>>  m_entries;
+	std::vector<Submission>              m_submissions; // oldest first
+	ResidencyCallback                    m_residencyCallback;
+	VkDeviceSize                         m_maxUploadPerFrame;
+	uint64_t                             m_updateIdx;
+	Stats                                m_stats;
+};
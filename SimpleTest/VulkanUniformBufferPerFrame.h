@@ -27,9 +27,8 @@ struct VulkanUniformBufferPerFrame
 
 	struct BufferDataLayout
 	{
-		glm::mat4 m_projectionMatrix;
-		glm::mat4 m_worldMatrix;
-		glm::mat4 m_viewMatrix;
+		// Projection * view * world, multiplied once here instead of per vertex
+		glm::mat4 m_modelViewProjection;
 	};
 
 	VulkanUniformBufferPerFrame(const VkObj<VkDevice>& in_device)
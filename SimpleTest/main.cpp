@@ -2,9 +2,21 @@
 #include "ErrorReporting.h"
 #include "Wnd.h"
 #include "VulkanGraphics.h"
+#include "Benchmarks.h"
+#include "RenderSnapshot.h"
+#include "SnapshotExchange.h"
+#include <thread>
+#include <atomic>
 
 int main(int argc, char* argv[])
 {
+	// Micro-benchmarks only, no window
+	if (argc > 1 && std::string(argv[1]) == "-bench")
+	{
+		Benchmarks::RunAll();
+		return 0;
+	}
+
 	int width = 800, height = 600;
 	std::unique_ptr<VulkanGraphics> vulkanGraphics = nullptr;
 
@@ -16,7 +28,10 @@ int main(int argc, char* argv[])
 		HINSTANCE hInstance;
 		HWND hWnd;
 		Wnd::GetPlatformWindowInfo(hWnd, hInstance);
-		vulkanGraphics = std::make_unique<VulkanGraphics>(hWnd, hInstance, width, height);
+		// Optional mesh file to view as first argument, and a texture for it as second
+		std::string meshPath = argc > 1 ? argv[1] : "";
+		std::string texturePath = argc > 2 ? argv[2] : "";
+		vulkanGraphics = std::make_unique<VulkanGraphics>(hWnd, hInstance, width, height, meshPath, texturePath);
 	}
 	catch (ProgramError& e)
 	{
@@ -29,8 +44,35 @@ int main(int argc, char* argv[])
 		return -1;
 	}
 
-	// Main loop
-	bool run = true;
+	// Pipelined main loop
+	// This thread handles the window and prepares frame N+1 while the render thread draws frame N,
+	// the snapshots of the two frames are handed over without locking. Each side sleeps while waiting
+	// on the other, but wakes up regularly to see if it should stop.
+	const std::chrono::milliseconds waitTimeout(10);
+	std::atomic<bool> run(true);
+	SnapshotExchange<RenderSnapshot> snapshots;
+	std::string renderError;
+
+	std::thread renderThread([&]()
+	{
+		try
+		{
+			while (run)
+			{
+				const RenderSnapshot* snapshot = snapshots.WaitRead(waitTimeout);
+				if (!snapshot)
+					continue;
+				vulkanGraphics->Render(*snapshot);
+				snapshots.EndRead();
+			}
+		}
+		catch (ProgramError& e)
+		{
+			renderError = e.what();
+			run = false;
+		}
+	});
+
 	std::vector<Wnd::WndEvent> events;
 	while (run)
 	{
@@ -44,10 +86,19 @@ int main(int argc, char* argv[])
 		// Main code
 		// ========================
 
-		vulkanGraphics->Render();
+		// Both snapshots are taken while the render thread is behind, keep the window responsive meanwhile
+		RenderSnapshot* snapshot = snapshots.WaitWrite(waitTimeout);
+		if (!snapshot)
+			continue;
+		vulkanGraphics->PrepareFrame(*snapshot);
+		snapshots.EndWrite();
 
 		// ========================
 	}
+	renderThread.join();
+
+	if (!renderError.empty())
+		MessageBox(0, renderError.c_str(), "Error!", MB_OK);
 
 
 	// Cleanup
@@ -0,0 +1,32 @@
+// The bindless table (see VulkanBindlessTable), include with GL_GOOGLE_include_directive.
+// Indices come from push constants or instance data, wrap them in nonuniformEXT when they
+// can differ within a draw, as for per instance materials. That needs the non uniform
+// indexing features, which the table only enables where the device has them.
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Immutable samplers, in the order of VulkanSamplerCache::CommonSampler
+#define SAMPLER_LINEAR_REPEAT  0
+#define SAMPLER_LINEAR_CLAMP   1
+#define SAMPLER_NEAREST_REPEAT 2
+#define SAMPLER_NEAREST_CLAMP  3
+
+layout (set = 1, binding = 0) uniform sampler bindlessSamplers[];
+
+layout (set = 1, binding = 1) readonly buffer BindlessBuffer
+{
+	uint data[];
+} bindlessBuffers[];
+
+layout (set = 1, binding = 2) uniform texture2D bindlessTextures[];
+
+// Indices that are the same for the whole draw, as from push constants
+vec4 SampleBindless(uint in_textureIdx, uint in_samplerIdx, vec2 in_uv)
+{
+	return texture(sampler2D(bindlessTextures[in_textureIdx], bindlessSamplers[in_samplerIdx]), in_uv);
+}
+
+vec4 SampleBindlessNonUniform(uint in_textureIdx, uint in_samplerIdx, vec2 in_uv)
+{
+	return texture(sampler2D(bindlessTextures[nonuniformEXT(in_textureIdx)], bindlessSamplers[nonuniformEXT(in_samplerIdx)]), in_uv);
+}
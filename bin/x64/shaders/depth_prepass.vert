@@ -0,0 +1,20 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Position only triangle.vert for the depth prepass (see DepthPrepass)
+
+layout (location = 0) in vec3 inPos;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 modelViewProjection;
+} ubo;
+
+invariant gl_Position;
+
+void main() 
+{
+	gl_Position = ubo.modelViewProjection * vec4(inPos.xyz, 1.0);
+}
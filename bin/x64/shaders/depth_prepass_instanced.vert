@@ -0,0 +1,17 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Position only triangle_instanced.vert for the depth prepass (see DepthPrepass)
+
+layout (location = 0) in vec3 inPos;
+// One column per location, 2 to 5
+layout (location = 2) in mat4 inModelViewProjection;
+
+invariant gl_Position;
+
+void main() 
+{
+	gl_Position = inModelViewProjection * vec4(inPos.xyz, 1.0);
+}
@@ -0,0 +1,22 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// Position only triangle_push.vert for the depth prepass (see DepthPrepass)
+
+layout (location = 0) in vec3 inPos;
+
+layout (push_constant) uniform PushConstants
+{
+	mat4 modelViewProjection;
+	uint objectIdx;
+	uint materialIdx;
+} pushConstants;
+
+invariant gl_Position;
+
+void main() 
+{
+	gl_Position = pushConstants.modelViewProjection * vec4(inPos.xyz, 1.0);
+}
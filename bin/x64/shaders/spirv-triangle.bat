@@ -1,3 +1,13 @@
 glslangvalidator -V triangle.vert -o triangle.vert.spv
+glslangvalidator -V triangle_instanced.vert -o triangle_instanced.vert.spv
+glslangvalidator -V triangle_push.vert -o triangle_push.vert.spv
+glslangvalidator -V depth_prepass.vert -o depth_prepass.vert.spv
+glslangvalidator -V depth_prepass_instanced.vert -o depth_prepass_instanced.vert.spv
+glslangvalidator -V depth_prepass_push.vert -o depth_prepass_push.vert.spv
 glslangvalidator -V triangle.frag -o triangle.frag.spv
+glslangvalidator -V -DBINDLESS triangle.frag -o triangle_bindless.frag.spv
+glslangvalidator -V meshlet_cull.comp -o meshlet_cull.comp.spv
+glslangvalidator -V -DOCCLUSION_CULLING meshlet_cull.comp -o meshlet_cull_occlusion.comp.spv
+glslangvalidator -V hiz_reduce.comp -o hiz_reduce.comp.spv
+glslangvalidator -V -DMULTISAMPLED hiz_reduce.comp -o hiz_reduce_ms.comp.spv
 
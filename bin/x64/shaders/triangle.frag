@@ -2,12 +2,33 @@
 
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
+#extension GL_GOOGLE_include_directive : enable
+
+// Compiled with BINDLESS the color is modulated by the material texture, from the bindless table
+
+#ifdef BINDLESS
+#include "bindless.glsl"
+#endif
 
 layout (location = 0) in vec3 inColor;
+layout (location = 1) in vec2 inUV;
 
 layout (location = 0) out vec4 outFragColor;
 
+#ifdef BINDLESS
+layout (push_constant) uniform PushConstants
+{
+	mat4 modelViewProjection;
+	uint objectIdx;
+	uint materialIdx; // texture in the bindless table, 0xFFFFFFFF for none
+} pushConstants;
+#endif
+
 void main() 
 {
   outFragColor = vec4(inColor, 1.0);
+#ifdef BINDLESS
+  if (pushConstants.materialIdx != 0xFFFFFFFFu)
+    outFragColor *= SampleBindless(pushConstants.materialIdx, SAMPLER_LINEAR_REPEAT, inUV);
+#endif
 }
\ No newline at end of file
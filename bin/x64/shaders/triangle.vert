@@ -8,15 +8,18 @@ layout (location = 1) in vec3 inColor;
 
 layout (binding = 0) uniform UBO 
 {
-	mat4 projectionMatrix;
-	mat4 modelMatrix;
-	mat4 viewMatrix;
+	mat4 modelViewProjection;
 } ubo;
 
 layout (location = 0) out vec3 outColor;
+// Planar mapped over the mesh, which has no texture coordinates of its own (see triangle.frag)
+layout (location = 1) out vec2 outUV;
+// Matches the depth prepass exactly, for its EQUAL depth test
+invariant gl_Position;
 
 void main() 
 {
 	outColor = inColor;
-	gl_Position = ubo.projectionMatrix * ubo.viewMatrix * ubo.modelMatrix * vec4(inPos.xyz, 1.0);
+	outUV = inPos.xy * 0.5 + 0.5;
+	gl_Position = ubo.modelViewProjection * vec4(inPos.xyz, 1.0);
 }
@@ -0,0 +1,29 @@
+#version 450
+
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shading_language_420pack : enable
+
+// triangle.vert with the model-view-projection pushed per draw (see VulkanPushConstants)
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inColor;
+
+layout (push_constant) uniform PushConstants
+{
+	mat4 modelViewProjection;
+	uint objectIdx;
+	uint materialIdx;
+} pushConstants;
+
+layout (location = 0) out vec3 outColor;
+// Planar mapped over the mesh, which has no texture coordinates of its own (see triangle.frag)
+layout (location = 1) out vec2 outUV;
+// Matches the depth prepass exactly, for its EQUAL depth test
+invariant gl_Position;
+
+void main() 
+{
+	outColor = inColor;
+	outUV = inPos.xy * 0.5 + 0.5;
+	gl_Position = pushConstants.modelViewProjection * vec4(inPos.xyz, 1.0);
+}